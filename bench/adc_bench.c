@@ -0,0 +1,1937 @@
+//
+// Copyright (c) 2024 Jose Rodriguez
+// All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+//
+// Host microbenchmarks for the ADC component.  Each benchmark is run for an
+// increasing number of iterations until it takes at least BENCH_MIN_TIME_NS,
+// and reported as time and heap allocations per operation.  Allocations are
+// counted by wrapping malloc and friends at link time (see CMakeLists.txt).
+//
+// usage: adc_bench [substring]   run only benchmarks whose name contains substring
+//
+
+#include <inttypes.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "context.h"
+#include "defaultatoms.h"
+#include "esp_adc/adc_continuous.h"
+#include "esp_adc/adc_oneshot.h"
+#include "esp_partition.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "globalcontext.h"
+#include "host_avm.h"
+#include "term.h"
+
+#include "adc_arbiter.h"
+#include "adc_calib.h"
+#include "adc_codec.h"
+#include "adc_credit.h"
+#include "adc_fft.h"
+#include "adc_filter.h"
+#include "adc_metrics.h"
+#include "adc_recorder.h"
+#include "adc_registry.h"
+#include "adc_ring.h"
+#include "adc_sim.h"
+#include "adc_stats.h"
+#include "adc_stream.h"
+#include "adc_unit.h"
+#include "adc_watch.h"
+#include "adc_worker.h"
+#include "atomvm_adc.h"
+
+#define BENCH_MIN_TIME_NS 200000000ULL
+#define BENCH_PIN 34
+#define BENCH_ADC2_PIN 25
+#define BENCH_DITHER_PIN 4
+#define BENCH_PARKED_READS 8
+#define BENCH_CAPTURE_SAMPLES 1024
+#define BENCH_FRAME_BYTES 256
+#define BENCH_PARTITION "adc_log"
+// four sectors of eight full blocks
+#define BENCH_PARTITION_SIZE (4 * ADC_RECORDER_SECTOR_SIZE)
+#define BENCH_SECTOR_BLOCKS (ADC_RECORDER_SECTOR_SIZE / ADC_RECORDER_BLOCK_SIZE)
+
+/*---------------------------------------------------------------
+        Allocation counting
+---------------------------------------------------------------*/
+
+static uint64_t alloc_count;
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t nmemb, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+void __real_free(void *ptr);
+
+void *__wrap_malloc(size_t size)
+{
+    __atomic_add_fetch(&alloc_count, 1, __ATOMIC_RELAXED);
+    return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t nmemb, size_t size)
+{
+    __atomic_add_fetch(&alloc_count, 1, __ATOMIC_RELAXED);
+    return __real_calloc(nmemb, size);
+}
+
+void *__wrap_realloc(void *ptr, size_t size)
+{
+    __atomic_add_fetch(&alloc_count, 1, __ATOMIC_RELAXED);
+    return __real_realloc(ptr, size);
+}
+
+void __wrap_free(void *ptr)
+{
+    __real_free(ptr);
+}
+
+/*---------------------------------------------------------------
+        Fixture
+---------------------------------------------------------------*/
+
+static struct ADCUnit unit;
+static struct ADCChannel *channel;
+static volatile uint32_t sink;
+
+static uint16_t capture_out[BENCH_CAPTURE_SAMPLES * 2];
+static uint16_t raw_buffer[BENCH_CAPTURE_SAMPLES];
+static uint8_t frame[BENCH_FRAME_BYTES];
+static uint16_t frame_samples[BENCH_FRAME_BYTES / SOC_ADC_DIGI_RESULT_BYTES];
+
+static SemaphoreHandle_t job_done;
+
+static struct ADCUnit unit2;
+static struct ADCChannel *channel2;
+static SemaphoreHandle_t parked_done;
+
+static void fixture_init(void)
+{
+    if (adc_registry_init() != ESP_OK || adc_sim_init() != ESP_OK || adc_unit_init(&unit, &adc_backend_oneshot, ADC_UNIT_1) != ESP_OK) {
+        fprintf(stderr, "failed to initialize unit\n");
+        exit(EXIT_FAILURE);
+    }
+    channel = adc_unit_channel(&unit, BENCH_PIN);
+    if (channel == NULL
+        || adc_unit_config_channel(&unit, channel, ADC_BITWIDTH_12, ADC_ATTEN_DB_12, ADC_UNIT_DEFAULT_SAMPLES) != ESP_OK
+        || adc_unit_calibrate_channel(&unit, channel, ADC_ATTEN_DB_12, ADC_BITWIDTH_12) != ESP_OK) {
+        fprintf(stderr, "failed to configure channel\n");
+        exit(EXIT_FAILURE);
+    }
+
+    for (size_t i = 0; i < BENCH_CAPTURE_SAMPLES; ++i) {
+        raw_buffer[i] = host_adc_oneshot_synthetic_value(ADC_CHANNEL_6, i);
+    }
+    for (size_t i = 0; i < sizeof(frame) / SOC_ADC_DIGI_RESULT_BYTES; ++i) {
+        adc_digi_output_data_t record = { 0 };
+        record.type1.channel = i % 4;
+        record.type1.data = i * 13;
+        memcpy(frame + i * SOC_ADC_DIGI_RESULT_BYTES, &record, SOC_ADC_DIGI_RESULT_BYTES);
+    }
+
+    if (adc_worker_init(ADC_WORKER_LANES) != ESP_OK || (job_done = xSemaphoreCreateBinary()) == NULL) {
+        fprintf(stderr, "failed to start worker\n");
+        exit(EXIT_FAILURE);
+    }
+
+    if (adc_unit_init(&unit2, &adc_backend_oneshot, ADC_UNIT_2) != ESP_OK
+        || (channel2 = adc_unit_channel(&unit2, BENCH_ADC2_PIN)) == NULL
+        || adc_unit_config_channel(&unit2, channel2, ADC_BITWIDTH_12, ADC_ATTEN_DB_12, ADC_UNIT_DEFAULT_SAMPLES) != ESP_OK
+        || adc_arbiter_init() != ESP_OK || (parked_done = xSemaphoreCreateBinary()) == NULL) {
+        fprintf(stderr, "failed to initialize ADC2\n");
+        exit(EXIT_FAILURE);
+    }
+
+    // the mapping keeps the file alive once it is unlinked
+    char path[] = "/tmp/adc_bench_XXXXXX";
+    int fd = mkstemp(path);
+    if (fd < 0 || host_esp_partition_add(BENCH_PARTITION, path, BENCH_PARTITION_SIZE) != ESP_OK || adc_recorder_init() != ESP_OK) {
+        fprintf(stderr, "failed to create partition\n");
+        exit(EXIT_FAILURE);
+    }
+    close(fd);
+    unlink(path);
+}
+
+static void set_filter(bool filtered)
+{
+    struct ADCFilterChain *filter = NULL;
+    if (filtered) {
+        filter = malloc(sizeof(struct ADCFilterChain));
+        adc_filter_init(filter);
+        adc_filter_add_stage(filter, ADC_FILTER_MEDIAN, 5, NULL);
+        adc_filter_add_stage(filter, ADC_FILTER_EXPONENTIAL, 3, NULL);
+    }
+    adc_unit_set_filter(&unit, channel, filter);
+}
+
+/*---------------------------------------------------------------
+        Benchmarks
+---------------------------------------------------------------*/
+
+// a second user of an open unit shares its driver handle, so costs no driver memory
+static void bench_unit_open_close(uint64_t n)
+{
+    static struct ADCUnit other;
+    // the fixture's unit, and the handle the nif benches opened
+    uint32_t users = adc_registry_users(&adc_backend_oneshot, ADC_UNIT_1);
+    for (uint64_t i = 0; i < n; ++i) {
+        if (adc_unit_init(&other, &adc_backend_oneshot, ADC_UNIT_1) != ESP_OK || other.shared != unit.shared || adc_registry_users(&adc_backend_oneshot, ADC_UNIT_1) != users + 1) {
+            fprintf(stderr, "registry: second user did not share the unit\n");
+            exit(EXIT_FAILURE);
+        }
+        adc_unit_deinit(&other);
+    }
+    if (adc_registry_users(&adc_backend_oneshot, ADC_UNIT_1) != users) {
+        fprintf(stderr, "registry: %" PRIu32 " users left\n", adc_registry_users(&adc_backend_oneshot, ADC_UNIT_1));
+        exit(EXIT_FAILURE);
+    }
+}
+
+// the pin -> channel resolution done by every nif taking a pin
+static void bench_channel_lookup(uint64_t n)
+{
+    for (uint64_t i = 0; i < n; ++i) {
+        sink += adc_unit_channel(&unit, BENCH_PIN + (i & 1))->channel;
+    }
+}
+
+static void bench_config_channel(uint64_t n)
+{
+    for (uint64_t i = 0; i < n; ++i) {
+        sink += adc_unit_config_channel(&unit, channel, ADC_BITWIDTH_12, ADC_ATTEN_DB_12, ADC_UNIT_DEFAULT_SAMPLES);
+    }
+}
+
+static void bench_calibrate_cached(uint64_t n)
+{
+    for (uint64_t i = 0; i < n; ++i) {
+        sink += adc_unit_calibrate_channel(&unit, channel, ADC_ATTEN_DB_12, ADC_BITWIDTH_12);
+    }
+}
+
+static void read_n(uint64_t n, uint32_t samples)
+{
+    for (uint64_t i = 0; i < n; ++i) {
+        uint32_t reading;
+        adc_unit_read(&unit, channel, samples, &reading);
+        sink += adc_calib_to_mv(channel->cali, reading);
+    }
+}
+
+static void bench_read_1(uint64_t n)
+{
+    read_n(n, 1);
+}
+
+static void bench_read_64(uint64_t n)
+{
+    read_n(n, 64);
+}
+
+#define BENCH_ADAPTIVE_LEVEL 2000
+#define BENCH_ADAPTIVE_MAX 1024
+
+static void read_adaptive_n(uint64_t n, const char *name, uint16_t noise, float tolerance, uint32_t max_samples, uint32_t max_used)
+{
+    host_adc_oneshot_set_level(ADC_UNIT_1, channel->channel, BENCH_ADAPTIVE_LEVEL, noise);
+    for (uint64_t i = 0; i < n; ++i) {
+        uint32_t reading;
+        uint32_t used;
+        if (adc_unit_read_adaptive(&unit, channel, ADC_UNIT_DEFAULT_MIN_SAMPLES, max_samples, tolerance, &reading, &used) != ESP_OK
+            || used < ADC_UNIT_DEFAULT_MIN_SAMPLES || used > max_used
+            || abs((int) reading - BENCH_ADAPTIVE_LEVEL) > noise / 2 + 1) {
+            fprintf(stderr, "%s: read %" PRIu32 " from %" PRIu32 " samples\n", name, reading, used);
+            exit(EXIT_FAILURE);
+        }
+        sink += reading + used;
+    }
+    host_adc_oneshot_set_level(ADC_UNIT_1, channel->channel, -1, 0);
+}
+
+// a steady input stops at the minimum
+static void bench_read_adaptive_quiet(uint64_t n)
+{
+    read_adaptive_n(n, "read_adaptive/quiet", 0, 0.5f, BENCH_ADAPTIVE_MAX, ADC_UNIT_DEFAULT_MIN_SAMPLES);
+}
+
+// +-8 LSB of uniform noise (sd 4.9) needs about 24 samples for 1 LSB
+static void bench_read_adaptive_noisy(uint64_t n)
+{
+    read_adaptive_n(n, "read_adaptive/noisy", 8, 1.0f, BENCH_ADAPTIVE_MAX, 64);
+}
+
+// full scale noise never settles to 0.1 LSB, so every read takes the most
+// samples an adaptive read may, with sums near their largest
+static void bench_read_adaptive_max(uint64_t n)
+{
+    read_adaptive_n(n, "read_adaptive/max", BENCH_ADAPTIVE_LEVEL, 0.1f, ADC_UNIT_MAX_ADAPTIVE_SAMPLES, ADC_UNIT_MAX_ADAPTIVE_SAMPLES);
+}
+
+// two users of the unit with different settings on the same channel, so
+// every read has to reprogram the channel
+static void bench_read_1_shared(uint64_t n)
+{
+    static struct ADCUnit other;
+    adc_unit_init(&other, &adc_backend_oneshot, ADC_UNIT_1);
+    struct ADCChannel *other_channel = adc_unit_channel(&other, BENCH_PIN);
+    adc_unit_config_channel(&other, other_channel, ADC_BITWIDTH_12, ADC_ATTEN_DB_0, ADC_UNIT_DEFAULT_SAMPLES);
+    for (uint64_t i = 0; i < n; ++i) {
+        uint32_t reading;
+        adc_unit_read((i & 1) ? &other : &unit, (i & 1) ? other_channel : channel, 1, &reading);
+        sink += reading;
+    }
+    adc_unit_deinit(&other);
+}
+
+struct OtherUnitReader
+{
+    uint64_t reads;
+    bool stop;
+};
+
+static void *other_unit_reader(void *arg)
+{
+    struct OtherUnitReader *reader = (struct OtherUnitReader *) arg;
+    while (!__atomic_load_n(&reader->stop, __ATOMIC_ACQUIRE)) {
+        uint32_t reading;
+        adc_unit_read(&unit2, channel2, 1, &reading);
+        reader->reads++;
+    }
+    return NULL;
+}
+
+// reads of ADC1 while another thread reads ADC2 flat out; the units have
+// separate locks, so given a spare core this costs about the same as read/1
+static void bench_read_1_other_unit(uint64_t n)
+{
+    struct OtherUnitReader reader = { .reads = 0, .stop = false };
+    pthread_t thread;
+    pthread_create(&thread, NULL, other_unit_reader, &reader);
+    read_n(n, 1);
+    __atomic_store_n(&reader.stop, true, __ATOMIC_RELEASE);
+    pthread_join(thread, NULL);
+    sink += (uint32_t) reader.reads;
+}
+
+static void bench_read_64_filtered(uint64_t n)
+{
+    set_filter(true);
+    read_n(n, 64);
+    set_filter(false);
+}
+
+static void stats_n(uint64_t n, bool order)
+{
+    for (uint64_t i = 0; i < n; ++i) {
+        struct ADCStats stats;
+        adc_unit_read_stats(&unit, channel, 64, false, order, &stats);
+        sink += stats.max + (uint32_t) adc_stats_stddev(&stats) + stats.p95;
+    }
+}
+
+static void bench_stats_64(uint64_t n)
+{
+    stats_n(n, false);
+}
+
+static void bench_stats_64_order(uint64_t n)
+{
+    stats_n(n, true);
+}
+
+static void bench_capture_1024(uint64_t n)
+{
+    for (uint64_t i = 0; i < n; ++i) {
+        adc_unit_capture(&unit, channel, BENCH_CAPTURE_SAMPLES, false, (uint8_t *) capture_out, NULL);
+        sink += capture_out[i % BENCH_CAPTURE_SAMPLES];
+    }
+}
+
+// the deltas must decode to count - 1 steps that add up to the last time
+static void check_timestamps(const char *name, const struct ADCTimestamps *timestamps, uint32_t count)
+{
+    int64_t time_us = timestamps->base_us;
+    size_t offset = 0;
+    for (uint32_t i = 1; i < count; ++i) {
+        uint32_t delta;
+        size_t n = adc_codec_get_varint(timestamps->deltas + offset, timestamps->size - offset, &delta);
+        if (n == 0) {
+            fprintf(stderr, "%s: truncated delta %" PRIu32 "\n", name, i);
+            exit(EXIT_FAILURE);
+        }
+        offset += n;
+        time_us += delta;
+    }
+    if (timestamps->count != count || offset != timestamps->size || time_us != timestamps->last_us) {
+        fprintf(stderr, "%s: bad timestamps for %" PRIu32 " samples\n", name, count);
+        exit(EXIT_FAILURE);
+    }
+}
+
+// on the host a clock read costs far more than a conversion; not so on a device
+static void bench_capture_1024_timestamps(uint64_t n)
+{
+    static uint8_t deltas[BENCH_CAPTURE_SAMPLES * ADC_CODEC_VARINT_MAX];
+    for (uint64_t i = 0; i < n; ++i) {
+        struct ADCTimestamps timestamps;
+        adc_codec_timestamps_init(&timestamps, deltas);
+        adc_unit_capture(&unit, channel, BENCH_CAPTURE_SAMPLES, false, (uint8_t *) capture_out, &timestamps);
+        check_timestamps("capture/1024+timestamps", &timestamps, BENCH_CAPTURE_SAMPLES);
+        sink += capture_out[i % BENCH_CAPTURE_SAMPLES] + timestamps.size;
+    }
+}
+
+// decode as adc:decode/2 does, to check that encodings round trip
+static void check_decode(const char *name, enum ADCEncoding encoding, const uint8_t *encoded, size_t size)
+{
+    uint16_t previous = 0;
+    size_t offset = 0;
+    for (size_t i = 0; i < BENCH_CAPTURE_SAMPLES; ++i) {
+        uint16_t sample;
+        if (encoding == ADC_ENCODING_PACKED12) {
+            const uint8_t *pair = encoded + (i / 2) * 3;
+            sample = i % 2 == 0 ? pair[0] | ((pair[1] & 0xF) << 8) : (pair[1] >> 4) | (pair[2] << 4);
+        } else {
+            uint32_t zigzag;
+            size_t n = adc_codec_get_varint(encoded + offset, size - offset, &zigzag);
+            if (n == 0) {
+                fprintf(stderr, "%s: truncated at sample %zu\n", name, i);
+                exit(EXIT_FAILURE);
+            }
+            offset += n;
+            sample = previous + (int32_t) ((zigzag >> 1) ^ -(zigzag & 1));
+            previous = sample;
+        }
+        if (sample != raw_buffer[i]) {
+            fprintf(stderr, "%s: sample %zu decodes to %u, not %u\n", name, i, sample, raw_buffer[i]);
+            exit(EXIT_FAILURE);
+        }
+    }
+}
+
+static void encode_n(uint64_t n, enum ADCEncoding encoding, const char *name)
+{
+    static uint8_t encoded[BENCH_CAPTURE_SAMPLES * 3];
+    for (uint64_t i = 0; i < n; ++i) {
+        size_t size = adc_codec_encoded_size(encoding, (const uint8_t *) raw_buffer, BENCH_CAPTURE_SAMPLES, 0xFFFF);
+        if (adc_codec_encode(encoding, (const uint8_t *) raw_buffer, BENCH_CAPTURE_SAMPLES, 0xFFFF, encoded) != size) {
+            fprintf(stderr, "%s: encoded size differs from the computed one\n", name);
+            exit(EXIT_FAILURE);
+        }
+        if (i == 0) {
+            check_decode(name, encoding, encoded, size);
+        }
+        sink += size;
+    }
+}
+
+// sizing and encoding, as a capture read does
+static void bench_encode_packed12(uint64_t n)
+{
+    encode_n(n, ADC_ENCODING_PACKED12, "encode/1024+packed12");
+}
+
+static void bench_encode_delta(uint64_t n)
+{
+    encode_n(n, ADC_ENCODING_DELTA, "encode/1024+delta");
+}
+
+static void oversample_n(uint64_t n, gpio_num_t dither_pin)
+{
+    adc_unit_set_dither(&unit, dither_pin);
+    for (uint64_t i = 0; i < n; ++i) {
+        uint32_t value;
+        uint8_t bits;
+        if (adc_unit_oversample(&unit, channel, ADC_UNIT_MAX_OVERSAMPLE_BITS, &value, &bits) != ESP_OK || bits != 16 || value > UINT16_MAX) {
+            fprintf(stderr, "oversample: bad reading %" PRIu32 " with %u bits\n", value, bits);
+            exit(EXIT_FAILURE);
+        }
+        sink += value;
+    }
+    adc_unit_set_dither(&unit, -1);
+}
+
+// 256 conversions for 4 extra bits
+static void bench_oversample_4(uint64_t n)
+{
+    oversample_n(n, -1);
+}
+
+static void bench_oversample_4_dither(uint64_t n)
+{
+    oversample_n(n, BENCH_DITHER_PIN);
+}
+
+#define BENCH_FFT_SIZE 1024
+#define BENCH_FFT_TONE_BIN 37
+#define BENCH_FFT_TONE_AMPLITUDE 1000
+#define BENCH_FFT_HUM_BIN 100
+#define BENCH_FFT_HUM_AMPLITUDE 300
+
+static void check_peak(const char *name, const uint8_t *peak, uint16_t bin, uint32_t amplitude)
+{
+    uint16_t got_bin = peak[0] | (peak[1] << 8);
+    uint32_t got = peak[2] | (peak[3] << 8);
+    // Q15 tables and integer rounding cost well under 2%
+    uint32_t expected = 16 * amplitude;
+    if (got_bin != bin || got < expected * 49 / 50 || got > expected * 51 / 50) {
+        fprintf(stderr, "%s: peak at bin %u of %" PRIu32 ", expected bin %u of %" PRIu32 "\n", name, got_bin, got, bin, expected);
+        exit(EXIT_FAILURE);
+    }
+}
+
+// two bin centred tones on a mid scale offset, through the engine alone
+static void bench_fft_1024_hann(uint64_t n)
+{
+    static struct ADCFFT fft;
+    if (adc_fft_reserve(&fft, BENCH_FFT_SIZE) != ESP_OK) {
+        fprintf(stderr, "fft: out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+    static uint8_t signal[2 * BENCH_FFT_SIZE];
+    for (size_t t = 0; t < BENCH_FFT_SIZE; ++t) {
+        double phase = 2.0 * M_PI * t / BENCH_FFT_SIZE;
+        long value = lround(2048.0 + BENCH_FFT_TONE_AMPLITUDE * sin(BENCH_FFT_TONE_BIN * phase + 0.3) + BENCH_FFT_HUM_AMPLITUDE * cos(BENCH_FFT_HUM_BIN * phase));
+        signal[2 * t] = value & 0xFF;
+        signal[2 * t + 1] = value >> 8;
+    }
+    for (uint64_t i = 0; i < n; ++i) {
+        // the transform works in place over its input
+        memcpy(adc_fft_input(&fft, BENCH_FFT_SIZE), signal, sizeof(signal));
+        adc_fft_run(&fft, BENCH_FFT_SIZE, ADC_WINDOW_HANN);
+        if (i == 0) {
+            uint8_t peaks[2 * ADC_FFT_PEAK_SIZE];
+            if (adc_fft_put_peaks(&fft, BENCH_FFT_SIZE, 2, peaks) != 2) {
+                fprintf(stderr, "fft/1024+hann: missing peaks\n");
+                exit(EXIT_FAILURE);
+            }
+            check_peak("fft/1024+hann", peaks, BENCH_FFT_TONE_BIN, BENCH_FFT_TONE_AMPLITUDE);
+            check_peak("fft/1024+hann", peaks + ADC_FFT_PEAK_SIZE, BENCH_FFT_HUM_BIN, BENCH_FFT_HUM_AMPLITUDE);
+        }
+        sink += fft.bins[BENCH_FFT_TONE_BIN];
+    }
+}
+
+// capture and transform; no allocation once the unit scratch is reserved
+static void bench_spectrum_1024(uint64_t n)
+{
+    for (uint64_t i = 0; i < n; ++i) {
+        size_t size;
+        uint32_t span_us;
+        if (adc_unit_spectrum(&unit, channel, BENCH_FFT_SIZE, ADC_WINDOW_BLACKMAN, 0, (uint8_t *) capture_out, &size, &span_us) != ESP_OK || size != BENCH_FFT_SIZE) {
+            fprintf(stderr, "spectrum/1024: read failed\n");
+            exit(EXIT_FAILURE);
+        }
+        sink += capture_out[i % (BENCH_FFT_SIZE / 2)] + span_us;
+    }
+}
+
+/*---------------------------------------------------------------
+        Simulated signals
+---------------------------------------------------------------*/
+
+#define BENCH_SIM_FREQ_HZ 20000
+#define BENCH_SIM_TONE_AMPLITUDE 1000
+#define BENCH_SIM_NOISE 100
+
+struct SimCapture
+{
+    SemaphoreHandle_t full;
+    // raw little-endian values, as the fft engine takes them
+    uint8_t values[2 * BENCH_FFT_SIZE];
+    uint32_t count;
+    bool replay;
+    uint32_t replayed;
+};
+
+static void sim_capture_frame(void *arg, const uint16_t *samples, size_t count, const struct ADCTimestamps *timestamps)
+{
+    (void) timestamps;
+    struct SimCapture *capture = (struct SimCapture *) arg;
+    for (size_t i = 0; i < count; ++i) {
+        uint16_t value = ADC_STREAM_SAMPLE_DATA(samples[i]);
+        if (capture->replay) {
+            // the file is a ramp, replayed at the conversion rate from its start
+            if (value != capture->replayed++ % 4096) {
+                fprintf(stderr, "stream/20kHz+sim_replay: sample %" PRIu32 " is %u\n", capture->replayed - 1, value);
+                exit(EXIT_FAILURE);
+            }
+        } else {
+            // the bench thread empties a full window before asking for the next
+            uint32_t at = __atomic_load_n(&capture->count, __ATOMIC_ACQUIRE);
+            if (at < BENCH_FFT_SIZE) {
+                capture->values[2 * at] = value & 0xFF;
+                capture->values[2 * at + 1] = value >> 8;
+                __atomic_store_n(&capture->count, at + 1, __ATOMIC_RELEASE);
+            }
+        }
+    }
+    xSemaphoreGive(capture->full);
+}
+
+static void sim_start_stream(struct ADCStream *stream, struct SimCapture *capture, const char *name, const struct ADCBackend *backend)
+{
+    struct ADCStreamConfig config = {
+        .unit = ADC_UNIT_1,
+        .atten = ADC_ATTEN_DB_12,
+        .channels = { channel->channel },
+        .num_channels = 1,
+        .sample_freq_hz = BENCH_SIM_FREQ_HZ,
+        .frame_size = BENCH_FRAME_BYTES,
+        .pool_size = 4 * BENCH_FRAME_BYTES,
+        .backend = backend,
+    };
+    if (adc_stream_start(stream, &config, sim_capture_frame, capture) != ESP_OK) {
+        fprintf(stderr, "%s: failed to start\n", name);
+        exit(EXIT_FAILURE);
+    }
+}
+
+// a bin centred sine streamed at an exact rate, one window per op
+static void bench_stream_sim_sine(uint64_t n)
+{
+    static struct ADCFFT fft;
+    static struct SimCapture capture;
+    struct ADCSimSignal signal = {
+        .wave = ADC_SIM_SINE,
+        .offset = 2048,
+        .amplitude = BENCH_SIM_TONE_AMPLITUDE,
+        .frequency_hz = (double) BENCH_FFT_TONE_BIN * BENCH_SIM_FREQ_HZ / BENCH_FFT_SIZE,
+    };
+    capture.full = xSemaphoreCreateBinary();
+    if (adc_fft_reserve(&fft, BENCH_FFT_SIZE) != ESP_OK || adc_sim_set_signal(ADC_UNIT_1, channel->channel, &signal) != ESP_OK) {
+        fprintf(stderr, "stream/20kHz+sim_sine: failed to set up\n");
+        exit(EXIT_FAILURE);
+    }
+    struct ADCStream stream;
+    sim_start_stream(&stream, &capture, "stream/20kHz+sim_sine", NULL);
+    for (uint64_t i = 0; i < n; ++i) {
+        __atomic_store_n(&capture.count, 0, __ATOMIC_RELEASE);
+        while (__atomic_load_n(&capture.count, __ATOMIC_ACQUIRE) < BENCH_FFT_SIZE) {
+            xSemaphoreTake(capture.full, portMAX_DELAY);
+        }
+        memcpy(adc_fft_input(&fft, BENCH_FFT_SIZE), capture.values, sizeof(capture.values));
+        adc_fft_run(&fft, BENCH_FFT_SIZE, ADC_WINDOW_HANN);
+        uint8_t peak[ADC_FFT_PEAK_SIZE];
+        if (adc_fft_put_peaks(&fft, BENCH_FFT_SIZE, 1, peak) != 1) {
+            fprintf(stderr, "stream/20kHz+sim_sine: no peak\n");
+            exit(EXIT_FAILURE);
+        }
+        check_peak("stream/20kHz+sim_sine", peak, BENCH_FFT_TONE_BIN, BENCH_SIM_TONE_AMPLITUDE);
+    }
+    adc_stream_stop(&stream);
+    adc_sim_clear(ADC_UNIT_1, channel->channel);
+    vSemaphoreDelete(capture.full);
+    sink += capture.count;
+}
+
+// a recorded ramp played back sample for sample, one frame per op
+static void stream_replay_n(uint64_t n, const char *name, const struct ADCBackend *backend)
+{
+    static uint8_t ramp[2 * 4096];
+    for (size_t i = 0; i < 4096; ++i) {
+        ramp[2 * i] = i & 0xFF;
+        ramp[2 * i + 1] = i >> 8;
+    }
+    char path[] = "/tmp/adc_bench_replay_XXXXXX";
+    int fd = mkstemp(path);
+    bool written = fd >= 0 && write(fd, ramp, sizeof(ramp)) == (ssize_t) sizeof(ramp);
+    if (fd >= 0) {
+        close(fd);
+    }
+    esp_err_t err = written ? adc_sim_replay_file(ADC_UNIT_1, channel->channel, path, BENCH_SIM_FREQ_HZ) : ESP_FAIL;
+    unlink(path);
+    if (err != ESP_OK) {
+        fprintf(stderr, "%s: failed to load\n", name);
+        exit(EXIT_FAILURE);
+    }
+    static struct SimCapture capture;
+    capture.full = xSemaphoreCreateBinary();
+    capture.replay = true;
+    capture.replayed = 0;
+    struct ADCStream stream;
+    sim_start_stream(&stream, &capture, name, backend);
+    uint32_t records = BENCH_FRAME_BYTES / SOC_ADC_DIGI_RESULT_BYTES;
+    while (__atomic_load_n(&capture.replayed, __ATOMIC_ACQUIRE) < n * records) {
+        xSemaphoreTake(capture.full, portMAX_DELAY);
+    }
+    adc_stream_stop(&stream);
+    adc_sim_clear(ADC_UNIT_1, channel->channel);
+    vSemaphoreDelete(capture.full);
+    sink += capture.replayed;
+}
+
+static void bench_stream_sim_replay(uint64_t n)
+{
+    stream_replay_n(n, "stream/20kHz+sim_replay", NULL);
+}
+
+// the same, with the simulator backend converting instead of the driver
+static void bench_stream_sim_backend(uint64_t n)
+{
+    stream_replay_n(n, "stream/20kHz+sim_backend", &adc_backend_sim);
+}
+
+// oneshot reads of simulated noise; the statistics must see its band
+static void bench_stats_64_sim_noise(uint64_t n)
+{
+    struct ADCSimSignal signal = {
+        .wave = ADC_SIM_NOISE,
+        .offset = 2000,
+        .amplitude = BENCH_SIM_NOISE,
+    };
+    adc_sim_set_signal(ADC_UNIT_1, channel->channel, &signal);
+    for (uint64_t i = 0; i < n; ++i) {
+        struct ADCStats stats;
+        adc_unit_read_stats(&unit, channel, 64, false, false, &stats);
+        if (stats.min < 2000 - BENCH_SIM_NOISE || stats.max > 2000 + BENCH_SIM_NOISE || fabs(adc_stats_mean(&stats) - 2000) > BENCH_SIM_NOISE / 2) {
+            fprintf(stderr, "stats/64+sim_noise: min %" PRIu32 ", max %" PRIu32 ", mean %.1f\n", stats.min, stats.max, adc_stats_mean(&stats));
+            exit(EXIT_FAILURE);
+        }
+        sink += stats.count;
+    }
+    adc_sim_clear(ADC_UNIT_1, channel->channel);
+}
+
+// reads of simulated noise through a unit of another backend: the
+// continuous one takes each batch in a burst of the driver, the simulator
+// samples the signal itself
+static void read_64_backend_n(uint64_t n, const char *name, const struct ADCBackend *backend)
+{
+    static struct ADCUnit backend_unit;
+    struct ADCChannel *backend_channel;
+    struct ADCSimSignal signal = {
+        .wave = ADC_SIM_NOISE,
+        .offset = 2000,
+        .amplitude = BENCH_SIM_NOISE,
+    };
+    if (adc_unit_init(&backend_unit, backend, ADC_UNIT_1) != ESP_OK
+        || backend_unit.shared == unit.shared
+        || (backend_channel = adc_unit_channel(&backend_unit, BENCH_PIN)) == NULL
+        || adc_unit_config_channel(&backend_unit, backend_channel, ADC_BITWIDTH_12, ADC_ATTEN_DB_12, ADC_UNIT_DEFAULT_SAMPLES) != ESP_OK
+        || adc_sim_set_signal(ADC_UNIT_1, backend_channel->channel, &signal) != ESP_OK) {
+        fprintf(stderr, "%s: failed to set up\n", name);
+        exit(EXIT_FAILURE);
+    }
+    for (uint64_t i = 0; i < n; ++i) {
+        uint32_t reading = 0;
+        if (adc_unit_read(&backend_unit, backend_channel, 64, &reading) != ESP_OK || abs((int) reading - 2000) > BENCH_SIM_NOISE / 2) {
+            fprintf(stderr, "%s: read %" PRIu32 "\n", name, reading);
+            exit(EXIT_FAILURE);
+        }
+        sink += reading;
+    }
+    adc_sim_clear(ADC_UNIT_1, backend_channel->channel);
+    adc_unit_deinit(&backend_unit);
+}
+
+static void bench_read_64_continuous_backend(uint64_t n)
+{
+    read_64_backend_n(n, "read/64+continuous_backend", &adc_backend_continuous);
+}
+
+static void bench_read_64_sim_backend(uint64_t n)
+{
+    read_64_backend_n(n, "read/64+sim_backend", &adc_backend_sim);
+}
+
+static void bench_calib_convert_1024(uint64_t n)
+{
+    for (uint64_t i = 0; i < n; ++i) {
+        adc_calib_convert(channel->cali, raw_buffer, capture_out, BENCH_CAPTURE_SAMPLES);
+        sink += capture_out[i % BENCH_CAPTURE_SAMPLES];
+    }
+}
+
+static void bench_stream_parse_frame(uint64_t n)
+{
+    for (uint64_t i = 0; i < n; ++i) {
+        sink += adc_stream_parse_frame(ADC_UNIT_1, frame, sizeof(frame), frame_samples, NULL);
+    }
+}
+
+struct StreamCheck
+{
+    const char *name;
+    SemaphoreHandle_t frame;
+    int64_t last_us;
+    uint32_t frames;
+};
+
+static void stream_check_frame(void *arg, const uint16_t *samples, size_t count, const struct ADCTimestamps *timestamps)
+{
+    struct StreamCheck *check = (struct StreamCheck *) arg;
+    (void) samples;
+    check_timestamps(check->name, timestamps, count);
+    // records of one frame are one conversion period (50 us) apart, unless
+    // the frame was pulled forward to keep times from going back
+    int64_t span = timestamps->last_us - timestamps->base_us;
+    int64_t expected = (int64_t) (count - 1) * 50;
+    if (timestamps->base_us < check->last_us || span > expected || (span < expected && timestamps->base_us != check->last_us)) {
+        fprintf(stderr, "%s: frame %" PRIu32 " spans %" PRId64 " us\n", check->name, check->frames, timestamps->last_us - timestamps->base_us);
+        exit(EXIT_FAILURE);
+    }
+    check->last_us = timestamps->last_us;
+    __atomic_add_fetch(&check->frames, 1, __ATOMIC_RELEASE);
+    xSemaphoreGive(check->frame);
+}
+
+// one frame of 128 records per op, so this reports the frame period
+static void bench_stream_timestamps(uint64_t n)
+{
+    struct StreamCheck check = { .name = "stream/20kHz+timestamps", .frame = xSemaphoreCreateBinary() };
+    struct ADCStreamConfig config = {
+        .unit = ADC_UNIT_1,
+        .atten = ADC_ATTEN_DB_12,
+        .channels = { channel->channel },
+        .num_channels = 1,
+        .sample_freq_hz = 20000,
+        .frame_size = BENCH_FRAME_BYTES,
+        .pool_size = 4 * BENCH_FRAME_BYTES,
+        .timestamps = true,
+    };
+    struct ADCStream stream;
+    if (adc_stream_start(&stream, &config, stream_check_frame, &check) != ESP_OK) {
+        fprintf(stderr, "stream/20kHz+timestamps: failed to start\n");
+        exit(EXIT_FAILURE);
+    }
+    while (__atomic_load_n(&check.frames, __ATOMIC_ACQUIRE) < n) {
+        xSemaphoreTake(check.frame, portMAX_DELAY);
+    }
+    adc_stream_stop(&stream);
+    vSemaphoreDelete(check.frame);
+    sink += check.frames;
+}
+
+#define BENCH_CREDITS 2
+
+static void check_credit(const char *name, bool ok)
+{
+    if (!ok) {
+        fprintf(stderr, "%s: wrong batch sent or dropped\n", name);
+        exit(EXIT_FAILURE);
+    }
+}
+
+static bool release_tag(struct ADCCredit *credit, uint64_t expected)
+{
+    const void *data;
+    size_t size;
+    uint64_t tag;
+    return adc_credit_release(credit, &data, &size, &tag) && tag == expected && *(const uint64_t *) data == expected;
+}
+
+static void hold_tag(struct ADCCredit *credit, uint64_t tag)
+{
+    adc_credit_hold(credit, &tag, sizeof(tag), tag);
+}
+
+static void check_credit_policies(void)
+{
+    struct ADCCredit credit;
+    struct ADCCreditConfig config = { .credits = 1, .policy = ADC_CREDIT_LATEST };
+    adc_credit_init(&credit, &config, sizeof(uint64_t));
+    check_credit("credit/latest", adc_credit_admit(&credit) && !adc_credit_admit(&credit));
+    hold_tag(&credit, 1);
+    hold_tag(&credit, 2);
+    check_credit("credit/latest", !release_tag(&credit, 2) && adc_credit_grant(&credit, 2) && release_tag(&credit, 2)
+        && adc_credit_admit(&credit) && adc_credit_dropped(&credit) == 1);
+    adc_credit_free(&credit);
+
+    config.credits = 0;
+    config.policy = ADC_CREDIT_DROP_NEW;
+    adc_credit_init(&credit, &config, sizeof(uint64_t));
+    hold_tag(&credit, 1);
+    check_credit("credit/drop_new", !adc_credit_grant(&credit, 1) && !release_tag(&credit, 1) && adc_credit_admit(&credit)
+        && adc_credit_dropped(&credit) == 1);
+    adc_credit_free(&credit);
+
+    // the newest are kept, and go out in order, ahead of new batches
+    config.policy = ADC_CREDIT_DROP_OLD;
+    adc_credit_init(&credit, &config, sizeof(uint64_t));
+    for (uint64_t tag = 0; tag < ADC_CREDIT_MAX_HELD + 2; ++tag) {
+        hold_tag(&credit, tag);
+    }
+    check_credit("credit/drop_old", adc_credit_grant(&credit, ADC_CREDIT_MAX_HELD + 1) && !adc_credit_admit(&credit));
+    for (uint64_t tag = 2; tag < ADC_CREDIT_MAX_HELD + 2; ++tag) {
+        check_credit("credit/drop_old", release_tag(&credit, tag));
+    }
+    check_credit("credit/drop_old", adc_credit_admit(&credit) && !adc_credit_admit(&credit) && adc_credit_dropped(&credit) == 2);
+    adc_credit_free(&credit);
+}
+
+// a subscriber granting a credit back for every batch it takes, one batch behind
+static void bench_credit_drop_old(uint64_t n)
+{
+    check_credit_policies();
+    struct ADCCredit credit;
+    struct ADCCreditConfig config = { .credits = BENCH_CREDITS, .policy = ADC_CREDIT_DROP_OLD };
+    adc_credit_init(&credit, &config, sizeof(uint64_t));
+    uint64_t sent = 0;
+    for (uint64_t i = 0; i < n; ++i) {
+        const void *data;
+        size_t size;
+        uint64_t tag;
+        while (adc_credit_release(&credit, &data, &size, &tag)) {
+            sent++;
+        }
+        if (adc_credit_admit(&credit)) {
+            sent++;
+        } else {
+            hold_tag(&credit, i);
+        }
+        if (i % 2 == 1) {
+            adc_credit_grant(&credit, 1);
+        }
+    }
+    // nothing beyond the credits granted goes out, and nothing is lost unaccounted
+    uint64_t granted = BENCH_CREDITS + n / 2;
+    check_credit("credit/drop_old", sent <= granted && sent + credit.count + adc_credit_dropped(&credit) == n);
+    sink += sent;
+    adc_credit_free(&credit);
+}
+
+// a subscriber that stalls, then takes frames one credit at a time
+static void bench_stream_credits(uint64_t n)
+{
+    struct StreamCheck check = { .name = "stream/20kHz+credits", .frame = xSemaphoreCreateBinary() };
+    struct ADCCreditConfig credit = { .credits = BENCH_CREDITS, .policy = ADC_CREDIT_DROP_OLD };
+    struct ADCStreamConfig config = {
+        .unit = ADC_UNIT_1,
+        .atten = ADC_ATTEN_DB_12,
+        .channels = { channel->channel },
+        .num_channels = 1,
+        .sample_freq_hz = 20000,
+        .frame_size = BENCH_FRAME_BYTES,
+        .pool_size = 4 * BENCH_FRAME_BYTES,
+        .timestamps = true,
+        .credit = &credit,
+    };
+    struct ADCStream stream;
+    if (adc_stream_start(&stream, &config, stream_check_frame, &check) != ESP_OK) {
+        fprintf(stderr, "stream/20kHz+credits: failed to start\n");
+        exit(EXIT_FAILURE);
+    }
+    // 64 ms is ten frames
+    usleep(64000);
+    uint32_t stalled = __atomic_load_n(&check.frames, __ATOMIC_ACQUIRE);
+    uint32_t dropped = adc_stream_dropped(&stream);
+    if (stalled != BENCH_CREDITS || dropped == 0) {
+        fprintf(stderr, "stream/20kHz+credits: %" PRIu32 " frames sent and %" PRIu32 " dropped without credit\n", stalled, dropped);
+        exit(EXIT_FAILURE);
+    }
+    uint64_t granted = BENCH_CREDITS;
+    while (__atomic_load_n(&check.frames, __ATOMIC_ACQUIRE) < n) {
+        adc_stream_grant(&stream, 1);
+        granted++;
+        xSemaphoreTake(check.frame, portMAX_DELAY);
+    }
+    adc_stream_stop(&stream);
+    vSemaphoreDelete(check.frame);
+    if (check.frames > granted) {
+        fprintf(stderr, "stream/20kHz+credits: %" PRIu32 " frames sent on %" PRIu64 " credits\n", check.frames, granted);
+        exit(EXIT_FAILURE);
+    }
+    sink += check.frames;
+}
+
+#define BENCH_DEMUX_LANES 3
+#define BENCH_DEMUX_RECORDS (BENCH_FRAME_BYTES / SOC_ADC_DIGI_RESULT_BYTES)
+#define BENCH_DEMUX_SKIP_PERIOD 50
+
+static const adc_channel_t demux_channels[BENCH_DEMUX_LANES] = { ADC_CHANNEL_6, ADC_CHANNEL_7, ADC_CHANNEL_4 };
+
+static void check_demux(const char *name, bool ok)
+{
+    if (!ok) {
+        fprintf(stderr, "%s: lanes out of step\n", name);
+        exit(EXIT_FAILURE);
+    }
+}
+
+//
+// A round broken by a missing record is dropped whole, and records are
+// skipped up to the start of the next round.
+//
+static void check_demux_resync(struct ADCStreamDemux *demux)
+{
+    static const uint8_t order[] = { 0, 1, 2, 0, 2, 0, 1, 2, 1, 2, 0, 1 };
+    uint16_t samples[sizeof(order)];
+    for (size_t i = 0; i < sizeof(order); ++i) {
+        samples[i] = ADC_STREAM_SAMPLE(demux_channels[order[i]], i);
+    }
+    adc_stream_demux_push(demux, samples, sizeof(order));
+    // rounds 0..2 and 5..7 survive, with 10..11 left over
+    check_demux("stream_demux/3ch", adc_stream_demux_rounds(demux) == 2 && demux->out_of_order == 3
+        && demux->lanes[0][1] == 5 && demux->lanes[2][1] == 7 && demux->counts[0] == 3 && demux->counts[1] == 3 && demux->counts[2] == 2);
+    adc_stream_demux_consume(demux);
+    check_demux("stream_demux/3ch", demux->counts[0] == 1 && demux->lanes[1][0] == 11 && demux->counts[2] == 0);
+    // complete the round, leaving the lanes empty
+    uint16_t last = ADC_STREAM_SAMPLE(demux_channels[2], sizeof(order));
+    adc_stream_demux_push(demux, &last, 1);
+    adc_stream_demux_consume(demux);
+    check_demux("stream_demux/3ch", demux->counts[0] == 0 && demux->out_of_order == 3);
+    demux->out_of_order = 0;
+}
+
+// one frame of interleaved records per op, starting anywhere in the pattern
+static void bench_stream_demux(uint64_t n)
+{
+    static uint16_t samples[BENCH_DEMUX_RECORDS];
+    struct ADCStreamDemux demux;
+    if (adc_stream_demux_init(&demux, demux_channels, BENCH_DEMUX_LANES, BENCH_DEMUX_RECORDS / BENCH_DEMUX_LANES + 2) != ESP_OK) {
+        fprintf(stderr, "stream_demux/3ch: failed to init\n");
+        exit(EXIT_FAILURE);
+    }
+    check_demux_resync(&demux);
+    uint32_t record = 0;
+    for (uint64_t i = 0; i < n; ++i) {
+        for (size_t r = 0; r < BENCH_DEMUX_RECORDS; ++r, ++record) {
+            // the round number, which must line up across lanes
+            samples[r] = ADC_STREAM_SAMPLE(demux_channels[record % BENCH_DEMUX_LANES], record / BENCH_DEMUX_LANES);
+        }
+        adc_stream_demux_push(&demux, samples, BENCH_DEMUX_RECORDS);
+        size_t rounds = adc_stream_demux_rounds(&demux);
+        check_demux("stream_demux/3ch", demux.out_of_order == 0 && rounds >= BENCH_DEMUX_RECORDS / BENCH_DEMUX_LANES - 1
+            && demux.lanes[0][rounds - 1] == demux.lanes[1][rounds - 1] && demux.lanes[1][rounds - 1] == demux.lanes[2][rounds - 1]);
+        sink += rounds;
+        adc_stream_demux_consume(&demux);
+    }
+    adc_stream_demux_free(&demux);
+}
+
+struct DemuxCheck
+{
+    SemaphoreHandle_t frame;
+    uint32_t frames;
+    uint32_t out_of_order;
+};
+
+static void stream_check_lanes(void *arg, const struct ADCStreamLanes *lanes)
+{
+    struct DemuxCheck *check = (struct DemuxCheck *) arg;
+    bool ok = lanes->num_lanes == BENCH_DEMUX_LANES;
+    for (size_t l = 0; ok && l < lanes->num_lanes; ++l) {
+        ok = lanes->counts[l] == lanes->counts[0];
+        // each channel of the synthetic source has its own residue mod 16
+        uint16_t residue = host_adc_continuous_synthetic_value(demux_channels[l], 0) % 16;
+        for (size_t i = 0; ok && i < lanes->counts[l]; ++i) {
+            ok = lanes->samples[l][i] % 16 == residue;
+        }
+    }
+    check_demux("stream/3ch+demux+skip", ok);
+    check->out_of_order += lanes->out_of_order;
+    __atomic_add_fetch(&check->frames, 1, __ATOMIC_RELEASE);
+    xSemaphoreGive(check->frame);
+}
+
+// the stand-in driver loses a conversion every 50, so rounds are dropped regularly
+static void bench_stream_demux_skip(uint64_t n)
+{
+    struct DemuxCheck check = { .frame = xSemaphoreCreateBinary() };
+    struct ADCStreamConfig config = {
+        .unit = ADC_UNIT_1,
+        .atten = ADC_ATTEN_DB_12,
+        .channels = { demux_channels[0], demux_channels[1], demux_channels[2] },
+        .num_channels = BENCH_DEMUX_LANES,
+        .sample_freq_hz = 20000,
+        .frame_size = BENCH_FRAME_BYTES,
+        .pool_size = 4 * BENCH_FRAME_BYTES,
+        .lanes_cb = stream_check_lanes,
+    };
+    struct ADCStream stream;
+    host_adc_continuous_set_skip_period(BENCH_DEMUX_SKIP_PERIOD);
+    if (adc_stream_start(&stream, &config, NULL, &check) != ESP_OK) {
+        fprintf(stderr, "stream/3ch+demux+skip: failed to start\n");
+        exit(EXIT_FAILURE);
+    }
+    while (__atomic_load_n(&check.frames, __ATOMIC_ACQUIRE) < n) {
+        xSemaphoreTake(check.frame, portMAX_DELAY);
+    }
+    adc_stream_stop(&stream);
+    host_adc_continuous_set_skip_period(0);
+    vSemaphoreDelete(check.frame);
+    // a frame can end just before a skip, so count over the whole run
+    if (check.frames * BENCH_DEMUX_RECORDS >= 2 * BENCH_DEMUX_SKIP_PERIOD && check.out_of_order == 0) {
+        fprintf(stderr, "stream/3ch+demux+skip: no records out of order over %" PRIu32 " frames\n", check.frames);
+        exit(EXIT_FAILURE);
+    }
+    sink += check.frames;
+}
+
+static void bench_filter_push(uint64_t n)
+{
+    struct ADCFilterChain chain;
+    static const int16_t taps[8] = { 4096, 4096, 4096, 4096, 4096, 4096, 4096, 4096 };
+    adc_filter_init(&chain);
+    adc_filter_add_stage(&chain, ADC_FILTER_MEDIAN, 5, NULL);
+    adc_filter_add_stage(&chain, ADC_FILTER_FIR, 8, taps);
+    adc_filter_add_stage(&chain, ADC_FILTER_EXPONENTIAL, 3, NULL);
+    for (uint64_t i = 0; i < n; ++i) {
+        uint16_t out;
+        if (adc_filter_push(&chain, raw_buffer[i % BENCH_CAPTURE_SAMPLES], &out)) {
+            sink += out;
+        }
+    }
+}
+
+static void bench_watch_classify(uint64_t n)
+{
+    struct ADCWatchConfig config = { .low = 1000, .high = 3000, .hysteresis = 50, .samples = 1, .period_ms = 100 };
+    enum ADCWatchState state = ADC_WATCH_NORMAL;
+    for (uint64_t i = 0; i < n; ++i) {
+        state = adc_watch_classify(state, &config, raw_buffer[i % BENCH_CAPTURE_SAMPLES]);
+        sink += state;
+    }
+}
+
+// the per read cost of metrics collection
+static void bench_metrics_record(uint64_t n)
+{
+    struct ADCMetrics metrics = { 0 };
+    for (uint64_t i = 0; i < n; ++i) {
+        adc_metrics_record(&metrics, adc_metrics_start(), 64, ESP_OK);
+    }
+    sink += metrics.reads;
+}
+
+static void bench_ring_push_drain(uint64_t n)
+{
+    struct ADCRing ring;
+    struct ADCRingEntry out[64];
+    adc_ring_init(&ring);
+    adc_ring_alloc(&ring, 1024);
+    for (uint64_t i = 0; i < n; i += 64) {
+        for (uint32_t j = 0; j < 64; ++j) {
+            struct ADCRingEntry entry = { .timestamp_us = (uint32_t) (i + j), .value = j };
+            adc_ring_push(&ring, &entry);
+        }
+        sink += adc_ring_drain(&ring, out, 64);
+    }
+    adc_ring_free(&ring);
+}
+
+struct RingProducer
+{
+    struct ADCRing *ring;
+    uint64_t n;
+    bool done;
+};
+
+static void *ring_producer(void *arg)
+{
+    struct RingProducer *producer = (struct RingProducer *) arg;
+    for (uint64_t i = 0; i < producer->n; ++i) {
+        struct ADCRingEntry entry = { .timestamp_us = (uint32_t) i, .value = (uint16_t) i, .pin = (uint8_t) i };
+        adc_ring_push(producer->ring, &entry);
+    }
+    __atomic_store_n(&producer->done, true, __ATOMIC_RELEASE);
+    return NULL;
+}
+
+static void ring_check(const struct ADCRingEntry *entries, size_t count, uint64_t *next, uint64_t *received)
+{
+    for (size_t i = 0; i < count; ++i) {
+        const struct ADCRingEntry *entry = &entries[i];
+        // entries are never reordered or torn; gaps are dropped pushes
+        if (entry->timestamp_us < *next || entry->value != (uint16_t) entry->timestamp_us || entry->pin != (uint8_t) entry->timestamp_us) {
+            fprintf(stderr, "ring: bad entry %" PRIu32 " after %" PRIu64 "\n", entry->timestamp_us, *next);
+            exit(EXIT_FAILURE);
+        }
+        *next = entry->timestamp_us + 1;
+    }
+    *received += count;
+}
+
+// producer thread against a draining consumer; verifies ordering and accounting
+static void bench_ring_spsc_stress(uint64_t n)
+{
+    struct ADCRing ring;
+    static struct ADCRingEntry out[256];
+    adc_ring_init(&ring);
+    adc_ring_alloc(&ring, 256);
+
+    n = n < UINT32_MAX ? n : UINT32_MAX;
+    struct RingProducer producer = { .ring = &ring, .n = n, .done = false };
+    pthread_t thread;
+    pthread_create(&thread, NULL, ring_producer, &producer);
+
+    uint64_t next = 0;
+    uint64_t received = 0;
+    while (!__atomic_load_n(&producer.done, __ATOMIC_ACQUIRE)) {
+        ring_check(out, adc_ring_drain(&ring, out, 256), &next, &received);
+    }
+    pthread_join(thread, NULL);
+    size_t count;
+    while ((count = adc_ring_drain(&ring, out, 256)) > 0) {
+        ring_check(out, count, &next, &received);
+    }
+
+    struct ADCRingInfo info;
+    adc_ring_info(&ring, &info);
+    if (received + info.overruns != n || info.high_water > info.size) {
+        fprintf(stderr, "ring: %" PRIu64 " received + %" PRIu32 " overruns != %" PRIu64 " pushed\n", received, info.overruns, n);
+        exit(EXIT_FAILURE);
+    }
+    sink += received;
+    adc_ring_free(&ring);
+}
+
+/*---------------------------------------------------------------
+        Recorder
+---------------------------------------------------------------*/
+
+static struct ADCRecorder recorder;
+
+static void recorder_open(void)
+{
+    adc_recorder_reset(&recorder);
+    if (adc_recorder_open(&recorder, BENCH_PARTITION) != ESP_OK) {
+        fprintf(stderr, "recorder: failed to open partition\n");
+        exit(EXIT_FAILURE);
+    }
+}
+
+// block k holds samples derived from k, with k as its time
+static void recorder_append_block(uint64_t k)
+{
+    uint16_t samples[ADC_RECORDER_MAX_SAMPLES];
+    for (size_t j = 0; j < ADC_RECORDER_MAX_SAMPLES; ++j) {
+        samples[j] = (uint16_t) ((k * 7 + j) & 0xFFF);
+    }
+    // a busy writer drops the block, so wait for it and append again
+    while (adc_recorder_append(&recorder, BENCH_PIN, 1000, (int64_t) k, samples, ADC_RECORDER_MAX_SAMPLES) == ESP_ERR_NO_MEM) {
+        adc_recorder_flush(&recorder);
+    }
+}
+
+static void recorder_check_block(const char *name, const struct ADCRecorderBlock *block, uint64_t k)
+{
+    uint16_t samples[ADC_RECORDER_MAX_SAMPLES];
+    bool ok = block->time_us == (int64_t) k && block->pin == BENCH_PIN && block->count == ADC_RECORDER_MAX_SAMPLES
+        && adc_recorder_copy(&recorder, block, samples);
+    for (size_t j = 0; ok && j < block->count; ++j) {
+        ok = samples[j] == (uint16_t) ((k * 7 + j) & 0xFFF);
+    }
+    if (!ok) {
+        fprintf(stderr, "%s: block %" PRIu32 " does not hold block %" PRIu64 "\n", name, block->seq, k);
+        exit(EXIT_FAILURE);
+    }
+}
+
+// end to end: copy into a slot, then CRC, erase and write on the writer task
+static void bench_recorder_append(uint64_t n)
+{
+    recorder_open();
+    for (uint64_t i = 0; i < n; ++i) {
+        recorder_append_block(i);
+    }
+    adc_recorder_flush(&recorder);
+    struct ADCRecorderInfo info;
+    adc_recorder_info(&recorder, &info);
+    if (info.write_errors != 0) {
+        fprintf(stderr, "recorder_append: %" PRIu32 " write errors\n", info.write_errors);
+        exit(EXIT_FAILURE);
+    }
+    sink += info.blocks;
+    adc_recorder_close(&recorder);
+}
+
+//
+// Appends more than a lap, remounts, and checks that the log holds every
+// block since the oldest sector, in order and intact.
+//
+static void bench_recorder_wrap_remount(uint64_t n)
+{
+    static struct ADCRecorderBlock blocks[BENCH_PARTITION_SIZE / ADC_RECORDER_BLOCK_SIZE];
+    for (uint64_t i = 0; i < n; ++i) {
+        recorder_open();
+        struct ADCRecorderInfo before;
+        adc_recorder_info(&recorder, &before);
+        uint64_t laps = BENCH_PARTITION_SIZE / ADC_RECORDER_BLOCK_SIZE + BENCH_SECTOR_BLOCKS / 2;
+        for (uint64_t k = 0; k < laps; ++k) {
+            recorder_append_block(before.next_seq + k);
+        }
+        adc_recorder_close(&recorder);
+
+        recorder_open();
+        struct ADCRecorderInfo info;
+        adc_recorder_info(&recorder, &info);
+        size_t count = adc_recorder_read(&recorder, info.first_seq, blocks, sizeof(blocks) / sizeof(blocks[0]));
+        // after a lap, every sector but the head one is full
+        uint32_t expected = (BENCH_PARTITION_SIZE / ADC_RECORDER_SECTOR_SIZE - 1) * BENCH_SECTOR_BLOCKS + (recorder.head - 1) % ADC_RECORDER_SECTOR_SIZE / ADC_RECORDER_BLOCK_SIZE + 1;
+        if (info.next_seq != before.next_seq + laps || count != info.blocks || count != expected
+            || info.first_seq != info.next_seq - count) {
+            fprintf(stderr, "recorder_wrap+remount: %zu blocks from %" PRIu32 " to %" PRIu32 "\n", count, info.first_seq, info.next_seq);
+            exit(EXIT_FAILURE);
+        }
+        // block times were chosen to match the seqs of a log without drops
+        for (size_t b = 0; b < count; ++b) {
+            if (blocks[b].seq != info.first_seq + b) {
+                fprintf(stderr, "recorder_wrap+remount: block %zu has seq %" PRIu32 "\n", b, blocks[b].seq);
+                exit(EXIT_FAILURE);
+            }
+            recorder_check_block("recorder_wrap+remount", &blocks[b], blocks[b].seq);
+        }
+        sink += count;
+        adc_recorder_close(&recorder);
+    }
+}
+
+// finding the blocks to return, as recorder_read does; the first run also checks a corrupt block is skipped
+static void bench_recorder_readout(uint64_t n)
+{
+    static struct ADCRecorderBlock blocks[BENCH_PARTITION_SIZE / ADC_RECORDER_BLOCK_SIZE];
+    static bool corrupted;
+    const size_t max = sizeof(blocks) / sizeof(blocks[0]);
+    recorder_open();
+    if (!corrupted) {
+        struct ADCRecorderInfo info;
+        adc_recorder_info(&recorder, &info);
+        // run on its own, nothing has been recorded yet
+        if (info.blocks < BENCH_SECTOR_BLOCKS) {
+            for (uint32_t k = 0; k < BENCH_SECTOR_BLOCKS; ++k) {
+                recorder_append_block(info.next_seq + k);
+            }
+            adc_recorder_flush(&recorder);
+            adc_recorder_info(&recorder, &info);
+        }
+        size_t count = adc_recorder_read(&recorder, info.first_seq, blocks, max);
+        if (count < 3) {
+            fprintf(stderr, "recorder_readout: only %zu blocks to corrupt\n", count);
+            exit(EXIT_FAILURE);
+        }
+        // clear the bits of one sample, as a failing cell would
+        struct ADCRecorderBlock victim = blocks[count / 2];
+        uint16_t zero = 0;
+        esp_partition_write(recorder.partition, victim.offset + 2, &zero, sizeof(zero));
+        // a block found before it went bad must not copy out either
+        uint16_t samples[ADC_RECORDER_MAX_SAMPLES];
+        size_t after = adc_recorder_read(&recorder, info.first_seq, blocks, max);
+        bool skipped = after == count - 1 && !adc_recorder_copy(&recorder, &victim, samples);
+        for (size_t b = 0; skipped && b < after; ++b) {
+            skipped = blocks[b].seq != victim.seq && blocks[b].seq == info.first_seq + b + (blocks[b].seq > victim.seq ? 1 : 0);
+        }
+        if (!skipped) {
+            fprintf(stderr, "recorder_readout: corrupt block %" PRIu32 " was not skipped\n", victim.seq);
+            exit(EXIT_FAILURE);
+        }
+        corrupted = true;
+    }
+    for (uint64_t i = 0; i < n; ++i) {
+        sink += adc_recorder_read(&recorder, 0, blocks, max);
+    }
+    adc_recorder_close(&recorder);
+}
+
+struct BenchJob
+{
+    uint32_t reading;
+};
+
+static void bench_job_run(void *arg)
+{
+    struct BenchJob *job = (struct BenchJob *) arg;
+    adc_unit_read(&unit, channel, 1, &job->reading);
+    xSemaphoreGive(job_done);
+}
+
+// the asynchronous read path: queue to the worker task and wait for the result
+static void bench_worker_round_trip(uint64_t n)
+{
+    struct BenchJob job;
+    for (uint64_t i = 0; i < n; ++i) {
+        while (adc_worker_submit(ADC_UNIT_1, bench_job_run, &job) != ESP_OK) {
+        }
+        xSemaphoreTake(job_done, portMAX_DELAY);
+        sink += job.reading;
+    }
+}
+
+struct ParkedRead
+{
+    int64_t deadline_us;
+    esp_err_t err;
+    uint32_t reading;
+    uint32_t completions;
+};
+
+static uint32_t parked_completed;
+
+static void parked_read_complete(struct ParkedRead *read, esp_err_t err)
+{
+    read->err = err;
+    __atomic_add_fetch(&read->completions, 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&parked_completed, 1, __ATOMIC_RELEASE);
+    xSemaphoreGive(parked_done);
+}
+
+static void parked_read_run(void *arg);
+
+static void parked_read_resume(void *arg, esp_err_t err)
+{
+    if (err == ESP_OK) {
+        parked_read_run(arg);
+    } else {
+        parked_read_complete((struct ParkedRead *) arg, err);
+    }
+}
+
+// what the read job in atomvm_adc.c does on the worker task
+static void parked_read_run(void *arg)
+{
+    struct ParkedRead *read = (struct ParkedRead *) arg;
+    esp_err_t err = adc_unit_read(&unit2, channel2, 1, &read->reading);
+    if (err == ESP_ERR_TIMEOUT) {
+        err = adc_arbiter_park(parked_read_resume, read, read->deadline_us);
+        if (err == ESP_OK) {
+            return;
+        }
+        if (err == ESP_ERR_INVALID_STATE) {
+            err = adc_unit_read(&unit2, channel2, 1, &read->reading);
+        }
+    }
+    parked_read_complete(read, err);
+}
+
+static void handover_done(void *arg, esp_err_t err)
+{
+    parked_read_complete((struct ParkedRead *) arg, err);
+}
+
+static void wait_parked(uint32_t target)
+{
+    while (__atomic_load_n(&parked_completed, __ATOMIC_ACQUIRE) < target) {
+        xSemaphoreTake(parked_done, portMAX_DELAY);
+    }
+}
+
+//
+// Wi-Fi takes ADC2 from a reader in progress, which reports the handover when
+// it leaves.  Then reads are queued: half of them have a deadline that
+// passes before it lets go and must time out, the rest must all be served
+// once it does.  Every read must complete exactly once.
+//
+static void bench_adc2_contention(uint64_t n)
+{
+    struct ParkedRead reads[BENCH_PARKED_READS];
+    for (uint64_t i = 0; i < n; ++i) {
+        struct ParkedRead handover = { 0 };
+        bool pending = false;
+        adc_arbiter_enter();
+        if (adc_arbiter_wifi_acquire(handover_done, &handover, &pending) != ESP_OK || !pending || handover.completions != 0) {
+            fprintf(stderr, "adc2: handover did not wait for the reader\n");
+            exit(EXIT_FAILURE);
+        }
+        adc_arbiter_leave();
+        if (handover.completions != 1 || handover.err != ESP_OK) {
+            fprintf(stderr, "adc2: handover completed %" PRIu32 " times with %i\n", handover.completions, handover.err);
+            exit(EXIT_FAILURE);
+        }
+        __atomic_store_n(&parked_completed, 0, __ATOMIC_RELAXED);
+        host_adc_oneshot_set_wifi_active(true);
+
+        uint32_t value;
+        if (adc_unit_read(&unit2, channel2, 1, &value) != ESP_ERR_TIMEOUT) {
+            fprintf(stderr, "adc2: read succeeded while Wi-Fi owns the unit\n");
+            exit(EXIT_FAILURE);
+        }
+        int64_t now = esp_timer_get_time();
+        for (size_t k = 0; k < BENCH_PARKED_READS; ++k) {
+            reads[k].deadline_us = now + (k % 2 == 0 ? 200 : 10000000);
+            reads[k].completions = 0;
+            while (adc_worker_submit(ADC_UNIT_2, parked_read_run, &reads[k]) != ESP_OK) {
+            }
+        }
+        wait_parked(BENCH_PARKED_READS / 2);
+
+        host_adc_oneshot_set_wifi_active(false);
+        adc_arbiter_wifi_release();
+        wait_parked(BENCH_PARKED_READS);
+
+        for (size_t k = 0; k < BENCH_PARKED_READS; ++k) {
+            esp_err_t expected = k % 2 == 0 ? ESP_ERR_TIMEOUT : ESP_OK;
+            if (__atomic_load_n(&reads[k].completions, __ATOMIC_RELAXED) != 1 || reads[k].err != expected) {
+                fprintf(stderr, "adc2: read %zu completed %" PRIu32 " times with %i\n", k, reads[k].completions, reads[k].err);
+                exit(EXIT_FAILURE);
+            }
+            sink += reads[k].reading;
+        }
+    }
+}
+
+/*---------------------------------------------------------------
+        Nifs, called as the emulator calls them
+---------------------------------------------------------------*/
+
+#define BENCH_NIF_PIN2 35
+#define BENCH_NIF_REPLY_MS 1000
+#define BENCH_NIF_SIM_LEVEL 1500
+#define BENCH_NIF_SIM_REPLAYED 700
+
+static GlobalContext *nif_global;
+// holds the handle and the arguments, which outlive the calls
+static Context *nif_owner;
+// makes the calls and receives the replies; its heap is dropped after each
+static Context *nif_ctx;
+static term nif_adc;
+static term nif_raw_options;
+static term nif_pins;
+static term nif_bad_options;
+static term nif_capture_options;
+static term nif_stream_pins;
+static term nif_stream_options;
+static term nif_adc_reading_atom;
+static term nif_adc_stream_atom;
+// a handle on the simulator backend, and the signals of its pins
+static term nif_sim_adc;
+static term nif_sim_level;
+static term nif_sim_replay;
+static term nif_sim_missing;
+
+static term call_nif(Context *ctx, const char *name, int argc, term argv[])
+{
+    const struct Nif *nif = atomvm_adc_get_nif(name);
+    if (nif == NULL) {
+        fprintf(stderr, "%s: not resolved\n", name);
+        exit(EXIT_FAILURE);
+    }
+    return nif->nif_ptr(ctx, argc, argv);
+}
+
+static void check_nif(const char *name, bool ok)
+{
+    if (!ok) {
+        fprintf(stderr, "%s: unexpected result\n", name);
+        exit(EXIT_FAILURE);
+    }
+}
+
+static bool is_tagged(term t, int arity, term tag)
+{
+    return term_is_tuple(t) && term_get_tuple_arity(t) == arity && term_get_tuple_element(t, 0) == tag;
+}
+
+static bool is_error(term t, term reason)
+{
+    return is_tagged(t, 2, ERROR_ATOM) && term_get_tuple_element(t, 1) == reason;
+}
+
+// requires TUPLE_SIZE(2) on the heap
+static term make_pair(Heap *heap, term first, term second)
+{
+    term pair = term_alloc_tuple(2, heap);
+    term_put_tuple_element(pair, 0, first);
+    term_put_tuple_element(pair, 1, second);
+    return pair;
+}
+
+static term make_atom(AtomString name)
+{
+    return globalcontext_make_atom(nif_global, name);
+}
+
+static void nif_fixture_init(void)
+{
+    if ((nif_global = globalcontext_new()) == NULL
+        || (nif_owner = context_new(nif_global)) == NULL
+        || (nif_ctx = context_new(nif_global)) == NULL) {
+        fprintf(stderr, "failed to create nif contexts\n");
+        exit(EXIT_FAILURE);
+    }
+    atomvm_adc_init(nif_global);
+    nif_adc_reading_atom = make_atom(ATOM_STR("\xb", "adc_reading"));
+    nif_adc_stream_atom = make_atom(ATOM_STR("\xa", "adc_stream"));
+
+    term argv[3] = { term_nil() };
+    nif_adc = call_nif(nif_owner, "adc:nif_init/1", 1, argv);
+    check_nif("nif/init", is_tagged(nif_adc, 3, make_atom(ATOM_STR("\x4", "$adc"))));
+
+    Heap *heap = &nif_owner->heap;
+    check_nif("nif/fixture", memory_ensure_free(nif_owner, LIST_SIZE(10, TUPLE_SIZE(2))) == MEMORY_GC_OK);
+    term config_options = term_list_prepend(make_pair(heap, make_atom(ATOM_STR("\x9", "bit_width")), make_atom(ATOM_STR("\x6", "bit_12"))), term_nil(), heap);
+    config_options = term_list_prepend(make_pair(heap, make_atom(ATOM_STR("\xb", "attenuation")), make_atom(ATOM_STR("\x5", "db_12"))), config_options, heap);
+    // a bare atom, as adc:read/3 passes it through
+    nif_raw_options = term_list_prepend(make_atom(ATOM_STR("\x3", "raw")), term_nil(), heap);
+    nif_pins = term_list_prepend(term_from_int(BENCH_PIN), term_list_prepend(term_from_int(BENCH_NIF_PIN2), term_nil(), heap), heap);
+    // no samples at all
+    nif_bad_options = term_list_prepend(make_pair(heap, make_atom(ATOM_STR("\x7", "samples")), term_from_int(0)), term_nil(), heap);
+    nif_capture_options = term_list_prepend(make_pair(heap, make_atom(ATOM_STR("\x7", "capture")), term_from_int(16)), term_nil(), heap);
+    nif_stream_pins = term_list_prepend(term_from_int(BENCH_PIN), term_nil(), heap);
+    nif_stream_options = term_list_prepend(make_pair(heap, make_atom(ATOM_STR("\x5", "owner")), term_from_local_process_id(nif_ctx->process_id)), term_nil(), heap);
+    nif_stream_options = term_list_prepend(make_pair(heap, make_atom(ATOM_STR("\xe", "sample_freq_hz")), term_from_int(ADC_STREAM_DEFAULT_SAMPLE_FREQ_HZ)), nif_stream_options, heap);
+    nif_stream_options = term_list_prepend(make_pair(heap, make_atom(ATOM_STR("\xa", "frame_size")), term_from_int(BENCH_FRAME_BYTES)), nif_stream_options, heap);
+
+    // [{backend, simulator}], {noise, Level, 0} and {replay, <<Replayed:16/little>>, 1000}
+    uint8_t replayed[2] = { BENCH_NIF_SIM_REPLAYED & 0xFF, BENCH_NIF_SIM_REPLAYED >> 8 };
+    check_nif("nif/fixture", memory_ensure_free(nif_owner, LIST_SIZE(1, TUPLE_SIZE(2)) + 2 * TUPLE_SIZE(3) + term_binary_heap_size(sizeof(replayed))) == MEMORY_GC_OK);
+    argv[0] = term_list_prepend(make_pair(heap, make_atom(ATOM_STR("\x7", "backend")), make_atom(ATOM_STR("\x9", "simulator"))), term_nil(), heap);
+    nif_sim_level = term_alloc_tuple(3, heap);
+    term_put_tuple_element(nif_sim_level, 0, make_atom(ATOM_STR("\x5", "noise")));
+    term_put_tuple_element(nif_sim_level, 1, term_from_int(BENCH_NIF_SIM_LEVEL));
+    term_put_tuple_element(nif_sim_level, 2, term_from_int(0));
+    nif_sim_replay = term_alloc_tuple(3, heap);
+    term_put_tuple_element(nif_sim_replay, 0, make_atom(ATOM_STR("\x6", "replay")));
+    term_put_tuple_element(nif_sim_replay, 1, term_from_literal_binary(replayed, sizeof(replayed), heap, nif_global));
+    term_put_tuple_element(nif_sim_replay, 2, term_from_int(1000));
+    // {replay, Path, 1000} of a file that is not there
+    static const char missing[] = "/nonexistent/adc_bench";
+    check_nif("nif/fixture", memory_ensure_free(nif_owner, LIST_SIZE(sizeof(missing) - 1, 0) + TUPLE_SIZE(3)) == MEMORY_GC_OK);
+    term path = term_nil();
+    for (size_t i = sizeof(missing) - 1; i > 0; --i) {
+        path = term_list_prepend(term_from_int(missing[i - 1]), path, heap);
+    }
+    nif_sim_missing = term_alloc_tuple(3, heap);
+    term_put_tuple_element(nif_sim_missing, 0, make_atom(ATOM_STR("\x6", "replay")));
+    term_put_tuple_element(nif_sim_missing, 1, path);
+    term_put_tuple_element(nif_sim_missing, 2, term_from_int(1000));
+    nif_sim_adc = call_nif(nif_owner, "adc:nif_init/1", 1, argv);
+    check_nif("nif/init simulator", is_tagged(nif_sim_adc, 3, make_atom(ATOM_STR("\x4", "$adc"))));
+
+    argv[2] = config_options;
+    term adcs[] = { nif_adc, nif_sim_adc };
+    for (size_t i = 0; i < sizeof(adcs) / sizeof(adcs[0]); ++i) {
+        argv[0] = adcs[i];
+        argv[1] = term_from_int(BENCH_PIN);
+        check_nif("nif/config", call_nif(nif_owner, "adc:nif_config_channel_bitwidth_atten/3", 3, argv) == OK_ATOM);
+        argv[1] = term_from_int(BENCH_NIF_PIN2);
+        check_nif("nif/config", call_nif(nif_owner, "adc:nif_config_channel_bitwidth_atten/3", 3, argv) == OK_ATOM);
+    }
+}
+
+// drive the pins of the simulator handle, or take their signals off
+static void nif_simulate_pins(bool on)
+{
+    term off = make_atom(ATOM_STR("\x3", "off"));
+    term argv[3] = { nif_sim_adc, term_from_int(BENCH_PIN), on ? nif_sim_level : off };
+    check_nif("nif/simulate", call_nif(nif_ctx, "adc:nif_simulate/3", 3, argv) == OK_ATOM);
+    argv[1] = term_from_int(BENCH_NIF_PIN2);
+    argv[2] = on ? nif_sim_replay : off;
+    check_nif("nif/simulate", call_nif(nif_ctx, "adc:nif_simulate/3", 3, argv) == OK_ATOM);
+}
+
+// {Raw, undefined}, as a read with {raw, true} returns
+static bool is_raw_reading(term reading)
+{
+    return term_is_tuple(reading)
+        && term_get_tuple_arity(reading) == 2
+        && term_is_integer(term_get_tuple_element(reading, 0))
+        && term_get_tuple_element(reading, 1) == UNDEFINED_ATOM;
+}
+
+// waits for the {adc_reading, Ref, {ok, Value}} of a read that returned submitted, {ok, Ref}
+static term receive_reading(const char *name, term submitted)
+{
+    check_nif(name, is_tagged(submitted, 2, OK_ATOM));
+    term message;
+    check_nif(name, host_context_receive(nif_ctx, BENCH_NIF_REPLY_MS, &message));
+    check_nif(name, is_tagged(message, 3, nif_adc_reading_atom)
+        && term_to_ref_ticks(term_get_tuple_element(message, 1)) == term_to_ref_ticks(term_get_tuple_element(submitted, 1)));
+    term result = term_get_tuple_element(message, 2);
+    check_nif(name, is_tagged(result, 2, OK_ATOM));
+    return term_get_tuple_element(result, 1);
+}
+
+// open and close a handle, its resource going with the heap
+static void bench_nif_init_close(uint64_t n)
+{
+    term adc_atom = make_atom(ATOM_STR("\x4", "$adc"));
+    for (uint64_t i = 0; i < n; ++i) {
+        term argv[1] = { term_nil() };
+        argv[0] = call_nif(nif_ctx, "adc:nif_init/1", 1, argv);
+        check_nif("nif/init", is_tagged(argv[0], 3, adc_atom));
+        check_nif("nif/close", call_nif(nif_ctx, "adc:nif_close/1", 1, argv) == OK_ATOM);
+        host_context_clear_heap(nif_ctx);
+    }
+}
+
+static void bench_nif_read_async(uint64_t n)
+{
+    term argv[4] = { nif_adc, term_from_int(BENCH_PIN), nif_raw_options, term_from_local_process_id(nif_ctx->process_id) };
+    for (uint64_t i = 0; i < n; ++i) {
+        term reading = receive_reading("nif/read_async", call_nif(nif_ctx, "adc:nif_take_reading_async/4", 4, argv));
+        check_nif("nif/read_async", is_raw_reading(reading));
+        sink += term_to_int(term_get_tuple_element(reading, 0));
+        host_context_clear_heap(nif_ctx);
+    }
+}
+
+static void bench_nif_read_many(uint64_t n)
+{
+    term argv[4] = { nif_adc, nif_pins, nif_raw_options, term_from_local_process_id(nif_ctx->process_id) };
+    for (uint64_t i = 0; i < n; ++i) {
+        term readings = receive_reading("nif/read_many", call_nif(nif_ctx, "adc:nif_take_readings_async/4", 4, argv));
+        check_nif("nif/read_many", term_is_tuple(readings)
+            && term_get_tuple_arity(readings) == 2
+            && is_raw_reading(term_get_tuple_element(readings, 0))
+            && is_raw_reading(term_get_tuple_element(readings, 1)));
+        sink += term_to_int(term_get_tuple_element(term_get_tuple_element(readings, 1), 0));
+        host_context_clear_heap(nif_ctx);
+    }
+}
+
+// a raw16 capture, which the job writes straight into the binary it sends
+static void bench_nif_capture(uint64_t n)
+{
+    term argv[4] = { nif_adc, term_from_int(BENCH_PIN), nif_capture_options, term_from_local_process_id(nif_ctx->process_id) };
+    for (uint64_t i = 0; i < n; ++i) {
+        term capture = receive_reading("nif/capture", call_nif(nif_ctx, "adc:nif_take_reading_async/4", 4, argv));
+        check_nif("nif/capture", term_is_binary(capture) && term_binary_size(capture) == 16 * sizeof(uint16_t));
+        sink += (uint8_t) term_binary_data(capture)[0];
+        host_context_clear_heap(nif_ctx);
+    }
+}
+
+// bad arguments are returned as errors, or raised where the nif is called
+// by the caller itself; nothing is queued for any of them
+static void bench_nif_badarg(uint64_t n)
+{
+    term owner = term_from_local_process_id(nif_ctx->process_id);
+    term unsupported = make_atom(ATOM_STR("\x12", "unsupported_option"));
+    term not_simulated = make_atom(ATOM_STR("\xd", "not_simulated"));
+    term not_found = make_atom(ATOM_STR("\x11", "esp_err_not_found"));
+    for (uint64_t i = 0; i < n; ++i) {
+        term argv[4] = { nif_adc, OK_ATOM, nif_raw_options, owner };
+        check_nif("nif/badarg config", is_error(call_nif(nif_ctx, "adc:nif_config_channel_bitwidth_atten/3", 3, argv), BADARG_ATOM));
+        argv[1] = term_from_int(BENCH_PIN);
+        argv[2] = nif_bad_options;
+        check_nif("nif/badarg read", is_error(call_nif(nif_ctx, "adc:nif_take_reading_async/4", 4, argv), BADARG_ATOM));
+        argv[1] = nif_pins;
+        argv[2] = nif_capture_options;
+        check_nif("nif/badarg read_many", is_error(call_nif(nif_ctx, "adc:nif_take_readings_async/4", 4, argv), unsupported));
+        argv[1] = nif_raw_options;
+        argv[2] = nif_stream_options;
+        check_nif("nif/badarg stream_start", is_error(call_nif(nif_ctx, "adc:nif_stream_start/3", 3, argv), BADARG_ATOM));
+        argv[0] = nif_sim_adc;
+        argv[1] = term_from_int(BENCH_PIN);
+        argv[2] = OK_ATOM;
+        check_nif("nif/badarg simulate", is_error(call_nif(nif_ctx, "adc:nif_simulate/3", 3, argv), BADARG_ATOM));
+        argv[2] = nif_sim_missing;
+        check_nif("nif/badarg simulate missing file", is_error(call_nif(nif_ctx, "adc:nif_simulate/3", 3, argv), not_found));
+        argv[0] = nif_adc;
+        argv[2] = nif_sim_level;
+        check_nif("nif/badarg simulate oneshot", is_error(call_nif(nif_ctx, "adc:nif_simulate/3", 3, argv), not_simulated));
+        argv[0] = OK_ATOM;
+        check_nif("nif/badarg bytes_per_sample", term_is_invalid_term(call_nif(nif_ctx, "adc:nif_bytes_per_sample/1", 1, argv)) && nif_ctx->x[1] == BADARG_ATOM);
+        host_context_clear_heap(nif_ctx);
+    }
+    check_nif("nif/badarg", mailbox_len(&nif_ctx->mailbox) == 0);
+}
+
+// start a stream, take its first frame and stop it
+static void bench_nif_stream(uint64_t n)
+{
+    term argv[3] = { nif_adc, nif_stream_pins, nif_stream_options };
+    for (uint64_t i = 0; i < n; ++i) {
+        term started = call_nif(nif_ctx, "adc:nif_stream_start/3", 3, argv);
+        check_nif("nif/stream_start", is_tagged(started, 2, OK_ATOM));
+        term stream = term_get_tuple_element(started, 1);
+        term message;
+        check_nif("nif/stream frame", host_context_receive(nif_ctx, BENCH_NIF_REPLY_MS, &message)
+            && is_tagged(message, 3, nif_adc_stream_atom)
+            && term_to_ref_ticks(term_get_tuple_element(message, 1)) == term_to_ref_ticks(term_get_tuple_element(stream, 2))
+            && term_is_binary(term_get_tuple_element(message, 2))
+            && term_binary_size(term_get_tuple_element(message, 2)) == BENCH_FRAME_BYTES / SOC_ADC_DIGI_RESULT_BYTES * sizeof(uint16_t));
+        check_nif("nif/stream_stop", call_nif(nif_ctx, "adc:nif_stream_stop/1", 1, &stream) == OK_ATOM);
+        // frames sent before the stop
+        while (host_context_receive(nif_ctx, 0, &message)) {
+        }
+        host_context_clear_heap(nif_ctx);
+    }
+}
+
+// a read and a read_many on the simulator backend return the signals set
+static void bench_nif_sim_read(uint64_t n)
+{
+    nif_simulate_pins(true);
+    term argv[4] = { nif_sim_adc, term_from_int(BENCH_PIN), nif_raw_options, term_from_local_process_id(nif_ctx->process_id) };
+    for (uint64_t i = 0; i < n; ++i) {
+        argv[1] = term_from_int(BENCH_PIN);
+        term reading = receive_reading("nif/sim_read", call_nif(nif_ctx, "adc:nif_take_reading_async/4", 4, argv));
+        check_nif("nif/sim_read", is_raw_reading(reading) && term_to_int(term_get_tuple_element(reading, 0)) == BENCH_NIF_SIM_LEVEL);
+        argv[1] = nif_pins;
+        term readings = receive_reading("nif/sim_read_many", call_nif(nif_ctx, "adc:nif_take_readings_async/4", 4, argv));
+        check_nif("nif/sim_read_many", term_is_tuple(readings)
+            && term_get_tuple_arity(readings) == 2
+            && is_raw_reading(term_get_tuple_element(readings, 0))
+            && is_raw_reading(term_get_tuple_element(readings, 1))
+            && term_to_int(term_get_tuple_element(term_get_tuple_element(readings, 0), 0)) == BENCH_NIF_SIM_LEVEL
+            && term_to_int(term_get_tuple_element(term_get_tuple_element(readings, 1), 0)) == BENCH_NIF_SIM_REPLAYED);
+        host_context_clear_heap(nif_ctx);
+    }
+    nif_simulate_pins(false);
+}
+
+// a stream on the simulator backend converts the signal of its pin
+static void bench_nif_sim_stream(uint64_t n)
+{
+    nif_simulate_pins(true);
+    term argv[3] = { nif_sim_adc, nif_stream_pins, nif_stream_options };
+    for (uint64_t i = 0; i < n; ++i) {
+        term started = call_nif(nif_ctx, "adc:nif_stream_start/3", 3, argv);
+        check_nif("nif/sim_stream_start", is_tagged(started, 2, OK_ATOM));
+        term stream = term_get_tuple_element(started, 1);
+        term message;
+        check_nif("nif/sim_stream frame", host_context_receive(nif_ctx, BENCH_NIF_REPLY_MS, &message)
+            && is_tagged(message, 3, nif_adc_stream_atom)
+            && term_is_binary(term_get_tuple_element(message, 2))
+            && term_binary_size(term_get_tuple_element(message, 2)) == BENCH_FRAME_BYTES / SOC_ADC_DIGI_RESULT_BYTES * sizeof(uint16_t));
+        const uint8_t *samples = (const uint8_t *) term_binary_data(term_get_tuple_element(message, 2));
+        for (size_t j = 0; j < BENCH_FRAME_BYTES / SOC_ADC_DIGI_RESULT_BYTES; ++j) {
+            uint16_t sample = samples[2 * j] | (samples[2 * j + 1] << 8);
+            check_nif("nif/sim_stream sample", ADC_STREAM_SAMPLE_DATA(sample) == BENCH_NIF_SIM_LEVEL && ADC_STREAM_SAMPLE_CHANNEL(sample) == channel->channel);
+        }
+        check_nif("nif/sim_stream_stop", call_nif(nif_ctx, "adc:nif_stream_stop/1", 1, &stream) == OK_ATOM);
+        while (host_context_receive(nif_ctx, 0, &message)) {
+        }
+        host_context_clear_heap(nif_ctx);
+    }
+    nif_simulate_pins(false);
+}
+
+struct Bench
+{
+    const char *name;
+    void (*fn)(uint64_t n);
+};
+
+static const struct Bench benches[] = {
+    { "unit_open_close", bench_unit_open_close },
+    { "channel_lookup", bench_channel_lookup },
+    { "config_channel", bench_config_channel },
+    { "calibrate_cached", bench_calibrate_cached },
+    { "read/1", bench_read_1 },
+    { "read/64", bench_read_64 },
+    { "read_adaptive/quiet", bench_read_adaptive_quiet },
+    { "read_adaptive/noisy", bench_read_adaptive_noisy },
+    { "read_adaptive/max", bench_read_adaptive_max },
+    { "read/1+shared", bench_read_1_shared },
+    { "read/1+other unit", bench_read_1_other_unit },
+    { "read/64+filter", bench_read_64_filtered },
+    { "stats/64", bench_stats_64 },
+    { "stats/64+median,p95", bench_stats_64_order },
+    { "capture/1024", bench_capture_1024 },
+    { "capture/1024+timestamps", bench_capture_1024_timestamps },
+    { "encode/1024+packed12", bench_encode_packed12 },
+    { "encode/1024+delta", bench_encode_delta },
+    { "oversample/4", bench_oversample_4 },
+    { "oversample/4+dither", bench_oversample_4_dither },
+    { "fft/1024+hann", bench_fft_1024_hann },
+    { "spectrum/1024", bench_spectrum_1024 },
+    { "stream/20kHz+sim_sine", bench_stream_sim_sine },
+    { "stream/20kHz+sim_replay", bench_stream_sim_replay },
+    { "stats/64+sim_noise", bench_stats_64_sim_noise },
+    { "stream/20kHz+sim_backend", bench_stream_sim_backend },
+    { "read/64+continuous_backend", bench_read_64_continuous_backend },
+    { "read/64+sim_backend", bench_read_64_sim_backend },
+    { "calib_convert/1024", bench_calib_convert_1024 },
+    { "stream_parse_frame/256B", bench_stream_parse_frame },
+    { "stream/20kHz+timestamps", bench_stream_timestamps },
+    { "stream/20kHz+credits", bench_stream_credits },
+    { "credit/drop_old", bench_credit_drop_old },
+    { "stream_demux/3ch", bench_stream_demux },
+    { "stream/3ch+demux+skip", bench_stream_demux_skip },
+    { "filter_push", bench_filter_push },
+    { "watch_classify", bench_watch_classify },
+    { "metrics_record", bench_metrics_record },
+    { "ring_push_drain", bench_ring_push_drain },
+    { "ring_spsc_stress", bench_ring_spsc_stress },
+    { "recorder_append/240", bench_recorder_append },
+    { "recorder_wrap+remount", bench_recorder_wrap_remount },
+    { "recorder_readout", bench_recorder_readout },
+    { "worker_round_trip", bench_worker_round_trip },
+    { "adc2_contention", bench_adc2_contention },
+    { "nif/init+close", bench_nif_init_close },
+    { "nif/read_async", bench_nif_read_async },
+    { "nif/read_many", bench_nif_read_many },
+    { "nif/capture", bench_nif_capture },
+    { "nif/badarg", bench_nif_badarg },
+    { "nif/stream", bench_nif_stream },
+    { "nif/sim_read", bench_nif_sim_read },
+    { "nif/sim_stream", bench_nif_sim_stream },
+};
+
+/*---------------------------------------------------------------
+        Runner
+---------------------------------------------------------------*/
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void run(const struct Bench *bench)
+{
+    uint64_t n = 1;
+    for (;;) {
+        uint64_t allocs = __atomic_load_n(&alloc_count, __ATOMIC_RELAXED);
+        uint64_t start = now_ns();
+        bench->fn(n);
+        uint64_t elapsed = now_ns() - start;
+        allocs = __atomic_load_n(&alloc_count, __ATOMIC_RELAXED) - allocs;
+        if (elapsed >= BENCH_MIN_TIME_NS || n >= (UINT64_C(1) << 40)) {
+            printf("%-26s %12" PRIu64 " %12.1f ns/op %10.2f allocs/op\n",
+                bench->name, n, (double) elapsed / n, (double) allocs / n);
+            return;
+        }
+        // aim a little past the minimum time, growing at most 100x per round
+        uint64_t next = elapsed > 0 ? n * BENCH_MIN_TIME_NS / elapsed * 6 / 5 : n * 100;
+        n = next > n * 100 ? n * 100 : next > n ? next : n + 1;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    const char *filter = argc > 1 ? argv[1] : NULL;
+    fixture_init();
+    nif_fixture_init();
+    for (size_t i = 0; i < sizeof(benches) / sizeof(benches[0]); ++i) {
+        if (filter == NULL || strstr(benches[i].name, filter) != NULL) {
+            run(&benches[i]);
+        }
+    }
+    // the handle goes with the heap holding it
+    context_destroy(nif_ctx);
+    context_destroy(nif_owner);
+    globalcontext_destroy(nif_global);
+    adc_unit_deinit(&unit);
+    adc_unit_deinit(&unit2);
+
+    // the last user must have deleted the driver unit
+    adc_oneshot_unit_handle_t handle;
+    adc_oneshot_unit_init_cfg_t init_config = { .unit_id = ADC_UNIT_1 };
+    if (adc_registry_users(&adc_backend_oneshot, ADC_UNIT_1) != 0 || adc_registry_users(&adc_backend_sim, ADC_UNIT_1) != 0
+        || adc_oneshot_new_unit(&init_config, &handle) != ESP_OK) {
+        fprintf(stderr, "registry: driver unit leaked\n");
+        return EXIT_FAILURE;
+    }
+    adc_oneshot_del_unit(handle);
+    return EXIT_SUCCESS;
+}
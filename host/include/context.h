@@ -0,0 +1,50 @@
+//
+// Copyright (c) 2024 Jose Rodriguez
+// All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+//
+// Host stand-in for AtomVM's context.h.  A context is only a heap, a process
+// id and a mailbox; nifs are called on it directly.
+//
+
+#ifndef __HOST_CONTEXT_H__
+#define __HOST_CONTEXT_H__
+
+#include <stdint.h>
+
+#include "globalcontext.h"
+#include "mailbox.h"
+#include "memory.h"
+#include "term.h"
+
+struct Context
+{
+    // an ErlNifEnv on a context is the context itself, so these come first,
+    // as they do in the env
+    GlobalContext *global;
+    Heap heap;
+
+    int32_t process_id;
+    // the class and reason of an error raised by a nif
+    term x[2];
+    Mailbox mailbox;
+    struct Context *next;
+};
+
+Context *context_new(GlobalContext *glb);
+void context_destroy(Context *c);
+
+#endif
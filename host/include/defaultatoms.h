@@ -0,0 +1,50 @@
+//
+// Copyright (c) 2024 Jose Rodriguez
+// All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+//
+// Host stand-in for AtomVM's defaultatoms.h: the atoms every global context
+// is created with, at fixed indices.
+//
+
+#ifndef __HOST_DEFAULTATOMS_H__
+#define __HOST_DEFAULTATOMS_H__
+
+#include "term.h"
+
+#define FALSE_ATOM_INDEX 0
+#define TRUE_ATOM_INDEX 1
+#define OK_ATOM_INDEX 2
+#define ERROR_ATOM_INDEX 3
+#define UNDEFINED_ATOM_INDEX 4
+#define BADARG_ATOM_INDEX 5
+#define OUT_OF_MEMORY_ATOM_INDEX 6
+#define TIMEOUT_ATOM_INDEX 7
+
+#define PLATFORM_ATOMS_BASE_INDEX 8
+
+#define FALSE_ATOM term_from_atom_index(FALSE_ATOM_INDEX)
+#define TRUE_ATOM term_from_atom_index(TRUE_ATOM_INDEX)
+#define OK_ATOM term_from_atom_index(OK_ATOM_INDEX)
+#define ERROR_ATOM term_from_atom_index(ERROR_ATOM_INDEX)
+#define UNDEFINED_ATOM term_from_atom_index(UNDEFINED_ATOM_INDEX)
+#define BADARG_ATOM term_from_atom_index(BADARG_ATOM_INDEX)
+#define OUT_OF_MEMORY_ATOM term_from_atom_index(OUT_OF_MEMORY_ATOM_INDEX)
+#define TIMEOUT_ATOM term_from_atom_index(TIMEOUT_ATOM_INDEX)
+
+void defaultatoms_init(GlobalContext *glb);
+
+#endif
@@ -0,0 +1,69 @@
+//
+// Copyright (c) 2024 Jose Rodriguez
+// All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+//
+// Host stand-in for AtomVM's erl_nif.h, the resource part of it.
+//
+
+#ifndef __HOST_ERL_NIF_H__
+#define __HOST_ERL_NIF_H__
+
+#include <stdint.h>
+
+#include "term_typedef.h"
+
+typedef term ERL_NIF_TERM;
+
+typedef struct ErlNifEnv ErlNifEnv;
+typedef struct ResourceType ErlNifResourceType;
+
+typedef struct
+{
+    int32_t pid;
+} ErlNifPid;
+
+typedef struct
+{
+    uint64_t ref_ticks;
+} ErlNifMonitor;
+
+typedef void ErlNifResourceDtor(ErlNifEnv *caller_env, void *obj);
+typedef void ErlNifResourceStop(ErlNifEnv *caller_env, void *obj, int event, int is_direct_call);
+typedef void ErlNifResourceDown(ErlNifEnv *caller_env, void *obj, ErlNifPid *pid, ErlNifMonitor *mon);
+
+typedef struct
+{
+    int members;
+    ErlNifResourceDtor *dtor;
+    ErlNifResourceStop *stop;
+    ErlNifResourceDown *down;
+} ErlNifResourceTypeInit;
+
+typedef enum
+{
+    ERL_NIF_RT_CREATE = 1,
+    ERL_NIF_RT_TAKEOVER = 2
+} ErlNifResourceFlags;
+
+ErlNifResourceType *enif_init_resource_type(ErlNifEnv *env, const char *name, const ErlNifResourceTypeInit *init, ErlNifResourceFlags flags, ErlNifResourceFlags *tried);
+void *enif_alloc_resource(ErlNifResourceType *type, unsigned size);
+int enif_get_resource(ErlNifEnv *env, ERL_NIF_TERM t, ErlNifResourceType *type, void **objp);
+int enif_keep_resource(void *resource);
+int enif_release_resource(void *resource);
+ERL_NIF_TERM enif_make_resource(ErlNifEnv *env, void *obj);
+
+#endif
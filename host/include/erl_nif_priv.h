@@ -0,0 +1,59 @@
+//
+// Copyright (c) 2024 Jose Rodriguez
+// All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+//
+// Host stand-in for AtomVM's erl_nif_priv.h.
+//
+
+#ifndef __HOST_ERL_NIF_PRIV_H__
+#define __HOST_ERL_NIF_PRIV_H__
+
+#include "context.h"
+#include "erl_nif.h"
+#include "memory.h"
+
+// laid out as the head of a Context, which is what a nif's env is
+struct ErlNifEnv
+{
+    GlobalContext *global;
+    Heap heap;
+};
+
+struct ResourceType
+{
+    const char *name;
+    GlobalContext *global;
+    ErlNifResourceDtor *dtor;
+    ErlNifResourceStop *stop;
+    ErlNifResourceDown *down;
+};
+
+static inline void erl_nif_env_partial_init_from_globalcontext(ErlNifEnv *env, GlobalContext *global)
+{
+    env->global = global;
+    env->heap.root = NULL;
+    env->heap.heap_ptr = NULL;
+    env->heap.heap_end = NULL;
+    env->heap.mso_list = term_nil();
+}
+
+static inline ErlNifEnv *erl_nif_env_from_context(Context *ctx)
+{
+    return (ErlNifEnv *) ctx;
+}
+
+#endif
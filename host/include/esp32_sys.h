@@ -0,0 +1,52 @@
+//
+// Copyright (c) 2024 Jose Rodriguez
+// All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+//
+// Host stand-in for AtomVM's esp32_sys.h.  There is no emulator to load nif
+// collections into, so a registered collection is only defined; its init and
+// resolve callbacks are called directly.
+//
+
+#ifndef __HOST_ESP32_SYS_H__
+#define __HOST_ESP32_SYS_H__
+
+#include "esp_err.h"
+#include "globalcontext.h"
+#include "nifs.h"
+#include "term.h"
+
+typedef void (*nif_collection_init_t)(GlobalContext *global);
+typedef void (*nif_collection_destroy_t)(GlobalContext *global);
+typedef const struct Nif *(*nif_collection_resolve_nif_t)(const char *name);
+
+struct NifCollectionDef
+{
+    const nif_collection_init_t nif_collection_init_cb;
+    const nif_collection_destroy_t nif_collection_destroy_cb;
+    const nif_collection_resolve_nif_t nif_collection_resolve_nif_cb;
+};
+
+#define REGISTER_NIF_COLLECTION(NAME, INIT_CB, DESTROY_CB, RESOLVE_NIF_CB) \
+    const struct NifCollectionDef NAME##_nif_collection_def = {             \
+        .nif_collection_init_cb = INIT_CB,                                  \
+        .nif_collection_destroy_cb = DESTROY_CB,                            \
+        .nif_collection_resolve_nif_cb = RESOLVE_NIF_CB                     \
+    };
+
+term esp_err_to_term(GlobalContext *glb, esp_err_t status);
+
+#endif
@@ -0,0 +1,49 @@
+//
+// Copyright (c) 2024 Jose Rodriguez
+// All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+//
+// Host stand-in for the ESP-IDF calibration schemes.  Like the ESP32, only
+// line fitting is offered, as an ideal linear curve over the attenuation range.
+//
+
+#ifndef __HOST_ADC_CALI_SCHEME_H__
+#define __HOST_ADC_CALI_SCHEME_H__
+
+#include "esp_adc/adc_cali.h"
+#include "hal/adc_types.h"
+
+#define ADC_CALI_SCHEME_LINE_FITTING_SUPPORTED 1
+
+typedef enum
+{
+    ADC_CALI_LINE_FITTING_EFUSE_VAL_EFUSE_VREF,
+    ADC_CALI_LINE_FITTING_EFUSE_VAL_EFUSE_TP,
+    ADC_CALI_LINE_FITTING_EFUSE_VAL_DEFAULT_VREF,
+} adc_cali_line_fitting_efuse_val_t;
+
+typedef struct
+{
+    adc_unit_t unit_id;
+    adc_atten_t atten;
+    adc_bitwidth_t bitwidth;
+    int default_vref;
+} adc_cali_line_fitting_config_t;
+
+esp_err_t adc_cali_create_scheme_line_fitting(const adc_cali_line_fitting_config_t *config, adc_cali_handle_t *ret_handle);
+esp_err_t adc_cali_delete_scheme_line_fitting(adc_cali_handle_t handle);
+
+#endif
@@ -0,0 +1,82 @@
+//
+// Copyright (c) 2024 Jose Rodriguez
+// All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+//
+// Host stand-in for the ESP-IDF ADC oneshot driver.  Reads return a
+// deterministic synthetic signal, or one set with adc_sim.h, so the
+// component can be run and measured off-device.
+//
+
+#ifndef __HOST_ADC_ONESHOT_H__
+#define __HOST_ADC_ONESHOT_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+#include "hal/adc_types.h"
+
+typedef struct adc_oneshot_unit_ctx_t *adc_oneshot_unit_handle_t;
+
+typedef enum
+{
+    ADC_DIGI_CLK_SRC_DEFAULT,
+} adc_oneshot_clk_src_t;
+
+typedef enum
+{
+    ADC_ULP_MODE_DISABLE,
+} adc_ulp_mode_t;
+
+typedef struct
+{
+    adc_unit_t unit_id;
+    adc_oneshot_clk_src_t clk_src;
+    adc_ulp_mode_t ulp_mode;
+} adc_oneshot_unit_init_cfg_t;
+
+typedef struct
+{
+    adc_atten_t atten;
+    adc_bitwidth_t bitwidth;
+} adc_oneshot_chan_cfg_t;
+
+esp_err_t adc_oneshot_new_unit(const adc_oneshot_unit_init_cfg_t *init_config, adc_oneshot_unit_handle_t *ret_unit);
+esp_err_t adc_oneshot_config_channel(adc_oneshot_unit_handle_t handle, adc_channel_t channel, const adc_oneshot_chan_cfg_t *config);
+esp_err_t adc_oneshot_read(adc_oneshot_unit_handle_t handle, adc_channel_t chan, int *out_raw);
+esp_err_t adc_oneshot_del_unit(adc_oneshot_unit_handle_t handle);
+
+//
+// Host only: value returned by the n-th read of a channel.  Exposed so host
+// programs can verify results.
+//
+uint16_t host_adc_oneshot_synthetic_value(adc_channel_t channel, uint32_t n);
+
+//
+// Host only: simulate the Wi-Fi PHY holding the ADC2 SAR.  While set, reads
+// on unit 2 fail with ESP_ERR_TIMEOUT, as they do on the device.
+//
+void host_adc_oneshot_set_wifi_active(bool active);
+
+//
+// Host only: make reads of a channel return level plus uniform noise of up
+// to +-noise, instead of the synthetic sawtooth.  A negative level restores
+// the sawtooth.
+//
+void host_adc_oneshot_set_level(adc_unit_t unit_id, adc_channel_t channel, int level, uint16_t noise);
+
+#endif
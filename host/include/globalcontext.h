@@ -0,0 +1,59 @@
+//
+// Copyright (c) 2024 Jose Rodriguez
+// All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+//
+// Host stand-in for AtomVM's globalcontext.h: the atom table, reference
+// ticks and the process table messages are delivered through.
+//
+
+#ifndef __HOST_GLOBALCONTEXT_H__
+#define __HOST_GLOBALCONTEXT_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "mailbox.h"
+#include "term.h"
+
+// an atom string is its length in one byte followed by its characters
+typedef const void *AtomString;
+
+#define ATOM_STR(LENSTR, STR) (LENSTR STR)
+
+GlobalContext *globalcontext_new(void);
+
+/**
+ * @brief   Destroy a global context, which must have no processes left.
+ */
+void globalcontext_destroy(GlobalContext *glb);
+
+term globalcontext_make_atom(GlobalContext *glb, AtomString string);
+bool globalcontext_is_term_equal_to_atom_string(GlobalContext *global, term atom_a, AtomString atom_string_b);
+uint64_t globalcontext_get_ref_ticks(GlobalContext *global);
+
+/**
+ * @brief   Copy t into the mailbox of a process.  A message to a process that
+ *          is not (or no longer) there is dropped.
+ */
+void globalcontext_send_message(GlobalContext *glb, int32_t process_id, term t);
+
+/**
+ * @brief   As globalcontext_send_message, from a task other than a scheduler.
+ */
+void globalcontext_send_message_from_task(GlobalContext *glb, int32_t process_id, enum MessageType type, term t);
+
+#endif
@@ -0,0 +1,45 @@
+//
+// Copyright (c) 2024 Jose Rodriguez
+// All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+//
+// Host only: running nifs without the emulator.  A context stands in for the
+// calling process; the messages nifs and tasks send it are picked up here.
+//
+
+#ifndef __HOST_AVM_H__
+#define __HOST_AVM_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "context.h"
+#include "term.h"
+
+/**
+ * @brief   Take the oldest message from the mailbox of ctx, waiting up to
+ *          timeout_ms for one.  Its terms move onto the heap of ctx.
+ * @return  false if none arrived in time.
+ */
+bool host_context_receive(Context *ctx, uint32_t timeout_ms, term *message);
+
+/**
+ * @brief   Drop every term on the heap of ctx, releasing the resources on it,
+ *          as a collection with no live roots would.
+ */
+void host_context_clear_heap(Context *ctx);
+
+#endif
@@ -0,0 +1,53 @@
+//
+// Copyright (c) 2024 Jose Rodriguez
+// All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+//
+// Host stand-in for AtomVM's interop.h.  Key-value lists are proplists of
+// {Key, Value} pairs; maps are not supported.
+//
+
+#ifndef __HOST_INTEROP_H__
+#define __HOST_INTEROP_H__
+
+#include "globalcontext.h"
+#include "term.h"
+
+typedef struct
+{
+    AtomString as_str;
+    int i_val;
+} AtomStringIntPair;
+
+#define SELECT_INT_DEFAULT(i_val) \
+    {                             \
+        .as_str = NULL, i_val     \
+    }
+
+term interop_kv_get_value_default(term kv, AtomString key, term default_value, GlobalContext *glb);
+
+static inline term interop_kv_get_value(term kv, AtomString key, GlobalContext *glb)
+{
+    return interop_kv_get_value_default(kv, key, term_invalid_term(), glb);
+}
+
+int interop_atom_term_select_int(const AtomStringIntPair *table, term atom, GlobalContext *global);
+
+// A malloc'd, NUL-terminated copy of a charlist; *ok is false (and NULL is
+// returned) if it is not a list of bytes or cannot be allocated.
+char *interop_list_to_string(term list, int *ok);
+
+#endif
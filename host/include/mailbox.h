@@ -0,0 +1,58 @@
+//
+// Copyright (c) 2024 Jose Rodriguez
+// All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+//
+// Host stand-in for AtomVM's mailbox.h.  A message is held on a heap of its
+// own until it is received.
+//
+
+#ifndef __HOST_MAILBOX_H__
+#define __HOST_MAILBOX_H__
+
+#include <pthread.h>
+#include <stddef.h>
+
+#include "memory.h"
+#include "term_typedef.h"
+
+enum MessageType
+{
+    NormalMessage
+};
+
+struct Message
+{
+    struct Message *next;
+    term message;
+    Heap heap;
+};
+
+typedef struct
+{
+    pthread_mutex_t lock;
+    pthread_cond_t not_empty;
+    // oldest first
+    struct Message *head;
+    struct Message **tail;
+} Mailbox;
+
+void mailbox_init(Mailbox *mbox);
+void mailbox_destroy(Mailbox *mbox, GlobalContext *global);
+void mailbox_send(Mailbox *mbox, struct Message *message);
+size_t mailbox_len(Mailbox *mbox);
+
+#endif
@@ -0,0 +1,114 @@
+//
+// Copyright (c) 2024 Jose Rodriguez
+// All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+//
+// Host stand-in for AtomVM's memory.h.  Heaps are chains of fragments that
+// are never collected, so terms do not move and roots need no fixing up.  A
+// heap only hands out what the last memory_ensure_free (or memory_init_heap)
+// reserved, and aborts on anything more, so a nif that allocates more than it
+// asked for is caught rather than corrupting memory.
+//
+
+#ifndef __HOST_MEMORY_H__
+#define __HOST_MEMORY_H__
+
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "term_typedef.h"
+#include "utils.h"
+
+struct HeapFragment
+{
+    struct HeapFragment *next;
+    term *end;
+    term storage[];
+};
+
+typedef struct Heap
+{
+    // newest fragment first
+    struct HeapFragment *root;
+    term *heap_ptr;
+    // end of the reservation, not of the fragment
+    term *heap_end;
+    // the refc binaries (resources) on the heap, chained through the binaries
+    // and released with it
+    term mso_list;
+} Heap;
+
+enum MemoryGCResult
+{
+    MEMORY_GC_OK = 0,
+    MEMORY_GC_ERROR_FAILED_ALLOCATION = 1,
+    MEMORY_GC_DENIED_ALLOCATION = 2
+};
+
+enum MemoryAllocMode
+{
+    MEMORY_NO_SHRINK = 0,
+    MEMORY_CAN_SHRINK = 1,
+    MEMORY_FORCE_SHRINK = 2,
+    MEMORY_NO_GC = 3
+};
+
+#define BEGIN_WITH_STACK_HEAP(size, name)                                           \
+    Heap name;                                                                      \
+    if (UNLIKELY(memory_init_heap(&name, size) != MEMORY_GC_OK)) {                  \
+        fprintf(stderr, "Unable to allocate %zu words for a stack heap\n", (size_t) (size)); \
+        abort();                                                                    \
+    }
+
+#define END_WITH_STACK_HEAP(name, global) memory_destroy_heap(&name, global);
+
+enum MemoryGCResult memory_init_heap(Heap *heap, size_t size);
+void memory_destroy_heap(Heap *heap, GlobalContext *global);
+enum MemoryGCResult memory_heap_ensure_free(Heap *heap, size_t size);
+enum MemoryGCResult memory_ensure_free(Context *ctx, size_t size);
+enum MemoryGCResult memory_ensure_free_with_roots(Context *ctx, size_t size, size_t num_roots, term *roots, enum MemoryAllocMode alloc_mode);
+
+/**
+ * @brief   Words a copy of t would take on another heap.
+ */
+size_t memory_estimate_usage(term t);
+
+/**
+ * @brief   Copy t onto new_heap, which must have memory_estimate_usage(t)
+ *          words reserved.  Binaries are copied whole; resources are shared.
+ */
+term memory_copy_term_tree(Heap *new_heap, term t);
+
+/**
+ * @brief   Move the fragments of from, and the resources on it, onto heap.
+ *          Terms on from stay where they are and remain valid.
+ */
+void memory_heap_append_heap(Heap *heap, Heap *from);
+
+void memory_heap_overrun(Heap *heap, size_t size);
+
+static inline term *memory_heap_alloc(Heap *heap, size_t size)
+{
+    if (__builtin_expect((size_t) (heap->heap_end - heap->heap_ptr) < size, 0)) {
+        memory_heap_overrun(heap, size);
+    }
+    term *ptr = heap->heap_ptr;
+    heap->heap_ptr += size;
+    return ptr;
+}
+
+#endif
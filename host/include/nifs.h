@@ -0,0 +1,61 @@
+//
+// Copyright (c) 2024 Jose Rodriguez
+// All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+//
+// Host stand-in for AtomVM's nifs.h and exportedfunction.h.
+//
+
+#ifndef __HOST_NIFS_H__
+#define __HOST_NIFS_H__
+
+#include "context.h"
+#include "defaultatoms.h"
+#include "term.h"
+
+typedef term (*NifImpl)(Context *ctx, int argc, term argv[]);
+
+enum ExportedFunctionType
+{
+    InvalidFunctionType = 0,
+    NIFFunctionType = 2
+};
+
+struct ExportedFunction
+{
+    enum ExportedFunctionType type;
+};
+
+struct Nif
+{
+    struct ExportedFunction base;
+    NifImpl nif_ptr;
+};
+
+// leaves the class and reason in x[0] and x[1], as the emulator expects
+#define RAISE_ERROR(error_type_atom)    \
+    do {                                \
+        ctx->x[0] = ERROR_ATOM;         \
+        ctx->x[1] = (error_type_atom);  \
+        return term_invalid_term();     \
+    } while (0)
+
+#define VALIDATE_VALUE(value, verify_function) \
+    if (UNLIKELY(!verify_function((value)))) { \
+        RAISE_ERROR(BADARG_ATOM);              \
+    }
+
+#endif
@@ -0,0 +1,45 @@
+//
+// Copyright (c) 2024 Jose Rodriguez
+// All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+//
+// Host stand-in for the ESP32 soc/adc_channel.h GPIO assignments.
+//
+
+#ifndef __HOST_SOC_ADC_CHANNEL_H__
+#define __HOST_SOC_ADC_CHANNEL_H__
+
+#define ADC1_CHANNEL_0_GPIO_NUM 36
+#define ADC1_CHANNEL_1_GPIO_NUM 37
+#define ADC1_CHANNEL_2_GPIO_NUM 38
+#define ADC1_CHANNEL_3_GPIO_NUM 39
+#define ADC1_CHANNEL_4_GPIO_NUM 32
+#define ADC1_CHANNEL_5_GPIO_NUM 33
+#define ADC1_CHANNEL_6_GPIO_NUM 34
+#define ADC1_CHANNEL_7_GPIO_NUM 35
+
+#define ADC2_CHANNEL_0_GPIO_NUM 4
+#define ADC2_CHANNEL_1_GPIO_NUM 0
+#define ADC2_CHANNEL_2_GPIO_NUM 2
+#define ADC2_CHANNEL_3_GPIO_NUM 15
+#define ADC2_CHANNEL_4_GPIO_NUM 13
+#define ADC2_CHANNEL_5_GPIO_NUM 12
+#define ADC2_CHANNEL_6_GPIO_NUM 14
+#define ADC2_CHANNEL_7_GPIO_NUM 27
+#define ADC2_CHANNEL_8_GPIO_NUM 25
+#define ADC2_CHANNEL_9_GPIO_NUM 26
+
+#endif
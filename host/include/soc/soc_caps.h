@@ -0,0 +1,38 @@
+//
+// Copyright (c) 2024 Jose Rodriguez
+// All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+//
+// Host stand-in for the ESP32 soc_caps.h ADC section.
+//
+
+#ifndef __HOST_SOC_CAPS_H__
+#define __HOST_SOC_CAPS_H__
+
+#define SOC_ADC_PERIPH_NUM (2)
+#define SOC_ADC_CHANNEL_NUM(PERIPH_NUM) ((PERIPH_NUM == 0) ? 8 : 10)
+#define SOC_ADC_MAX_CHANNEL_NUM (10)
+#define SOC_ADC_PATT_LEN_MAX (16)
+#define SOC_ADC_DIGI_MAX_BITWIDTH (12)
+#define SOC_ADC_DIGI_RESULT_BYTES (2)
+#define SOC_ADC_RTC_MIN_BITWIDTH (9)
+#define SOC_ADC_RTC_MAX_BITWIDTH (12)
+#define SOC_ADC_SAMPLE_FREQ_THRES_HIGH (2 * 1000 * 1000)
+#define SOC_ADC_SAMPLE_FREQ_THRES_LOW (20 * 1000)
+
+#define SOC_GPIO_PIN_COUNT (40)
+
+#endif
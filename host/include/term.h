@@ -0,0 +1,416 @@
+//
+// Copyright (c) 2024 Jose Rodriguez
+// All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+//
+// Host stand-in for AtomVM's term.h, keeping its tagging: immediates
+// (small integers, atoms, local pids, nil) in the word itself, lists and
+// boxed terms as tagged pointers onto a heap.
+//
+
+#ifndef __HOST_TERM_H__
+#define __HOST_TERM_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "memory.h"
+#include "term_typedef.h"
+#include "utils.h"
+
+#define TERM_PRIMARY_MASK 0x3
+#define TERM_PRIMARY_LIST 0x1
+#define TERM_PRIMARY_BOXED 0x2
+#define TERM_PRIMARY_IMMED 0x3
+
+#define TERM_IMMED_TAG_MASK 0xF
+#define TERM_PID_TAG 0x3
+#define TERM_INTEGER_TAG 0xF
+
+#define TERM_IMMED2_TAG_MASK 0x3F
+#define TERM_IMMED2_ATOM 0xB
+#define TERM_NIL 0x3B
+
+#define TERM_BOXED_TAG_MASK 0x3F
+#define TERM_BOXED_TUPLE 0x0
+#define TERM_BOXED_INTEGER 0x8
+#define TERM_BOXED_REF 0x10
+#define TERM_BOXED_FLOAT 0x18
+#define TERM_BOXED_REFC_BINARY 0x20
+#define TERM_BOXED_HEAP_BINARY 0x24
+#define TERM_BOXED_SUB_BINARY 0x28
+
+#define TERM_WORDS(bytes) (((bytes) + sizeof(term) - 1) / sizeof(term))
+
+#define TUPLE_SIZE(elems) ((elems) + 1)
+#define CONS_SIZE 2
+#define LIST_SIZE(num_elements, element_size) ((num_elements) * ((element_size) + CONS_SIZE))
+#define BOXED_INT64_SIZE (1 + TERM_WORDS(sizeof(avm_int64_t)))
+#define REF_SIZE (1 + TERM_WORDS(sizeof(uint64_t)))
+#define FLOAT_SIZE (1 + TERM_WORDS(sizeof(avm_float_t)))
+// header, size, data, resource, next on the mso list
+#define TERM_BOXED_REFC_BINARY_SIZE 5
+#define TERM_BOXED_RESOURCE_SIZE TERM_BOXED_REFC_BINARY_SIZE
+// header, size, offset, binary
+#define TERM_BOXED_SUB_BINARY_SIZE 4
+
+static inline term term_invalid_term(void)
+{
+    return 0;
+}
+
+static inline bool term_is_invalid_term(term t)
+{
+    return t == 0;
+}
+
+static inline term term_nil(void)
+{
+    return TERM_NIL;
+}
+
+static inline bool term_is_nil(term t)
+{
+    return t == TERM_NIL;
+}
+
+static inline bool term_is_boxed(term t)
+{
+    return (t & TERM_PRIMARY_MASK) == TERM_PRIMARY_BOXED;
+}
+
+static inline const term *term_to_const_term_ptr(term t)
+{
+    return (const term *) (t & ~((term) TERM_PRIMARY_MASK));
+}
+
+static inline term *term_to_term_ptr(term t)
+{
+    return (term *) (t & ~((term) TERM_PRIMARY_MASK));
+}
+
+static inline int term_boxed_tag(term t)
+{
+    return term_to_const_term_ptr(t)[0] & TERM_BOXED_TAG_MASK;
+}
+
+static inline size_t term_boxed_size(term t)
+{
+    return term_to_const_term_ptr(t)[0] >> 6;
+}
+
+static inline bool term_is_boxed_with_tag(term t, int tag)
+{
+    return term_is_boxed(t) && term_boxed_tag(t) == tag;
+}
+
+static inline term *term_boxed_alloc(size_t size, int tag, Heap *heap)
+{
+    term *boxed = memory_heap_alloc(heap, 1 + size);
+    boxed[0] = ((term) size << 6) | tag;
+    return boxed;
+}
+
+static inline term term_from_boxed(term *boxed)
+{
+    return (term) boxed | TERM_PRIMARY_BOXED;
+}
+
+// Integers
+
+static inline bool term_is_integer(term t)
+{
+    return (t & TERM_IMMED_TAG_MASK) == TERM_INTEGER_TAG;
+}
+
+static inline bool term_is_boxed_integer(term t)
+{
+    return term_is_boxed_with_tag(t, TERM_BOXED_INTEGER);
+}
+
+static inline bool term_is_any_integer(term t)
+{
+    return term_is_integer(t) || term_is_boxed_integer(t);
+}
+
+static inline avm_int_t term_to_int(term t)
+{
+    return ((avm_int_t) t) >> 4;
+}
+
+static inline int32_t term_to_int32(term t)
+{
+    return (int32_t) term_to_int(t);
+}
+
+static inline term term_from_int(avm_int_t value)
+{
+    return ((term) value << 4) | TERM_INTEGER_TAG;
+}
+
+static inline term term_from_int32(int32_t value)
+{
+    return term_from_int(value);
+}
+
+static inline avm_int64_t term_unbox_int64(term t)
+{
+    avm_int64_t value;
+    memcpy(&value, term_to_const_term_ptr(t) + 1, sizeof(value));
+    return value;
+}
+
+static inline avm_int64_t term_maybe_unbox_int64(term t)
+{
+    return term_is_integer(t) ? term_to_int(t) : term_unbox_int64(t);
+}
+
+static inline term term_make_maybe_boxed_int64(avm_int64_t value, Heap *heap)
+{
+    if (value >= AVM_INT_MIN && value <= AVM_INT_MAX) {
+        return term_from_int((avm_int_t) value);
+    }
+    term *boxed = term_boxed_alloc(BOXED_INT64_SIZE - 1, TERM_BOXED_INTEGER, heap);
+    memcpy(boxed + 1, &value, sizeof(value));
+    return term_from_boxed(boxed);
+}
+
+// Floats
+
+static inline bool term_is_float(term t)
+{
+    return term_is_boxed_with_tag(t, TERM_BOXED_FLOAT);
+}
+
+static inline bool term_is_number(term t)
+{
+    return term_is_any_integer(t) || term_is_float(t);
+}
+
+static inline avm_float_t term_to_float(term t)
+{
+    avm_float_t value;
+    memcpy(&value, term_to_const_term_ptr(t) + 1, sizeof(value));
+    return value;
+}
+
+static inline avm_float_t term_conv_to_float(term t)
+{
+    return term_is_float(t) ? term_to_float(t) : (avm_float_t) term_maybe_unbox_int64(t);
+}
+
+static inline term term_from_float(avm_float_t value, Heap *heap)
+{
+    term *boxed = term_boxed_alloc(FLOAT_SIZE - 1, TERM_BOXED_FLOAT, heap);
+    memcpy(boxed + 1, &value, sizeof(value));
+    return term_from_boxed(boxed);
+}
+
+// Atoms
+
+static inline bool term_is_atom(term t)
+{
+    return (t & TERM_IMMED2_TAG_MASK) == TERM_IMMED2_ATOM;
+}
+
+static inline term term_from_atom_index(size_t index)
+{
+    return ((term) index << 6) | TERM_IMMED2_ATOM;
+}
+
+static inline size_t term_to_atom_index(term t)
+{
+    return t >> 6;
+}
+
+// Pids
+
+static inline bool term_is_local_pid(term t)
+{
+    return (t & TERM_IMMED_TAG_MASK) == TERM_PID_TAG;
+}
+
+static inline bool term_is_pid(term t)
+{
+    return term_is_local_pid(t);
+}
+
+static inline term term_from_local_process_id(int32_t process_id)
+{
+    return ((term) process_id << 4) | TERM_PID_TAG;
+}
+
+static inline int32_t term_to_local_process_id(term t)
+{
+    return (int32_t) (t >> 4);
+}
+
+// References
+
+static inline bool term_is_reference(term t)
+{
+    return term_is_boxed_with_tag(t, TERM_BOXED_REF);
+}
+
+static inline term term_from_ref_ticks(uint64_t ref_ticks, Heap *heap)
+{
+    term *boxed = term_boxed_alloc(REF_SIZE - 1, TERM_BOXED_REF, heap);
+    memcpy(boxed + 1, &ref_ticks, sizeof(ref_ticks));
+    return term_from_boxed(boxed);
+}
+
+static inline uint64_t term_to_ref_ticks(term t)
+{
+    uint64_t ref_ticks;
+    memcpy(&ref_ticks, term_to_const_term_ptr(t) + 1, sizeof(ref_ticks));
+    return ref_ticks;
+}
+
+// Tuples
+
+static inline bool term_is_tuple(term t)
+{
+    return term_is_boxed_with_tag(t, TERM_BOXED_TUPLE);
+}
+
+static inline term term_alloc_tuple(uint32_t size, Heap *heap)
+{
+    term *boxed = term_boxed_alloc(size, TERM_BOXED_TUPLE, heap);
+    for (uint32_t i = 0; i < size; ++i) {
+        boxed[1 + i] = term_nil();
+    }
+    return term_from_boxed(boxed);
+}
+
+static inline int term_get_tuple_arity(term t)
+{
+    return (int) term_boxed_size(t);
+}
+
+static inline void term_put_tuple_element(term t, uint32_t elem_index, term put_value)
+{
+    term_to_term_ptr(t)[1 + elem_index] = put_value;
+}
+
+static inline term term_get_tuple_element(term t, int elem_index)
+{
+    return term_to_const_term_ptr(t)[1 + elem_index];
+}
+
+// Lists
+
+static inline bool term_is_nonempty_list(term t)
+{
+    return (t & TERM_PRIMARY_MASK) == TERM_PRIMARY_LIST;
+}
+
+static inline bool term_is_list(term t)
+{
+    return term_is_nil(t) || term_is_nonempty_list(t);
+}
+
+static inline term term_get_list_head(term t)
+{
+    return ((const term *) (t & ~((term) TERM_PRIMARY_MASK)))[0];
+}
+
+static inline term term_get_list_tail(term t)
+{
+    return ((const term *) (t & ~((term) TERM_PRIMARY_MASK)))[1];
+}
+
+static inline term term_list_prepend(term head, term tail, Heap *heap)
+{
+    term *cons = memory_heap_alloc(heap, CONS_SIZE);
+    cons[0] = head;
+    cons[1] = tail;
+    return (term) cons | TERM_PRIMARY_LIST;
+}
+
+// Binaries
+
+static inline bool term_is_binary(term t)
+{
+    if (!term_is_boxed(t)) {
+        return false;
+    }
+    int tag = term_boxed_tag(t);
+    return tag == TERM_BOXED_REFC_BINARY || tag == TERM_BOXED_HEAP_BINARY || tag == TERM_BOXED_SUB_BINARY;
+}
+
+static inline size_t term_binary_size(term t)
+{
+    return term_to_const_term_ptr(t)[1];
+}
+
+static inline const char *term_binary_data(term t)
+{
+    const term *boxed = term_to_const_term_ptr(t);
+    switch (boxed[0] & TERM_BOXED_TAG_MASK) {
+        case TERM_BOXED_HEAP_BINARY:
+            return (const char *) (boxed + 2);
+        case TERM_BOXED_REFC_BINARY:
+            return (const char *) boxed[2];
+        default:
+            return term_binary_data(boxed[3]) + boxed[2];
+    }
+}
+
+static inline size_t term_binary_heap_size(size_t size)
+{
+    return 2 + TERM_WORDS(size);
+}
+
+static inline term term_create_uninitialized_binary(size_t size, Heap *heap, GlobalContext *glb)
+{
+    UNUSED(glb);
+    term *boxed = term_boxed_alloc(term_binary_heap_size(size) - 1, TERM_BOXED_HEAP_BINARY, heap);
+    boxed[1] = size;
+    return term_from_boxed(boxed);
+}
+
+static inline term term_from_literal_binary(const void *data, size_t size, Heap *heap, GlobalContext *glb)
+{
+    term binary = term_create_uninitialized_binary(size, heap, glb);
+    memcpy((char *) term_binary_data(binary), data, size);
+    return binary;
+}
+
+// a binary over memory that outlives every term referring to it
+static inline term term_from_const_binary(const void *data, size_t size, Heap *heap, GlobalContext *glb)
+{
+    UNUSED(glb);
+    term *boxed = term_boxed_alloc(TERM_BOXED_REFC_BINARY_SIZE - 1, TERM_BOXED_REFC_BINARY, heap);
+    boxed[1] = size;
+    boxed[2] = (term) data;
+    boxed[3] = (term) NULL;
+    boxed[4] = term_nil();
+    return term_from_boxed(boxed);
+}
+
+static inline term term_maybe_create_sub_binary(term binary, size_t offset, size_t len, Heap *heap, GlobalContext *glb)
+{
+    UNUSED(glb);
+    term *boxed = term_boxed_alloc(TERM_BOXED_SUB_BINARY_SIZE - 1, TERM_BOXED_SUB_BINARY, heap);
+    boxed[1] = len;
+    boxed[2] = offset;
+    boxed[3] = binary;
+    return term_from_boxed(boxed);
+}
+
+#endif
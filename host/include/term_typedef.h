@@ -0,0 +1,39 @@
+//
+// Copyright (c) 2024 Jose Rodriguez
+// All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+//
+// Host stand-in for AtomVM's term_typedef.h: a term is one machine word.
+//
+
+#ifndef __HOST_TERM_TYPEDEF_H__
+#define __HOST_TERM_TYPEDEF_H__
+
+#include <stdint.h>
+
+typedef uintptr_t term;
+
+typedef intptr_t avm_int_t;
+typedef int64_t avm_int64_t;
+typedef double avm_float_t;
+
+#define AVM_INT_MIN (INTPTR_MIN >> 4)
+#define AVM_INT_MAX (INTPTR_MAX >> 4)
+
+typedef struct Context Context;
+typedef struct GlobalContext GlobalContext;
+
+#endif
@@ -0,0 +1,58 @@
+//
+// Copyright (c) 2024 Jose Rodriguez
+// All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "esp_adc/adc_cali_scheme.h"
+
+#include <stdlib.h>
+
+struct adc_cali_scheme_t
+{
+    int max_raw;
+    int max_mv;
+};
+
+esp_err_t adc_cali_create_scheme_line_fitting(const adc_cali_line_fitting_config_t *config, adc_cali_handle_t *ret_handle)
+{
+    static const int range_mv[] = { 950, 1250, 1750, 2450 };
+    if (config == NULL || ret_handle == NULL || config->atten > ADC_ATTEN_DB_12) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    struct adc_cali_scheme_t *scheme = malloc(sizeof(struct adc_cali_scheme_t));
+    if (scheme == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    int bits = config->bitwidth == ADC_BITWIDTH_DEFAULT ? 12 : (int) config->bitwidth;
+    scheme->max_raw = (1 << bits) - 1;
+    scheme->max_mv = range_mv[config->atten];
+    *ret_handle = scheme;
+    return ESP_OK;
+}
+
+esp_err_t adc_cali_delete_scheme_line_fitting(adc_cali_handle_t handle)
+{
+    free(handle);
+    return ESP_OK;
+}
+
+esp_err_t adc_cali_raw_to_voltage(adc_cali_handle_t handle, int raw, int *voltage)
+{
+    if (handle == NULL || voltage == NULL || raw < 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    *voltage = raw * handle->max_mv / handle->max_raw;
+    return ESP_OK;
+}
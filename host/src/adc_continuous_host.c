@@ -0,0 +1,268 @@
+//
+// Copyright (c) 2024 Jose Rodriguez
+// All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+//
+// Synthetic stand-in for the ESP-IDF ADC continuous driver.
+//
+// A producer thread walks the configured pattern table at sample_freq_hz and
+// packs TYPE1 conversion records into conv_frame_size frames, taking values
+// from the simulated signal of each channel (adc_sim.h), if any.  Each completed
+// frame is announced through on_conv_done and appended to the pool, or dropped
+// with on_pool_ovf if the pool is full, in that order and under the pool lock,
+// so a reader sees the whole DMA EOF interrupt or none of it.
+//
+
+#include "esp_adc/adc_continuous.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "adc_sim.h"
+#include "soc/soc_caps.h"
+
+struct adc_continuous_ctx_t
+{
+    pthread_mutex_t lock;
+    pthread_cond_t available;
+    pthread_t producer;
+    volatile bool running;
+
+    uint8_t *pool;
+    uint32_t pool_size;
+    uint32_t pool_head;
+    uint32_t pool_count;
+    uint32_t frame_size;
+
+    adc_digi_pattern_config_t pattern[SOC_ADC_PATT_LEN_MAX];
+    uint32_t pattern_num;
+    uint32_t sample_freq_hz;
+    uint32_t conversions[SOC_ADC_MAX_CHANNEL_NUM];
+    // conversions since start, which times them for the simulated signals
+    uint64_t converted;
+
+    adc_continuous_evt_cbs_t cbs;
+    void *user_data;
+};
+
+static uint32_t skip_period;
+
+void host_adc_continuous_set_skip_period(uint32_t period)
+{
+    __atomic_store_n(&skip_period, period, __ATOMIC_RELAXED);
+}
+
+uint16_t host_adc_continuous_synthetic_value(adc_channel_t channel, uint32_t n)
+{
+    // Per channel sawtooth, offset by channel so interleaved data is easy to tell apart.
+    return (uint16_t) ((n * 16 + (uint32_t) channel * 409) & 0xFFF);
+}
+
+static void pool_push(struct adc_continuous_ctx_t *ctx, const uint8_t *frame, uint32_t size)
+{
+    for (uint32_t i = 0; i < size; ++i) {
+        ctx->pool[(ctx->pool_head + ctx->pool_count + i) % ctx->pool_size] = frame[i];
+    }
+    ctx->pool_count += size;
+}
+
+static void *producer_main(void *arg)
+{
+    struct adc_continuous_ctx_t *ctx = (struct adc_continuous_ctx_t *) arg;
+    uint32_t records = ctx->frame_size / SOC_ADC_DIGI_RESULT_BYTES;
+    uint8_t *frame = malloc(ctx->frame_size);
+    uint64_t frame_ns = (uint64_t) records * 1000000000ULL / ctx->sample_freq_hz;
+    uint32_t slot = 0;
+    uint32_t skip = __atomic_load_n(&skip_period, __ATOMIC_RELAXED);
+    uint32_t since_skip = 0;
+
+    struct timespec next;
+    clock_gettime(CLOCK_MONOTONIC, &next);
+
+    while (ctx->running && frame != NULL) {
+        for (uint32_t i = 0; i < records; ++i) {
+            if (skip != 0 && ++since_skip == skip) {
+                since_skip = 0;
+                slot = (slot + 1) % ctx->pattern_num;
+            }
+            const adc_digi_pattern_config_t *pattern = &ctx->pattern[slot];
+            adc_digi_output_data_t record = { 0 };
+            uint32_t n = ctx->conversions[pattern->channel]++;
+            uint16_t value;
+            if (!adc_sim_sample(pattern->unit, pattern->channel, (double) ctx->converted / ctx->sample_freq_hz, n, &value)) {
+                value = host_adc_continuous_synthetic_value(pattern->channel, n);
+            }
+            ctx->converted++;
+            record.type1.channel = pattern->channel;
+            record.type1.data = value;
+            memcpy(frame + i * SOC_ADC_DIGI_RESULT_BYTES, &record, SOC_ADC_DIGI_RESULT_BYTES);
+            slot = (slot + 1) % ctx->pattern_num;
+        }
+
+        next.tv_nsec += frame_ns;
+        while (next.tv_nsec >= 1000000000L) {
+            next.tv_sec += 1;
+            next.tv_nsec -= 1000000000L;
+        }
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+        if (!ctx->running) {
+            break;
+        }
+
+        adc_continuous_evt_data_t edata = {
+            .conv_frame_buffer = frame,
+            .size = ctx->frame_size
+        };
+        pthread_mutex_lock(&ctx->lock);
+        if (ctx->cbs.on_conv_done != NULL) {
+            ctx->cbs.on_conv_done(ctx, &edata, ctx->user_data);
+        }
+        if (ctx->pool_count + ctx->frame_size <= ctx->pool_size) {
+            pool_push(ctx, frame, ctx->frame_size);
+            pthread_cond_broadcast(&ctx->available);
+        } else if (ctx->cbs.on_pool_ovf != NULL) {
+            ctx->cbs.on_pool_ovf(ctx, &edata, ctx->user_data);
+        }
+        pthread_mutex_unlock(&ctx->lock);
+    }
+
+    free(frame);
+    return NULL;
+}
+
+esp_err_t adc_continuous_new_handle(const adc_continuous_handle_cfg_t *hdl_config, adc_continuous_handle_t *ret_handle)
+{
+    if (hdl_config == NULL || ret_handle == NULL || hdl_config->conv_frame_size == 0
+        || hdl_config->conv_frame_size % SOC_ADC_DIGI_RESULT_BYTES != 0
+        || hdl_config->max_store_buf_size < hdl_config->conv_frame_size) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    struct adc_continuous_ctx_t *ctx = calloc(1, sizeof(struct adc_continuous_ctx_t));
+    if (ctx == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    ctx->pool = malloc(hdl_config->max_store_buf_size);
+    if (ctx->pool == NULL) {
+        free(ctx);
+        return ESP_ERR_NO_MEM;
+    }
+    ctx->pool_size = hdl_config->max_store_buf_size;
+    ctx->frame_size = hdl_config->conv_frame_size;
+    pthread_mutex_init(&ctx->lock, NULL);
+    pthread_cond_init(&ctx->available, NULL);
+    *ret_handle = ctx;
+    return ESP_OK;
+}
+
+esp_err_t adc_continuous_config(adc_continuous_handle_t handle, const adc_continuous_config_t *config)
+{
+    if (handle->running) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (config->pattern_num == 0 || config->pattern_num > SOC_ADC_PATT_LEN_MAX
+        || config->sample_freq_hz < SOC_ADC_SAMPLE_FREQ_THRES_LOW
+        || config->sample_freq_hz > SOC_ADC_SAMPLE_FREQ_THRES_HIGH
+        || config->format != ADC_DIGI_OUTPUT_FORMAT_TYPE1) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    for (uint32_t i = 0; i < config->pattern_num; ++i) {
+        if (config->adc_pattern[i].channel >= SOC_ADC_MAX_CHANNEL_NUM) {
+            return ESP_ERR_INVALID_ARG;
+        }
+    }
+    memcpy(handle->pattern, config->adc_pattern, config->pattern_num * sizeof(adc_digi_pattern_config_t));
+    handle->pattern_num = config->pattern_num;
+    handle->sample_freq_hz = config->sample_freq_hz;
+    return ESP_OK;
+}
+
+esp_err_t adc_continuous_register_event_callbacks(adc_continuous_handle_t handle, const adc_continuous_evt_cbs_t *cbs, void *user_data)
+{
+    if (handle->running) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    handle->cbs = *cbs;
+    handle->user_data = user_data;
+    return ESP_OK;
+}
+
+esp_err_t adc_continuous_start(adc_continuous_handle_t handle)
+{
+    if (handle->running || handle->pattern_num == 0) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    handle->running = true;
+    if (pthread_create(&handle->producer, NULL, producer_main, handle) != 0) {
+        handle->running = false;
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+esp_err_t adc_continuous_read(adc_continuous_handle_t handle, uint8_t *buf, uint32_t length_max, uint32_t *out_length, uint32_t timeout_ms)
+{
+    pthread_mutex_lock(&handle->lock);
+    if (handle->pool_count == 0 && timeout_ms > 0 && handle->running) {
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_sec += timeout_ms / 1000;
+        deadline.tv_nsec += (long) (timeout_ms % 1000) * 1000000L;
+        if (deadline.tv_nsec >= 1000000000L) {
+            deadline.tv_sec += 1;
+            deadline.tv_nsec -= 1000000000L;
+        }
+        while (handle->pool_count == 0) {
+            if (pthread_cond_timedwait(&handle->available, &handle->lock, &deadline) != 0) {
+                break;
+            }
+        }
+    }
+    uint32_t size = handle->pool_count < length_max ? handle->pool_count : length_max;
+    size -= size % SOC_ADC_DIGI_RESULT_BYTES;
+    for (uint32_t i = 0; i < size; ++i) {
+        buf[i] = handle->pool[(handle->pool_head + i) % handle->pool_size];
+    }
+    handle->pool_head = (handle->pool_head + size) % handle->pool_size;
+    handle->pool_count -= size;
+    pthread_mutex_unlock(&handle->lock);
+
+    *out_length = size;
+    return size > 0 ? ESP_OK : ESP_ERR_TIMEOUT;
+}
+
+esp_err_t adc_continuous_stop(adc_continuous_handle_t handle)
+{
+    if (!handle->running) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    handle->running = false;
+    pthread_join(handle->producer, NULL);
+    return ESP_OK;
+}
+
+esp_err_t adc_continuous_deinit(adc_continuous_handle_t handle)
+{
+    if (handle->running) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    pthread_cond_destroy(&handle->available);
+    pthread_mutex_destroy(&handle->lock);
+    free(handle->pool);
+    free(handle);
+    return ESP_OK;
+}
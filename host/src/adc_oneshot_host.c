@@ -0,0 +1,124 @@
+//
+// Copyright (c) 2024 Jose Rodriguez
+// All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "esp_adc/adc_oneshot.h"
+
+#include <stdlib.h>
+
+#include "esp_timer.h"
+#include "adc_sim.h"
+#include "soc/soc_caps.h"
+
+struct adc_oneshot_unit_ctx_t
+{
+    adc_unit_t unit_id;
+    adc_oneshot_chan_cfg_t channels[SOC_ADC_MAX_CHANNEL_NUM];
+    uint32_t conversions[SOC_ADC_MAX_CHANNEL_NUM];
+};
+
+static bool wifi_active;
+// like the IDF driver, one handle per unit
+static bool unit_in_use[SOC_ADC_PERIPH_NUM];
+// host_adc_oneshot_set_level settings; levels hold level + 1, so 0 means the sawtooth
+static int levels[SOC_ADC_PERIPH_NUM][SOC_ADC_MAX_CHANNEL_NUM];
+static uint16_t noises[SOC_ADC_PERIPH_NUM][SOC_ADC_MAX_CHANNEL_NUM];
+
+void host_adc_oneshot_set_wifi_active(bool active)
+{
+    __atomic_store_n(&wifi_active, active, __ATOMIC_RELEASE);
+}
+
+void host_adc_oneshot_set_level(adc_unit_t unit_id, adc_channel_t channel, int level, uint16_t noise)
+{
+    __atomic_store_n(&noises[unit_id][channel], noise, __ATOMIC_RELAXED);
+    __atomic_store_n(&levels[unit_id][channel], level < 0 ? 0 : level + 1, __ATOMIC_RELEASE);
+}
+
+static uint16_t level_value(int level, uint16_t noise, uint32_t n)
+{
+    if (noise == 0) {
+        return (uint16_t) level;
+    }
+    // Knuth multiplicative hash of the conversion count, for repeatable noise
+    uint32_t hash = (n * 2654435761u) >> 8;
+    int value = level + (int) (hash % (2u * noise + 1)) - noise;
+    return (uint16_t) (value < 0 ? 0 : value > 0xFFF ? 0xFFF : value);
+}
+
+uint16_t host_adc_oneshot_synthetic_value(adc_channel_t channel, uint32_t n)
+{
+    // Per channel sawtooth with a little alternating noise, offset by channel.
+    return (uint16_t) ((n * 7 + (uint32_t) channel * 409 + (n & 1) * 3) & 0xFFF);
+}
+
+esp_err_t adc_oneshot_new_unit(const adc_oneshot_unit_init_cfg_t *init_config, adc_oneshot_unit_handle_t *ret_unit)
+{
+    if (init_config == NULL || ret_unit == NULL || init_config->unit_id >= SOC_ADC_PERIPH_NUM) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (__atomic_exchange_n(&unit_in_use[init_config->unit_id], true, __ATOMIC_ACQ_REL)) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    struct adc_oneshot_unit_ctx_t *ctx = calloc(1, sizeof(struct adc_oneshot_unit_ctx_t));
+    if (ctx == NULL) {
+        __atomic_store_n(&unit_in_use[init_config->unit_id], false, __ATOMIC_RELEASE);
+        return ESP_ERR_NO_MEM;
+    }
+    ctx->unit_id = init_config->unit_id;
+    *ret_unit = ctx;
+    return ESP_OK;
+}
+
+esp_err_t adc_oneshot_config_channel(adc_oneshot_unit_handle_t handle, adc_channel_t channel, const adc_oneshot_chan_cfg_t *config)
+{
+    if (handle == NULL || config == NULL || channel >= SOC_ADC_CHANNEL_NUM(handle->unit_id)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    handle->channels[channel] = *config;
+    return ESP_OK;
+}
+
+esp_err_t adc_oneshot_read(adc_oneshot_unit_handle_t handle, adc_channel_t chan, int *out_raw)
+{
+    if (handle == NULL || out_raw == NULL || chan >= SOC_ADC_CHANNEL_NUM(handle->unit_id)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (handle->unit_id == ADC_UNIT_2 && __atomic_load_n(&wifi_active, __ATOMIC_ACQUIRE)) {
+        return ESP_ERR_TIMEOUT;
+    }
+    int level = __atomic_load_n(&levels[handle->unit_id][chan], __ATOMIC_ACQUIRE);
+    uint32_t n = handle->conversions[chan]++;
+    uint16_t value;
+    if (adc_sim_sample(handle->unit_id, chan, esp_timer_get_time() / 1e6, n, &value)) {
+        *out_raw = value;
+    } else if (level > 0) {
+        *out_raw = level_value(level - 1, __atomic_load_n(&noises[handle->unit_id][chan], __ATOMIC_RELAXED), n);
+    } else {
+        *out_raw = host_adc_oneshot_synthetic_value(chan, n);
+    }
+    return ESP_OK;
+}
+
+esp_err_t adc_oneshot_del_unit(adc_oneshot_unit_handle_t handle)
+{
+    if (handle == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    __atomic_store_n(&unit_in_use[handle->unit_id], false, __ATOMIC_RELEASE);
+    free(handle);
+    return ESP_OK;
+}
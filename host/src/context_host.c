@@ -0,0 +1,113 @@
+//
+// Copyright (c) 2024 Jose Rodriguez
+// All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+//
+// Mailboxes of the AtomVM stand-in, and receiving from them.
+//
+
+#include "context.h"
+
+#include "host_avm.h"
+#include "mailbox.h"
+#include "memory.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <time.h>
+
+void mailbox_init(Mailbox *mbox)
+{
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&mbox->not_empty, &attr);
+    pthread_condattr_destroy(&attr);
+    pthread_mutex_init(&mbox->lock, NULL);
+    mbox->head = NULL;
+    mbox->tail = &mbox->head;
+}
+
+void mailbox_destroy(Mailbox *mbox, GlobalContext *global)
+{
+    struct Message *message = mbox->head;
+    while (message != NULL) {
+        struct Message *next = message->next;
+        memory_destroy_heap(&message->heap, global);
+        free(message);
+        message = next;
+    }
+    pthread_cond_destroy(&mbox->not_empty);
+    pthread_mutex_destroy(&mbox->lock);
+}
+
+void mailbox_send(Mailbox *mbox, struct Message *message)
+{
+    pthread_mutex_lock(&mbox->lock);
+    *mbox->tail = message;
+    mbox->tail = &message->next;
+    pthread_cond_signal(&mbox->not_empty);
+    pthread_mutex_unlock(&mbox->lock);
+}
+
+size_t mailbox_len(Mailbox *mbox)
+{
+    size_t len = 0;
+    pthread_mutex_lock(&mbox->lock);
+    for (const struct Message *message = mbox->head; message != NULL; message = message->next) {
+        ++len;
+    }
+    pthread_mutex_unlock(&mbox->lock);
+    return len;
+}
+
+bool host_context_receive(Context *ctx, uint32_t timeout_ms, term *message)
+{
+    Mailbox *mbox = &ctx->mailbox;
+    struct timespec deadline;
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    deadline.tv_sec += timeout_ms / 1000;
+    deadline.tv_nsec += (long) (timeout_ms % 1000) * 1000000L;
+    if (deadline.tv_nsec >= 1000000000L) {
+        deadline.tv_sec += 1;
+        deadline.tv_nsec -= 1000000000L;
+    }
+
+    pthread_mutex_lock(&mbox->lock);
+    while (mbox->head == NULL) {
+        if (pthread_cond_timedwait(&mbox->not_empty, &mbox->lock, &deadline) == ETIMEDOUT && mbox->head == NULL) {
+            pthread_mutex_unlock(&mbox->lock);
+            return false;
+        }
+    }
+    struct Message *received = mbox->head;
+    mbox->head = received->next;
+    if (mbox->head == NULL) {
+        mbox->tail = &mbox->head;
+    }
+    pthread_mutex_unlock(&mbox->lock);
+
+    memory_heap_append_heap(&ctx->heap, &received->heap);
+    *message = received->message;
+    free(received);
+    return true;
+}
+
+void host_context_clear_heap(Context *ctx)
+{
+    memory_destroy_heap(&ctx->heap, ctx->global);
+}
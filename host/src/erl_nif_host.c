@@ -0,0 +1,120 @@
+//
+// Copyright (c) 2024 Jose Rodriguez
+// All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+//
+// Resources of the AtomVM stand-in: reference counted objects, destroyed
+// when the last term or reference to them is dropped.
+//
+
+#include "erl_nif.h"
+#include "erl_nif_priv.h"
+
+#include <stddef.h>
+#include <stdlib.h>
+
+struct RefcBinary
+{
+    uint32_t ref_count;
+    struct ResourceType *resource_type;
+    _Alignas(max_align_t) uint8_t data[];
+};
+
+static struct RefcBinary *refc_binary_from_data(void *obj)
+{
+    return (struct RefcBinary *) ((uint8_t *) obj - offsetof(struct RefcBinary, data));
+}
+
+ErlNifResourceType *enif_init_resource_type(ErlNifEnv *env, const char *name, const ErlNifResourceTypeInit *init, ErlNifResourceFlags flags, ErlNifResourceFlags *tried)
+{
+    if (tried != NULL) {
+        *tried = flags;
+    }
+    struct ResourceType *resource_type = calloc(1, sizeof(struct ResourceType));
+    if (resource_type == NULL) {
+        return NULL;
+    }
+    resource_type->name = name;
+    resource_type->global = env->global;
+    resource_type->dtor = init->dtor;
+    if (init->members >= 2) {
+        resource_type->stop = init->stop;
+    }
+    if (init->members >= 3) {
+        resource_type->down = init->down;
+    }
+    return resource_type;
+}
+
+void *enif_alloc_resource(ErlNifResourceType *type, unsigned size)
+{
+    struct RefcBinary *refc = malloc(sizeof(struct RefcBinary) + size);
+    if (refc == NULL) {
+        return NULL;
+    }
+    refc->ref_count = 1;
+    refc->resource_type = type;
+    return refc->data;
+}
+
+int enif_keep_resource(void *resource)
+{
+    __atomic_add_fetch(&refc_binary_from_data(resource)->ref_count, 1, __ATOMIC_RELAXED);
+    return 1;
+}
+
+int enif_release_resource(void *resource)
+{
+    if (resource == NULL) {
+        return 0;
+    }
+    struct RefcBinary *refc = refc_binary_from_data(resource);
+    if (__atomic_sub_fetch(&refc->ref_count, 1, __ATOMIC_ACQ_REL) == 0) {
+        if (refc->resource_type->dtor != NULL) {
+            ErlNifEnv env;
+            erl_nif_env_partial_init_from_globalcontext(&env, refc->resource_type->global);
+            refc->resource_type->dtor(&env, resource);
+        }
+        free(refc);
+    }
+    return 1;
+}
+
+int enif_get_resource(ErlNifEnv *env, ERL_NIF_TERM t, ErlNifResourceType *type, void **objp)
+{
+    UNUSED(env);
+    if (!term_is_boxed_with_tag(t, TERM_BOXED_REFC_BINARY)) {
+        return 0;
+    }
+    void *resource = (void *) term_to_const_term_ptr(t)[3];
+    if (resource == NULL || refc_binary_from_data(resource)->resource_type != type) {
+        return 0;
+    }
+    *objp = resource;
+    return 1;
+}
+
+ERL_NIF_TERM enif_make_resource(ErlNifEnv *env, void *obj)
+{
+    term *boxed = term_boxed_alloc(TERM_BOXED_RESOURCE_SIZE - 1, TERM_BOXED_REFC_BINARY, &env->heap);
+    boxed[1] = 0;
+    boxed[2] = (term) obj;
+    boxed[3] = (term) obj;
+    boxed[4] = env->heap.mso_list;
+    env->heap.mso_list = term_from_boxed(boxed);
+    enif_keep_resource(obj);
+    return env->heap.mso_list;
+}
@@ -0,0 +1,168 @@
+//
+// Copyright (c) 2024 Jose Rodriguez
+// All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+//
+// File backed stand-in for esp_partition.  Each partition is a file, mapped
+// shared so that mappings see writes straight away, as the flash cache does
+// once the IDF has invalidated it.  Writes AND into the existing contents and
+// erases fill whole sectors with 0xFF, so code that forgets to erase breaks
+// here as it would on NOR flash.
+//
+
+#include "esp_partition.h"
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define HOST_PARTITION_MAX 4
+#define HOST_PARTITION_SECTOR_SIZE 4096
+
+struct host_partition
+{
+    esp_partition_t partition;
+    int fd;
+    uint8_t *data;
+};
+
+static struct host_partition partitions[HOST_PARTITION_MAX];
+static size_t num_partitions;
+static pthread_mutex_t partitions_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static struct host_partition *host_partition(const esp_partition_t *partition)
+{
+    return (struct host_partition *) partition;
+}
+
+esp_err_t host_esp_partition_add(const char *label, const char *path, uint32_t size)
+{
+    if (strlen(label) >= sizeof(partitions[0].partition.label) || size == 0 || size % HOST_PARTITION_SECTOR_SIZE != 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    int fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (fd < 0) {
+        return ESP_FAIL;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return ESP_FAIL;
+    }
+    // whatever is added to the file reads as erased flash
+    static const uint8_t erased[HOST_PARTITION_SECTOR_SIZE] = { [0 ... HOST_PARTITION_SECTOR_SIZE - 1] = 0xFF };
+    for (off_t offset = st.st_size; offset < (off_t) size; offset += sizeof(erased)) {
+        size_t n = (off_t) size - offset < (off_t) sizeof(erased) ? (size_t) ((off_t) size - offset) : sizeof(erased);
+        if (pwrite(fd, erased, n, offset) != (ssize_t) n) {
+            close(fd);
+            return ESP_FAIL;
+        }
+    }
+    uint8_t *data = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (data == MAP_FAILED) {
+        close(fd);
+        return ESP_FAIL;
+    }
+
+    pthread_mutex_lock(&partitions_lock);
+    if (num_partitions == HOST_PARTITION_MAX) {
+        pthread_mutex_unlock(&partitions_lock);
+        munmap(data, size);
+        close(fd);
+        return ESP_ERR_NO_MEM;
+    }
+    struct host_partition *p = &partitions[num_partitions];
+    memset(p, 0, sizeof(struct host_partition));
+    p->partition.type = ESP_PARTITION_TYPE_DATA;
+    p->partition.subtype = 0x40;
+    p->partition.size = size;
+    p->partition.erase_size = HOST_PARTITION_SECTOR_SIZE;
+    strcpy(p->partition.label, label);
+    p->fd = fd;
+    p->data = data;
+    num_partitions++;
+    pthread_mutex_unlock(&partitions_lock);
+    return ESP_OK;
+}
+
+const esp_partition_t *esp_partition_find_first(esp_partition_type_t type, esp_partition_subtype_t subtype, const char *label)
+{
+    const esp_partition_t *ret = NULL;
+    pthread_mutex_lock(&partitions_lock);
+    for (size_t i = 0; i < num_partitions && i < HOST_PARTITION_MAX && ret == NULL; ++i) {
+        const esp_partition_t *partition = &partitions[i].partition;
+        if ((type == ESP_PARTITION_TYPE_ANY || type == partition->type)
+            && (subtype == ESP_PARTITION_SUBTYPE_ANY || subtype == partition->subtype)
+            && (label == NULL || strcmp(label, partition->label) == 0)) {
+            ret = partition;
+        }
+    }
+    pthread_mutex_unlock(&partitions_lock);
+    return ret;
+}
+
+esp_err_t esp_partition_read(const esp_partition_t *partition, size_t src_offset, void *dst, size_t size)
+{
+    if (src_offset > partition->size || size > partition->size - src_offset) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    memcpy(dst, host_partition(partition)->data + src_offset, size);
+    return ESP_OK;
+}
+
+esp_err_t esp_partition_write(const esp_partition_t *partition, size_t dst_offset, const void *src, size_t size)
+{
+    if (dst_offset > partition->size || size > partition->size - dst_offset) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    uint8_t *data = host_partition(partition)->data + dst_offset;
+    for (size_t i = 0; i < size; ++i) {
+        data[i] &= ((const uint8_t *) src)[i];
+    }
+    return ESP_OK;
+}
+
+esp_err_t esp_partition_erase_range(const esp_partition_t *partition, size_t offset, size_t size)
+{
+    if (offset % partition->erase_size != 0 || size % partition->erase_size != 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (offset > partition->size || size > partition->size - offset) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    memset(host_partition(partition)->data + offset, 0xFF, size);
+    return ESP_OK;
+}
+
+// the whole file is mapped already; a mapping is a view into it
+esp_err_t esp_partition_mmap(const esp_partition_t *partition, size_t offset, size_t size, esp_partition_mmap_memory_t memory, const void **out_ptr, esp_partition_mmap_handle_t *out_handle)
+{
+    (void) memory;
+    if (offset > partition->size || size > partition->size - offset) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    *out_ptr = host_partition(partition)->data + offset;
+    *out_handle = 0;
+    return ESP_OK;
+}
+
+void esp_partition_munmap(esp_partition_mmap_handle_t handle)
+{
+    (void) handle;
+}
@@ -0,0 +1,194 @@
+//
+// Copyright (c) 2024 Jose Rodriguez
+// All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+//
+// pthread based stand-in for esp_timer.  Each started timer runs its callback
+// on its own thread, on absolute monotonic deadlines so periods do not drift.
+//
+
+#include "esp_timer.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <time.h>
+
+struct esp_timer
+{
+    esp_timer_cb_t callback;
+    void *arg;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    bool running;
+    bool periodic;
+    uint64_t period_us;
+    // bumped by every start and stop, so threads of earlier starts know to quit
+    uint32_t generation;
+    // threads not yet exited; delete waits for them
+    uint32_t threads;
+};
+
+struct timer_run
+{
+    struct esp_timer *timer;
+    uint32_t generation;
+};
+
+int64_t esp_timer_get_time(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void add_us(struct timespec *ts, uint64_t us)
+{
+    ts->tv_sec += us / 1000000;
+    ts->tv_nsec += (long) (us % 1000000) * 1000;
+    if (ts->tv_nsec >= 1000000000L) {
+        ts->tv_sec++;
+        ts->tv_nsec -= 1000000000L;
+    }
+}
+
+static void *timer_thread(void *arg)
+{
+    struct timer_run *run = (struct timer_run *) arg;
+    struct esp_timer *timer = run->timer;
+    uint32_t generation = run->generation;
+    free(run);
+
+    struct timespec deadline;
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+
+    pthread_mutex_lock(&timer->lock);
+    while (timer->generation == generation) {
+        add_us(&deadline, timer->period_us);
+        int err = 0;
+        while (timer->generation == generation && err == 0) {
+            err = pthread_cond_timedwait(&timer->cond, &timer->lock, &deadline);
+        }
+        if (timer->generation != generation) {
+            break;
+        }
+        if (!timer->periodic) {
+            timer->running = false;
+            timer->generation++;
+        }
+        pthread_mutex_unlock(&timer->lock);
+        timer->callback(timer->arg);
+        pthread_mutex_lock(&timer->lock);
+    }
+    timer->threads--;
+    pthread_cond_broadcast(&timer->cond);
+    pthread_mutex_unlock(&timer->lock);
+    return NULL;
+}
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t *create_args, esp_timer_handle_t *out_handle)
+{
+    if (create_args == NULL || create_args->callback == NULL || out_handle == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    struct esp_timer *timer = calloc(1, sizeof(struct esp_timer));
+    if (timer == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    timer->callback = create_args->callback;
+    timer->arg = create_args->arg;
+    pthread_mutex_init(&timer->lock, NULL);
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&timer->cond, &attr);
+    pthread_condattr_destroy(&attr);
+    *out_handle = timer;
+    return ESP_OK;
+}
+
+static esp_err_t timer_start(esp_timer_handle_t timer, uint64_t period_us, bool periodic)
+{
+    struct timer_run *run = malloc(sizeof(struct timer_run));
+    if (run == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    pthread_mutex_lock(&timer->lock);
+    if (timer->running) {
+        pthread_mutex_unlock(&timer->lock);
+        free(run);
+        return ESP_ERR_INVALID_STATE;
+    }
+    timer->running = true;
+    timer->periodic = periodic;
+    timer->period_us = period_us;
+    run->timer = timer;
+    run->generation = ++timer->generation;
+
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, timer_thread, run) != 0) {
+        timer->running = false;
+        timer->generation++;
+        pthread_mutex_unlock(&timer->lock);
+        free(run);
+        return ESP_ERR_NO_MEM;
+    }
+    pthread_detach(thread);
+    timer->threads++;
+    pthread_mutex_unlock(&timer->lock);
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_start_periodic(esp_timer_handle_t timer, uint64_t period)
+{
+    return timer_start(timer, period, true);
+}
+
+esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeout_us)
+{
+    return timer_start(timer, timeout_us, false);
+}
+
+// like the real esp_timer, this does not wait for a callback in progress
+esp_err_t esp_timer_stop(esp_timer_handle_t timer)
+{
+    pthread_mutex_lock(&timer->lock);
+    bool was_running = timer->running;
+    if (was_running) {
+        timer->running = false;
+        timer->generation++;
+        pthread_cond_broadcast(&timer->cond);
+    }
+    pthread_mutex_unlock(&timer->lock);
+    return was_running ? ESP_OK : ESP_ERR_INVALID_STATE;
+}
+
+// unlike the real esp_timer, this waits for callbacks in progress to finish
+esp_err_t esp_timer_delete(esp_timer_handle_t timer)
+{
+    pthread_mutex_lock(&timer->lock);
+    if (timer->running) {
+        pthread_mutex_unlock(&timer->lock);
+        return ESP_ERR_INVALID_STATE;
+    }
+    while (timer->threads > 0) {
+        pthread_cond_wait(&timer->cond, &timer->lock);
+    }
+    pthread_mutex_unlock(&timer->lock);
+    pthread_mutex_destroy(&timer->lock);
+    pthread_cond_destroy(&timer->cond);
+    free(timer);
+    return ESP_OK;
+}
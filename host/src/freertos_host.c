@@ -0,0 +1,285 @@
+//
+// Copyright (c) 2024 Jose Rodriguez
+// All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+//
+// pthread based stand-in for the FreeRTOS primitives used by the ADC component.
+//
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+
+#include <errno.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+struct HostTask
+{
+    pthread_t thread;
+    TaskFunction_t fn;
+    void *arg;
+};
+
+struct HostSemaphore
+{
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    unsigned int count;
+    unsigned int max_count;
+};
+
+struct HostQueue
+{
+    pthread_mutex_t lock;
+    pthread_cond_t not_empty;
+    pthread_cond_t not_full;
+    UBaseType_t length;
+    UBaseType_t item_size;
+    UBaseType_t head;
+    UBaseType_t count;
+    uint8_t *items;
+};
+
+static void deadline_from_ticks(struct timespec *deadline, TickType_t ticks)
+{
+    clock_gettime(CLOCK_REALTIME, deadline);
+    uint64_t ns = (uint64_t) ticks * (1000000000ULL / configTICK_RATE_HZ);
+    deadline->tv_sec += ns / 1000000000ULL;
+    deadline->tv_nsec += ns % 1000000000ULL;
+    if (deadline->tv_nsec >= 1000000000L) {
+        deadline->tv_sec += 1;
+        deadline->tv_nsec -= 1000000000L;
+    }
+}
+
+// Waits on cond until pred holds; returns false on timeout.  Called with lock held.
+#define WAIT_UNTIL(pred, cond, lock, ticks)                                          \
+    ({                                                                               \
+        bool ok__ = true;                                                            \
+        if ((ticks) == portMAX_DELAY) {                                              \
+            while (!(pred)) {                                                        \
+                pthread_cond_wait(cond, lock);                                       \
+            }                                                                        \
+        } else {                                                                     \
+            struct timespec deadline__;                                              \
+            deadline_from_ticks(&deadline__, ticks);                                 \
+            while (!(pred)) {                                                        \
+                if (pthread_cond_timedwait(cond, lock, &deadline__) == ETIMEDOUT) {  \
+                    ok__ = (pred);                                                   \
+                    break;                                                           \
+                }                                                                    \
+            }                                                                        \
+        }                                                                            \
+        ok__;                                                                        \
+    })
+
+//
+// Tasks
+//
+
+static void *host_task_main(void *arg)
+{
+    struct HostTask *task = (struct HostTask *) arg;
+    task->fn(task->arg);
+    free(task);
+    return NULL;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t fn, const char *name, uint32_t stack_depth, void *arg, UBaseType_t priority, TaskHandle_t *handle)
+{
+    (void) name;
+    (void) stack_depth;
+    (void) priority;
+
+    struct HostTask *task = malloc(sizeof(struct HostTask));
+    if (task == NULL) {
+        return pdFAIL;
+    }
+    task->fn = fn;
+    task->arg = arg;
+    if (pthread_create(&task->thread, NULL, host_task_main, task) != 0) {
+        free(task);
+        return pdFAIL;
+    }
+    pthread_detach(task->thread);
+    if (handle != NULL) {
+        *handle = task;
+    }
+    return pdPASS;
+}
+
+void vTaskDelete(TaskHandle_t task)
+{
+    // Only self deletion is supported; the thread simply returns afterwards.
+    (void) task;
+}
+
+void vTaskDelay(TickType_t ticks)
+{
+    struct timespec ts = {
+        .tv_sec = ticks / configTICK_RATE_HZ,
+        .tv_nsec = (long) (ticks % configTICK_RATE_HZ) * (1000000000L / configTICK_RATE_HZ)
+    };
+    nanosleep(&ts, NULL);
+}
+
+TickType_t xTaskGetTickCount(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (TickType_t) (ts.tv_sec * configTICK_RATE_HZ + ts.tv_nsec / (1000000000L / configTICK_RATE_HZ));
+}
+
+//
+// Semaphores
+//
+
+static SemaphoreHandle_t semaphore_create(unsigned int initial, unsigned int max_count)
+{
+    struct HostSemaphore *sem = malloc(sizeof(struct HostSemaphore));
+    if (sem == NULL) {
+        return NULL;
+    }
+    pthread_mutex_init(&sem->lock, NULL);
+    pthread_cond_init(&sem->cond, NULL);
+    sem->count = initial;
+    sem->max_count = max_count;
+    return sem;
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinary(void)
+{
+    return semaphore_create(0, 1);
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void)
+{
+    return semaphore_create(1, 1);
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t sem, TickType_t ticks)
+{
+    pthread_mutex_lock(&sem->lock);
+    bool ok = WAIT_UNTIL(sem->count > 0, &sem->cond, &sem->lock, ticks);
+    if (ok) {
+        sem->count--;
+    }
+    pthread_mutex_unlock(&sem->lock);
+    return ok ? pdTRUE : pdFALSE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t sem)
+{
+    BaseType_t ret = pdFALSE;
+    pthread_mutex_lock(&sem->lock);
+    if (sem->count < sem->max_count) {
+        sem->count++;
+        ret = pdTRUE;
+        pthread_cond_signal(&sem->cond);
+    }
+    pthread_mutex_unlock(&sem->lock);
+    return ret;
+}
+
+BaseType_t xSemaphoreGiveFromISR(SemaphoreHandle_t sem, BaseType_t *woken)
+{
+    if (woken != NULL) {
+        *woken = pdFALSE;
+    }
+    return xSemaphoreGive(sem);
+}
+
+void vSemaphoreDelete(SemaphoreHandle_t sem)
+{
+    pthread_cond_destroy(&sem->cond);
+    pthread_mutex_destroy(&sem->lock);
+    free(sem);
+}
+
+//
+// Queues
+//
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size)
+{
+    struct HostQueue *queue = malloc(sizeof(struct HostQueue));
+    if (queue == NULL) {
+        return NULL;
+    }
+    queue->items = malloc((size_t) length * item_size);
+    if (queue->items == NULL) {
+        free(queue);
+        return NULL;
+    }
+    pthread_mutex_init(&queue->lock, NULL);
+    pthread_cond_init(&queue->not_empty, NULL);
+    pthread_cond_init(&queue->not_full, NULL);
+    queue->length = length;
+    queue->item_size = item_size;
+    queue->head = 0;
+    queue->count = 0;
+    return queue;
+}
+
+BaseType_t xQueueSend(QueueHandle_t queue, const void *item, TickType_t ticks)
+{
+    pthread_mutex_lock(&queue->lock);
+    bool ok = WAIT_UNTIL(queue->count < queue->length, &queue->not_full, &queue->lock, ticks);
+    if (ok) {
+        UBaseType_t tail = (queue->head + queue->count) % queue->length;
+        memcpy(queue->items + (size_t) tail * queue->item_size, item, queue->item_size);
+        queue->count++;
+        pthread_cond_signal(&queue->not_empty);
+    }
+    pthread_mutex_unlock(&queue->lock);
+    return ok ? pdPASS : pdFAIL;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void *item, TickType_t ticks)
+{
+    pthread_mutex_lock(&queue->lock);
+    bool ok = WAIT_UNTIL(queue->count > 0, &queue->not_empty, &queue->lock, ticks);
+    if (ok) {
+        memcpy(item, queue->items + (size_t) queue->head * queue->item_size, queue->item_size);
+        queue->head = (queue->head + 1) % queue->length;
+        queue->count--;
+        pthread_cond_signal(&queue->not_full);
+    }
+    pthread_mutex_unlock(&queue->lock);
+    return ok ? pdTRUE : pdFALSE;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue)
+{
+    pthread_mutex_lock(&queue->lock);
+    UBaseType_t count = queue->count;
+    pthread_mutex_unlock(&queue->lock);
+    return count;
+}
+
+void vQueueDelete(QueueHandle_t queue)
+{
+    pthread_cond_destroy(&queue->not_full);
+    pthread_cond_destroy(&queue->not_empty);
+    pthread_mutex_destroy(&queue->lock);
+    free(queue->items);
+    free(queue);
+}
@@ -0,0 +1,211 @@
+//
+// Copyright (c) 2024 Jose Rodriguez
+// All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+//
+// The global context of the AtomVM stand-in: atoms, reference ticks, and the
+// processes messages are delivered to.
+//
+
+#include "globalcontext.h"
+
+#include "context.h"
+#include "defaultatoms.h"
+#include "mailbox.h"
+#include "memory.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct GlobalContext
+{
+    // atoms are only ever added, each one its length byte and characters
+    pthread_mutex_t atoms_lock;
+    char **atoms;
+    size_t num_atoms;
+    size_t atoms_capacity;
+
+    uint64_t ref_ticks;
+
+    pthread_mutex_t processes_lock;
+    Context *processes;
+    int32_t last_process_id;
+};
+
+GlobalContext *globalcontext_new(void)
+{
+    GlobalContext *glb = calloc(1, sizeof(GlobalContext));
+    if (glb == NULL) {
+        return NULL;
+    }
+    pthread_mutex_init(&glb->atoms_lock, NULL);
+    pthread_mutex_init(&glb->processes_lock, NULL);
+    defaultatoms_init(glb);
+    return glb;
+}
+
+void globalcontext_destroy(GlobalContext *glb)
+{
+    for (size_t i = 0; i < glb->num_atoms; ++i) {
+        free(glb->atoms[i]);
+    }
+    free(glb->atoms);
+    pthread_mutex_destroy(&glb->atoms_lock);
+    pthread_mutex_destroy(&glb->processes_lock);
+    free(glb);
+}
+
+void defaultatoms_init(GlobalContext *glb)
+{
+    static const char *const default_atoms[] = {
+        [FALSE_ATOM_INDEX] = ATOM_STR("\x5", "false"),
+        [TRUE_ATOM_INDEX] = ATOM_STR("\x4", "true"),
+        [OK_ATOM_INDEX] = ATOM_STR("\x2", "ok"),
+        [ERROR_ATOM_INDEX] = ATOM_STR("\x5", "error"),
+        [UNDEFINED_ATOM_INDEX] = ATOM_STR("\x9", "undefined"),
+        [BADARG_ATOM_INDEX] = ATOM_STR("\x6", "badarg"),
+        [OUT_OF_MEMORY_ATOM_INDEX] = ATOM_STR("\xd", "out_of_memory"),
+        [TIMEOUT_ATOM_INDEX] = ATOM_STR("\x7", "timeout"),
+    };
+    for (size_t i = 0; i < PLATFORM_ATOMS_BASE_INDEX; ++i) {
+        if (globalcontext_make_atom(glb, default_atoms[i]) != term_from_atom_index(i)) {
+            abort();
+        }
+    }
+}
+
+static size_t atom_string_size(AtomString string)
+{
+    return 1 + ((const uint8_t *) string)[0];
+}
+
+term globalcontext_make_atom(GlobalContext *glb, AtomString string)
+{
+    size_t size = atom_string_size(string);
+    pthread_mutex_lock(&glb->atoms_lock);
+    for (size_t i = 0; i < glb->num_atoms; ++i) {
+        if (memcmp(glb->atoms[i], string, size) == 0) {
+            pthread_mutex_unlock(&glb->atoms_lock);
+            return term_from_atom_index(i);
+        }
+    }
+    if (glb->num_atoms == glb->atoms_capacity) {
+        size_t capacity = glb->atoms_capacity > 0 ? glb->atoms_capacity * 2 : 64;
+        char **atoms = realloc(glb->atoms, capacity * sizeof(char *));
+        if (atoms == NULL) {
+            pthread_mutex_unlock(&glb->atoms_lock);
+            return term_invalid_term();
+        }
+        glb->atoms = atoms;
+        glb->atoms_capacity = capacity;
+    }
+    char *atom = malloc(size);
+    if (atom == NULL) {
+        pthread_mutex_unlock(&glb->atoms_lock);
+        return term_invalid_term();
+    }
+    memcpy(atom, string, size);
+    size_t index = glb->num_atoms++;
+    glb->atoms[index] = atom;
+    pthread_mutex_unlock(&glb->atoms_lock);
+    return term_from_atom_index(index);
+}
+
+bool globalcontext_is_term_equal_to_atom_string(GlobalContext *global, term atom_a, AtomString atom_string_b)
+{
+    if (!term_is_atom(atom_a)) {
+        return false;
+    }
+    size_t index = term_to_atom_index(atom_a);
+    pthread_mutex_lock(&global->atoms_lock);
+    bool equal = index < global->num_atoms && memcmp(global->atoms[index], atom_string_b, atom_string_size(atom_string_b)) == 0;
+    pthread_mutex_unlock(&global->atoms_lock);
+    return equal;
+}
+
+uint64_t globalcontext_get_ref_ticks(GlobalContext *global)
+{
+    return __atomic_add_fetch(&global->ref_ticks, 1, __ATOMIC_RELAXED);
+}
+
+Context *context_new(GlobalContext *glb)
+{
+    Context *ctx = calloc(1, sizeof(Context));
+    if (ctx == NULL) {
+        return NULL;
+    }
+    ctx->global = glb;
+    ctx->heap.mso_list = term_nil();
+    mailbox_init(&ctx->mailbox);
+    pthread_mutex_lock(&glb->processes_lock);
+    ctx->process_id = ++glb->last_process_id;
+    ctx->next = glb->processes;
+    glb->processes = ctx;
+    pthread_mutex_unlock(&glb->processes_lock);
+    return ctx;
+}
+
+void context_destroy(Context *c)
+{
+    GlobalContext *glb = c->global;
+    pthread_mutex_lock(&glb->processes_lock);
+    Context **link = &glb->processes;
+    while (*link != c) {
+        link = &(*link)->next;
+    }
+    *link = c->next;
+    pthread_mutex_unlock(&glb->processes_lock);
+    mailbox_destroy(&c->mailbox, glb);
+    memory_destroy_heap(&c->heap, glb);
+    free(c);
+}
+
+void globalcontext_send_message(GlobalContext *glb, int32_t process_id, term t)
+{
+    struct Message *message = malloc(sizeof(struct Message));
+    if (message == NULL) {
+        return;
+    }
+    if (memory_init_heap(&message->heap, memory_estimate_usage(t)) != MEMORY_GC_OK) {
+        free(message);
+        return;
+    }
+    message->next = NULL;
+    message->message = memory_copy_term_tree(&message->heap, t);
+
+    pthread_mutex_lock(&glb->processes_lock);
+    Context *ctx = glb->processes;
+    while (ctx != NULL && ctx->process_id != process_id) {
+        ctx = ctx->next;
+    }
+    if (ctx != NULL) {
+        mailbox_send(&ctx->mailbox, message);
+    }
+    pthread_mutex_unlock(&glb->processes_lock);
+
+    // the process is gone; releasing resources may call back in, so unlocked
+    if (ctx == NULL) {
+        memory_destroy_heap(&message->heap, glb);
+        free(message);
+    }
+}
+
+void globalcontext_send_message_from_task(GlobalContext *glb, int32_t process_id, enum MessageType type, term t)
+{
+    UNUSED(type);
+    globalcontext_send_message(glb, process_id, t);
+}
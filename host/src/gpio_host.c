@@ -0,0 +1,50 @@
+//
+// Copyright (c) 2024 Jose Rodriguez
+// All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "driver/gpio.h"
+
+
+static gpio_mode_t modes[SOC_GPIO_PIN_COUNT];
+static uint32_t levels[SOC_GPIO_PIN_COUNT];
+
+esp_err_t gpio_reset_pin(gpio_num_t gpio_num)
+{
+    if (!GPIO_IS_VALID_GPIO(gpio_num)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    modes[gpio_num] = GPIO_MODE_INPUT;
+    levels[gpio_num] = 0;
+    return ESP_OK;
+}
+
+esp_err_t gpio_set_direction(gpio_num_t gpio_num, gpio_mode_t mode)
+{
+    if (!GPIO_IS_VALID_GPIO(gpio_num) || (mode == GPIO_MODE_OUTPUT && !GPIO_IS_VALID_OUTPUT_GPIO(gpio_num))) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    modes[gpio_num] = mode;
+    return ESP_OK;
+}
+
+esp_err_t gpio_set_level(gpio_num_t gpio_num, uint32_t level)
+{
+    if (!GPIO_IS_VALID_GPIO(gpio_num)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    levels[gpio_num] = level & 1;
+    return ESP_OK;
+}
@@ -0,0 +1,112 @@
+//
+// Copyright (c) 2024 Jose Rodriguez
+// All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+//
+// Interop helpers of the AtomVM stand-in, and the esp_err_t terms of
+// esp32_sys.h.
+//
+
+#include "interop.h"
+
+#include <stdlib.h>
+
+#include "defaultatoms.h"
+#include "esp32_sys.h"
+#include "globalcontext.h"
+#include "term.h"
+
+term interop_kv_get_value_default(term kv, AtomString key, term default_value, GlobalContext *glb)
+{
+    while (term_is_nonempty_list(kv)) {
+        term t = term_get_list_head(kv);
+        // as in a proplist, a bare atom stands for {Atom, true}
+        if (term_is_atom(t) && globalcontext_is_term_equal_to_atom_string(glb, t, key)) {
+            return TRUE_ATOM;
+        }
+        if (term_is_tuple(t) && term_get_tuple_arity(t) == 2 && globalcontext_is_term_equal_to_atom_string(glb, term_get_tuple_element(t, 0), key)) {
+            return term_get_tuple_element(t, 1);
+        }
+        kv = term_get_list_tail(kv);
+    }
+    return default_value;
+}
+
+int interop_atom_term_select_int(const AtomStringIntPair *table, term atom, GlobalContext *global)
+{
+    int i;
+    for (i = 0; table[i].as_str != NULL; ++i) {
+        if (globalcontext_is_term_equal_to_atom_string(global, atom, table[i].as_str)) {
+            break;
+        }
+    }
+    return table[i].i_val;
+}
+
+char *interop_list_to_string(term list, int *ok)
+{
+    size_t len = 0;
+    term t = list;
+    while (term_is_nonempty_list(t)) {
+        term c = term_get_list_head(t);
+        if (!term_is_integer(c) || term_to_int(c) < 0 || term_to_int(c) > 255) {
+            *ok = 0;
+            return NULL;
+        }
+        ++len;
+        t = term_get_list_tail(t);
+    }
+    if (!term_is_nil(t)) {
+        *ok = 0;
+        return NULL;
+    }
+    char *str = malloc(len + 1);
+    if (str == NULL) {
+        *ok = 0;
+        return NULL;
+    }
+    for (size_t i = 0; i < len; ++i) {
+        str[i] = (char) term_to_int(term_get_list_head(list));
+        list = term_get_list_tail(list);
+    }
+    str[len] = '\0';
+    *ok = 1;
+    return str;
+}
+
+term esp_err_to_term(GlobalContext *glb, esp_err_t status)
+{
+    switch (status) {
+        case ESP_FAIL:
+            return globalcontext_make_atom(glb, ATOM_STR("\x8", "esp_fail"));
+        case ESP_ERR_NO_MEM:
+            return globalcontext_make_atom(glb, ATOM_STR("\xE", "esp_err_no_mem"));
+        case ESP_ERR_INVALID_ARG:
+            return globalcontext_make_atom(glb, ATOM_STR("\x13", "esp_err_invalid_arg"));
+        case ESP_ERR_INVALID_STATE:
+            return globalcontext_make_atom(glb, ATOM_STR("\x15", "esp_err_invalid_state"));
+        case ESP_ERR_INVALID_SIZE:
+            return globalcontext_make_atom(glb, ATOM_STR("\x14", "esp_err_invalid_size"));
+        case ESP_ERR_NOT_FOUND:
+            return globalcontext_make_atom(glb, ATOM_STR("\x11", "esp_err_not_found"));
+        case ESP_ERR_NOT_SUPPORTED:
+            return globalcontext_make_atom(glb, ATOM_STR("\x15", "esp_err_not_supported"));
+        case ESP_ERR_TIMEOUT:
+            return globalcontext_make_atom(glb, ATOM_STR("\xF", "esp_err_timeout"));
+        default:
+            return term_from_int(status);
+    }
+}
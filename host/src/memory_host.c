@@ -0,0 +1,223 @@
+//
+// Copyright (c) 2024 Jose Rodriguez
+// All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+//
+// Heaps for the AtomVM stand-in: fragments that are only freed with the
+// heap, and the copying of terms between heaps for messages.
+//
+
+#include "memory.h"
+
+#include "context.h"
+#include "erl_nif.h"
+#include "term.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+// a fragment is at least this many words, so small reservations share one
+#define HEAP_FRAGMENT_MIN_SIZE 256
+
+static struct HeapFragment *heap_fragment_new(size_t size)
+{
+    struct HeapFragment *fragment = malloc(sizeof(struct HeapFragment) + size * sizeof(term));
+    if (fragment == NULL) {
+        return NULL;
+    }
+    fragment->next = NULL;
+    fragment->end = fragment->storage + size;
+    return fragment;
+}
+
+enum MemoryGCResult memory_init_heap(Heap *heap, size_t size)
+{
+    heap->root = heap_fragment_new(size);
+    if (heap->root == NULL) {
+        return MEMORY_GC_ERROR_FAILED_ALLOCATION;
+    }
+    heap->heap_ptr = heap->root->storage;
+    heap->heap_end = heap->heap_ptr + size;
+    heap->mso_list = term_nil();
+    return MEMORY_GC_OK;
+}
+
+void memory_destroy_heap(Heap *heap, GlobalContext *global)
+{
+    UNUSED(global);
+    term mso = heap->mso_list;
+    while (!term_is_nil(mso)) {
+        const term *boxed = term_to_const_term_ptr(mso);
+        mso = boxed[4];
+        enif_release_resource((void *) boxed[3]);
+    }
+    struct HeapFragment *fragment = heap->root;
+    while (fragment != NULL) {
+        struct HeapFragment *next = fragment->next;
+        free(fragment);
+        fragment = next;
+    }
+    heap->root = NULL;
+    heap->heap_ptr = NULL;
+    heap->heap_end = NULL;
+    heap->mso_list = term_nil();
+}
+
+enum MemoryGCResult memory_heap_ensure_free(Heap *heap, size_t size)
+{
+    if (heap->heap_ptr == NULL || (size_t) (heap->root->end - heap->heap_ptr) < size) {
+        struct HeapFragment *fragment = heap_fragment_new(size > HEAP_FRAGMENT_MIN_SIZE ? size : HEAP_FRAGMENT_MIN_SIZE);
+        if (fragment == NULL) {
+            return MEMORY_GC_ERROR_FAILED_ALLOCATION;
+        }
+        fragment->next = heap->root;
+        heap->root = fragment;
+        heap->heap_ptr = fragment->storage;
+    }
+    heap->heap_end = heap->heap_ptr + size;
+    return MEMORY_GC_OK;
+}
+
+enum MemoryGCResult memory_ensure_free(Context *ctx, size_t size)
+{
+    return memory_heap_ensure_free(&ctx->heap, size);
+}
+
+enum MemoryGCResult memory_ensure_free_with_roots(Context *ctx, size_t size, size_t num_roots, term *roots, enum MemoryAllocMode alloc_mode)
+{
+    // nothing moves, so the roots stay as they are
+    UNUSED(num_roots);
+    UNUSED(roots);
+    UNUSED(alloc_mode);
+    return memory_heap_ensure_free(&ctx->heap, size);
+}
+
+void memory_heap_overrun(Heap *heap, size_t size)
+{
+    fprintf(stderr, "heap overrun: %zu words allocated with %zu reserved\n", size, (size_t) (heap->heap_end - heap->heap_ptr));
+    abort();
+}
+
+void memory_heap_append_heap(Heap *heap, Heap *from)
+{
+    if (from->root != NULL) {
+        struct HeapFragment *last = from->root;
+        while (last->next != NULL) {
+            last = last->next;
+        }
+        // behind the fragment being allocated from, if there is one
+        if (heap->root == NULL) {
+            heap->root = from->root;
+            heap->heap_ptr = NULL;
+            heap->heap_end = NULL;
+        } else {
+            last->next = heap->root->next;
+            heap->root->next = from->root;
+        }
+    }
+    if (!term_is_nil(from->mso_list)) {
+        term *last = term_to_term_ptr(from->mso_list);
+        while (!term_is_nil(last[4])) {
+            last = term_to_term_ptr(last[4]);
+        }
+        last[4] = heap->mso_list;
+        heap->mso_list = from->mso_list;
+    }
+    from->root = NULL;
+    from->heap_ptr = NULL;
+    from->heap_end = NULL;
+    from->mso_list = term_nil();
+}
+
+static bool is_resource(term t)
+{
+    return term_boxed_tag(t) == TERM_BOXED_REFC_BINARY && term_to_const_term_ptr(t)[3] != (term) NULL;
+}
+
+size_t memory_estimate_usage(term t)
+{
+    size_t size = 0;
+    while (term_is_nonempty_list(t)) {
+        size += CONS_SIZE + memory_estimate_usage(term_get_list_head(t));
+        t = term_get_list_tail(t);
+    }
+    if (!term_is_boxed(t)) {
+        return size;
+    }
+    switch (term_boxed_tag(t)) {
+        case TERM_BOXED_TUPLE: {
+            int arity = term_get_tuple_arity(t);
+            size += TUPLE_SIZE(arity);
+            for (int i = 0; i < arity; ++i) {
+                size += memory_estimate_usage(term_get_tuple_element(t, i));
+            }
+            return size;
+        }
+        case TERM_BOXED_REFC_BINARY:
+        case TERM_BOXED_SUB_BINARY:
+            // other than resources, binaries are copied onto the heap
+            return size + (is_resource(t) ? TERM_BOXED_RESOURCE_SIZE : term_binary_heap_size(term_binary_size(t)));
+        default:
+            return size + 1 + term_boxed_size(t);
+    }
+}
+
+term memory_copy_term_tree(Heap *new_heap, term t)
+{
+    if (term_is_nonempty_list(t)) {
+        term copy;
+        term *tail = &copy;
+        while (term_is_nonempty_list(t)) {
+            term head = memory_copy_term_tree(new_heap, term_get_list_head(t));
+            term cons = term_list_prepend(head, term_nil(), new_heap);
+            *tail = cons;
+            tail = term_to_term_ptr(cons) + 1;
+            t = term_get_list_tail(t);
+        }
+        *tail = memory_copy_term_tree(new_heap, t);
+        return copy;
+    }
+    if (!term_is_boxed(t)) {
+        return t;
+    }
+    switch (term_boxed_tag(t)) {
+        case TERM_BOXED_TUPLE: {
+            int arity = term_get_tuple_arity(t);
+            term copy = term_alloc_tuple(arity, new_heap);
+            for (int i = 0; i < arity; ++i) {
+                term_put_tuple_element(copy, i, memory_copy_term_tree(new_heap, term_get_tuple_element(t, i)));
+            }
+            return copy;
+        }
+        case TERM_BOXED_REFC_BINARY:
+        case TERM_BOXED_SUB_BINARY:
+            if (is_resource(t)) {
+                term *boxed = memory_heap_alloc(new_heap, TERM_BOXED_RESOURCE_SIZE);
+                memcpy(boxed, term_to_const_term_ptr(t), TERM_BOXED_RESOURCE_SIZE * sizeof(term));
+                boxed[4] = new_heap->mso_list;
+                new_heap->mso_list = term_from_boxed(boxed);
+                enif_keep_resource((void *) boxed[3]);
+                return new_heap->mso_list;
+            }
+            return term_from_literal_binary(term_binary_data(t), term_binary_size(t), new_heap, NULL);
+        default: {
+            size_t size = 1 + term_boxed_size(t);
+            term *boxed = memory_heap_alloc(new_heap, size);
+            memcpy(boxed, term_to_const_term_ptr(t), size * sizeof(term));
+            return term_from_boxed(boxed);
+        }
+    }
+}
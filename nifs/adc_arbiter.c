@@ -0,0 +1,276 @@
+//
+// Copyright (c) 2024 Jose Rodriguez
+// All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+//
+// ADC2 shares its SAR with the Wi-Fi PHY.  The arbiter tracks which side owns
+// the unit: conversions enter and leave it (and fail fast while Wi-Fi owns
+// it), Wi-Fi acquisition is reported once the conversions in progress have
+// left, by whichever of them leaves last, and reads
+// that would rather wait than fail are parked with a deadline.  A single
+// esp_timer, armed for the earliest deadline, fails parked reads that run out
+// of time; releasing the unit hands all the others to the worker at once.
+//
+
+#include "adc_arbiter.h"
+
+#include <stddef.h>
+#include <stdlib.h>
+
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "hal/adc_types.h"
+
+#include "adc_worker.h"
+
+#define TAG "adc_arbiter"
+
+struct ADCArbiterPending
+{
+    adc_arbiter_fn_t fn;
+    void *arg;
+    int64_t deadline_us;
+};
+
+struct ADCArbiterBatch
+{
+    size_t count;
+    struct ADCArbiterPending pending[];
+};
+
+static SemaphoreHandle_t arbiter_lock;
+static esp_timer_handle_t arbiter_timer;
+
+// all guarded by arbiter_lock
+static bool wifi_owned;
+static uint32_t readers;
+// waiting for the readers to leave, or NULL
+static adc_arbiter_fn_t handover_fn;
+static void *handover_arg;
+static struct ADCArbiterPending pending[ADC_ARBITER_MAX_PENDING];
+static size_t num_pending;
+
+// requires the lock
+static void arm_timer(void)
+{
+    esp_timer_stop(arbiter_timer);
+    if (num_pending == 0) {
+        return;
+    }
+    int64_t earliest = pending[0].deadline_us;
+    for (size_t i = 1; i < num_pending; ++i) {
+        if (pending[i].deadline_us < earliest) {
+            earliest = pending[i].deadline_us;
+        }
+    }
+    int64_t delay = earliest - esp_timer_get_time();
+    esp_timer_start_once(arbiter_timer, delay > 0 ? (uint64_t) delay : 1);
+}
+
+static void adc_arbiter_expire(void *arg)
+{
+    (void) arg;
+    struct ADCArbiterPending expired[ADC_ARBITER_MAX_PENDING];
+    size_t num_expired = 0;
+
+    xSemaphoreTake(arbiter_lock, portMAX_DELAY);
+    int64_t now = esp_timer_get_time();
+    size_t n = 0;
+    for (size_t i = 0; i < num_pending; ++i) {
+        if (pending[i].deadline_us <= now) {
+            expired[num_expired++] = pending[i];
+        } else {
+            pending[n++] = pending[i];
+        }
+    }
+    num_pending = n;
+    arm_timer();
+    xSemaphoreGive(arbiter_lock);
+
+    for (size_t i = 0; i < num_expired; ++i) {
+        expired[i].fn(expired[i].arg, ESP_ERR_TIMEOUT);
+    }
+}
+
+static void adc_arbiter_serve(void *arg)
+{
+    struct ADCArbiterBatch *batch = (struct ADCArbiterBatch *) arg;
+    for (size_t i = 0; i < batch->count; ++i) {
+        batch->pending[i].fn(batch->pending[i].arg, ESP_OK);
+    }
+    free(batch);
+}
+
+esp_err_t adc_arbiter_init(void)
+{
+    if (arbiter_lock != NULL) {
+        return ESP_OK;
+    }
+    SemaphoreHandle_t lock = xSemaphoreCreateMutex();
+    esp_timer_create_args_t timer_args = {
+        .callback = adc_arbiter_expire,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "adc_arbiter",
+    };
+    if (lock == NULL || esp_timer_create(&timer_args, &arbiter_timer) != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to create arbiter");
+        if (lock != NULL) {
+            vSemaphoreDelete(lock);
+        }
+        return ESP_ERR_NO_MEM;
+    }
+    arbiter_lock = lock;
+    return ESP_OK;
+}
+
+bool adc_arbiter_enter(void)
+{
+    // without an arbiter nothing can take the unit away
+    if (arbiter_lock == NULL) {
+        return true;
+    }
+    xSemaphoreTake(arbiter_lock, portMAX_DELAY);
+    bool ret = !wifi_owned;
+    if (ret) {
+        readers++;
+    }
+    xSemaphoreGive(arbiter_lock);
+    return ret;
+}
+
+void adc_arbiter_leave(void)
+{
+    if (arbiter_lock == NULL) {
+        return;
+    }
+    adc_arbiter_fn_t fn = NULL;
+    void *arg = NULL;
+    xSemaphoreTake(arbiter_lock, portMAX_DELAY);
+    if (--readers == 0 && handover_fn != NULL) {
+        fn = handover_fn;
+        arg = handover_arg;
+        handover_fn = NULL;
+    }
+    xSemaphoreGive(arbiter_lock);
+    if (fn != NULL) {
+        fn(arg, ESP_OK);
+    }
+}
+
+esp_err_t adc_arbiter_wifi_acquire(adc_arbiter_fn_t fn, void *arg, bool *pending)
+{
+    if (arbiter_lock == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    esp_err_t err = ESP_OK;
+    xSemaphoreTake(arbiter_lock, portMAX_DELAY);
+    if (handover_fn != NULL) {
+        err = ESP_ERR_INVALID_STATE;
+    } else {
+        // new readers are turned away, so only the current ones are waited for
+        wifi_owned = true;
+        *pending = readers > 0;
+        if (*pending) {
+            handover_fn = fn;
+            handover_arg = arg;
+        }
+    }
+    xSemaphoreGive(arbiter_lock);
+    return err;
+}
+
+esp_err_t adc_arbiter_wifi_release(void)
+{
+    if (arbiter_lock == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    xSemaphoreTake(arbiter_lock, portMAX_DELAY);
+    wifi_owned = false;
+    adc_arbiter_fn_t fn = handover_fn;
+    void *arg = handover_arg;
+    handover_fn = NULL;
+    size_t count = num_pending;
+    struct ADCArbiterBatch *batch = NULL;
+    if (count > 0) {
+        batch = malloc(sizeof(struct ADCArbiterBatch) + count * sizeof(struct ADCArbiterPending));
+        if (batch != NULL) {
+            batch->count = count;
+            for (size_t i = 0; i < count; ++i) {
+                batch->pending[i] = pending[i];
+            }
+            num_pending = 0;
+            arm_timer();
+        }
+    }
+    xSemaphoreGive(arbiter_lock);
+
+    // the unit was taken back before the readers it waited for had left
+    if (fn != NULL) {
+        fn(arg, ESP_ERR_INVALID_STATE);
+    }
+    if (count == 0) {
+        return ESP_OK;
+    }
+    // without memory for the batch the reads stay parked until their deadline
+    if (batch == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    esp_err_t err = adc_worker_submit(ADC_UNIT_2, adc_arbiter_serve, batch);
+    if (err != ESP_OK) {
+        for (size_t i = 0; i < batch->count; ++i) {
+            batch->pending[i].fn(batch->pending[i].arg, err);
+        }
+        free(batch);
+    }
+    return err;
+}
+
+bool adc_arbiter_wifi_owned(void)
+{
+    if (arbiter_lock == NULL) {
+        return false;
+    }
+    xSemaphoreTake(arbiter_lock, portMAX_DELAY);
+    bool ret = wifi_owned;
+    xSemaphoreGive(arbiter_lock);
+    return ret;
+}
+
+esp_err_t adc_arbiter_park(adc_arbiter_fn_t fn, void *arg, int64_t deadline_us)
+{
+    if (arbiter_lock == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    esp_err_t err = ESP_OK;
+    xSemaphoreTake(arbiter_lock, portMAX_DELAY);
+    if (!wifi_owned) {
+        err = ESP_ERR_INVALID_STATE;
+    } else if (deadline_us <= esp_timer_get_time()) {
+        err = ESP_ERR_TIMEOUT;
+    } else if (num_pending == ADC_ARBITER_MAX_PENDING) {
+        err = ESP_ERR_NO_MEM;
+    } else {
+        pending[num_pending].fn = fn;
+        pending[num_pending].arg = arg;
+        pending[num_pending].deadline_us = deadline_us;
+        num_pending++;
+        arm_timer();
+    }
+    xSemaphoreGive(arbiter_lock);
+    return err;
+}
@@ -0,0 +1,81 @@
+//
+// Copyright (c) 2024 Jose Rodriguez
+// All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef __ADC_ARBITER_H__
+#define __ADC_ARBITER_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+
+// reads that may wait for Wi-Fi to release ADC2 at the same time
+#define ADC_ARBITER_MAX_PENDING 16
+
+// called with ESP_OK once ADC2 is free again (on the worker task), or with
+// the reason the read will not be served (deadline passed, worker busy);
+// also reports a Wi-Fi handover (see adc_arbiter_wifi_acquire)
+typedef void (*adc_arbiter_fn_t)(void *arg, esp_err_t err);
+
+/**
+ * @brief   Create the arbiter state.  Safe to call more than once.
+ */
+esp_err_t adc_arbiter_init(void);
+
+/**
+ * @brief   Start a conversion sequence on ADC2.
+ * @return  false if Wi-Fi owns the unit; otherwise adc_arbiter_leave must follow.
+ */
+bool adc_arbiter_enter(void);
+
+/**
+ * @brief   End a conversion sequence started with adc_arbiter_enter.
+ */
+void adc_arbiter_leave(void);
+
+/**
+ * @brief   Hand ADC2 to Wi-Fi without waiting: new conversions are turned
+ *          away from now on.
+ * @details If conversions are still in progress, *pending is set and fn is
+ *          called once, with ESP_OK from the task whose conversion leaves
+ *          last, or with ESP_ERR_INVALID_STATE if the unit is released first.
+ *          Otherwise fn is not called.
+ * @return  ESP_ERR_INVALID_STATE if an earlier handover is still pending.
+ */
+esp_err_t adc_arbiter_wifi_acquire(adc_arbiter_fn_t fn, void *arg, bool *pending);
+
+/**
+ * @brief   Take ADC2 back from Wi-Fi and serve every parked read as one
+ *          batch on the worker task.
+ */
+esp_err_t adc_arbiter_wifi_release(void);
+
+/**
+ * @brief   Whether Wi-Fi currently owns ADC2.
+ */
+bool adc_arbiter_wifi_owned(void);
+
+/**
+ * @brief   Park a read until ADC2 is released or deadline_us (esp_timer time) passes.
+ * @return  ESP_OK if parked, in which case fn will be called exactly once;
+ *          ESP_ERR_INVALID_STATE if the unit is free (again) and the read
+ *          should simply be retried; ESP_ERR_TIMEOUT if the deadline has
+ *          already passed; ESP_ERR_NO_MEM if too many reads are parked.
+ */
+esp_err_t adc_arbiter_park(adc_arbiter_fn_t fn, void *arg, int64_t deadline_us);
+
+#endif
@@ -0,0 +1,104 @@
+//
+// Copyright (c) 2024 Jose Rodriguez
+// All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef __ADC_BACKEND_H__
+#define __ADC_BACKEND_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+#include "hal/adc_types.h"
+#include "sdkconfig.h"
+#include "soc/soc_caps.h"
+
+//
+// Continuous conversion records, as the driver of the target packs them.  A
+// simulated stream packs its records the same way, so they parse alike.
+//
+#if CONFIG_IDF_TARGET_ESP32 || CONFIG_IDF_TARGET_ESP32S2
+#define ADC_BACKEND_OUTPUT_FORMAT ADC_DIGI_OUTPUT_FORMAT_TYPE1
+#define ADC_BACKEND_RECORD_CHANNEL(p) ((p)->type1.channel)
+#define ADC_BACKEND_RECORD_DATA(p) ((p)->type1.data)
+#define ADC_BACKEND_RECORD_SET(p, unit_id, chan, value) ((void) (unit_id), (p)->type1.channel = (chan), (p)->type1.data = (value))
+#else
+#define ADC_BACKEND_OUTPUT_FORMAT ADC_DIGI_OUTPUT_FORMAT_TYPE2
+#define ADC_BACKEND_RECORD_CHANNEL(p) ((p)->type2.channel)
+#define ADC_BACKEND_RECORD_DATA(p) ((p)->type2.data)
+#define ADC_BACKEND_RECORD_SET(p, unit_id, chan, value) ((p)->type2.unit = (unit_id), (p)->type2.channel = (chan), (p)->type2.data = (value))
+#endif
+
+struct ADCBackendStreamConfig
+{
+    adc_unit_t unit;
+    adc_atten_t atten;
+    const adc_channel_t *channels;
+    size_t num_channels;
+    uint32_t sample_freq_hz;
+    uint32_t frame_size;
+    uint32_t pool_size;
+};
+
+//
+// Events of a stream.  On hardware they are raised from the DMA interrupt, so
+// the handlers must be ISR safe and in IRAM; they return whether a higher
+// priority task was woken.
+//
+struct ADCBackendStreamEvents
+{
+    // a frame was converted, and is about to be queued to the pool
+    bool (*frame_done)(void *arg);
+    // the frame just announced was dropped, the pool being full
+    bool (*pool_overflow)(void *arg);
+    void *arg;
+};
+
+//
+// A source of conversions.  The unit operations are called with the shared
+// lock of the unit held (see adc_registry.h), so a backend need not serialize
+// them; raw values are in the bit width the channel was configured with.
+// Backends without continuous conversion leave the stream operations NULL.
+//
+struct ADCBackend
+{
+    const char *name;
+
+    esp_err_t (*init)(adc_unit_t unit_id, void **ctx);
+    esp_err_t (*config)(void *ctx, adc_channel_t channel, adc_bitwidth_t bitwidth, adc_atten_t atten);
+    esp_err_t (*read)(void *ctx, adc_channel_t channel, int *raw);
+    esp_err_t (*read_batch)(void *ctx, adc_channel_t channel, uint16_t *raw, size_t count);
+    // fill mv[0..max_raw] with the millivolts of each raw value
+    esp_err_t (*calibrate)(void *ctx, adc_channel_t channel, adc_atten_t atten, adc_bitwidth_t bitwidth, uint16_t *mv, uint32_t max_raw);
+    void (*close)(void *ctx);
+
+    esp_err_t (*stream_open)(const struct ADCBackendStreamConfig *config, const struct ADCBackendStreamEvents *events, void **ctx);
+    esp_err_t (*stream_start)(void *ctx);
+    // take up to size bytes of converted records from the pool, without waiting
+    esp_err_t (*stream_read)(void *ctx, uint8_t *buf, uint32_t size, uint32_t *out_size);
+    esp_err_t (*stream_stop)(void *ctx);
+    void (*stream_close)(void *ctx);
+};
+
+// the ESP-IDF oneshot driver; it has no streams
+extern const struct ADCBackend adc_backend_oneshot;
+// the ESP-IDF continuous driver; unit reads are taken in short DMA bursts
+extern const struct ADCBackend adc_backend_continuous;
+// simulated signals (see adc_sim.h), for running without an analog front end
+extern const struct ADCBackend adc_backend_sim;
+
+#endif
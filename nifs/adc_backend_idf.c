@@ -0,0 +1,449 @@
+//
+// Copyright (c) 2024 Jose Rodriguez
+// All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+// References
+// https://docs.espressif.com/projects/esp-idf/en/v5.1/esp32/api-reference/peripherals/adc_oneshot.html
+// https://docs.espressif.com/projects/esp-idf/en/v5.1/esp32/api-reference/peripherals/adc_continuous.html
+//
+
+//
+// The ESP-IDF driver backends.  The oneshot backend converts on request; the
+// continuous backend serves unit reads with a short DMA burst of the channel
+// (one frame at least, so single reads are expensive) and runs streams.
+// Both calibrate with the eFuse schemes of the target.
+//
+
+#include "adc_backend.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "esp_adc/adc_cali.h"
+#include "esp_adc/adc_cali_scheme.h"
+#include "esp_adc/adc_continuous.h"
+#include "esp_adc/adc_oneshot.h"
+#include "esp_attr.h"
+#include "esp_log.h"
+
+#define TAG "adc_backend"
+
+#define ADC_BACKEND_BURST_FREQ_HZ SOC_ADC_SAMPLE_FREQ_THRES_HIGH
+#define ADC_BACKEND_BURST_FRAME_SIZE 128
+#define ADC_BACKEND_BURST_POOL_SIZE (4 * ADC_BACKEND_BURST_FRAME_SIZE)
+#define ADC_BACKEND_BURST_TIMEOUT_MS 100
+
+static adc_bitwidth_t resolve_bitwidth(adc_bitwidth_t bitwidth)
+{
+    return bitwidth == ADC_BITWIDTH_DEFAULT ? (adc_bitwidth_t) SOC_ADC_RTC_MAX_BITWIDTH : bitwidth;
+}
+
+/*---------------------------------------------------------------
+        ADC Calibration
+---------------------------------------------------------------*/
+static bool adc_calibration_init(adc_unit_t unit, adc_channel_t channel, adc_atten_t atten, adc_bitwidth_t bitwidth, adc_cali_handle_t *out_handle)
+{
+    adc_cali_handle_t handle = NULL;
+    esp_err_t ret = ESP_FAIL;
+    bool calibrated = false;
+
+#if ADC_CALI_SCHEME_CURVE_FITTING_SUPPORTED
+    if (!calibrated) {
+        ESP_LOGI(TAG, "calibration scheme version is %s", "Curve Fitting");
+        adc_cali_curve_fitting_config_t cali_config = {
+            .unit_id = unit,
+            .chan = channel,
+            .atten = atten,
+            .bitwidth = bitwidth,
+        };
+        ret = adc_cali_create_scheme_curve_fitting(&cali_config, &handle);
+        if (ret == ESP_OK) {
+            calibrated = true;
+        }
+    }
+#else
+    (void) channel;
+#endif
+
+#if ADC_CALI_SCHEME_LINE_FITTING_SUPPORTED
+    if (!calibrated) {
+        ESP_LOGI(TAG, "calibration scheme version is %s", "Line Fitting");
+        adc_cali_line_fitting_config_t cali_config = {
+            .unit_id = unit,
+            .atten = atten,
+            .bitwidth = bitwidth,
+        };
+        ret = adc_cali_create_scheme_line_fitting(&cali_config, &handle);
+        if (ret == ESP_OK) {
+            calibrated = true;
+        }
+    }
+#endif
+
+    *out_handle = handle;
+    if (ret == ESP_OK) {
+        ESP_LOGI(TAG, "Calibration Success");
+    } else if (ret == ESP_ERR_NOT_SUPPORTED || !calibrated) {
+        ESP_LOGW(TAG, "eFuse not burnt, skip software calibration");
+    } else {
+        ESP_LOGE(TAG, "Invalid arg or no memory");
+    }
+
+    return calibrated;
+}
+
+static void adc_calibration_deinit(adc_cali_handle_t handle)
+{
+#if ADC_CALI_SCHEME_CURVE_FITTING_SUPPORTED
+    adc_cali_delete_scheme_curve_fitting(handle);
+#elif ADC_CALI_SCHEME_LINE_FITTING_SUPPORTED
+    adc_cali_delete_scheme_line_fitting(handle);
+#endif
+}
+
+// the scheme is only needed to fill the table, so it is deleted right after
+static esp_err_t idf_calibrate(adc_unit_t unit_id, adc_channel_t channel, adc_atten_t atten, adc_bitwidth_t bitwidth, uint16_t *mv, uint32_t max_raw)
+{
+    adc_cali_handle_t handle;
+    if (!adc_calibration_init(unit_id, channel, atten, resolve_bitwidth(bitwidth), &handle)) {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    for (uint32_t raw = 0; raw <= max_raw; ++raw) {
+        int voltage = 0;
+        if (adc_cali_raw_to_voltage(handle, raw, &voltage) != ESP_OK || voltage < 0) {
+            voltage = 0;
+        }
+        mv[raw] = voltage > UINT16_MAX ? UINT16_MAX : voltage;
+    }
+    adc_calibration_deinit(handle);
+    return ESP_OK;
+}
+
+/*---------------------------------------------------------------
+        Oneshot
+---------------------------------------------------------------*/
+struct OneshotUnit
+{
+    adc_unit_t unit_id;
+    adc_oneshot_unit_handle_t handle;
+};
+
+static esp_err_t oneshot_init(adc_unit_t unit_id, void **ctx)
+{
+    struct OneshotUnit *unit = malloc(sizeof(struct OneshotUnit));
+    if (unit == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    unit->unit_id = unit_id;
+    adc_oneshot_unit_init_cfg_t init_config = {
+        .unit_id = unit_id,
+    };
+    esp_err_t err = adc_oneshot_new_unit(&init_config, &unit->handle);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to create oneshot unit %i.  err=%i", unit_id, err);
+        free(unit);
+        return err;
+    }
+    *ctx = unit;
+    return ESP_OK;
+}
+
+static esp_err_t oneshot_config(void *ctx, adc_channel_t channel, adc_bitwidth_t bitwidth, adc_atten_t atten)
+{
+    struct OneshotUnit *unit = (struct OneshotUnit *) ctx;
+    adc_oneshot_chan_cfg_t config = {
+        .bitwidth = bitwidth,
+        .atten = atten,
+    };
+    return adc_oneshot_config_channel(unit->handle, channel, &config);
+}
+
+static esp_err_t oneshot_read(void *ctx, adc_channel_t channel, int *raw)
+{
+    return adc_oneshot_read(((struct OneshotUnit *) ctx)->handle, channel, raw);
+}
+
+static esp_err_t oneshot_read_batch(void *ctx, adc_channel_t channel, uint16_t *raw, size_t count)
+{
+    adc_oneshot_unit_handle_t handle = ((struct OneshotUnit *) ctx)->handle;
+    for (size_t i = 0; i < count; ++i) {
+        int adc_raw;
+        esp_err_t err = adc_oneshot_read(handle, channel, &adc_raw);
+        if (err != ESP_OK) {
+            return err;
+        }
+        raw[i] = (uint16_t) adc_raw;
+    }
+    return ESP_OK;
+}
+
+static esp_err_t oneshot_calibrate(void *ctx, adc_channel_t channel, adc_atten_t atten, adc_bitwidth_t bitwidth, uint16_t *mv, uint32_t max_raw)
+{
+    return idf_calibrate(((struct OneshotUnit *) ctx)->unit_id, channel, atten, bitwidth, mv, max_raw);
+}
+
+static void oneshot_close(void *ctx)
+{
+    struct OneshotUnit *unit = (struct OneshotUnit *) ctx;
+    adc_oneshot_del_unit(unit->handle);
+    free(unit);
+}
+
+const struct ADCBackend adc_backend_oneshot = {
+    .name = "oneshot",
+    .init = oneshot_init,
+    .config = oneshot_config,
+    .read = oneshot_read,
+    .read_batch = oneshot_read_batch,
+    .calibrate = oneshot_calibrate,
+    .close = oneshot_close,
+};
+
+/*---------------------------------------------------------------
+        Continuous
+---------------------------------------------------------------*/
+struct ContinuousStream
+{
+    adc_continuous_handle_t handle;
+    struct ADCBackendStreamEvents events;
+};
+
+static bool IRAM_ATTR continuous_conv_done(adc_continuous_handle_t handle, const adc_continuous_evt_data_t *edata, void *user_data)
+{
+    (void) handle;
+    (void) edata;
+    const struct ADCBackendStreamEvents *events = &((struct ContinuousStream *) user_data)->events;
+    return events->frame_done != NULL && events->frame_done(events->arg);
+}
+
+static bool IRAM_ATTR continuous_pool_ovf(adc_continuous_handle_t handle, const adc_continuous_evt_data_t *edata, void *user_data)
+{
+    (void) handle;
+    (void) edata;
+    const struct ADCBackendStreamEvents *events = &((struct ContinuousStream *) user_data)->events;
+    return events->pool_overflow != NULL && events->pool_overflow(events->arg);
+}
+
+static esp_err_t continuous_configure(struct ContinuousStream *stream, const struct ADCBackendStreamConfig *config)
+{
+    adc_digi_pattern_config_t pattern[SOC_ADC_PATT_LEN_MAX] = { 0 };
+    for (size_t i = 0; i < config->num_channels; ++i) {
+        pattern[i].atten = config->atten;
+        pattern[i].channel = config->channels[i];
+        pattern[i].unit = config->unit;
+        pattern[i].bit_width = SOC_ADC_DIGI_MAX_BITWIDTH;
+    }
+    adc_continuous_config_t dig_cfg = {
+        .pattern_num = config->num_channels,
+        .adc_pattern = pattern,
+        .sample_freq_hz = config->sample_freq_hz,
+        .conv_mode = config->unit == ADC_UNIT_1 ? ADC_CONV_SINGLE_UNIT_1 : ADC_CONV_SINGLE_UNIT_2,
+        .format = ADC_BACKEND_OUTPUT_FORMAT,
+    };
+    esp_err_t err = adc_continuous_config(stream->handle, &dig_cfg);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to configure continuous handle.  err=%i", err);
+    }
+    return err;
+}
+
+static esp_err_t continuous_stream_open(const struct ADCBackendStreamConfig *config, const struct ADCBackendStreamEvents *events, void **ctx)
+{
+    struct ContinuousStream *stream = calloc(1, sizeof(struct ContinuousStream));
+    if (stream == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    if (events != NULL) {
+        stream->events = *events;
+    }
+    adc_continuous_handle_cfg_t handle_config = {
+        .max_store_buf_size = config->pool_size,
+        .conv_frame_size = config->frame_size,
+    };
+    esp_err_t err = adc_continuous_new_handle(&handle_config, &stream->handle);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to create continuous handle.  err=%i", err);
+        free(stream);
+        return err;
+    }
+    err = continuous_configure(stream, config);
+    if (err == ESP_OK && events != NULL) {
+        adc_continuous_evt_cbs_t cbs = {
+            .on_conv_done = continuous_conv_done,
+            .on_pool_ovf = continuous_pool_ovf,
+        };
+        err = adc_continuous_register_event_callbacks(stream->handle, &cbs, stream);
+    }
+    if (err != ESP_OK) {
+        adc_continuous_deinit(stream->handle);
+        free(stream);
+        return err;
+    }
+    *ctx = stream;
+    return ESP_OK;
+}
+
+static esp_err_t continuous_stream_start(void *ctx)
+{
+    esp_err_t err = adc_continuous_start(((struct ContinuousStream *) ctx)->handle);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to start continuous conversion.  err=%i", err);
+    }
+    return err;
+}
+
+static esp_err_t continuous_stream_read(void *ctx, uint8_t *buf, uint32_t size, uint32_t *out_size)
+{
+    return adc_continuous_read(((struct ContinuousStream *) ctx)->handle, buf, size, out_size, 0);
+}
+
+static esp_err_t continuous_stream_stop(void *ctx)
+{
+    return adc_continuous_stop(((struct ContinuousStream *) ctx)->handle);
+}
+
+static void continuous_stream_close(void *ctx)
+{
+    struct ContinuousStream *stream = (struct ContinuousStream *) ctx;
+    adc_continuous_deinit(stream->handle);
+    free(stream);
+}
+
+struct ContinuousUnit
+{
+    adc_unit_t unit_id;
+    // a stream without events, reconfigured for the channel of each burst
+    struct ContinuousStream burst;
+    adc_atten_t atten[SOC_ADC_MAX_CHANNEL_NUM];
+    adc_bitwidth_t bitwidth[SOC_ADC_MAX_CHANNEL_NUM];
+    uint8_t frame[ADC_BACKEND_BURST_FRAME_SIZE];
+};
+
+static esp_err_t continuous_init(adc_unit_t unit_id, void **ctx)
+{
+    struct ContinuousUnit *unit = calloc(1, sizeof(struct ContinuousUnit));
+    if (unit == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    unit->unit_id = unit_id;
+    adc_continuous_handle_cfg_t handle_config = {
+        .max_store_buf_size = ADC_BACKEND_BURST_POOL_SIZE,
+        .conv_frame_size = ADC_BACKEND_BURST_FRAME_SIZE,
+    };
+    esp_err_t err = adc_continuous_new_handle(&handle_config, &unit->burst.handle);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to create continuous handle.  err=%i", err);
+        free(unit);
+        return err;
+    }
+    *ctx = unit;
+    return ESP_OK;
+}
+
+static esp_err_t continuous_config(void *ctx, adc_channel_t channel, adc_bitwidth_t bitwidth, adc_atten_t atten)
+{
+    struct ContinuousUnit *unit = (struct ContinuousUnit *) ctx;
+    if (channel >= SOC_ADC_CHANNEL_NUM(unit->unit_id) || (bitwidth != ADC_BITWIDTH_DEFAULT && bitwidth > SOC_ADC_DIGI_MAX_BITWIDTH)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    unit->atten[channel] = atten;
+    unit->bitwidth[channel] = bitwidth;
+    return ESP_OK;
+}
+
+//
+// Convert the channel at the burst rate until count values are in, and drop
+// whatever the DMA added to the pool in the meantime, so the next burst
+// starts from an empty pool.
+//
+static esp_err_t continuous_read_batch(void *ctx, adc_channel_t channel, uint16_t *raw, size_t count)
+{
+    struct ContinuousUnit *unit = (struct ContinuousUnit *) ctx;
+    struct ADCBackendStreamConfig config = {
+        .unit = unit->unit_id,
+        .atten = unit->atten[channel],
+        .channels = &channel,
+        .num_channels = 1,
+        .sample_freq_hz = ADC_BACKEND_BURST_FREQ_HZ,
+    };
+    // the DMA converts at its own width, which the default stands for
+    adc_bitwidth_t bitwidth = unit->bitwidth[channel];
+    uint32_t shift = bitwidth == ADC_BITWIDTH_DEFAULT ? 0 : SOC_ADC_DIGI_MAX_BITWIDTH - bitwidth;
+    esp_err_t err = continuous_configure(&unit->burst, &config);
+    if (err == ESP_OK) {
+        err = adc_continuous_start(unit->burst.handle);
+    }
+    if (err != ESP_OK) {
+        return err;
+    }
+    size_t n = 0;
+    while (n < count) {
+        uint32_t size = 0;
+        err = adc_continuous_read(unit->burst.handle, unit->frame, sizeof(unit->frame), &size, ADC_BACKEND_BURST_TIMEOUT_MS);
+        if (err != ESP_OK) {
+            break;
+        }
+        for (uint32_t i = 0; i + SOC_ADC_DIGI_RESULT_BYTES <= size && n < count; i += SOC_ADC_DIGI_RESULT_BYTES) {
+            adc_digi_output_data_t record;
+            memcpy(&record, unit->frame + i, SOC_ADC_DIGI_RESULT_BYTES);
+            if (ADC_BACKEND_RECORD_CHANNEL(&record) == (uint32_t) channel) {
+                raw[n++] = (uint16_t) (ADC_BACKEND_RECORD_DATA(&record) >> shift);
+            }
+        }
+    }
+    adc_continuous_stop(unit->burst.handle);
+    uint32_t size;
+    while (adc_continuous_read(unit->burst.handle, unit->frame, sizeof(unit->frame), &size, 0) == ESP_OK) {
+    }
+    return err;
+}
+
+static esp_err_t continuous_read(void *ctx, adc_channel_t channel, int *raw)
+{
+    uint16_t value;
+    esp_err_t err = continuous_read_batch(ctx, channel, &value, 1);
+    if (err == ESP_OK) {
+        *raw = value;
+    }
+    return err;
+}
+
+static esp_err_t continuous_calibrate(void *ctx, adc_channel_t channel, adc_atten_t atten, adc_bitwidth_t bitwidth, uint16_t *mv, uint32_t max_raw)
+{
+    return idf_calibrate(((struct ContinuousUnit *) ctx)->unit_id, channel, atten, bitwidth, mv, max_raw);
+}
+
+static void continuous_close(void *ctx)
+{
+    struct ContinuousUnit *unit = (struct ContinuousUnit *) ctx;
+    adc_continuous_deinit(unit->burst.handle);
+    free(unit);
+}
+
+const struct ADCBackend adc_backend_continuous = {
+    .name = "continuous",
+    .init = continuous_init,
+    .config = continuous_config,
+    .read = continuous_read,
+    .read_batch = continuous_read_batch,
+    .calibrate = continuous_calibrate,
+    .close = continuous_close,
+    .stream_open = continuous_stream_open,
+    .stream_start = continuous_stream_start,
+    .stream_read = continuous_stream_read,
+    .stream_stop = continuous_stream_stop,
+    .stream_close = continuous_stream_close,
+};
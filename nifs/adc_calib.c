@@ -0,0 +1,56 @@
+//
+// Copyright (c) 2024 Jose Rodriguez
+// All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "adc_calib.h"
+
+#include <stdlib.h>
+
+#include "soc/soc_caps.h"
+
+static adc_bitwidth_t resolve_bitwidth(adc_bitwidth_t bitwidth)
+{
+    return bitwidth == ADC_BITWIDTH_DEFAULT ? (adc_bitwidth_t) SOC_ADC_RTC_MAX_BITWIDTH : bitwidth;
+}
+
+struct ADCCaliTable *adc_calib_create(const struct ADCBackend *backend, void *ctx, adc_channel_t channel, adc_atten_t atten, adc_bitwidth_t bitwidth)
+{
+    uint32_t max_raw = (1U << resolve_bitwidth(bitwidth)) - 1;
+    struct ADCCaliTable *table = malloc(sizeof(struct ADCCaliTable) + (max_raw + 1) * sizeof(uint16_t));
+    if (table == NULL) {
+        return NULL;
+    }
+    table->atten = atten;
+    table->bitwidth = bitwidth;
+    table->max_raw = max_raw;
+    if (backend->calibrate(ctx, channel, atten, bitwidth, table->mv, max_raw) != ESP_OK) {
+        free(table);
+        return NULL;
+    }
+    return table;
+}
+
+void adc_calib_destroy(struct ADCCaliTable *table)
+{
+    free(table);
+}
+
+void adc_calib_convert(const struct ADCCaliTable *table, const uint16_t *raw, uint16_t *mv, size_t count)
+{
+    for (size_t i = 0; i < count; ++i) {
+        mv[i] = adc_calib_to_mv(table, raw[i]);
+    }
+}
@@ -0,0 +1,78 @@
+//
+// Copyright (c) 2024 Jose Rodriguez
+// All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef __ADC_CALIB_H__
+#define __ADC_CALIB_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "hal/adc_types.h"
+
+#include "adc_backend.h"
+
+//
+// A raw -> millivolt lookup table for one (attenuation, bit width) pair of a
+// unit, precomputed from the calibration of its backend so that conversion on
+// the read path is a single load.
+//
+struct ADCCaliTable
+{
+    adc_atten_t atten;
+    adc_bitwidth_t bitwidth;
+    uint32_t max_raw;
+    uint16_t mv[];
+};
+
+/**
+ * @brief   Create the lookup table for a channel of a unit opened on backend,
+ *          ctx being the backend unit.
+ * @details bitwidth may be ADC_BITWIDTH_DEFAULT, in which case the table covers
+ *          the maximum bit width of the target.
+ * @return  NULL if the device is not calibrated or memory is exhausted.
+ */
+struct ADCCaliTable *adc_calib_create(const struct ADCBackend *backend, void *ctx, adc_channel_t channel, adc_atten_t atten, adc_bitwidth_t bitwidth);
+
+/**
+ * @brief   Free the table.
+ */
+void adc_calib_destroy(struct ADCCaliTable *table);
+
+static inline uint16_t adc_calib_to_mv(const struct ADCCaliTable *table, uint32_t raw)
+{
+    return table->mv[raw < table->max_raw ? raw : table->max_raw];
+}
+
+/**
+ * @brief   Convert a value with frac_bits bits below the raw resolution to
+ *          millivolts, interpolating between adjacent table entries.
+ */
+static inline uint16_t adc_calib_to_mv_frac(const struct ADCCaliTable *table, uint32_t value, uint8_t frac_bits)
+{
+    uint32_t raw = value >> frac_bits;
+    int32_t frac = (int32_t) (value & ((UINT32_C(1) << frac_bits) - 1));
+    int32_t mv = adc_calib_to_mv(table, raw);
+    int32_t next = adc_calib_to_mv(table, raw + 1);
+    return (uint16_t) (mv + (((next - mv) * frac) >> frac_bits));
+}
+
+/**
+ * @brief   Convert a buffer of raw samples to millivolts.  raw and mv may alias.
+ */
+void adc_calib_convert(const struct ADCCaliTable *table, const uint16_t *raw, uint16_t *mv, size_t count);
+
+#endif
@@ -0,0 +1,174 @@
+//
+// Copyright (c) 2024 Jose Rodriguez
+// All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+//
+// Compact encodings for sample binaries.  Sample times are kept as a base time
+// and a varint delta per sample: oneshot conversions are tens of microseconds
+// apart, so a delta usually takes one byte, next to the two of the sample.
+// Samples themselves may be bit packed, which always saves a quarter, or delta
+// coded, which does better on slow or quiet signals and worse on noisy ones.
+//
+
+#include "adc_codec.h"
+
+size_t adc_codec_put_varint(uint8_t *out, uint32_t value)
+{
+    size_t n = 0;
+    while (value >= 0x80) {
+        out[n++] = (uint8_t) (value | 0x80);
+        value >>= 7;
+    }
+    out[n++] = (uint8_t) value;
+    return n;
+}
+
+size_t adc_codec_get_varint(const uint8_t *in, size_t size, uint32_t *value)
+{
+    uint32_t result = 0;
+    for (size_t n = 0; n < size && n < ADC_CODEC_VARINT_MAX; ++n) {
+        result |= (uint32_t) (in[n] & 0x7F) << (7 * n);
+        if ((in[n] & 0x80) == 0) {
+            *value = result;
+            return n + 1;
+        }
+    }
+    return 0;
+}
+
+static inline uint16_t get_sample(const uint8_t *samples, size_t i, uint16_t mask)
+{
+    return (uint16_t) (samples[2 * i] | (samples[2 * i + 1] << 8)) & mask;
+}
+
+static inline uint32_t zigzag(uint16_t sample, uint16_t previous)
+{
+    int32_t delta = (int32_t) sample - (int32_t) previous;
+    return ((uint32_t) delta << 1) ^ (uint32_t) (delta >> 31);
+}
+
+static inline size_t varint_size(uint32_t value)
+{
+    return value < (1 << 7) ? 1 : value < (1 << 14) ? 2 : 3;
+}
+
+size_t adc_codec_encoded_size(enum ADCEncoding encoding, const uint8_t *samples, size_t count, uint16_t mask)
+{
+    switch (encoding) {
+        case ADC_ENCODING_PACKED12:
+            return (count / 2) * 3 + (count % 2) * 2;
+        case ADC_ENCODING_DELTA: {
+            size_t size = 0;
+            uint16_t previous = 0;
+            for (size_t i = 0; i < count; ++i) {
+                uint16_t sample = get_sample(samples, i, mask);
+                size += varint_size(zigzag(sample, previous));
+                previous = sample;
+            }
+            return size;
+        }
+        default:
+            return count * sizeof(uint16_t);
+    }
+}
+
+static inline uint16_t saturate12(uint16_t sample)
+{
+    return sample > 0xFFF ? 0xFFF : sample;
+}
+
+size_t adc_codec_encode(enum ADCEncoding encoding, const uint8_t *samples, size_t count, uint16_t mask, uint8_t *out)
+{
+    size_t n = 0;
+    switch (encoding) {
+        case ADC_ENCODING_PACKED12: {
+            size_t i = 0;
+            for (; i + 1 < count; i += 2) {
+                uint16_t a = saturate12(get_sample(samples, i, mask));
+                uint16_t b = saturate12(get_sample(samples, i + 1, mask));
+                out[n++] = (uint8_t) a;
+                out[n++] = (uint8_t) ((a >> 8) | (b << 4));
+                out[n++] = (uint8_t) (b >> 4);
+            }
+            if (i < count) {
+                uint16_t a = saturate12(get_sample(samples, i, mask));
+                out[n++] = (uint8_t) a;
+                out[n++] = (uint8_t) (a >> 8);
+            }
+            break;
+        }
+        case ADC_ENCODING_DELTA: {
+            uint16_t previous = 0;
+            for (size_t i = 0; i < count; ++i) {
+                uint16_t sample = get_sample(samples, i, mask);
+                n += adc_codec_put_varint(out + n, zigzag(sample, previous));
+                previous = sample;
+            }
+            break;
+        }
+        default:
+            for (size_t i = 0; i < count; ++i) {
+                uint16_t sample = get_sample(samples, i, mask);
+                out[n++] = (uint8_t) sample;
+                out[n++] = (uint8_t) (sample >> 8);
+            }
+            break;
+    }
+    return n;
+}
+
+void adc_codec_timestamps_init(struct ADCTimestamps *timestamps, uint8_t *deltas)
+{
+    timestamps->base_us = 0;
+    timestamps->last_us = 0;
+    timestamps->count = 0;
+    timestamps->size = 0;
+    timestamps->deltas = deltas;
+}
+
+void adc_codec_timestamps_push(struct ADCTimestamps *timestamps, int64_t time_us)
+{
+    if (timestamps->count == 0) {
+        timestamps->base_us = time_us;
+        timestamps->last_us = time_us;
+    } else {
+        int64_t delta = time_us - timestamps->last_us;
+        if (delta < 0) {
+            delta = 0;
+        } else if (delta > UINT32_MAX) {
+            delta = UINT32_MAX;
+        }
+        timestamps->size += adc_codec_put_varint(timestamps->deltas + timestamps->size, (uint32_t) delta);
+        timestamps->last_us += delta;
+    }
+    timestamps->count++;
+}
+
+void adc_codec_put_timestamp_header(uint8_t *out, const struct ADCTimestamps *timestamps)
+{
+    uint64_t base = (uint64_t) timestamps->base_us;
+    for (int i = 0; i < 8; ++i) {
+        out[i] = (uint8_t) (base >> (8 * i));
+    }
+    for (int i = 0; i < 4; ++i) {
+        out[8 + i] = (uint8_t) (timestamps->count >> (8 * i));
+    }
+}
+
+size_t adc_codec_timestamped_size(const struct ADCTimestamps *timestamps)
+{
+    return ADC_CODEC_TIMESTAMP_HEADER_SIZE + timestamps->count * sizeof(uint16_t) + timestamps->size;
+}
@@ -0,0 +1,113 @@
+//
+// Copyright (c) 2024 Jose Rodriguez
+// All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef __ADC_CODEC_H__
+#define __ADC_CODEC_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// an unsigned LEB128 encoding of a uint32_t takes at most this many bytes
+#define ADC_CODEC_VARINT_MAX 5
+
+//
+// A timestamped sample binary:
+// <<BaseUs:64/little-signed, Count:32/little, Samples:Count/binary-unit:16, Deltas/binary>>
+// BaseUs is the esp_timer time of the first sample and Deltas holds Count - 1
+// unsigned LEB128 varints, the microseconds from each sample to the next.
+//
+#define ADC_CODEC_TIMESTAMP_HEADER_SIZE 12
+
+//
+// Encodings of a sequence of samples:
+//   raw16     2 bytes per sample, little-endian
+//   packed12  3 bytes per pair of samples <<A:12, B:12>> with the low byte of
+//             A first, then the high nibble of A below the low nibble of B,
+//             then the high byte of B; an odd last sample takes 2 bytes as in
+//             raw16.  Values above 12 bits saturate.
+//   delta     the difference to the previous sample (the first to 0), zigzag
+//             mapped and written as an unsigned LEB128 varint of 1 to 3 bytes
+//
+enum ADCEncoding
+{
+    ADC_ENCODING_RAW16,
+    ADC_ENCODING_PACKED12,
+    ADC_ENCODING_DELTA,
+    ADC_ENCODING_COUNT
+};
+
+struct ADCTimestamps
+{
+    int64_t base_us;
+    int64_t last_us;
+    uint32_t count;
+    // bytes of deltas written so far
+    size_t size;
+    // room for ADC_CODEC_VARINT_MAX bytes per sample
+    uint8_t *deltas;
+};
+
+/**
+ * @brief   Write value to out as an unsigned LEB128 varint.
+ * @return  the number of bytes written, at most ADC_CODEC_VARINT_MAX.
+ */
+size_t adc_codec_put_varint(uint8_t *out, uint32_t value);
+
+/**
+ * @brief   Read an unsigned LEB128 varint of at most 32 bits from in.
+ * @return  the number of bytes read, or 0 if the varint is truncated or too long.
+ */
+size_t adc_codec_get_varint(const uint8_t *in, size_t size, uint32_t *value);
+
+/**
+ * @brief   Size of count samples (2 * count little-endian bytes) in an encoding.
+ * @details mask is applied to every sample first, e.g. to drop the channel of
+ *          stream samples.
+ */
+size_t adc_codec_encoded_size(enum ADCEncoding encoding, const uint8_t *samples, size_t count, uint16_t mask);
+
+/**
+ * @brief   Encode count samples (2 * count little-endian bytes) to out.
+ * @details out must have room for adc_codec_encoded_size bytes; mask is as there.
+ * @return  the number of bytes written.
+ */
+size_t adc_codec_encode(enum ADCEncoding encoding, const uint8_t *samples, size_t count, uint16_t mask, uint8_t *out);
+
+/**
+ * @brief   Start recording sample times, writing the deltas to deltas.
+ */
+void adc_codec_timestamps_init(struct ADCTimestamps *timestamps, uint8_t *deltas);
+
+/**
+ * @brief   Record the time of the next sample.
+ * @details Times are expected not to go backwards; a time earlier than the
+ *          previous one is recorded as equal to it.
+ */
+void adc_codec_timestamps_push(struct ADCTimestamps *timestamps, int64_t time_us);
+
+/**
+ * @brief   Write the header of a timestamped sample binary to out.
+ */
+void adc_codec_put_timestamp_header(uint8_t *out, const struct ADCTimestamps *timestamps);
+
+/**
+ * @brief   Size of the timestamped binary for the samples recorded so far.
+ */
+size_t adc_codec_timestamped_size(const struct ADCTimestamps *timestamps);
+
+#endif
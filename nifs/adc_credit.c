@@ -0,0 +1,132 @@
+//
+// Copyright (c) 2024 Jose Rodriguez
+// All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+#include "adc_credit.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define TAG "adc_credit"
+
+esp_err_t adc_credit_init(struct ADCCredit *credit, const struct ADCCreditConfig *config, size_t slot_size)
+{
+    memset(credit, 0, sizeof(struct ADCCredit));
+    uint32_t max_held;
+    switch (config->policy) {
+        case ADC_CREDIT_LATEST:
+            max_held = 1;
+            break;
+        case ADC_CREDIT_DROP_NEW:
+            max_held = 0;
+            break;
+        case ADC_CREDIT_DROP_OLD:
+            max_held = ADC_CREDIT_MAX_HELD;
+            break;
+        default:
+            return ESP_ERR_INVALID_ARG;
+    }
+    if (max_held > 0) {
+        credit->slots = malloc(max_held * slot_size);
+        credit->sizes = malloc(max_held * sizeof(size_t));
+        credit->tags = malloc(max_held * sizeof(uint64_t));
+        if (credit->slots == NULL || credit->sizes == NULL || credit->tags == NULL) {
+            adc_credit_free(credit);
+            return ESP_ERR_NO_MEM;
+        }
+    }
+    credit->policy = config->policy;
+    credit->credits = config->credits;
+    credit->slot_size = slot_size;
+    credit->max_held = max_held;
+    credit->limited = true;
+    return ESP_OK;
+}
+
+void adc_credit_free(struct ADCCredit *credit)
+{
+    free(credit->slots);
+    free(credit->sizes);
+    free(credit->tags);
+    memset(credit, 0, sizeof(struct ADCCredit));
+}
+
+static bool take_credit(struct ADCCredit *credit)
+{
+    uint32_t credits = __atomic_load_n(&credit->credits, __ATOMIC_ACQUIRE);
+    while (credits > 0) {
+        if (__atomic_compare_exchange_n(&credit->credits, &credits, credits - 1, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool adc_credit_admit(struct ADCCredit *credit)
+{
+    if (!credit->limited) {
+        return true;
+    }
+    return credit->count == 0 && take_credit(credit);
+}
+
+void adc_credit_hold(struct ADCCredit *credit, const void *data, size_t size, uint64_t tag)
+{
+    if (credit->max_held == 0) {
+        __atomic_add_fetch(&credit->dropped, 1, __ATOMIC_RELAXED);
+        return;
+    }
+    if (credit->count == credit->max_held) {
+        // make room by dropping the oldest, which under latest is the only one
+        credit->first = (credit->first + 1) % credit->max_held;
+        __atomic_store_n(&credit->count, credit->count - 1, __ATOMIC_RELEASE);
+        __atomic_add_fetch(&credit->dropped, 1, __ATOMIC_RELAXED);
+    }
+    uint32_t slot = (credit->first + credit->count) % credit->max_held;
+    size = size < credit->slot_size ? size : credit->slot_size;
+    memcpy(credit->slots + slot * credit->slot_size, data, size);
+    credit->sizes[slot] = size;
+    credit->tags[slot] = tag;
+    __atomic_store_n(&credit->count, credit->count + 1, __ATOMIC_RELEASE);
+}
+
+bool adc_credit_release(struct ADCCredit *credit, const void **data, size_t *size, uint64_t *tag)
+{
+    if (credit->count == 0 || !take_credit(credit)) {
+        return false;
+    }
+    uint32_t slot = credit->first;
+    *data = credit->slots + slot * credit->slot_size;
+    *size = credit->sizes[slot];
+    *tag = credit->tags[slot];
+    credit->first = (slot + 1) % credit->max_held;
+    __atomic_store_n(&credit->count, credit->count - 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+bool adc_credit_grant(struct ADCCredit *credit, uint32_t credits)
+{
+    uint32_t current = __atomic_load_n(&credit->credits, __ATOMIC_RELAXED);
+    uint32_t next;
+    do {
+        next = credits > UINT32_MAX - current ? UINT32_MAX : current + credits;
+    } while (!__atomic_compare_exchange_n(&credit->credits, &current, next, false, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED));
+    return __atomic_load_n(&credit->count, __ATOMIC_ACQUIRE) > 0;
+}
+
+uint32_t adc_credit_dropped(const struct ADCCredit *credit)
+{
+    return __atomic_load_n(&credit->dropped, __ATOMIC_RELAXED);
+}
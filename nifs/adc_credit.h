@@ -0,0 +1,121 @@
+//
+// Copyright (c) 2024 Jose Rodriguez
+// All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+#ifndef __ADC_CREDIT_H__
+#define __ADC_CREDIT_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+
+// batches a drop_old subscription holds back while it has no credit
+#define ADC_CREDIT_MAX_HELD 4
+
+// what becomes of a batch produced while the subscriber has no credit
+enum ADCCreditPolicy
+{
+    // keep only the newest, replacing (and dropping) any held before it
+    ADC_CREDIT_LATEST,
+    // drop it
+    ADC_CREDIT_DROP_NEW,
+    // keep up to ADC_CREDIT_MAX_HELD, dropping the oldest held to make room
+    ADC_CREDIT_DROP_OLD
+};
+
+struct ADCCreditConfig
+{
+    // granted up front
+    uint32_t credits;
+    enum ADCCreditPolicy policy;
+};
+
+//
+// Flow control for batches pushed to a subscriber: each batch sent uses up a
+// credit, which the subscriber grants back as it consumes them, so no more
+// than the credits granted are ever waiting in its mailbox.  The producer
+// task is the only one to admit, hold and release batches; grants may come
+// from any task.  A zeroed gate has no limit.
+//
+struct ADCCredit
+{
+    bool limited;
+    enum ADCCreditPolicy policy;
+    // accessed atomically
+    uint32_t credits;
+    // batches dropped for want of credit; accessed atomically
+    uint32_t dropped;
+    // held batches, oldest first: a ring of max_held slots of slot_size
+    // bytes, each with the size and tag it was held with; count is read
+    // atomically by grants
+    uint8_t *slots;
+    size_t *sizes;
+    uint64_t *tags;
+    size_t slot_size;
+    uint32_t max_held;
+    uint32_t first;
+    uint32_t count;
+};
+
+/**
+ * @brief   Limit a gate to the credits of config, holding back batches of up
+ *          to slot_size bytes as its policy says.
+ * @return  ESP_ERR_INVALID_ARG for an unknown policy, ESP_ERR_NO_MEM if
+ *          allocation fails (the gate is then left unlimited).
+ */
+esp_err_t adc_credit_init(struct ADCCredit *credit, const struct ADCCreditConfig *config, size_t slot_size);
+
+/**
+ * @brief   Release the held batches and lift the limit.  Safe to call more
+ *          than once.
+ */
+void adc_credit_free(struct ADCCredit *credit);
+
+/**
+ * @brief   Decide whether a new batch may be sent, using up a credit if so.
+ * @details A batch is never admitted ahead of held ones; those must first be
+ *          sent with adc_credit_release.
+ */
+bool adc_credit_admit(struct ADCCredit *credit);
+
+/**
+ * @brief   Keep or drop a batch that was not admitted, as the policy says.
+ * @details tag is handed back with the batch by adc_credit_release.
+ */
+void adc_credit_hold(struct ADCCredit *credit, const void *data, size_t size, uint64_t tag);
+
+/**
+ * @brief   Take the oldest held batch, if there is one and a credit to send
+ *          it with.
+ * @details *data stays valid until the next call to adc_credit_hold.
+ * @return  false if nothing may be sent yet.
+ */
+bool adc_credit_release(struct ADCCredit *credit, const void **data, size_t *size, uint64_t *tag);
+
+/**
+ * @brief   Add credits (saturating); safe to call from any task.
+ * @return  true if batches are held, in which case the producer should be
+ *          woken to release them.
+ */
+bool adc_credit_grant(struct ADCCredit *credit, uint32_t credits);
+
+/**
+ * @brief   The number of batches dropped for want of credit.
+ */
+uint32_t adc_credit_dropped(const struct ADCCredit *credit);
+
+#endif
@@ -0,0 +1,261 @@
+//
+// Copyright (c) 2024 Jose Rodriguez
+// All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+//
+// Real FFT of N points as a complex FFT of N/2 points over the even and odd
+// samples, followed by the usual split step.  Samples are centred and scaled
+// up by 16 before windowing, so that the window keeps their low bits; with
+// 13-bit samples and N up to 2048, values stay below 2^30 through every
+// stage without rescaling.  Products with Q15 twiddles are taken in 64 bits.
+//
+
+#include "adc_fft.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define ADC_FFT_INPUT_SHIFT 4
+#define Q15_ONE 32767
+
+void adc_fft_init(struct ADCFFT *fft)
+{
+    memset(fft, 0, sizeof(struct ADCFFT));
+    fft->window = -1;
+}
+
+void adc_fft_free(struct ADCFFT *fft)
+{
+    free(fft->work);
+    free(fft->cos);
+    free(fft->sin);
+    free(fft->window_table);
+    free(fft->bins);
+    adc_fft_init(fft);
+}
+
+esp_err_t adc_fft_reserve(struct ADCFFT *fft, size_t size)
+{
+    if (!adc_fft_valid_size(size)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (size <= fft->capacity) {
+        return ESP_OK;
+    }
+    adc_fft_free(fft);
+    fft->work = malloc(size * sizeof(int32_t));
+    fft->cos = malloc(size / 2 * sizeof(int16_t));
+    fft->sin = malloc(size / 2 * sizeof(int16_t));
+    fft->window_table = malloc(size * sizeof(int16_t));
+    fft->bins = malloc(size / 2 * sizeof(uint16_t));
+    if (fft->work == NULL || fft->cos == NULL || fft->sin == NULL || fft->window_table == NULL || fft->bins == NULL) {
+        adc_fft_free(fft);
+        return ESP_ERR_NO_MEM;
+    }
+    fft->capacity = size;
+    return ESP_OK;
+}
+
+uint8_t *adc_fft_input(struct ADCFFT *fft, size_t size)
+{
+    // converting sample n to work[n] only overwrites samples already read
+    return (uint8_t *) fft->work + size * sizeof(int32_t) - size * sizeof(uint16_t);
+}
+
+static int16_t to_q15(double x)
+{
+    long q = lround(x * 32768.0);
+    return (int16_t) (q > Q15_ONE ? Q15_ONE : q < -Q15_ONE ? -Q15_ONE : q);
+}
+
+static void prepare_tables(struct ADCFFT *fft, size_t size, enum ADCWindow window)
+{
+    if (fft->size != size) {
+        for (size_t k = 0; k < size / 2; ++k) {
+            double angle = 2.0 * M_PI * k / size;
+            fft->cos[k] = to_q15(cos(angle));
+            fft->sin[k] = to_q15(sin(angle));
+        }
+        fft->size = size;
+        fft->window = -1;
+    }
+    if (fft->window != (int) window) {
+        // periodic windows, as suit spectral analysis
+        int64_t sum = 0;
+        for (size_t n = 0; n < size; ++n) {
+            double phase = 2.0 * M_PI * n / size;
+            double w;
+            switch (window) {
+                case ADC_WINDOW_HANN:
+                    w = 0.5 - 0.5 * cos(phase);
+                    break;
+                case ADC_WINDOW_HAMMING:
+                    w = 0.54 - 0.46 * cos(phase);
+                    break;
+                case ADC_WINDOW_BLACKMAN:
+                    w = 0.42 - 0.5 * cos(phase) + 0.08 * cos(2.0 * phase);
+                    break;
+                default:
+                    w = 1.0;
+                    break;
+            }
+            fft->window_table[n] = to_q15(w);
+            sum += fft->window_table[n];
+        }
+        fft->window = (int) window;
+        fft->window_sum = sum;
+    }
+}
+
+static inline int32_t mul_q15(int32_t a, int16_t b)
+{
+    return (int32_t) (((int64_t) a * b) >> 15);
+}
+
+// in place complex FFT of m points, interleaved re, im; twiddles are for 2 * m points
+static void complex_fft(const struct ADCFFT *fft, int32_t *z, size_t m)
+{
+    for (size_t i = 1, j = 0; i < m; ++i) {
+        size_t bit = m >> 1;
+        for (; j & bit; bit >>= 1) {
+            j ^= bit;
+        }
+        j |= bit;
+        if (i < j) {
+            int32_t re = z[2 * i];
+            int32_t im = z[2 * i + 1];
+            z[2 * i] = z[2 * j];
+            z[2 * i + 1] = z[2 * j + 1];
+            z[2 * j] = re;
+            z[2 * j + 1] = im;
+        }
+    }
+    for (size_t len = 2; len <= m; len <<= 1) {
+        size_t half = len / 2;
+        // W_len^j = W_(2m)^(j * 2m / len)
+        size_t step = 2 * m / len;
+        for (size_t i = 0; i < m; i += len) {
+            for (size_t j = 0; j < half; ++j) {
+                int16_t c = fft->cos[j * step];
+                int16_t s = fft->sin[j * step];
+                int32_t *a = &z[2 * (i + j)];
+                int32_t *b = &z[2 * (i + j + half)];
+                int32_t tr = mul_q15(b[0], c) + mul_q15(b[1], s);
+                int32_t ti = mul_q15(b[1], c) - mul_q15(b[0], s);
+                b[0] = a[0] - tr;
+                b[1] = a[1] - ti;
+                a[0] += tr;
+                a[1] += ti;
+            }
+        }
+    }
+}
+
+static uint32_t isqrt64(uint64_t x)
+{
+    uint64_t root = 0;
+    uint64_t bit = UINT64_C(1) << 62;
+    while (bit > x) {
+        bit >>= 2;
+    }
+    while (bit != 0) {
+        if (x >= root + bit) {
+            x -= root + bit;
+            root = (root >> 1) + bit;
+        } else {
+            root >>= 1;
+        }
+        bit >>= 2;
+    }
+    return (uint32_t) root;
+}
+
+void adc_fft_run(struct ADCFFT *fft, size_t size, enum ADCWindow window)
+{
+    prepare_tables(fft, size, window);
+
+    const uint8_t *input = adc_fft_input(fft, size);
+    int32_t *z = fft->work;
+    uint32_t sum = 0;
+    for (size_t n = 0; n < size; ++n) {
+        sum += input[2 * n] | (input[2 * n + 1] << 8);
+    }
+    int32_t mean = (int32_t) ((sum + size / 2) / size);
+    for (size_t n = 0; n < size; ++n) {
+        int32_t x = (int32_t) (input[2 * n] | (input[2 * n + 1] << 8)) - mean;
+        z[n] = mul_q15(x * (1 << ADC_FFT_INPUT_SHIFT), fft->window_table[n]);
+    }
+
+    // z holds even samples as re and odd ones as im
+    size_t m = size / 2;
+    complex_fft(fft, z, m);
+
+    // X[k] = E[k] + W^k O[k], where E and O are the transforms of the even
+    // and odd samples, from Z[k] and conj(Z[m - k])
+    for (size_t k = 0; k < m; ++k) {
+        size_t mk = k == 0 ? 0 : m - k;
+        int32_t er = (z[2 * k] + z[2 * mk]) / 2;
+        int32_t ei = (z[2 * k + 1] - z[2 * mk + 1]) / 2;
+        int32_t or = (z[2 * k + 1] + z[2 * mk + 1]) / 2;
+        int32_t oi = (z[2 * mk] - z[2 * k]) / 2;
+        int64_t xr = er + mul_q15(or, fft->cos[k]) + mul_q15(oi, fft->sin[k]);
+        int64_t xi = ei + mul_q15(oi, fft->cos[k]) - mul_q15(or, fft->sin[k]);
+        // a sine of amplitude A gives |X| = A * window_sum / 2, scaled up by the input shift
+        uint64_t amplitude = (uint64_t) isqrt64((uint64_t) (xr * xr + xi * xi)) * 2 * 32768 / (uint64_t) fft->window_sum;
+        fft->bins[k] = amplitude > UINT16_MAX ? UINT16_MAX : (uint16_t) amplitude;
+    }
+}
+
+void adc_fft_put_bins(const struct ADCFFT *fft, size_t size, uint8_t *out)
+{
+    for (size_t k = 0; k < size / 2; ++k) {
+        out[2 * k] = fft->bins[k] & 0xFF;
+        out[2 * k + 1] = fft->bins[k] >> 8;
+    }
+}
+
+size_t adc_fft_put_peaks(const struct ADCFFT *fft, size_t size, size_t k, uint8_t *out)
+{
+    uint16_t peaks[ADC_FFT_MAX_PEAKS];
+    size_t count = 0;
+    if (k > ADC_FFT_MAX_PEAKS) {
+        k = ADC_FFT_MAX_PEAKS;
+    }
+    const uint16_t *bins = fft->bins;
+    size_t m = size / 2;
+    // insertion into the k highest so far; k is small
+    for (size_t b = 1; b < m && k > 0; ++b) {
+        bool peak = bins[b] > bins[b - 1] && (b + 1 == m || bins[b] >= bins[b + 1]);
+        if (!peak || (count == k && bins[b] <= bins[peaks[k - 1]])) {
+            continue;
+        }
+        size_t i = count < k ? count++ : k - 1;
+        while (i > 0 && bins[peaks[i - 1]] < bins[b]) {
+            peaks[i] = peaks[i - 1];
+            i--;
+        }
+        peaks[i] = (uint16_t) b;
+    }
+    for (size_t i = 0; i < count; ++i) {
+        uint16_t bin = peaks[i];
+        out[ADC_FFT_PEAK_SIZE * i] = bin & 0xFF;
+        out[ADC_FFT_PEAK_SIZE * i + 1] = bin >> 8;
+        out[ADC_FFT_PEAK_SIZE * i + 2] = bins[bin] & 0xFF;
+        out[ADC_FFT_PEAK_SIZE * i + 3] = bins[bin] >> 8;
+    }
+    return count;
+}
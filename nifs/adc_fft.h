@@ -0,0 +1,116 @@
+//
+// Copyright (c) 2024 Jose Rodriguez
+// All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef __ADC_FFT_H__
+#define __ADC_FFT_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+
+#define ADC_FFT_MIN_SIZE 16
+#define ADC_FFT_MAX_SIZE 2048
+#define ADC_FFT_MAX_PEAKS 32
+// a peak is <<Bin:16/little, Amplitude:16/little>>
+#define ADC_FFT_PEAK_SIZE 4
+
+enum ADCWindow
+{
+    ADC_WINDOW_RECTANGULAR,
+    ADC_WINDOW_HANN,
+    ADC_WINDOW_HAMMING,
+    ADC_WINDOW_BLACKMAN
+};
+
+//
+// Scratch for real FFTs of up to capacity points, in Q15 fixed point.  The
+// twiddle and window tables are kept for the last size and window used, so
+// repeated spectra of the same shape only transform.
+//
+struct ADCFFT
+{
+    size_t capacity;
+    // size and window the tables below are for; 0 and -1 when there are none
+    size_t size;
+    int window;
+    // sum of the window, to turn magnitudes into amplitudes
+    int64_t window_sum;
+    // capacity / 2 complex values; the samples are captured into its top half
+    int32_t *work;
+    // cos and sin of 2 pi k / size, k < size / 2
+    int16_t *cos;
+    int16_t *sin;
+    int16_t *window_table;
+    // amplitudes of the last transform, size / 2 of them
+    uint16_t *bins;
+};
+
+/**
+ * @brief   Check that size is a power of two from ADC_FFT_MIN_SIZE to ADC_FFT_MAX_SIZE.
+ */
+static inline bool adc_fft_valid_size(size_t size)
+{
+    return size >= ADC_FFT_MIN_SIZE && size <= ADC_FFT_MAX_SIZE && (size & (size - 1)) == 0;
+}
+
+/**
+ * @brief   Clear fft.  Nothing is allocated.
+ */
+void adc_fft_init(struct ADCFFT *fft);
+
+/**
+ * @brief   Make room for transforms of size points.
+ * @details Only allocates if size exceeds the capacity.
+ */
+esp_err_t adc_fft_reserve(struct ADCFFT *fft, size_t size);
+
+/**
+ * @brief   Release the scratch buffers.  Safe to call more than once.
+ */
+void adc_fft_free(struct ADCFFT *fft);
+
+/**
+ * @brief   Where to put size little-endian uint16 samples to transform.
+ * @details Requires room for size points.
+ */
+uint8_t *adc_fft_input(struct ADCFFT *fft, size_t size);
+
+/**
+ * @brief   Transform the samples at adc_fft_input, setting fft->bins.
+ * @details The mean is removed and the window applied first.  Bin k holds
+ *          the amplitude, in 1/16 of a sample unit, of the component at k
+ *          times the sample rate over size; a sine of amplitude A centred
+ *          on bin k reads 16 * A there.  Bin 0 is near zero.
+ */
+void adc_fft_run(struct ADCFFT *fft, size_t size, enum ADCWindow window);
+
+/**
+ * @brief   Write the size / 2 bins of the last transform to out as
+ *          little-endian uint16.
+ */
+void adc_fft_put_bins(const struct ADCFFT *fft, size_t size, uint8_t *out);
+
+/**
+ * @brief   Write the (at most) k highest local maxima of the last transform
+ *          to out, highest first, ADC_FFT_PEAK_SIZE bytes each.
+ * @return  the number of peaks written.
+ */
+size_t adc_fft_put_peaks(const struct ADCFFT *fft, size_t size, size_t k, uint8_t *out);
+
+#endif
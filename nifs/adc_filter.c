@@ -0,0 +1,192 @@
+//
+// Copyright (c) 2024 Jose Rodriguez
+// All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "adc_filter.h"
+
+#include <string.h>
+
+static uint16_t clamp_u16(int64_t value)
+{
+    if (value < 0) {
+        return 0;
+    }
+    return value > UINT16_MAX ? UINT16_MAX : (uint16_t) value;
+}
+
+void adc_filter_init(struct ADCFilterChain *chain)
+{
+    memset(chain, 0, sizeof(struct ADCFilterChain));
+}
+
+esp_err_t adc_filter_add_stage(struct ADCFilterChain *chain, enum ADCFilterType type, size_t length, const int16_t *coeffs)
+{
+    switch (type) {
+        case ADC_FILTER_BOXCAR:
+            if (length < 1 || length > ADC_FILTER_MAX_TAPS) {
+                return ESP_ERR_INVALID_ARG;
+            }
+            break;
+        case ADC_FILTER_EXPONENTIAL:
+            if (length < 1 || length > ADC_FILTER_MAX_SHIFT) {
+                return ESP_ERR_INVALID_ARG;
+            }
+            break;
+        case ADC_FILTER_FIR:
+            if (length < 1 || length > ADC_FILTER_MAX_TAPS || coeffs == NULL) {
+                return ESP_ERR_INVALID_ARG;
+            }
+            break;
+        case ADC_FILTER_MEDIAN:
+            if (length < 1 || length > ADC_FILTER_MAX_MEDIAN || length % 2 == 0) {
+                return ESP_ERR_INVALID_ARG;
+            }
+            break;
+        case ADC_FILTER_DECIMATE:
+            if (length < 1 || length > UINT8_MAX) {
+                return ESP_ERR_INVALID_ARG;
+            }
+            break;
+        default:
+            return ESP_ERR_INVALID_ARG;
+    }
+    if (chain->num_stages == ADC_FILTER_MAX_STAGES) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    struct ADCFilterStage *stage = &chain->stages[chain->num_stages++];
+    memset(stage, 0, sizeof(struct ADCFilterStage));
+    stage->type = type;
+    stage->length = (uint8_t) length;
+    if (type == ADC_FILTER_FIR) {
+        memcpy(stage->coeffs, coeffs, length * sizeof(int16_t));
+    }
+    return ESP_OK;
+}
+
+void adc_filter_reset(struct ADCFilterChain *chain)
+{
+    for (size_t i = 0; i < chain->num_stages; ++i) {
+        struct ADCFilterStage *stage = &chain->stages[i];
+        stage->pos = 0;
+        stage->count = 0;
+        stage->acc = 0;
+        memset(stage->history, 0, sizeof(stage->history));
+    }
+    chain->last = 0;
+}
+
+static uint16_t boxcar(struct ADCFilterStage *stage, uint16_t in)
+{
+    // running sum over the window; averages what it has until the window fills
+    if (stage->count == stage->length) {
+        stage->acc -= stage->history[stage->pos];
+    } else {
+        stage->count++;
+    }
+    stage->acc += in;
+    stage->history[stage->pos] = in;
+    stage->pos = (stage->pos + 1) % stage->length;
+    return (uint16_t) (stage->acc / stage->count);
+}
+
+static uint16_t exponential(struct ADCFilterStage *stage, uint16_t in)
+{
+    // y += (x - y) * 2^-shift, state in Q8, seeded with the first sample
+    int32_t x = (int32_t) in << 8;
+    if (stage->count == 0) {
+        stage->acc = x;
+        stage->count = 1;
+    } else {
+        stage->acc += (x - stage->acc) >> stage->length;
+    }
+    return (uint16_t) ((stage->acc + 0x80) >> 8);
+}
+
+static uint16_t fir(struct ADCFilterStage *stage, uint16_t in)
+{
+    // seed the history with the first sample to avoid a start-up transient
+    if (stage->count == 0) {
+        for (size_t i = 0; i < stage->length; ++i) {
+            stage->history[i] = in;
+        }
+        stage->count = 1;
+    }
+    stage->history[stage->pos] = in;
+
+    int64_t acc = 0;
+    size_t j = stage->pos;
+    for (size_t i = 0; i < stage->length; ++i) {
+        acc += (int32_t) stage->coeffs[i] * stage->history[j];
+        j = j == 0 ? (size_t) stage->length - 1 : j - 1;
+    }
+    stage->pos = (stage->pos + 1) % stage->length;
+    return clamp_u16((acc + (1 << (ADC_FILTER_FIR_Q - 1))) >> ADC_FILTER_FIR_Q);
+}
+
+static uint16_t median(struct ADCFilterStage *stage, uint16_t in)
+{
+    stage->history[stage->pos] = in;
+    stage->pos = (stage->pos + 1) % stage->length;
+    if (stage->count < stage->length) {
+        stage->count++;
+    }
+
+    // insertion sort of at most ADC_FILTER_MAX_MEDIAN values
+    uint16_t sorted[ADC_FILTER_MAX_MEDIAN];
+    size_t n = stage->count;
+    for (size_t i = 0; i < n; ++i) {
+        uint16_t v = stage->history[i];
+        size_t k = i;
+        while (k > 0 && sorted[k - 1] > v) {
+            sorted[k] = sorted[k - 1];
+            k--;
+        }
+        sorted[k] = v;
+    }
+    return sorted[n / 2];
+}
+
+bool adc_filter_push(struct ADCFilterChain *chain, uint16_t in, uint16_t *out)
+{
+    uint16_t value = in;
+    for (size_t i = 0; i < chain->num_stages; ++i) {
+        struct ADCFilterStage *stage = &chain->stages[i];
+        switch (stage->type) {
+            case ADC_FILTER_BOXCAR:
+                value = boxcar(stage, value);
+                break;
+            case ADC_FILTER_EXPONENTIAL:
+                value = exponential(stage, value);
+                break;
+            case ADC_FILTER_FIR:
+                value = fir(stage, value);
+                break;
+            case ADC_FILTER_MEDIAN:
+                value = median(stage, value);
+                break;
+            case ADC_FILTER_DECIMATE:
+                if (++stage->count < stage->length) {
+                    return false;
+                }
+                stage->count = 0;
+                break;
+        }
+    }
+    chain->last = value;
+    *out = value;
+    return true;
+}
@@ -0,0 +1,93 @@
+//
+// Copyright (c) 2024 Jose Rodriguez
+// All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef __ADC_FILTER_H__
+#define __ADC_FILTER_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+
+#define ADC_FILTER_MAX_STAGES 4
+#define ADC_FILTER_MAX_TAPS 32
+#define ADC_FILTER_MAX_MEDIAN 15
+#define ADC_FILTER_MAX_SHIFT 15
+#define ADC_FILTER_FIR_Q 15
+
+enum ADCFilterType
+{
+    ADC_FILTER_BOXCAR,
+    ADC_FILTER_EXPONENTIAL,
+    ADC_FILTER_FIR,
+    ADC_FILTER_MEDIAN,
+    ADC_FILTER_DECIMATE
+};
+
+//
+// One stage of a filter chain.  All arithmetic is integer: the exponential
+// stage keeps its state in Q8 and FIR coefficients are Q15.
+//
+struct ADCFilterStage
+{
+    enum ADCFilterType type;
+    // window length, number of taps, shift or decimation factor
+    uint8_t length;
+    uint8_t pos;
+    uint8_t count;
+    int32_t acc;
+    int16_t coeffs[ADC_FILTER_MAX_TAPS];
+    uint16_t history[ADC_FILTER_MAX_TAPS];
+};
+
+struct ADCFilterChain
+{
+    size_t num_stages;
+    // most recent output, used when a read yields no output (decimation)
+    uint16_t last;
+    struct ADCFilterStage stages[ADC_FILTER_MAX_STAGES];
+};
+
+/**
+ * @brief   Make chain an empty chain, which passes samples through unchanged.
+ */
+void adc_filter_init(struct ADCFilterChain *chain);
+
+/**
+ * @brief   Append a stage to the chain.
+ * @details length is the boxcar or median window (median windows must be odd),
+ *          the exponential shift (alpha = 2^-length), the decimation factor
+ *          or the number of FIR coefficients, which are given in Q15.
+ * @return  ESP_ERR_INVALID_ARG if the parameters are out of range,
+ *          ESP_ERR_NO_MEM if the chain already has ADC_FILTER_MAX_STAGES stages.
+ */
+esp_err_t adc_filter_add_stage(struct ADCFilterChain *chain, enum ADCFilterType type, size_t length, const int16_t *coeffs);
+
+/**
+ * @brief   Clear the history of every stage, keeping the configuration.
+ */
+void adc_filter_reset(struct ADCFilterChain *chain);
+
+/**
+ * @brief   Run one sample through the chain.
+ * @return  true, with the result in out, if the chain produced an output;
+ *          false if a decimation stage swallowed the sample.
+ */
+bool adc_filter_push(struct ADCFilterChain *chain, uint16_t in, uint16_t *out);
+
+#endif
@@ -0,0 +1,60 @@
+//
+// Copyright (c) 2024 Jose Rodriguez
+// All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "adc_metrics.h"
+
+#if CONFIG_AVM_ADC_METRICS
+
+static uint32_t latency_bucket(uint32_t us)
+{
+    uint32_t bucket = us == 0 ? 0 : 32 - __builtin_clz(us);
+    return bucket < ADC_METRICS_LATENCY_BUCKETS ? bucket : ADC_METRICS_LATENCY_BUCKETS - 1;
+}
+
+static void count_error(struct ADCMetrics *metrics, esp_err_t err)
+{
+    metrics->errors++;
+    for (int i = 0; i < ADC_METRICS_MAX_ERROR_CODES; ++i) {
+        struct ADCMetricsError *entry = &metrics->error_codes[i];
+        if (entry->count == 0) {
+            entry->err = err;
+        }
+        if (entry->err == err) {
+            entry->count++;
+            return;
+        }
+    }
+}
+
+void adc_metrics_record(struct ADCMetrics *metrics, int64_t start, uint32_t samples, esp_err_t err)
+{
+    int64_t elapsed = esp_timer_get_time() - start;
+    uint32_t us = elapsed < 0 ? 0 : elapsed > UINT32_MAX ? UINT32_MAX : (uint32_t) elapsed;
+
+    metrics->reads++;
+    metrics->samples += samples;
+    metrics->time_us += us;
+    if (us > metrics->max_us) {
+        metrics->max_us = us;
+    }
+    metrics->latency[latency_bucket(us)]++;
+    if (err != ESP_OK) {
+        count_error(metrics, err);
+    }
+}
+
+#endif
@@ -0,0 +1,86 @@
+//
+// Copyright (c) 2024 Jose Rodriguez
+// All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef __ADC_METRICS_H__
+#define __ADC_METRICS_H__
+
+#include <stdint.h>
+
+#include "esp_err.h"
+#include "sdkconfig.h"
+
+#if CONFIG_AVM_ADC_METRICS
+#include "esp_timer.h"
+#endif
+
+// bucket i counts operations that took [2^(i-1), 2^i) microseconds, the last one everything longer
+#define ADC_METRICS_LATENCY_BUCKETS 16
+// distinct error codes counted per channel; further codes only count towards errors
+#define ADC_METRICS_MAX_ERROR_CODES 4
+
+struct ADCMetricsError
+{
+    esp_err_t err;
+    uint32_t count;
+};
+
+//
+// Counters of one channel.  An operation is one read, capture or stats call,
+// and is timed as a whole so that the per sample cost of collection is nil.
+//
+struct ADCMetrics
+{
+    uint32_t reads;
+    uint32_t errors;
+    uint64_t samples;
+    uint64_t time_us;
+    uint32_t max_us;
+    uint32_t latency[ADC_METRICS_LATENCY_BUCKETS];
+    struct ADCMetricsError error_codes[ADC_METRICS_MAX_ERROR_CODES];
+};
+
+#if CONFIG_AVM_ADC_METRICS
+
+static inline int64_t adc_metrics_start(void)
+{
+    return esp_timer_get_time();
+}
+
+/**
+ * @brief   Account an operation started at start (see adc_metrics_start) that
+ *          made samples successful conversions and ended with err.
+ */
+void adc_metrics_record(struct ADCMetrics *metrics, int64_t start, uint32_t samples, esp_err_t err);
+
+#else
+
+static inline int64_t adc_metrics_start(void)
+{
+    return 0;
+}
+
+static inline void adc_metrics_record(struct ADCMetrics *metrics, int64_t start, uint32_t samples, esp_err_t err)
+{
+    (void) metrics;
+    (void) start;
+    (void) samples;
+    (void) err;
+}
+
+#endif
+
+#endif
@@ -0,0 +1,475 @@
+//
+// Copyright (c) 2024 Jose Rodriguez
+// All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+//
+// The partition is a ring of sectors filled with blocks front to back.  The
+// writer erases a sector as it enters it, so the sector after the head always
+// holds the oldest blocks.  Only the writer task touches the flash, and the
+// lock only guards where the next block goes: a reader may see a block being
+// written or a sector being erased, which the CRC turns away.  Mount finds
+// the head from the newest block, so nothing but the log itself is persisted.
+//
+
+#include "adc_recorder.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "esp_log.h"
+#include "esp_rom_crc.h"
+#include "freertos/task.h"
+
+#include "adc_codec.h"
+
+#define TAG "adc_recorder"
+
+#define ADC_RECORDER_TASK_STACK_SIZE 3072
+#define ADC_RECORDER_TASK_PRIORITY 5
+#define ADC_RECORDER_FLUSH 0xFE
+#define ADC_RECORDER_STOP 0xFF
+
+_Static_assert(sizeof(struct ADCRecorderHeader) == 32, "block header layout");
+_Static_assert(ADC_RECORDER_SLOTS < ADC_RECORDER_FLUSH, "slot indexes collide with requests");
+
+struct ADCRecorderMapping
+{
+    const esp_partition_t *partition;
+    const uint8_t *map;
+    esp_partition_mmap_handle_t handle;
+    bool in_use;
+};
+
+static SemaphoreHandle_t mappings_lock;
+// guarded by mappings_lock
+static struct ADCRecorderMapping mappings[ADC_RECORDER_MAX_PARTITIONS];
+
+esp_err_t adc_recorder_init(void)
+{
+    if (mappings_lock != NULL) {
+        return ESP_OK;
+    }
+    mappings_lock = xSemaphoreCreateMutex();
+    return mappings_lock != NULL ? ESP_OK : ESP_ERR_NO_MEM;
+}
+
+static esp_err_t claim_mapping(const esp_partition_t *partition, const uint8_t **map)
+{
+    if (mappings_lock == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    esp_err_t err = ESP_OK;
+    xSemaphoreTake(mappings_lock, portMAX_DELAY);
+    struct ADCRecorderMapping *mapping = NULL;
+    struct ADCRecorderMapping *unused = NULL;
+    for (int i = 0; i < ADC_RECORDER_MAX_PARTITIONS; ++i) {
+        if (mappings[i].partition == partition) {
+            mapping = &mappings[i];
+        } else if (mappings[i].partition == NULL && unused == NULL) {
+            unused = &mappings[i];
+        }
+    }
+    if (mapping != NULL && mapping->in_use) {
+        err = ESP_ERR_INVALID_STATE;
+    } else if (mapping == NULL && unused == NULL) {
+        err = ESP_ERR_NO_MEM;
+    } else if (mapping == NULL) {
+        const void *ptr;
+        err = esp_partition_mmap(partition, 0, partition->size, ESP_PARTITION_MMAP_DATA, &ptr, &unused->handle);
+        if (err == ESP_OK) {
+            mapping = unused;
+            mapping->partition = partition;
+            mapping->map = (const uint8_t *) ptr;
+        }
+    }
+    if (err == ESP_OK) {
+        mapping->in_use = true;
+        *map = mapping->map;
+    }
+    xSemaphoreGive(mappings_lock);
+    return err;
+}
+
+static void release_mapping(const esp_partition_t *partition)
+{
+    xSemaphoreTake(mappings_lock, portMAX_DELAY);
+    for (int i = 0; i < ADC_RECORDER_MAX_PARTITIONS; ++i) {
+        if (mappings[i].partition == partition) {
+            mappings[i].in_use = false;
+        }
+    }
+    xSemaphoreGive(mappings_lock);
+}
+
+static inline uint32_t block_size(size_t count)
+{
+    return (uint32_t) ((sizeof(struct ADCRecorderHeader) + count * sizeof(uint16_t) + 3) & ~(size_t) 3);
+}
+
+static inline bool seq_after_or_at(uint32_t seq, uint32_t ref)
+{
+    return (int32_t) (seq - ref) >= 0;
+}
+
+static uint32_t block_crc(const struct ADCRecorderHeader *header, const uint8_t *samples)
+{
+    uint32_t crc = esp_rom_crc32_le(0, (const uint8_t *) header, offsetof(struct ADCRecorderHeader, crc));
+    return esp_rom_crc32_le(crc, samples, header->count * sizeof(uint16_t));
+}
+
+//
+// Check the block at offset, setting *size to how far the next block is.
+// Returns false with *size 0 where the blocks of a sector end (an erased or
+// garbled header), and false with *size set for a block that fails its CRC.
+//
+static bool check_block(const struct ADCRecorder *rec, uint32_t offset, struct ADCRecorderHeader *header, uint32_t *size)
+{
+    *size = 0;
+    uint32_t room = ADC_RECORDER_SECTOR_SIZE - offset % ADC_RECORDER_SECTOR_SIZE;
+    if (room < sizeof(struct ADCRecorderHeader)) {
+        return false;
+    }
+    memcpy(header, rec->map + offset, sizeof(struct ADCRecorderHeader));
+    if (header->magic != ADC_RECORDER_MAGIC || header->count == 0 || header->count > ADC_RECORDER_MAX_SAMPLES
+        || block_size(header->count) > room) {
+        return false;
+    }
+    *size = block_size(header->count);
+    return block_crc(header, rec->map + offset + sizeof(struct ADCRecorderHeader)) == header->crc;
+}
+
+static bool is_erased(const uint8_t *data, size_t size)
+{
+    for (size_t i = 0; i < size; ++i) {
+        if (data[i] != 0xFF) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void mount(struct ADCRecorder *rec)
+{
+    bool found = false;
+    uint32_t newest_seq = 0;
+    uint32_t newest_end = 0;
+    for (uint32_t sector = 0; sector < rec->partition->size; sector += ADC_RECORDER_SECTOR_SIZE) {
+        uint32_t offset = sector;
+        uint32_t size;
+        struct ADCRecorderHeader header;
+        do {
+            if (check_block(rec, offset, &header, &size) && (!found || !seq_after_or_at(newest_seq, header.seq))) {
+                found = true;
+                newest_seq = header.seq;
+                newest_end = offset + size;
+            }
+            offset += size;
+        } while (size > 0 && offset % ADC_RECORDER_SECTOR_SIZE != 0);
+    }
+    rec->head = newest_end;
+    rec->next_seq = found ? newest_seq + 1 : 0;
+    ESP_LOGI(TAG, "Mounted %s, next block %u at 0x%x", rec->partition->label, (unsigned) rec->next_seq, (unsigned) rec->head);
+}
+
+// the sector holding the newest block; the one after it holds the oldest
+static uint32_t head_sector(uint32_t head)
+{
+    return head == 0 ? 0 : (head - 1) / ADC_RECORDER_SECTOR_SIZE * ADC_RECORDER_SECTOR_SIZE;
+}
+
+static esp_err_t write_block(struct ADCRecorder *rec, struct ADCRecorderSlot *slot)
+{
+    struct ADCRecorderHeader *header = &slot->header;
+    uint32_t size = block_size(header->count);
+    uint32_t partition_size = rec->partition->size;
+
+    xSemaphoreTake(rec->lock, portMAX_DELAY);
+    uint32_t offset = rec->head == partition_size ? 0 : rec->head;
+    // a block that does not fit, or lands on what a torn write left, goes to the next sector
+    if (offset % ADC_RECORDER_SECTOR_SIZE != 0
+        && (size > ADC_RECORDER_SECTOR_SIZE - offset % ADC_RECORDER_SECTOR_SIZE || !is_erased(rec->map + offset, size))) {
+        offset += ADC_RECORDER_SECTOR_SIZE - offset % ADC_RECORDER_SECTOR_SIZE;
+        if (offset == partition_size) {
+            offset = 0;
+        }
+    }
+    header->seq = rec->next_seq++;
+    rec->head = offset + size;
+    xSemaphoreGive(rec->lock);
+
+    header->crc = block_crc(header, (const uint8_t *) slot->samples);
+    esp_err_t err = ESP_OK;
+    if (offset % ADC_RECORDER_SECTOR_SIZE == 0) {
+        err = esp_partition_erase_range(rec->partition, offset, ADC_RECORDER_SECTOR_SIZE);
+    }
+    if (err == ESP_OK) {
+        err = esp_partition_write(rec->partition, offset, slot, size);
+    }
+    return err;
+}
+
+static void adc_recorder_task(void *arg)
+{
+    struct ADCRecorder *rec = (struct ADCRecorder *) arg;
+
+    while (true) {
+        uint8_t index;
+        xQueueReceive(rec->full_slots, &index, portMAX_DELAY);
+        if (index == ADC_RECORDER_STOP) {
+            break;
+        }
+        if (index == ADC_RECORDER_FLUSH) {
+            xSemaphoreGive(rec->flushed);
+            continue;
+        }
+        esp_err_t err = write_block(rec, &rec->slots[index]);
+        if (err != ESP_OK) {
+            ESP_LOGW(TAG, "Failed to write block: err: %i.", err);
+            __atomic_fetch_add(&rec->write_errors, 1, __ATOMIC_RELAXED);
+        }
+        xQueueSend(rec->free_slots, &index, portMAX_DELAY);
+    }
+
+    xSemaphoreGive(rec->done);
+    vTaskDelete(NULL);
+}
+
+void adc_recorder_reset(struct ADCRecorder *rec)
+{
+    memset(rec, 0, sizeof(struct ADCRecorder));
+}
+
+static void adc_recorder_free(struct ADCRecorder *rec)
+{
+    if (rec->free_slots != NULL) {
+        vQueueDelete(rec->free_slots);
+    }
+    if (rec->full_slots != NULL) {
+        vQueueDelete(rec->full_slots);
+    }
+    if (rec->lock != NULL) {
+        vSemaphoreDelete(rec->lock);
+    }
+    if (rec->flushed != NULL) {
+        vSemaphoreDelete(rec->flushed);
+    }
+    if (rec->done != NULL) {
+        vSemaphoreDelete(rec->done);
+    }
+    free(rec->slots);
+    release_mapping(rec->partition);
+    adc_recorder_reset(rec);
+}
+
+esp_err_t adc_recorder_open(struct ADCRecorder *rec, const char *label)
+{
+    if (rec->partition != NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    const esp_partition_t *partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, label);
+    if (partition == NULL) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    if (partition->size < 2 * ADC_RECORDER_SECTOR_SIZE || partition->size % ADC_RECORDER_SECTOR_SIZE != 0) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    const uint8_t *map;
+    esp_err_t err = claim_mapping(partition, &map);
+    if (err != ESP_OK) {
+        return err;
+    }
+    rec->partition = partition;
+    rec->map = map;
+    rec->slots = malloc(ADC_RECORDER_SLOTS * sizeof(struct ADCRecorderSlot));
+    rec->free_slots = xQueueCreate(ADC_RECORDER_SLOTS, sizeof(uint8_t));
+    // room for every slot plus a flush and the stop request
+    rec->full_slots = xQueueCreate(ADC_RECORDER_SLOTS + 2, sizeof(uint8_t));
+    rec->lock = xSemaphoreCreateMutex();
+    rec->flushed = xSemaphoreCreateBinary();
+    rec->done = xSemaphoreCreateBinary();
+    if (rec->slots == NULL || rec->free_slots == NULL || rec->full_slots == NULL || rec->lock == NULL
+        || rec->flushed == NULL || rec->done == NULL) {
+        adc_recorder_free(rec);
+        return ESP_ERR_NO_MEM;
+    }
+    for (uint8_t i = 0; i < ADC_RECORDER_SLOTS; ++i) {
+        xQueueSend(rec->free_slots, &i, 0);
+    }
+    mount(rec);
+    if (xTaskCreate(adc_recorder_task, "adc_recorder", ADC_RECORDER_TASK_STACK_SIZE, rec, ADC_RECORDER_TASK_PRIORITY, NULL) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create writer task");
+        adc_recorder_free(rec);
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+bool adc_recorder_is_open(const struct ADCRecorder *rec)
+{
+    return rec->partition != NULL;
+}
+
+esp_err_t adc_recorder_append(struct ADCRecorder *rec, int pin, uint32_t period_us, int64_t time_us, const uint16_t *samples, size_t count)
+{
+    if (count == 0 || count > ADC_RECORDER_MAX_SAMPLES) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    uint8_t index;
+    if (xQueueReceive(rec->free_slots, &index, 0) != pdTRUE) {
+        __atomic_fetch_add(&rec->dropped, 1, __ATOMIC_RELAXED);
+        return ESP_ERR_NO_MEM;
+    }
+    struct ADCRecorderSlot *slot = &rec->slots[index];
+    slot->header.magic = ADC_RECORDER_MAGIC;
+    slot->header.time_us = time_us;
+    slot->header.period_us = period_us;
+    slot->header.count = (uint16_t) count;
+    slot->header.pin = (uint8_t) pin;
+    slot->header.encoding = ADC_ENCODING_RAW16;
+    slot->header.reserved = UINT32_MAX;
+    memcpy(slot->samples, samples, count * sizeof(uint16_t));
+    // the padding of an odd count stays erased
+    if (count & 1) {
+        slot->samples[count] = UINT16_MAX;
+    }
+    xQueueSend(rec->full_slots, &index, portMAX_DELAY);
+    return ESP_OK;
+}
+
+void adc_recorder_flush(struct ADCRecorder *rec)
+{
+    uint8_t request = ADC_RECORDER_FLUSH;
+    xQueueSend(rec->full_slots, &request, portMAX_DELAY);
+    xSemaphoreTake(rec->flushed, portMAX_DELAY);
+}
+
+//
+// Walk every block from the oldest sector on, calling fn with the valid ones
+// until it returns false.
+//
+typedef bool (*block_fn_t)(void *arg, uint32_t offset, const struct ADCRecorderHeader *header);
+
+static void walk(struct ADCRecorder *rec, block_fn_t fn, void *arg)
+{
+    xSemaphoreTake(rec->lock, portMAX_DELAY);
+    uint32_t newest = head_sector(rec->head);
+    xSemaphoreGive(rec->lock);
+
+    uint32_t partition_size = rec->partition->size;
+    uint32_t sector = newest;
+    do {
+        sector = sector + ADC_RECORDER_SECTOR_SIZE == partition_size ? 0 : sector + ADC_RECORDER_SECTOR_SIZE;
+        uint32_t offset = sector;
+        uint32_t size;
+        struct ADCRecorderHeader header;
+        do {
+            if (check_block(rec, offset, &header, &size) && !fn(arg, offset, &header)) {
+                return;
+            }
+            offset += size;
+        } while (size > 0 && offset % ADC_RECORDER_SECTOR_SIZE != 0);
+    } while (sector != newest);
+}
+
+struct ReadState
+{
+    uint32_t from;
+    struct ADCRecorderBlock *out;
+    size_t max;
+    size_t count;
+};
+
+static bool read_block(void *arg, uint32_t offset, const struct ADCRecorderHeader *header)
+{
+    struct ReadState *state = (struct ReadState *) arg;
+    if (!seq_after_or_at(header->seq, state->from)) {
+        return true;
+    }
+    struct ADCRecorderBlock *block = &state->out[state->count++];
+    block->seq = header->seq;
+    block->pin = header->pin;
+    block->encoding = header->encoding;
+    block->count = header->count;
+    block->time_us = header->time_us;
+    block->period_us = header->period_us;
+    block->offset = offset + sizeof(struct ADCRecorderHeader);
+    return state->count < state->max;
+}
+
+size_t adc_recorder_read(struct ADCRecorder *rec, uint32_t from, struct ADCRecorderBlock *out, size_t max)
+{
+    if (max == 0) {
+        return 0;
+    }
+    struct ReadState state = {
+        .from = from,
+        .out = out,
+        .max = max,
+    };
+    walk(rec, read_block, &state);
+    return state.count;
+}
+
+bool adc_recorder_copy(const struct ADCRecorder *rec, const struct ADCRecorderBlock *block, uint16_t *samples)
+{
+    // the writer may have wrapped over the block since it was found; if so
+    // the header no longer matches, or the CRC of the copy fails
+    struct ADCRecorderHeader header;
+    memcpy(&header, rec->map + block->offset - sizeof(struct ADCRecorderHeader), sizeof(struct ADCRecorderHeader));
+    if (header.magic != ADC_RECORDER_MAGIC || header.seq != block->seq || header.count != block->count) {
+        return false;
+    }
+    memcpy(samples, rec->map + block->offset, block->count * sizeof(uint16_t));
+    return block_crc(&header, (const uint8_t *) samples) == header.crc;
+}
+
+static bool count_block(void *arg, uint32_t offset, const struct ADCRecorderHeader *header)
+{
+    (void) offset;
+    struct ADCRecorderInfo *info = (struct ADCRecorderInfo *) arg;
+    if (info->blocks++ == 0) {
+        info->first_seq = header->seq;
+    }
+    info->used += block_size(header->count);
+    return true;
+}
+
+void adc_recorder_info(struct ADCRecorder *rec, struct ADCRecorderInfo *info)
+{
+    memset(info, 0, sizeof(struct ADCRecorderInfo));
+    info->size = rec->partition->size;
+    walk(rec, count_block, info);
+    xSemaphoreTake(rec->lock, portMAX_DELAY);
+    info->next_seq = rec->next_seq;
+    xSemaphoreGive(rec->lock);
+    if (info->blocks == 0) {
+        info->first_seq = info->next_seq;
+    }
+    info->dropped = __atomic_load_n(&rec->dropped, __ATOMIC_RELAXED);
+    info->write_errors = __atomic_load_n(&rec->write_errors, __ATOMIC_RELAXED);
+}
+
+void adc_recorder_close(struct ADCRecorder *rec)
+{
+    if (rec->partition == NULL) {
+        return;
+    }
+    // queued after every pending block, so those are written first
+    uint8_t request = ADC_RECORDER_STOP;
+    xQueueSend(rec->full_slots, &request, portMAX_DELAY);
+    xSemaphoreTake(rec->done, portMAX_DELAY);
+    adc_recorder_free(rec);
+}
@@ -0,0 +1,188 @@
+//
+// Copyright (c) 2024 Jose Rodriguez
+// All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef __ADC_RECORDER_H__
+#define __ADC_RECORDER_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+#include "esp_partition.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+
+// erase unit; blocks never straddle one
+#define ADC_RECORDER_SECTOR_SIZE 4096
+#define ADC_RECORDER_BLOCK_SIZE 512
+#define ADC_RECORDER_MAX_SAMPLES ((ADC_RECORDER_BLOCK_SIZE - sizeof(struct ADCRecorderHeader)) / sizeof(uint16_t))
+// blocks that may wait for the writer task before appends are dropped
+#define ADC_RECORDER_SLOTS 8
+// partitions that can be mapped over the life of the VM
+#define ADC_RECORDER_MAX_PARTITIONS 2
+
+#define ADC_RECORDER_MAGIC 0x52434441
+
+//
+// On flash, a block is this header followed by count little-endian uint16
+// samples, padded to a multiple of 4 bytes.  crc is the CRC-32 of the header
+// up to crc and of the samples.
+//
+struct ADCRecorderHeader
+{
+    uint32_t magic;
+    uint32_t seq;
+    // when the first sample was taken
+    int64_t time_us;
+    uint32_t period_us;
+    uint16_t count;
+    uint8_t pin;
+    // enum ADCEncoding of the samples
+    uint8_t encoding;
+    uint32_t crc;
+    uint32_t reserved;
+};
+
+struct ADCRecorderSlot
+{
+    struct ADCRecorderHeader header;
+    uint16_t samples[ADC_RECORDER_MAX_SAMPLES];
+};
+
+// a block found by adc_recorder_read
+struct ADCRecorderBlock
+{
+    uint32_t seq;
+    uint8_t pin;
+    uint8_t encoding;
+    uint16_t count;
+    int64_t time_us;
+    uint32_t period_us;
+    // of the samples, from the start of the partition (and of its mapping)
+    uint32_t offset;
+};
+
+struct ADCRecorderInfo
+{
+    uint32_t size;
+    // bytes taken by valid blocks
+    uint32_t used;
+    uint32_t blocks;
+    uint32_t first_seq;
+    uint32_t next_seq;
+    uint32_t dropped;
+    uint32_t write_errors;
+};
+
+//
+// A circular log of sample blocks in a data partition.  Appends copy into
+// preallocated slots, which a writer task commits to flash, so appending never
+// allocates and never waits for flash.  The partition stays mapped, and
+// readout points into the mapping.
+//
+struct ADCRecorder
+{
+    // NULL unless open
+    const esp_partition_t *partition;
+    const uint8_t *map;
+    struct ADCRecorderSlot *slots;
+    // slot indexes; full also carries the flush and stop requests
+    QueueHandle_t free_slots;
+    QueueHandle_t full_slots;
+    SemaphoreHandle_t lock;
+    SemaphoreHandle_t flushed;
+    SemaphoreHandle_t done;
+    // guarded by lock; the offset of the next block, and its seq
+    uint32_t head;
+    uint32_t next_seq;
+    // accessed atomically
+    uint32_t dropped;
+    uint32_t write_errors;
+};
+
+/**
+ * @brief   Create the table of mapped partitions.  Safe to call more than once.
+ */
+esp_err_t adc_recorder_init(void);
+
+/**
+ * @brief   Mark a recorder closed.  Nothing is allocated.
+ */
+void adc_recorder_reset(struct ADCRecorder *rec);
+
+/**
+ * @brief   Open the data partition with the given label, find the newest
+ *          block in it and start the writer task.
+ * @details The partition is mapped the first time it is opened and stays
+ *          mapped until the VM exits, so pointers into it never dangle.
+ * @return  ESP_ERR_NOT_FOUND if there is no such partition,
+ *          ESP_ERR_INVALID_SIZE if it holds fewer than two sectors,
+ *          ESP_ERR_INVALID_STATE if this or another recorder has it open.
+ */
+esp_err_t adc_recorder_open(struct ADCRecorder *rec, const char *label);
+
+/**
+ * @brief   Check whether a recorder is open.
+ */
+bool adc_recorder_is_open(const struct ADCRecorder *rec);
+
+/**
+ * @brief   Queue a block of samples for writing.
+ * @details Copies the samples, so they can be reused at once.  Safe to call
+ *          from any task, but not from an ISR.
+ * @return  ESP_ERR_INVALID_SIZE if count exceeds ADC_RECORDER_MAX_SAMPLES,
+ *          ESP_ERR_NO_MEM if every slot is waiting for the writer, in which
+ *          case the block is counted as dropped.
+ */
+esp_err_t adc_recorder_append(struct ADCRecorder *rec, int pin, uint32_t period_us, int64_t time_us, const uint16_t *samples, size_t count);
+
+/**
+ * @brief   Wait until every block appended so far is on flash.
+ */
+void adc_recorder_flush(struct ADCRecorder *rec);
+
+/**
+ * @brief   Find up to max valid blocks with seq at or after from, oldest first.
+ * @details Blocks that fail their CRC are skipped.  The samples stay in
+ *          the mapping only until the log wraps over them, so copy them out
+ *          with adc_recorder_copy.
+ * @return  the number of blocks found.
+ */
+size_t adc_recorder_read(struct ADCRecorder *rec, uint32_t from, struct ADCRecorderBlock *out, size_t max);
+
+/**
+ * @brief   Copy the block->count samples of a block found by
+ *          adc_recorder_read to samples.
+ * @return  false if the log has wrapped over the block since, in which case
+ *          samples holds garbage.
+ */
+bool adc_recorder_copy(const struct ADCRecorder *rec, const struct ADCRecorderBlock *block, uint16_t *samples);
+
+/**
+ * @brief   Count the valid blocks and snapshot the counters.
+ */
+void adc_recorder_info(struct ADCRecorder *rec, struct ADCRecorderInfo *info);
+
+/**
+ * @brief   Write out the queued blocks, stop the writer task and release the
+ *          partition.  The mapping is kept.  Safe to call more than once.
+ */
+void adc_recorder_close(struct ADCRecorder *rec);
+
+#endif
@@ -0,0 +1,143 @@
+//
+// Copyright (c) 2024 Jose Rodriguez
+// All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+//
+// The drivers allow one handle per unit, so every resource opened on a unit
+// borrows the same backend unit (and calibration tables) from here.  Entries
+// are kept per backend, created for the first user and torn down with the
+// last.
+//
+
+#include "adc_registry.h"
+
+#include <stdlib.h>
+
+#include "esp_log.h"
+
+#define TAG "adc_registry"
+
+static SemaphoreHandle_t registry_lock;
+// guarded by registry_lock
+static struct ADCUnitShared *units;
+
+esp_err_t adc_registry_init(void)
+{
+    if (registry_lock != NULL) {
+        return ESP_OK;
+    }
+    registry_lock = xSemaphoreCreateMutex();
+    return registry_lock != NULL ? ESP_OK : ESP_ERR_NO_MEM;
+}
+
+// requires the registry lock
+static struct ADCUnitShared *adc_registry_find(const struct ADCBackend *backend, adc_unit_t unit_id)
+{
+    struct ADCUnitShared *shared = units;
+    while (shared != NULL && (shared->backend != backend || shared->unit_id != unit_id)) {
+        shared = shared->next;
+    }
+    return shared;
+}
+
+static esp_err_t adc_registry_create(const struct ADCBackend *backend, adc_unit_t unit_id, struct ADCUnitShared **out)
+{
+    struct ADCUnitShared *shared = calloc(1, sizeof(struct ADCUnitShared));
+    if (shared == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    shared->backend = backend;
+    shared->unit_id = unit_id;
+    shared->lock = xSemaphoreCreateMutex();
+    if (shared->lock == NULL) {
+        free(shared);
+        return ESP_ERR_NO_MEM;
+    }
+    esp_err_t err = backend->init(unit_id, &shared->handle);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to create %s unit %i.  err=%i", backend->name, unit_id, err);
+        vSemaphoreDelete(shared->lock);
+        free(shared);
+        return err;
+    }
+    *out = shared;
+    return ESP_OK;
+}
+
+static void adc_registry_destroy(struct ADCUnitShared *shared)
+{
+    for (int i = 0; i < ADC_REGISTRY_MAX_CALI_TABLES; ++i) {
+        if (shared->cali_tables[i] != NULL) {
+            adc_calib_destroy(shared->cali_tables[i]);
+        }
+    }
+    shared->backend->close(shared->handle);
+    vSemaphoreDelete(shared->lock);
+    free(shared);
+}
+
+esp_err_t adc_registry_acquire(const struct ADCBackend *backend, adc_unit_t unit_id, struct ADCUnitShared **shared)
+{
+    if ((unsigned) unit_id >= SOC_ADC_PERIPH_NUM) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (registry_lock == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    esp_err_t err = ESP_OK;
+    xSemaphoreTake(registry_lock, portMAX_DELAY);
+    struct ADCUnitShared *found = adc_registry_find(backend, unit_id);
+    if (found == NULL) {
+        err = adc_registry_create(backend, unit_id, &found);
+        if (err == ESP_OK) {
+            found->next = units;
+            units = found;
+        }
+    }
+    if (err == ESP_OK) {
+        found->refcount++;
+        *shared = found;
+    }
+    xSemaphoreGive(registry_lock);
+    return err;
+}
+
+void adc_registry_release(struct ADCUnitShared *shared)
+{
+    // destroyed under the lock, so a new first user cannot race the old driver unit
+    xSemaphoreTake(registry_lock, portMAX_DELAY);
+    if (--shared->refcount == 0) {
+        struct ADCUnitShared **link = &units;
+        while (*link != shared) {
+            link = &(*link)->next;
+        }
+        *link = shared->next;
+        adc_registry_destroy(shared);
+    }
+    xSemaphoreGive(registry_lock);
+}
+
+uint32_t adc_registry_users(const struct ADCBackend *backend, adc_unit_t unit_id)
+{
+    if (registry_lock == NULL) {
+        return 0;
+    }
+    xSemaphoreTake(registry_lock, portMAX_DELAY);
+    struct ADCUnitShared *shared = adc_registry_find(backend, unit_id);
+    uint32_t users = shared != NULL ? shared->refcount : 0;
+    xSemaphoreGive(registry_lock);
+    return users;
+}
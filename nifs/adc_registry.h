@@ -0,0 +1,85 @@
+//
+// Copyright (c) 2024 Jose Rodriguez
+// All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef __ADC_REGISTRY_H__
+#define __ADC_REGISTRY_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "soc/soc_caps.h"
+
+#include "adc_backend.h"
+#include "adc_calib.h"
+
+#define ADC_REGISTRY_MAX_CALI_TABLES 8
+
+// channel settings last written to the driver
+struct ADCProgrammed
+{
+    bool valid;
+    adc_bitwidth_t bitwidth;
+    adc_atten_t atten;
+};
+
+//
+// Driver state of one ADC unit on one backend, shared by every resource
+// opened on it.
+//
+struct ADCUnitShared
+{
+    const struct ADCBackend *backend;
+    adc_unit_t unit_id;
+    // the backend unit
+    void *handle;
+    // serializes conversions and channel configuration of every user
+    SemaphoreHandle_t lock;
+    // calibration tables shared by all channels with the same atten/bitwidth; guarded by lock
+    struct ADCCaliTable *cali_tables[ADC_REGISTRY_MAX_CALI_TABLES];
+    // users may configure a channel differently, so reads reprogram it on change; guarded by lock
+    struct ADCProgrammed programmed[SOC_ADC_MAX_CHANNEL_NUM];
+    // guarded by the registry lock
+    uint32_t refcount;
+    struct ADCUnitShared *next;
+};
+
+/**
+ * @brief   Create the registry lock.  Called once, at nif collection init.
+ */
+esp_err_t adc_registry_init(void);
+
+/**
+ * @brief   Get the shared state of a unit on a backend, creating the backend
+ *          unit for its first user.
+ * @return  the backend error if its unit cannot be created.
+ */
+esp_err_t adc_registry_acquire(const struct ADCBackend *backend, adc_unit_t unit_id, struct ADCUnitShared **shared);
+
+/**
+ * @brief   Drop a reference taken with adc_registry_acquire.  The last one
+ *          deletes the calibration tables and the backend unit.
+ */
+void adc_registry_release(struct ADCUnitShared *shared);
+
+/**
+ * @brief   Number of users of a unit on a backend, for diagnostics.
+ */
+uint32_t adc_registry_users(const struct ADCBackend *backend, adc_unit_t unit_id);
+
+#endif
@@ -0,0 +1,111 @@
+//
+// Copyright (c) 2024 Jose Rodriguez
+// All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "adc_ring.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+void adc_ring_init(struct ADCRing *ring)
+{
+    memset(ring, 0, sizeof(struct ADCRing));
+}
+
+esp_err_t adc_ring_alloc(struct ADCRing *ring, uint32_t size)
+{
+    if (size == 0 || size > (UINT32_C(1) << 31)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    uint32_t capacity = 1;
+    while (capacity < size) {
+        capacity <<= 1;
+    }
+    struct ADCRingEntry *entries = malloc(capacity * sizeof(struct ADCRingEntry));
+    if (entries == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    ring->entries = entries;
+    ring->head = 0;
+    ring->tail = 0;
+    ring->overruns = 0;
+    ring->high_water = 0;
+    __atomic_store_n(&ring->size, capacity, __ATOMIC_RELEASE);
+    return ESP_OK;
+}
+
+void adc_ring_free(struct ADCRing *ring)
+{
+    free(ring->entries);
+    adc_ring_init(ring);
+}
+
+bool adc_ring_push(struct ADCRing *ring, const struct ADCRingEntry *entry)
+{
+    uint32_t head = ring->head;
+    uint32_t count = head - __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+    if (count == ring->size) {
+        __atomic_store_n(&ring->overruns, ring->overruns + 1, __ATOMIC_RELAXED);
+        return false;
+    }
+    ring->entries[head & (ring->size - 1)] = *entry;
+    // the entry must be visible before the consumer can see the new head
+    __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+    if (count + 1 > ring->high_water) {
+        __atomic_store_n(&ring->high_water, count + 1, __ATOMIC_RELAXED);
+    }
+    return true;
+}
+
+uint32_t adc_ring_count(const struct ADCRing *ring)
+{
+    if (__atomic_load_n(&ring->size, __ATOMIC_ACQUIRE) == 0) {
+        return 0;
+    }
+    uint32_t tail = __atomic_load_n(&ring->tail, __ATOMIC_RELAXED);
+    return __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) - tail;
+}
+
+size_t adc_ring_drain(struct ADCRing *ring, void *out, size_t max)
+{
+    uint32_t size = __atomic_load_n(&ring->size, __ATOMIC_ACQUIRE);
+    if (size == 0) {
+        return 0;
+    }
+    uint32_t tail = ring->tail;
+    uint32_t count = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) - tail;
+    size_t n = count < max ? count : max;
+    if (n == 0) {
+        return 0;
+    }
+
+    uint32_t start = tail & (size - 1);
+    size_t first = size - start < n ? size - start : n;
+    memcpy(out, &ring->entries[start], first * sizeof(struct ADCRingEntry));
+    memcpy((struct ADCRingEntry *) out + first, ring->entries, (n - first) * sizeof(struct ADCRingEntry));
+
+    // the entries must be read before the producer may overwrite them
+    __atomic_store_n(&ring->tail, tail + (uint32_t) n, __ATOMIC_RELEASE);
+    return n;
+}
+
+void adc_ring_info(const struct ADCRing *ring, struct ADCRingInfo *info)
+{
+    info->size = __atomic_load_n(&ring->size, __ATOMIC_ACQUIRE);
+    info->count = adc_ring_count(ring);
+    info->overruns = __atomic_load_n(&ring->overruns, __ATOMIC_RELAXED);
+    info->high_water = __atomic_load_n(&ring->high_water, __ATOMIC_RELAXED);
+}
@@ -0,0 +1,112 @@
+//
+// Copyright (c) 2024 Jose Rodriguez
+// All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef __ADC_RING_H__
+#define __ADC_RING_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+
+//
+// One sample as stored in the ring, and as copied out by adc_ring_drain:
+// <<TimestampUs:32/little, Value:16/little, Pin:8, 0:8>>
+//
+// timestamp_us holds the low 32 bits of the esp_timer time, which keeps
+// entries at 8 bytes but wraps every 2^32 us (about 71.6 minutes).  Compare
+// two timestamps by their difference modulo 2^32, which is right for entries
+// less than one wrap apart; entries drained more than a wrap apart cannot be
+// ordered from their timestamps alone.
+//
+struct ADCRingEntry
+{
+    uint32_t timestamp_us;
+    uint16_t value;
+    uint8_t pin;
+    uint8_t reserved;
+};
+
+_Static_assert(sizeof(struct ADCRingEntry) == 8, "ring entries are copied out verbatim");
+
+//
+// Lock-free ring for exactly one producer and one consumer.  head is only
+// written by the producer and tail only by the consumer; both run freely and
+// are reduced modulo size (a power of two) on access.  When the ring is full
+// the producer drops the new sample and counts an overrun.
+//
+struct ADCRing
+{
+    struct ADCRingEntry *entries;
+    // zero until adc_ring_alloc; published last, so a non-zero size means the ring is usable
+    uint32_t size;
+    uint32_t head;
+    uint32_t tail;
+    uint32_t overruns;
+    uint32_t high_water;
+};
+
+struct ADCRingInfo
+{
+    uint32_t size;
+    uint32_t count;
+    uint32_t overruns;
+    uint32_t high_water;
+};
+
+/**
+ * @brief   Prepare an empty ring.  Nothing is allocated.
+ */
+void adc_ring_init(struct ADCRing *ring);
+
+/**
+ * @brief   Allocate room for size entries, rounded up to a power of two.
+ * @details Must not race with the producer or consumer.
+ * @return  ESP_ERR_INVALID_ARG for a zero size, ESP_ERR_NO_MEM if allocation fails.
+ */
+esp_err_t adc_ring_alloc(struct ADCRing *ring, uint32_t size);
+
+/**
+ * @brief   Release the entries.  Must not race with the producer or consumer.
+ */
+void adc_ring_free(struct ADCRing *ring);
+
+/**
+ * @brief   Append an entry.  Producer side only.
+ * @return  false, counting an overrun, if the ring is full.
+ */
+bool adc_ring_push(struct ADCRing *ring, const struct ADCRingEntry *entry);
+
+/**
+ * @brief   Number of entries available to the consumer.
+ */
+uint32_t adc_ring_count(const struct ADCRing *ring);
+
+/**
+ * @brief   Move up to max entries, oldest first, into out.  Consumer side only.
+ * @details Copies at most two contiguous runs, so the cost is that of a memcpy.
+ * @return  the number of entries copied.
+ */
+size_t adc_ring_drain(struct ADCRing *ring, void *out, size_t max);
+
+/**
+ * @brief   Snapshot the fill level and counters.  Safe from either side.
+ */
+void adc_ring_info(const struct ADCRing *ring, struct ADCRingInfo *info);
+
+#endif
@@ -0,0 +1,410 @@
+//
+// Copyright (c) 2024 Jose Rodriguez
+// All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+//
+// Periodic sampling on hardware timers.  Timer callbacks only count expiries
+// and wake the sampler task, which runs above the AtomVM schedulers, so the
+// sampling instant does not depend on VM load.  Each tick is compared with its
+// ideal deadline (group start + tick * period) to track jitter, and expiries
+// that pile up while the sampler is busy are counted as missed deadlines.
+// Batches of a channel with flow control only go out while its subscriber
+// has credit; the rest are held back or dropped, and held ones go out, in
+// order and ahead of new ones, as soon as credit is granted.
+//
+
+#include "adc_sched.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "esp_log.h"
+#include "freertos/task.h"
+
+#define TAG "adc_sched"
+
+#define ADC_SCHED_TASK_STACK_SIZE 3072
+#define ADC_SCHED_TASK_PRIORITY 10
+
+static void adc_sched_timer_cb(void *arg)
+{
+    struct ADCSchedGroup *group = (struct ADCSchedGroup *) arg;
+    __atomic_fetch_add(&group->due, 1, __ATOMIC_RELEASE);
+    xSemaphoreGive(group->sched->wake);
+}
+
+static void adc_sched_sample(struct ADCScheduler *sched, struct ADCSchedGroup *group, struct ADCSchedEntry *entry, uint32_t due)
+{
+    int64_t deadline = group->start_us + (int64_t) group->tick * group->period_us;
+    int64_t now = esp_timer_get_time();
+    uint32_t jitter = now > deadline ? (uint32_t) (now - deadline) : 0;
+
+    struct ADCSchedInfo *info = &entry->info;
+    info->ticks++;
+    info->missed += due - 1;
+    info->total_jitter_us += jitter;
+    if (jitter > info->max_jitter_us) {
+        info->max_jitter_us = jitter;
+    }
+
+    uint32_t reading;
+    if (adc_unit_read(sched->unit, entry->channel, entry->samples, &reading) != ESP_OK) {
+        info->errors++;
+        return;
+    }
+    if (entry->sink == ADC_SCHED_RING) {
+        struct ADCRingEntry ring_entry = {
+            // wraps; see struct ADCRingEntry
+            .timestamp_us = (uint32_t) now,
+            .value = (uint16_t) reading,
+            .pin = (uint8_t) entry->pin,
+        };
+        adc_ring_push(&sched->ring, &ring_entry);
+        return;
+    }
+    if (entry->count == 0) {
+        entry->batch_start_us = now;
+    }
+    entry->batch[entry->count++] = (uint16_t) reading;
+    if (entry->count < entry->batch_size) {
+        return;
+    }
+    if (entry->sink == ADC_SCHED_RECORD) {
+        // a drop is counted by the recorder
+        adc_recorder_append(sched->recorder, entry->pin, group->period_us, entry->batch_start_us, entry->batch, entry->count);
+    } else if (adc_credit_admit(&entry->credit)) {
+        sched->cb(sched->cb_arg, entry->pin, entry->owner, entry->batch, entry->count);
+    } else {
+        adc_credit_hold(&entry->credit, entry->batch, entry->count * sizeof(uint16_t), 0);
+    }
+    entry->count = 0;
+}
+
+// send what was held back for want of credit, for as long as credit lasts
+static void adc_sched_release(struct ADCScheduler *sched, struct ADCSchedEntry *entry)
+{
+    const void *data;
+    size_t size;
+    uint64_t tag;
+    while (adc_credit_release(&entry->credit, &data, &size, &tag)) {
+        sched->cb(sched->cb_arg, entry->pin, entry->owner, (const uint16_t *) data, size / sizeof(uint16_t));
+    }
+}
+
+static void adc_sched_task(void *arg)
+{
+    struct ADCScheduler *sched = (struct ADCScheduler *) arg;
+
+    while (sched->running) {
+        xSemaphoreTake(sched->wake, portMAX_DELAY);
+
+        xSemaphoreTake(sched->lock, portMAX_DELAY);
+        // grants wake the task too
+        for (int i = 0; i < SOC_ADC_MAX_CHANNEL_NUM; ++i) {
+            if (sched->entries[i].active) {
+                adc_sched_release(sched, &sched->entries[i]);
+            }
+        }
+        for (int g = 0; g < ADC_SCHED_MAX_GROUPS; ++g) {
+            struct ADCSchedGroup *group = &sched->groups[g];
+            if (!group->active) {
+                continue;
+            }
+            uint32_t due = __atomic_exchange_n(&group->due, 0, __ATOMIC_ACQUIRE);
+            if (due == 0) {
+                continue;
+            }
+            group->tick += due;
+            for (int i = 0; i < SOC_ADC_MAX_CHANNEL_NUM; ++i) {
+                struct ADCSchedEntry *entry = &sched->entries[i];
+                if (entry->active && entry->group == g) {
+                    adc_sched_sample(sched, group, entry, due);
+                }
+            }
+        }
+        xSemaphoreGive(sched->lock);
+    }
+
+    xSemaphoreGive(sched->done);
+    vTaskDelete(NULL);
+}
+
+void adc_sched_init(struct ADCScheduler *sched, struct ADCUnit *unit, adc_sched_batch_cb_t cb, void *cb_arg)
+{
+    memset(sched, 0, sizeof(struct ADCScheduler));
+    sched->unit = unit;
+    sched->cb = cb;
+    sched->cb_arg = cb_arg;
+    adc_ring_init(&sched->ring);
+    for (int g = 0; g < ADC_SCHED_MAX_GROUPS; ++g) {
+        sched->groups[g].sched = sched;
+    }
+}
+
+void adc_sched_free(struct ADCScheduler *sched)
+{
+    if (sched->lock != NULL) {
+        vSemaphoreDelete(sched->lock);
+        sched->lock = NULL;
+    }
+    if (sched->wake != NULL) {
+        vSemaphoreDelete(sched->wake);
+        sched->wake = NULL;
+    }
+    if (sched->done != NULL) {
+        vSemaphoreDelete(sched->done);
+        sched->done = NULL;
+    }
+}
+
+static esp_err_t adc_sched_start(struct ADCScheduler *sched)
+{
+    // a stopped scheduler keeps its semaphores until it is freed
+    if (sched->lock == NULL) {
+        sched->lock = xSemaphoreCreateMutex();
+    }
+    if (sched->wake == NULL) {
+        sched->wake = xSemaphoreCreateBinary();
+    }
+    if (sched->done == NULL) {
+        sched->done = xSemaphoreCreateBinary();
+    }
+    if (sched->lock == NULL || sched->wake == NULL || sched->done == NULL) {
+        adc_sched_free(sched);
+        return ESP_ERR_NO_MEM;
+    }
+    sched->running = true;
+    if (xTaskCreate(adc_sched_task, "adc_sched", ADC_SCHED_TASK_STACK_SIZE, sched, ADC_SCHED_TASK_PRIORITY, NULL) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create sampler task");
+        sched->running = false;
+        adc_sched_free(sched);
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+static void adc_sched_group_release(struct ADCSchedGroup *group)
+{
+    esp_timer_stop(group->timer);
+    esp_timer_delete(group->timer);
+    group->timer = NULL;
+    group->active = false;
+}
+
+// requires the lock
+static bool adc_sched_remove_locked(struct ADCScheduler *sched, struct ADCSchedEntry *entry)
+{
+    if (!entry->active) {
+        return false;
+    }
+    entry->active = false;
+    free(entry->batch);
+    entry->batch = NULL;
+    adc_credit_free(&entry->credit);
+
+    for (int i = 0; i < SOC_ADC_MAX_CHANNEL_NUM; ++i) {
+        if (sched->entries[i].active && sched->entries[i].group == entry->group) {
+            return true;
+        }
+    }
+    adc_sched_group_release(&sched->groups[entry->group]);
+    return true;
+}
+
+// requires the lock
+static int adc_sched_group_for(struct ADCScheduler *sched, uint32_t period_us)
+{
+    int free_group = -1;
+    for (int g = 0; g < ADC_SCHED_MAX_GROUPS; ++g) {
+        struct ADCSchedGroup *group = &sched->groups[g];
+        if (group->active && group->period_us == period_us) {
+            return g;
+        }
+        if (!group->active && free_group < 0) {
+            free_group = g;
+        }
+    }
+    if (free_group < 0) {
+        return -1;
+    }
+
+    struct ADCSchedGroup *group = &sched->groups[free_group];
+    esp_timer_create_args_t timer_args = {
+        .callback = adc_sched_timer_cb,
+        .arg = group,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "adc_sched",
+        .skip_unhandled_events = false,
+    };
+    if (esp_timer_create(&timer_args, &group->timer) != ESP_OK) {
+        return -1;
+    }
+    group->period_us = period_us;
+    group->tick = 0;
+    group->due = 0;
+    group->start_us = esp_timer_get_time();
+    if (esp_timer_start_periodic(group->timer, period_us) != ESP_OK) {
+        esp_timer_delete(group->timer);
+        group->timer = NULL;
+        return -1;
+    }
+    group->active = true;
+    return free_group;
+}
+
+esp_err_t adc_sched_add(struct ADCScheduler *sched, struct ADCChannel *channel, int pin, int32_t owner, uint32_t period_us, uint32_t samples, size_t batch_size, enum ADCSchedSink sink, const struct ADCCreditConfig *credit)
+{
+    bool ring = sink == ADC_SCHED_RING;
+    if (period_us < ADC_SCHED_MIN_PERIOD_US || samples == 0 || (!ring && batch_size == 0)
+        || (credit != NULL && sink != ADC_SCHED_BATCH)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (sink == ADC_SCHED_RECORD && batch_size > ADC_RECORDER_MAX_SAMPLES) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    if (sink == ADC_SCHED_RECORD && (sched->recorder == NULL || !adc_recorder_is_open(sched->recorder))) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    uint16_t *batch = NULL;
+    if (!ring) {
+        batch = malloc(batch_size * sizeof(uint16_t));
+        if (batch == NULL) {
+            return ESP_ERR_NO_MEM;
+        }
+    }
+    struct ADCCredit gate = { 0 };
+    if (credit != NULL) {
+        esp_err_t err = adc_credit_init(&gate, credit, batch_size * sizeof(uint16_t));
+        if (err != ESP_OK) {
+            free(batch);
+            return err;
+        }
+    }
+    if (!sched->running) {
+        esp_err_t err = adc_sched_start(sched);
+        if (err != ESP_OK) {
+            free(batch);
+            adc_credit_free(&gate);
+            return err;
+        }
+    }
+
+    xSemaphoreTake(sched->lock, portMAX_DELAY);
+    // the sampler only pushes under the lock, so the ring can be set up here
+    if (ring && sched->ring.size == 0 && adc_ring_alloc(&sched->ring, ADC_SCHED_RING_SIZE) != ESP_OK) {
+        xSemaphoreGive(sched->lock);
+        return ESP_ERR_NO_MEM;
+    }
+    struct ADCSchedEntry *entry = &sched->entries[channel->channel];
+    adc_sched_remove_locked(sched, entry);
+    int group = adc_sched_group_for(sched, period_us);
+    if (group < 0) {
+        xSemaphoreGive(sched->lock);
+        free(batch);
+        adc_credit_free(&gate);
+        return ESP_ERR_NOT_FOUND;
+    }
+    memset(entry, 0, sizeof(struct ADCSchedEntry));
+    entry->pin = pin;
+    entry->owner = owner;
+    entry->channel = channel;
+    entry->group = (uint8_t) group;
+    entry->samples = samples;
+    entry->sink = sink;
+    entry->batch = batch;
+    entry->batch_size = batch_size;
+    entry->credit = gate;
+    entry->info.period_us = period_us;
+    entry->active = true;
+    xSemaphoreGive(sched->lock);
+    return ESP_OK;
+}
+
+bool adc_sched_remove(struct ADCScheduler *sched, struct ADCChannel *channel)
+{
+    if (!sched->running) {
+        return false;
+    }
+    xSemaphoreTake(sched->lock, portMAX_DELAY);
+    bool ret = adc_sched_remove_locked(sched, &sched->entries[channel->channel]);
+    xSemaphoreGive(sched->lock);
+    return ret;
+}
+
+bool adc_sched_grant(struct ADCScheduler *sched, const struct ADCChannel *channel, uint32_t credits)
+{
+    if (!sched->running) {
+        return false;
+    }
+    xSemaphoreTake(sched->lock, portMAX_DELAY);
+    struct ADCSchedEntry *entry = &sched->entries[channel->channel];
+    bool ret = entry->active && entry->credit.limited;
+    if (ret && adc_credit_grant(&entry->credit, credits)) {
+        xSemaphoreGive(sched->wake);
+    }
+    xSemaphoreGive(sched->lock);
+    return ret;
+}
+
+bool adc_sched_info(struct ADCScheduler *sched, const struct ADCChannel *channel, struct ADCSchedInfo *info)
+{
+    if (!sched->running) {
+        return false;
+    }
+    xSemaphoreTake(sched->lock, portMAX_DELAY);
+    const struct ADCSchedEntry *entry = &sched->entries[channel->channel];
+    bool ret = entry->active;
+    if (ret) {
+        *info = entry->info;
+        info->dropped = adc_credit_dropped(&entry->credit);
+    }
+    xSemaphoreGive(sched->lock);
+    return ret;
+}
+
+uint32_t adc_sched_ring_count(struct ADCScheduler *sched)
+{
+    return adc_ring_count(&sched->ring);
+}
+
+size_t adc_sched_drain(struct ADCScheduler *sched, void *out, size_t max)
+{
+    return adc_ring_drain(&sched->ring, out, max);
+}
+
+void adc_sched_ring_info(struct ADCScheduler *sched, struct ADCRingInfo *info)
+{
+    adc_ring_info(&sched->ring, info);
+}
+
+void adc_sched_stop(struct ADCScheduler *sched)
+{
+    if (!sched->running) {
+        return;
+    }
+    xSemaphoreTake(sched->lock, portMAX_DELAY);
+    for (int i = 0; i < SOC_ADC_MAX_CHANNEL_NUM; ++i) {
+        adc_sched_remove_locked(sched, &sched->entries[i]);
+    }
+    xSemaphoreGive(sched->lock);
+
+    sched->running = false;
+    xSemaphoreGive(sched->wake);
+    xSemaphoreTake(sched->done, portMAX_DELAY);
+    // a grant or info call that saw the scheduler running may still be
+    // waiting on the lock, so the semaphores are left to adc_sched_free
+    adc_ring_free(&sched->ring);
+}
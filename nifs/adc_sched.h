@@ -0,0 +1,203 @@
+//
+// Copyright (c) 2024 Jose Rodriguez
+// All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef __ADC_SCHED_H__
+#define __ADC_SCHED_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "soc/soc_caps.h"
+
+#include "adc_credit.h"
+#include "adc_recorder.h"
+#include "adc_ring.h"
+#include "adc_unit.h"
+
+#define ADC_SCHED_MAX_GROUPS 4
+#define ADC_SCHED_MIN_PERIOD_US 100
+#define ADC_SCHED_DEFAULT_BATCH 32
+// entries of the shared ring, allocated when the first channel is scheduled into it
+#define ADC_SCHED_RING_SIZE 1024
+
+// where the readings of a scheduled channel go
+enum ADCSchedSink
+{
+    // to the callback, a batch at a time
+    ADC_SCHED_BATCH,
+    // to the scheduler ring, one entry per tick
+    ADC_SCHED_RING,
+    // to the scheduler recorder, a block per batch
+    ADC_SCHED_RECORD
+};
+
+// called from the sampler task with each full batch of a channel
+typedef void (*adc_sched_batch_cb_t)(void *arg, int pin, int32_t owner, const uint16_t *samples, size_t count);
+
+//
+// Channels sampled at the same period share a rate group: one periodic
+// esp_timer whose callback wakes the sampler task, which then samples every
+// channel of the group back to back.
+//
+struct ADCScheduler;
+
+struct ADCSchedGroup
+{
+    struct ADCScheduler *sched;
+    bool active;
+    uint32_t period_us;
+    esp_timer_handle_t timer;
+    int64_t start_us;
+    uint64_t tick;
+    // timer expiries not yet served; written by the timer callback
+    volatile uint32_t due;
+};
+
+struct ADCSchedInfo
+{
+    uint32_t period_us;
+    uint64_t ticks;
+    // deadlines passed while the sampler was busy
+    uint32_t missed;
+    // periods whose conversion failed, so that gave no reading
+    uint32_t errors;
+    uint32_t max_jitter_us;
+    uint64_t total_jitter_us;
+    // batches dropped for want of subscriber credit
+    uint32_t dropped;
+};
+
+struct ADCSchedEntry
+{
+    bool active;
+    int pin;
+    int32_t owner;
+    struct ADCChannel *channel;
+    uint8_t group;
+    uint32_t samples;
+    enum ADCSchedSink sink;
+    uint16_t *batch;
+    size_t batch_size;
+    size_t count;
+    // when the first reading of the batch was taken
+    int64_t batch_start_us;
+    // unlimited unless the subscriber asked for flow control
+    struct ADCCredit credit;
+    struct ADCSchedInfo info;
+};
+
+struct ADCScheduler
+{
+    struct ADCUnit *unit;
+    SemaphoreHandle_t lock;
+    SemaphoreHandle_t wake;
+    SemaphoreHandle_t done;
+    volatile bool running;
+    adc_sched_batch_cb_t cb;
+    void *cb_arg;
+    struct ADCSchedGroup groups[ADC_SCHED_MAX_GROUPS];
+    // indexed by channel
+    struct ADCSchedEntry entries[SOC_ADC_MAX_CHANNEL_NUM];
+    // the sampler task is the only producer; see adc_sched_drain for the consumer
+    struct ADCRing ring;
+    // where ADC_SCHED_RECORD batches go; set by the owner, and open for as
+    // long as any channel records into it
+    struct ADCRecorder *recorder;
+};
+
+/**
+ * @brief   Prepare a scheduler for a unit.  Nothing is allocated, and no task
+ *          is started, until the first channel is scheduled.
+ */
+void adc_sched_init(struct ADCScheduler *sched, struct ADCUnit *unit, adc_sched_batch_cb_t cb, void *cb_arg);
+
+/**
+ * @brief   Sample a channel every period_us, averaging samples conversions
+ *          per tick, and hand the readings to the callback batch_size at a time.
+ * @details Replaces any existing schedule of the channel; pin and owner are
+ *          handed back to the callback untouched.  With ADC_SCHED_RING,
+ *          readings are instead appended to the scheduler ring (and
+ *          batch_size is ignored), to be collected with adc_sched_drain.  With
+ *          ADC_SCHED_RECORD, each batch is appended to the recorder as a block;
+ *          one that finds the recorder busy is dropped.  If credit is not
+ *          NULL, batches are only handed to the callback while the
+ *          subscriber has credit (see adc_credit.h and adc_sched_grant).
+ * @return  ESP_ERR_INVALID_ARG for a period below ADC_SCHED_MIN_PERIOD_US, a
+ *          zero batch size or credit with another sink, ESP_ERR_INVALID_SIZE for a recorded batch above
+ *          ADC_RECORDER_MAX_SAMPLES, ESP_ERR_INVALID_STATE for a recorded
+ *          channel without an open recorder, ESP_ERR_NOT_FOUND if all rate
+ *          groups are taken by other periods, ESP_ERR_NO_MEM if allocation
+ *          fails.
+ */
+esp_err_t adc_sched_add(struct ADCScheduler *sched, struct ADCChannel *channel, int pin, int32_t owner, uint32_t period_us, uint32_t samples, size_t batch_size, enum ADCSchedSink sink, const struct ADCCreditConfig *credit);
+
+/**
+ * @brief   Stop sampling a channel, dropping any partial batch.
+ * @return  false if the channel was not scheduled.
+ */
+bool adc_sched_remove(struct ADCScheduler *sched, struct ADCChannel *channel);
+
+/**
+ * @brief   Grant the subscriber of a channel more credits, and have the
+ *          sampler send what it held back for want of them.
+ * @return  false if the channel is not scheduled with flow control.
+ */
+bool adc_sched_grant(struct ADCScheduler *sched, const struct ADCChannel *channel, uint32_t credits);
+
+/**
+ * @brief   Copy the timing counters of a scheduled channel.
+ * @return  false if the channel is not scheduled.
+ */
+bool adc_sched_info(struct ADCScheduler *sched, const struct ADCChannel *channel, struct ADCSchedInfo *info);
+
+/**
+ * @brief   Number of ring entries waiting to be drained.
+ */
+uint32_t adc_sched_ring_count(struct ADCScheduler *sched);
+
+/**
+ * @brief   Move up to max ring entries (struct ADCRingEntry) into out.
+ * @details Lock free, but there must be a single consumer at a time.
+ * @return  the number of entries copied.
+ */
+size_t adc_sched_drain(struct ADCScheduler *sched, void *out, size_t max);
+
+/**
+ * @brief   Snapshot the fill level and counters of the ring.
+ */
+void adc_sched_ring_info(struct ADCScheduler *sched, struct ADCRingInfo *info);
+
+/**
+ * @brief   Stop every timer and the sampler task, and release the ring.
+ * @details Once this returns the callback is no longer called.  The
+ *          semaphores outlive the task, as a concurrent grant may still hold
+ *          the lock; release them with adc_sched_free.
+ */
+void adc_sched_stop(struct ADCScheduler *sched);
+
+/**
+ * @brief   Release the semaphores of a stopped scheduler.  Safe to call more
+ *          than once.
+ */
+void adc_sched_free(struct ADCScheduler *sched);
+
+#endif
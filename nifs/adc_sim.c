@@ -0,0 +1,476 @@
+//
+// Copyright (c) 2024 Jose Rodriguez
+// All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "adc_sim.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "soc/soc_caps.h"
+
+#define ADC_SIM_TASK_STACK_SIZE 3072
+#define ADC_SIM_TASK_PRIORITY 5
+
+// the 12-bit signal spans these millivolts at each attenuation, ideally
+static const uint16_t sim_range_mv[] = { 950, 1250, 1750, 3100 };
+
+struct SimChannel
+{
+    // read without the lock, so channels without a signal cost nothing
+    bool active;
+    struct ADCSimSignal signal;
+    // owned copy of the replayed values
+    uint16_t *samples;
+};
+
+static SemaphoreHandle_t sim_lock;
+// guarded by sim_lock
+static struct SimChannel channels[SOC_ADC_PERIPH_NUM][SOC_ADC_MAX_CHANNEL_NUM];
+
+esp_err_t adc_sim_init(void)
+{
+    if (sim_lock != NULL) {
+        return ESP_OK;
+    }
+    sim_lock = xSemaphoreCreateMutex();
+    return sim_lock != NULL ? ESP_OK : ESP_ERR_NO_MEM;
+}
+
+static bool valid_channel(adc_unit_t unit_id, adc_channel_t channel)
+{
+    return (int) unit_id >= 0 && (int) unit_id < SOC_ADC_PERIPH_NUM && (int) channel >= 0 && (int) channel < SOC_ADC_MAX_CHANNEL_NUM;
+}
+
+// requires the lock
+static void clear_locked(struct SimChannel *sim)
+{
+    __atomic_store_n(&sim->active, false, __ATOMIC_RELEASE);
+    free(sim->samples);
+    memset(sim, 0, sizeof(struct SimChannel));
+}
+
+esp_err_t adc_sim_set_signal(adc_unit_t unit_id, adc_channel_t channel, const struct ADCSimSignal *signal)
+{
+    if (!valid_channel(unit_id, channel) || signal->wave > ADC_SIM_REPLAY
+        || (signal->wave == ADC_SIM_REPLAY && (signal->samples == NULL || signal->count == 0 || signal->sample_rate_hz == 0))) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (sim_lock == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    uint16_t *samples = NULL;
+    if (signal->wave == ADC_SIM_REPLAY) {
+        samples = malloc(signal->count * sizeof(uint16_t));
+        if (samples == NULL) {
+            return ESP_ERR_NO_MEM;
+        }
+        memcpy(samples, signal->samples, signal->count * sizeof(uint16_t));
+    }
+    xSemaphoreTake(sim_lock, portMAX_DELAY);
+    struct SimChannel *sim = &channels[unit_id][channel];
+    clear_locked(sim);
+    sim->signal = *signal;
+    sim->signal.samples = samples;
+    sim->samples = samples;
+    __atomic_store_n(&sim->active, true, __ATOMIC_RELEASE);
+    xSemaphoreGive(sim_lock);
+    return ESP_OK;
+}
+
+esp_err_t adc_sim_replay_file(adc_unit_t unit_id, adc_channel_t channel, const char *path, uint32_t sample_rate_hz)
+{
+    FILE *file = fopen(path, "rb");
+    if (file == NULL) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    size_t capacity = 1024;
+    size_t count = 0;
+    uint16_t *samples = malloc(capacity * sizeof(uint16_t));
+    uint8_t bytes[2];
+    while (samples != NULL && fread(bytes, 1, sizeof(bytes), file) == sizeof(bytes)) {
+        if (count == capacity) {
+            capacity *= 2;
+            uint16_t *grown = realloc(samples, capacity * sizeof(uint16_t));
+            if (grown == NULL) {
+                free(samples);
+                samples = NULL;
+                break;
+            }
+            samples = grown;
+        }
+        samples[count++] = (uint16_t) (bytes[0] | (bytes[1] << 8));
+    }
+    fclose(file);
+    if (samples == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    if (count == 0) {
+        free(samples);
+        return ESP_ERR_NOT_FOUND;
+    }
+    struct ADCSimSignal signal = {
+        .wave = ADC_SIM_REPLAY,
+        .samples = samples,
+        .count = count,
+        .sample_rate_hz = sample_rate_hz,
+    };
+    esp_err_t err = adc_sim_set_signal(unit_id, channel, &signal);
+    free(samples);
+    return err;
+}
+
+void adc_sim_clear(adc_unit_t unit_id, adc_channel_t channel)
+{
+    if (!valid_channel(unit_id, channel) || sim_lock == NULL) {
+        return;
+    }
+    xSemaphoreTake(sim_lock, portMAX_DELAY);
+    clear_locked(&channels[unit_id][channel]);
+    xSemaphoreGive(sim_lock);
+}
+
+static uint16_t clamp_raw(double value)
+{
+    return (uint16_t) (value < 0 ? 0 : value > 0xFFF ? 0xFFF : lround(value));
+}
+
+bool adc_sim_sample(adc_unit_t unit_id, adc_channel_t channel, double time_s, uint32_t n, uint16_t *value)
+{
+    // a channel only turns active once the lock exists
+    if (!valid_channel(unit_id, channel) || !__atomic_load_n(&channels[unit_id][channel].active, __ATOMIC_ACQUIRE)) {
+        return false;
+    }
+    xSemaphoreTake(sim_lock, portMAX_DELAY);
+    const struct SimChannel *sim = &channels[unit_id][channel];
+    const struct ADCSimSignal *signal = &sim->signal;
+    bool ret = sim->active;
+    if (ret) {
+        // the phase is taken modulo a cycle first, so long runs keep their precision
+        double cycles = time_s * signal->frequency_hz;
+        double phase = cycles - floor(cycles);
+        switch (signal->wave) {
+            case ADC_SIM_SINE:
+                *value = clamp_raw(signal->offset + signal->amplitude * sin(2 * M_PI * phase));
+                break;
+            case ADC_SIM_SQUARE:
+                *value = clamp_raw(phase < 0.5 ? signal->offset + signal->amplitude : signal->offset - signal->amplitude);
+                break;
+            case ADC_SIM_NOISE: {
+                // Knuth multiplicative hash of the conversion index, for repeatable noise
+                uint32_t hash = (n * 2654435761u) >> 8;
+                *value = clamp_raw((double) signal->offset + (double) (hash % (2u * signal->amplitude + 1)) - signal->amplitude);
+                break;
+            }
+            case ADC_SIM_REPLAY: {
+                // nudged, so conversions at the replay rate land on their own sample
+                uint64_t index = (uint64_t) (time_s * signal->sample_rate_hz + 1e-6);
+                *value = signal->samples[index % signal->count] & 0xFFF;
+                break;
+            }
+        }
+    }
+    xSemaphoreGive(sim_lock);
+    return ret;
+}
+
+// a channel without a signal is grounded
+static uint16_t sim_value(adc_unit_t unit_id, adc_channel_t channel, double time_s, uint32_t n)
+{
+    uint16_t value;
+    return adc_sim_sample(unit_id, channel, time_s, n, &value) ? value : 0;
+}
+
+/*---------------------------------------------------------------
+        Unit reads
+---------------------------------------------------------------*/
+struct SimUnit
+{
+    adc_unit_t unit_id;
+    adc_bitwidth_t bitwidth[SOC_ADC_MAX_CHANNEL_NUM];
+    uint32_t conversions[SOC_ADC_MAX_CHANNEL_NUM];
+};
+
+static esp_err_t sim_init(adc_unit_t unit_id, void **ctx)
+{
+    if ((unsigned) unit_id >= SOC_ADC_PERIPH_NUM) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    struct SimUnit *unit = calloc(1, sizeof(struct SimUnit));
+    if (unit == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    unit->unit_id = unit_id;
+    *ctx = unit;
+    return ESP_OK;
+}
+
+static esp_err_t sim_config(void *ctx, adc_channel_t channel, adc_bitwidth_t bitwidth, adc_atten_t atten)
+{
+    struct SimUnit *unit = (struct SimUnit *) ctx;
+    if (channel >= SOC_ADC_CHANNEL_NUM(unit->unit_id) || atten > ADC_ATTEN_DB_12) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    unit->bitwidth[channel] = bitwidth;
+    return ESP_OK;
+}
+
+// the signal is 12 bits wide; scale it to the width of the channel
+static uint16_t sim_scale(adc_bitwidth_t bitwidth, uint16_t value)
+{
+    int bits = bitwidth == ADC_BITWIDTH_DEFAULT ? SOC_ADC_RTC_MAX_BITWIDTH : (int) bitwidth;
+    return (uint16_t) (bits < 12 ? value >> (12 - bits) : value << (bits - 12));
+}
+
+static esp_err_t sim_read_batch(void *ctx, adc_channel_t channel, uint16_t *raw, size_t count)
+{
+    struct SimUnit *unit = (struct SimUnit *) ctx;
+    if (channel >= SOC_ADC_CHANNEL_NUM(unit->unit_id)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    for (size_t i = 0; i < count; ++i) {
+        uint16_t value = sim_value(unit->unit_id, channel, esp_timer_get_time() / 1e6, unit->conversions[channel]++);
+        raw[i] = sim_scale(unit->bitwidth[channel], value);
+    }
+    return ESP_OK;
+}
+
+static esp_err_t sim_read(void *ctx, adc_channel_t channel, int *raw)
+{
+    uint16_t value;
+    esp_err_t err = sim_read_batch(ctx, channel, &value, 1);
+    if (err == ESP_OK) {
+        *raw = value;
+    }
+    return err;
+}
+
+static esp_err_t sim_calibrate(void *ctx, adc_channel_t channel, adc_atten_t atten, adc_bitwidth_t bitwidth, uint16_t *mv, uint32_t max_raw)
+{
+    (void) ctx;
+    (void) channel;
+    (void) bitwidth;
+    if (atten > ADC_ATTEN_DB_12) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    for (uint32_t raw = 0; raw <= max_raw; ++raw) {
+        mv[raw] = (uint16_t) (raw * sim_range_mv[atten] / max_raw);
+    }
+    return ESP_OK;
+}
+
+static void sim_close(void *ctx)
+{
+    free(ctx);
+}
+
+/*---------------------------------------------------------------
+        Streams
+---------------------------------------------------------------*/
+
+//
+// A task walks the pattern at sample_freq_hz, as far as the clock has got
+// each tick, and packs the conversions into frames.  Each frame is announced
+// and then queued to the pool, or dropped with an overflow if the pool is
+// full, under the pool lock, so a reader sees the whole event or none of it.
+//
+struct SimStream
+{
+    adc_unit_t unit;
+    adc_channel_t channels[SOC_ADC_PATT_LEN_MAX];
+    size_t num_channels;
+    uint32_t sample_freq_hz;
+    struct ADCBackendStreamEvents events;
+    SemaphoreHandle_t lock;
+    SemaphoreHandle_t done;
+    volatile bool running;
+
+    uint8_t *pool;
+    uint32_t pool_size;
+    uint32_t pool_head;
+    uint32_t pool_count;
+    uint8_t *frame;
+    uint32_t frame_size;
+
+    int64_t start_us;
+    // conversions since start, which times them
+    uint64_t converted;
+    uint32_t conversions[SOC_ADC_MAX_CHANNEL_NUM];
+};
+
+static void sim_stream_fill(struct SimStream *stream)
+{
+    uint32_t records = stream->frame_size / SOC_ADC_DIGI_RESULT_BYTES;
+    for (uint32_t i = 0; i < records; ++i) {
+        adc_channel_t channel = stream->channels[stream->converted % stream->num_channels];
+        uint16_t value = sim_value(stream->unit, channel, (double) stream->converted / stream->sample_freq_hz, stream->conversions[channel]++);
+        adc_digi_output_data_t record;
+        memset(&record, 0, sizeof(record));
+        ADC_BACKEND_RECORD_SET(&record, stream->unit, channel, value);
+        memcpy(stream->frame + i * SOC_ADC_DIGI_RESULT_BYTES, &record, SOC_ADC_DIGI_RESULT_BYTES);
+        stream->converted++;
+    }
+}
+
+static void sim_stream_queue(struct SimStream *stream)
+{
+    xSemaphoreTake(stream->lock, portMAX_DELAY);
+    if (stream->events.frame_done != NULL) {
+        stream->events.frame_done(stream->events.arg);
+    }
+    if (stream->pool_count + stream->frame_size <= stream->pool_size) {
+        for (uint32_t i = 0; i < stream->frame_size; ++i) {
+            stream->pool[(stream->pool_head + stream->pool_count + i) % stream->pool_size] = stream->frame[i];
+        }
+        stream->pool_count += stream->frame_size;
+    } else if (stream->events.pool_overflow != NULL) {
+        stream->events.pool_overflow(stream->events.arg);
+    }
+    xSemaphoreGive(stream->lock);
+}
+
+static void sim_stream_task(void *arg)
+{
+    struct SimStream *stream = (struct SimStream *) arg;
+    uint32_t records = stream->frame_size / SOC_ADC_DIGI_RESULT_BYTES;
+
+    while (stream->running) {
+        vTaskDelay(1);
+        uint64_t due = (uint64_t) (esp_timer_get_time() - stream->start_us) * stream->sample_freq_hz / 1000000;
+        while (stream->running && stream->converted + records <= due) {
+            sim_stream_fill(stream);
+            sim_stream_queue(stream);
+        }
+    }
+
+    xSemaphoreGive(stream->done);
+    vTaskDelete(NULL);
+}
+
+static void sim_stream_close(void *ctx)
+{
+    struct SimStream *stream = (struct SimStream *) ctx;
+    if (stream->lock != NULL) {
+        vSemaphoreDelete(stream->lock);
+    }
+    if (stream->done != NULL) {
+        vSemaphoreDelete(stream->done);
+    }
+    free(stream->pool);
+    free(stream->frame);
+    free(stream);
+}
+
+static esp_err_t sim_stream_open(const struct ADCBackendStreamConfig *config, const struct ADCBackendStreamEvents *events, void **ctx)
+{
+    if ((unsigned) config->unit >= SOC_ADC_PERIPH_NUM || config->num_channels == 0 || config->num_channels > SOC_ADC_PATT_LEN_MAX
+        || config->sample_freq_hz == 0 || config->frame_size == 0 || config->frame_size % SOC_ADC_DIGI_RESULT_BYTES != 0
+        || config->pool_size < config->frame_size) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    for (size_t i = 0; i < config->num_channels; ++i) {
+        if (config->channels[i] >= SOC_ADC_CHANNEL_NUM(config->unit)) {
+            return ESP_ERR_INVALID_ARG;
+        }
+    }
+    struct SimStream *stream = calloc(1, sizeof(struct SimStream));
+    if (stream == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    stream->unit = config->unit;
+    memcpy(stream->channels, config->channels, config->num_channels * sizeof(adc_channel_t));
+    stream->num_channels = config->num_channels;
+    stream->sample_freq_hz = config->sample_freq_hz;
+    if (events != NULL) {
+        stream->events = *events;
+    }
+    stream->pool_size = config->pool_size;
+    stream->frame_size = config->frame_size;
+    stream->pool = malloc(config->pool_size);
+    stream->frame = malloc(config->frame_size);
+    stream->lock = xSemaphoreCreateMutex();
+    stream->done = xSemaphoreCreateBinary();
+    if (stream->pool == NULL || stream->frame == NULL || stream->lock == NULL || stream->done == NULL) {
+        sim_stream_close(stream);
+        return ESP_ERR_NO_MEM;
+    }
+    *ctx = stream;
+    return ESP_OK;
+}
+
+static esp_err_t sim_stream_start(void *ctx)
+{
+    struct SimStream *stream = (struct SimStream *) ctx;
+    if (stream->running) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    stream->start_us = esp_timer_get_time();
+    stream->running = true;
+    if (xTaskCreate(sim_stream_task, "adc_sim", ADC_SIM_TASK_STACK_SIZE, stream, ADC_SIM_TASK_PRIORITY, NULL) != pdPASS) {
+        stream->running = false;
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+static esp_err_t sim_stream_read(void *ctx, uint8_t *buf, uint32_t size, uint32_t *out_size)
+{
+    struct SimStream *stream = (struct SimStream *) ctx;
+    xSemaphoreTake(stream->lock, portMAX_DELAY);
+    uint32_t n = stream->pool_count < size ? stream->pool_count : size;
+    n -= n % SOC_ADC_DIGI_RESULT_BYTES;
+    for (uint32_t i = 0; i < n; ++i) {
+        buf[i] = stream->pool[(stream->pool_head + i) % stream->pool_size];
+    }
+    stream->pool_head = (stream->pool_head + n) % stream->pool_size;
+    stream->pool_count -= n;
+    xSemaphoreGive(stream->lock);
+
+    *out_size = n;
+    return n > 0 ? ESP_OK : ESP_ERR_TIMEOUT;
+}
+
+static esp_err_t sim_stream_stop(void *ctx)
+{
+    struct SimStream *stream = (struct SimStream *) ctx;
+    if (!stream->running) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    stream->running = false;
+    xSemaphoreTake(stream->done, portMAX_DELAY);
+    return ESP_OK;
+}
+
+const struct ADCBackend adc_backend_sim = {
+    .name = "simulator",
+    .init = sim_init,
+    .config = sim_config,
+    .read = sim_read,
+    .read_batch = sim_read_batch,
+    .calibrate = sim_calibrate,
+    .close = sim_close,
+    .stream_open = sim_stream_open,
+    .stream_start = sim_stream_start,
+    .stream_read = sim_stream_read,
+    .stream_stop = sim_stream_stop,
+    .stream_close = sim_stream_close,
+};
@@ -0,0 +1,98 @@
+//
+// Copyright (c) 2024 Jose Rodriguez
+// All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+//
+// Simulated analog signals, and the backend that converts them.  A channel
+// given a signal here reads it on every unit opened with adc_backend_sim; one
+// without reads as grounded.  Unit reads sample the signal at the time of
+// the read (esp_timer_get_time), and stream conversions at the instant the
+// sample clock puts them, conversion k of a stream falling at
+// k / sample_freq_hz seconds after it started, so streamed waveforms have
+// exact rates.  The simulator is portable, so it runs on a device as well as
+// on the host, where the driver stand-ins take their input from it too.
+//
+
+#ifndef __ADC_SIM_H__
+#define __ADC_SIM_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+#include "hal/adc_types.h"
+
+#include "adc_backend.h"
+
+enum ADCSimWave
+{
+    ADC_SIM_SINE,
+    ADC_SIM_SQUARE,
+    // uniform, repeatable noise
+    ADC_SIM_NOISE,
+    // recorded samples, played back in a loop
+    ADC_SIM_REPLAY
+};
+
+struct ADCSimSignal
+{
+    enum ADCSimWave wave;
+    // raw level the wave is centred on, and its peak deviation from it;
+    // values are clamped to 12 bits
+    uint16_t offset;
+    uint16_t amplitude;
+    // cycles per second of a sine or square
+    double frequency_hz;
+    // replayed raw values, copied by adc_sim_set_signal, and their rate
+    const uint16_t *samples;
+    size_t count;
+    uint32_t sample_rate_hz;
+};
+
+/**
+ * @brief   Create the simulator lock.  Called once, at nif collection init.
+ */
+esp_err_t adc_sim_init(void);
+
+/**
+ * @brief   Drive a channel with a simulated signal.
+ * @return  ESP_ERR_INVALID_ARG for an unknown channel or wave, or a replay
+ *          without samples or rate, ESP_ERR_NO_MEM if they cannot be copied.
+ */
+esp_err_t adc_sim_set_signal(adc_unit_t unit_id, adc_channel_t channel, const struct ADCSimSignal *signal);
+
+/**
+ * @brief   Replay a file of little-endian uint16 raw values, as returned by
+ *          a capture read, at sample_rate_hz.
+ * @return  ESP_ERR_NOT_FOUND if the file cannot be read or holds no values,
+ *          otherwise as adc_sim_set_signal.
+ */
+esp_err_t adc_sim_replay_file(adc_unit_t unit_id, adc_channel_t channel, const char *path, uint32_t sample_rate_hz);
+
+/**
+ * @brief   Take the signal off a channel.
+ */
+void adc_sim_clear(adc_unit_t unit_id, adc_channel_t channel);
+
+/**
+ * @brief   The 12-bit value of a channel's signal time_s seconds in, n being
+ *          the index of the conversion (which seeds the noise).
+ * @return  false if the channel has no simulated signal.
+ */
+bool adc_sim_sample(adc_unit_t unit_id, adc_channel_t channel, double time_s, uint32_t n, uint16_t *value);
+
+#endif
@@ -0,0 +1,76 @@
+//
+// Copyright (c) 2024 Jose Rodriguez
+// All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "adc_stats.h"
+
+#include <math.h>
+#include <string.h>
+
+void adc_stats_init(struct ADCStats *stats, uint16_t *histogram, size_t histogram_size)
+{
+    memset(stats, 0, sizeof(struct ADCStats));
+    if (histogram != NULL) {
+        memset(histogram, 0, histogram_size * sizeof(uint16_t));
+        stats->histogram = histogram;
+        stats->histogram_size = histogram_size;
+    }
+}
+
+double adc_stats_mean(const struct ADCStats *stats)
+{
+    return stats->count > 0 ? (double) stats->sum / stats->count : 0.0;
+}
+
+double adc_stats_stddev(const struct ADCStats *stats)
+{
+    if (stats->count == 0) {
+        return 0.0;
+    }
+    double mean = adc_stats_mean(stats);
+    double variance = (double) stats->sum_sq / stats->count - mean * mean;
+    // rounding can leave a tiny negative variance for constant input
+    return variance > 0.0 ? sqrt(variance) : 0.0;
+}
+
+uint16_t adc_stats_percentile(const struct ADCStats *stats, uint32_t percent)
+{
+    if (stats->count == 0 || stats->histogram == NULL) {
+        return 0;
+    }
+    // rank = ceil(percent * count / 100), at least 1
+    uint64_t rank = ((uint64_t) percent * stats->count + 99) / 100;
+    if (rank == 0) {
+        rank = 1;
+    }
+    uint64_t seen = 0;
+    for (size_t value = stats->min; value <= stats->max && value < stats->histogram_size; ++value) {
+        seen += stats->histogram[value];
+        if (seen >= rank) {
+            return (uint16_t) value;
+        }
+    }
+    return stats->max;
+}
+
+void adc_stats_finish(struct ADCStats *stats)
+{
+    if (stats->histogram != NULL) {
+        stats->median = adc_stats_percentile(stats, 50);
+        stats->p95 = adc_stats_percentile(stats, 95);
+        stats->histogram = NULL;
+    }
+}
@@ -0,0 +1,94 @@
+//
+// Copyright (c) 2024 Jose Rodriguez
+// All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef __ADC_STATS_H__
+#define __ADC_STATS_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+enum ADCStat
+{
+    ADC_STAT_MIN,
+    ADC_STAT_MAX,
+    ADC_STAT_MEAN,
+    ADC_STAT_STDDEV,
+    ADC_STAT_MEDIAN,
+    ADC_STAT_P95,
+    ADC_STAT_COUNT
+};
+
+//
+// Single pass accumulator.  Order statistics (median, percentiles) are read
+// off a counting histogram, indexed by sample value, instead of sorting.
+//
+struct ADCStats
+{
+    uint32_t count;
+    uint16_t min;
+    uint16_t max;
+    uint64_t sum;
+    uint64_t sum_sq;
+    // filled in by adc_stats_finish, if there is a histogram
+    uint16_t median;
+    uint16_t p95;
+    uint16_t *histogram;
+    size_t histogram_size;
+};
+
+/**
+ * @brief   Reset stats.  histogram may be NULL if no order statistics are needed;
+ *          otherwise it is cleared, and must have a bin for every sample value.
+ */
+void adc_stats_init(struct ADCStats *stats, uint16_t *histogram, size_t histogram_size);
+
+static inline void adc_stats_add(struct ADCStats *stats, uint16_t value)
+{
+    if (stats->count == 0 || value < stats->min) {
+        stats->min = value;
+    }
+    if (stats->count == 0 || value > stats->max) {
+        stats->max = value;
+    }
+    stats->count++;
+    stats->sum += value;
+    stats->sum_sq += (uint32_t) value * value;
+    if (stats->histogram != NULL) {
+        stats->histogram[value < stats->histogram_size ? value : stats->histogram_size - 1]++;
+    }
+}
+
+/**
+ * @brief   Read the order statistics off the histogram, then detach it.
+ */
+void adc_stats_finish(struct ADCStats *stats);
+
+double adc_stats_mean(const struct ADCStats *stats);
+
+/**
+ * @brief   Population standard deviation.
+ */
+double adc_stats_stddev(const struct ADCStats *stats);
+
+/**
+ * @brief   Nearest-rank percentile, e.g. 50 for the (lower) median.
+ * @details Requires a histogram.
+ */
+uint16_t adc_stats_percentile(const struct ADCStats *stats, uint32_t percent);
+
+#endif
@@ -0,0 +1,488 @@
+//
+// Copyright (c) 2024 Jose Rodriguez
+// All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+// References
+// https://docs.espressif.com/projects/esp-idf/en/v5.1/esp32/api-reference/peripherals/adc_continuous.html
+//
+
+#include "adc_stream.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "esp_attr.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/task.h"
+#include "sdkconfig.h"
+
+#define TAG "adc_stream"
+
+#define ADC_STREAM_TASK_STACK_SIZE 3072
+#define ADC_STREAM_TASK_PRIORITY 5
+
+size_t adc_stream_parse_frame(adc_unit_t unit, const uint8_t *frame, size_t size, uint16_t *out, uint32_t *positions)
+{
+    size_t count = 0;
+    for (size_t i = 0; i + SOC_ADC_DIGI_RESULT_BYTES <= size; i += SOC_ADC_DIGI_RESULT_BYTES) {
+        adc_digi_output_data_t record;
+        memcpy(&record, frame + i, SOC_ADC_DIGI_RESULT_BYTES);
+        uint32_t channel = ADC_BACKEND_RECORD_CHANNEL(&record);
+        // the driver may hand back records for channels outside of the unit; drop them
+        if (channel < SOC_ADC_CHANNEL_NUM(unit)) {
+            if (positions != NULL) {
+                positions[count] = i / SOC_ADC_DIGI_RESULT_BYTES;
+            }
+            out[count++] = ADC_STREAM_SAMPLE(channel, ADC_BACKEND_RECORD_DATA(&record));
+        }
+    }
+    return count;
+}
+
+esp_err_t adc_stream_demux_init(struct ADCStreamDemux *demux, const adc_channel_t *channels, size_t num_channels, size_t capacity)
+{
+    memset(demux, 0, sizeof(struct ADCStreamDemux));
+    memset(demux->lane_of, ADC_STREAM_NO_LANE, sizeof(demux->lane_of));
+    if (num_channels == 0 || num_channels > SOC_ADC_PATT_LEN_MAX || capacity == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    for (size_t l = 0; l < num_channels; ++l) {
+        if (channels[l] >= SOC_ADC_MAX_CHANNEL_NUM || demux->lane_of[channels[l]] != ADC_STREAM_NO_LANE) {
+            return ESP_ERR_INVALID_ARG;
+        }
+        demux->lane_of[channels[l]] = (uint8_t) l;
+    }
+    // one block for all the lanes
+    uint16_t *storage = malloc(num_channels * capacity * sizeof(uint16_t));
+    if (storage == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    for (size_t l = 0; l < num_channels; ++l) {
+        demux->lanes[l] = storage + l * capacity;
+    }
+    demux->num_lanes = num_channels;
+    demux->capacity = capacity;
+    return ESP_OK;
+}
+
+void adc_stream_demux_free(struct ADCStreamDemux *demux)
+{
+    free(demux->lanes[0]);
+    memset(demux->lanes, 0, sizeof(demux->lanes));
+    demux->num_lanes = 0;
+}
+
+void adc_stream_demux_push(struct ADCStreamDemux *demux, const uint16_t *samples, size_t count)
+{
+    for (size_t i = 0; i < count; ++i) {
+        uint8_t lane = demux->lane_of[ADC_STREAM_SAMPLE_CHANNEL(samples[i])];
+        if (lane != demux->next_lane || demux->counts[lane] == demux->capacity) {
+            demux->out_of_order++;
+            // drop the round so far, so the lanes stay in step
+            for (uint8_t l = 0; l < demux->next_lane; ++l) {
+                demux->counts[l]--;
+            }
+            demux->next_lane = 0;
+            if (lane != 0 || demux->counts[0] == demux->capacity) {
+                continue;
+            }
+        }
+        demux->lanes[lane][demux->counts[lane]++] = ADC_STREAM_SAMPLE_DATA(samples[i]);
+        demux->next_lane = (uint8_t) ((lane + 1) % demux->num_lanes);
+    }
+}
+
+size_t adc_stream_demux_rounds(const struct ADCStreamDemux *demux)
+{
+    // lanes before next_lane hold one more, for the incomplete round
+    return demux->counts[demux->num_lanes - 1];
+}
+
+void adc_stream_demux_consume(struct ADCStreamDemux *demux)
+{
+    size_t rounds = adc_stream_demux_rounds(demux);
+    for (size_t l = 0; l < demux->num_lanes; ++l) {
+        if (l < demux->next_lane) {
+            demux->lanes[l][0] = demux->lanes[l][rounds];
+            demux->counts[l] = 1;
+        } else {
+            demux->counts[l] = 0;
+        }
+    }
+}
+
+//
+// The backend announces a frame just before it queues it to the pool, and
+// reports an overflow right after if the pool had no room, in which case the
+// frame is dropped and so is its stamp.
+//
+static bool IRAM_ATTR adc_stream_conv_done(void *arg)
+{
+    struct ADCStream *stream = (struct ADCStream *) arg;
+
+    if (stream->stamps != NULL) {
+        uint32_t head = __atomic_load_n(&stream->stamp_head, __ATOMIC_RELAXED);
+        stream->stamps[head & (stream->num_stamps - 1)] = esp_timer_get_time();
+        __atomic_store_n(&stream->stamp_head, head + 1, __ATOMIC_RELEASE);
+    }
+
+    BaseType_t must_yield = pdFALSE;
+    xSemaphoreGiveFromISR(stream->ready, &must_yield);
+    return must_yield == pdTRUE;
+}
+
+static bool IRAM_ATTR adc_stream_pool_ovf(void *arg)
+{
+    struct ADCStream *stream = (struct ADCStream *) arg;
+
+    __atomic_add_fetch(&stream->overflows, 1, __ATOMIC_RELAXED);
+    if (stream->stamps != NULL) {
+        __atomic_sub_fetch(&stream->stamp_head, 1, __ATOMIC_RELEASE);
+    }
+    return false;
+}
+
+// run each sample through the filter of its channel, compacting in place
+static size_t adc_stream_filter(struct ADCStream *stream, uint16_t *samples, uint32_t *positions, size_t count)
+{
+    size_t n = 0;
+    for (size_t i = 0; i < count; ++i) {
+        uint16_t sample = samples[i];
+        uint32_t channel = ADC_STREAM_SAMPLE_CHANNEL(sample);
+        struct ADCFilterChain *filter = stream->filters[channel];
+        uint16_t value = ADC_STREAM_SAMPLE_DATA(sample);
+        if (filter != NULL) {
+            if (!adc_filter_push(filter, value, &value)) {
+                continue;
+            }
+            value = value > 0xFFF ? 0xFFF : value;
+        }
+        if (positions != NULL) {
+            positions[n] = positions[i];
+        }
+        samples[n++] = ADC_STREAM_SAMPLE(channel, value);
+    }
+    return n;
+}
+
+//
+// Time the samples just read.  A record finished (frame_records - 1 - index)
+// conversion periods before the end of its frame, which the interrupt stamped;
+// a frame too old to still have its stamp falls back to the current time.
+// Times never go back, across frames as well.
+//
+static void adc_stream_timestamp(struct ADCStream *stream, uint64_t bytes_read, const uint32_t *positions, size_t count, struct ADCTimestamps *timestamps)
+{
+    uint32_t frame_records = stream->frame_size / SOC_ADC_DIGI_RESULT_BYTES;
+    uint64_t first_record = bytes_read / SOC_ADC_DIGI_RESULT_BYTES;
+    uint32_t head = __atomic_load_n(&stream->stamp_head, __ATOMIC_ACQUIRE);
+    int64_t now = esp_timer_get_time();
+
+    adc_codec_timestamps_init(timestamps, stream->deltas);
+    for (size_t i = 0; i < count; ++i) {
+        uint64_t record = first_record + positions[i];
+        uint32_t frame = (uint32_t) (record / frame_records);
+        uint32_t before_end = frame_records - 1 - (uint32_t) (record % frame_records);
+        uint32_t age = head - frame;
+        int64_t time_us = now;
+        if (age >= 1 && age < stream->num_stamps) {
+            time_us = stream->stamps[frame & (stream->num_stamps - 1)]
+                - (int64_t) (((uint64_t) before_end * 1000000 + stream->sample_freq_hz / 2) / stream->sample_freq_hz);
+        }
+        // interrupt latency varies, so frames may overlap by a little
+        if (time_us < stream->last_us) {
+            time_us = stream->last_us;
+        }
+        stream->last_us = time_us;
+        adc_codec_timestamps_push(timestamps, time_us);
+    }
+}
+
+//
+// Demultiplex the samples just read and hand the complete rounds, filtered
+// lane by lane, to the lanes callback.
+//
+static void adc_stream_send_lanes(struct ADCStream *stream, size_t count)
+{
+    struct ADCStreamDemux *demux = &stream->demux;
+    adc_stream_demux_push(demux, stream->samples, count);
+    size_t rounds = adc_stream_demux_rounds(demux);
+    if (rounds == 0 && demux->out_of_order == 0) {
+        return;
+    }
+    struct ADCStreamLanes lanes = {
+        .num_lanes = demux->num_lanes,
+        .out_of_order = demux->out_of_order,
+    };
+    for (size_t l = 0; l < demux->num_lanes; ++l) {
+        uint16_t *lane = demux->lanes[l];
+        struct ADCFilterChain *filter = stream->filters[stream->channels[l]];
+        size_t n = rounds;
+        if (filter != NULL) {
+            // compacting in place leaves the incomplete round, past rounds, alone
+            n = 0;
+            for (size_t i = 0; i < rounds; ++i) {
+                uint16_t value;
+                if (adc_filter_push(filter, lane[i], &value)) {
+                    lane[n++] = value > 0xFFF ? 0xFFF : value;
+                }
+            }
+        }
+        lanes.samples[l] = lane;
+        lanes.counts[l] = n;
+    }
+    demux->out_of_order = 0;
+    stream->lanes_cb(stream->frame_cb_arg, &lanes);
+    adc_stream_demux_consume(demux);
+}
+
+//
+// Hand on the raw driver output read at bytes_read into the stream.
+//
+static void adc_stream_deliver(struct ADCStream *stream, const uint8_t *frame, size_t size, uint64_t bytes_read)
+{
+    size_t count = adc_stream_parse_frame(stream->unit, frame, size, stream->samples, stream->positions);
+    if (stream->lanes_cb != NULL) {
+        adc_stream_send_lanes(stream, count);
+        return;
+    }
+    if (stream->filtered) {
+        count = adc_stream_filter(stream, stream->samples, stream->positions, count);
+    }
+    struct ADCTimestamps timestamps;
+    if (stream->stamps != NULL) {
+        adc_stream_timestamp(stream, bytes_read, stream->positions, count, &timestamps);
+    }
+    if (count > 0) {
+        stream->frame_cb(stream->frame_cb_arg, stream->samples, count, stream->stamps != NULL ? &timestamps : NULL);
+    }
+}
+
+// send what was held back for want of credit, for as long as credit lasts
+static void adc_stream_release(struct ADCStream *stream)
+{
+    const void *frame;
+    size_t size;
+    uint64_t bytes_read;
+    while (adc_credit_release(&stream->credit, &frame, &size, &bytes_read)) {
+        adc_stream_deliver(stream, (const uint8_t *) frame, size, bytes_read);
+    }
+}
+
+static void adc_stream_task(void *arg)
+{
+    struct ADCStream *stream = (struct ADCStream *) arg;
+
+    while (stream->running) {
+        xSemaphoreTake(stream->ready, portMAX_DELAY);
+        // drain every frame that is ready, a single notification may cover several
+        while (stream->running) {
+            // grants wake the task too
+            adc_stream_release(stream);
+            uint32_t size = 0;
+            esp_err_t err = stream->backend->stream_read(stream->handle, stream->frame, stream->frame_size, &size);
+            if (err != ESP_OK) {
+                break;
+            }
+            uint64_t bytes_read = stream->bytes_read;
+            stream->bytes_read += size;
+            if (adc_credit_admit(&stream->credit)) {
+                adc_stream_deliver(stream, stream->frame, size, bytes_read);
+            } else {
+                adc_credit_hold(&stream->credit, stream->frame, size, bytes_read);
+            }
+        }
+    }
+
+    xSemaphoreGive(stream->done);
+    vTaskDelete(NULL);
+}
+
+static void adc_stream_free(struct ADCStream *stream)
+{
+    if (stream->handle != NULL) {
+        stream->backend->stream_close(stream->handle);
+        stream->handle = NULL;
+    }
+    if (stream->ready != NULL) {
+        vSemaphoreDelete(stream->ready);
+        stream->ready = NULL;
+    }
+    if (stream->done != NULL) {
+        vSemaphoreDelete(stream->done);
+        stream->done = NULL;
+    }
+    free(stream->frame);
+    stream->frame = NULL;
+    free(stream->samples);
+    stream->samples = NULL;
+    free(stream->stamps);
+    stream->stamps = NULL;
+    free(stream->positions);
+    stream->positions = NULL;
+    free(stream->deltas);
+    stream->deltas = NULL;
+    adc_stream_demux_free(&stream->demux);
+    adc_credit_free(&stream->credit);
+    for (size_t i = 0; i < SOC_ADC_MAX_CHANNEL_NUM; ++i) {
+        free(stream->filters[i]);
+        stream->filters[i] = NULL;
+    }
+}
+
+esp_err_t adc_stream_start(struct ADCStream *stream, const struct ADCStreamConfig *config, adc_stream_frame_cb_t frame_cb, void *frame_cb_arg)
+{
+    memset(stream, 0, sizeof(struct ADCStream));
+    for (size_t i = 0; i < SOC_ADC_MAX_CHANNEL_NUM; ++i) {
+        stream->filters[i] = config->filters[i];
+        stream->filtered |= config->filters[i] != NULL;
+    }
+    if (config->num_channels == 0 || config->num_channels > SOC_ADC_PATT_LEN_MAX
+        || config->frame_size == 0 || config->frame_size % SOC_ADC_DIGI_RESULT_BYTES != 0
+        || config->pool_size < config->frame_size
+        || (config->lanes_cb != NULL && config->timestamps)) {
+        adc_stream_free(stream);
+        return ESP_ERR_INVALID_ARG;
+    }
+    for (size_t i = 0; i < config->num_channels; ++i) {
+        if (config->channels[i] >= SOC_ADC_CHANNEL_NUM(config->unit)) {
+            adc_stream_free(stream);
+            return ESP_ERR_INVALID_ARG;
+        }
+    }
+
+    stream->backend = config->backend != NULL ? config->backend : &adc_backend_continuous;
+    if (stream->backend->stream_open == NULL) {
+        adc_stream_free(stream);
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    stream->unit = config->unit;
+    stream->frame_size = config->frame_size;
+    stream->frame_cb = frame_cb;
+    stream->frame_cb_arg = frame_cb_arg;
+    stream->sample_freq_hz = config->sample_freq_hz;
+    stream->lanes_cb = config->lanes_cb;
+    memcpy(stream->channels, config->channels, sizeof(stream->channels));
+
+    size_t frame_records = config->frame_size / SOC_ADC_DIGI_RESULT_BYTES;
+    stream->frame = malloc(config->frame_size);
+    stream->samples = malloc(frame_records * sizeof(uint16_t));
+    stream->ready = xSemaphoreCreateBinary();
+    stream->done = xSemaphoreCreateBinary();
+    if (stream->frame == NULL || stream->samples == NULL || stream->ready == NULL || stream->done == NULL) {
+        adc_stream_free(stream);
+        return ESP_ERR_NO_MEM;
+    }
+    if (config->lanes_cb != NULL) {
+        esp_err_t err = adc_stream_demux_init(&stream->demux, config->channels, config->num_channels, frame_records / config->num_channels + 2);
+        if (err != ESP_OK) {
+            adc_stream_free(stream);
+            return err;
+        }
+    }
+    if (config->credit != NULL) {
+        esp_err_t err = adc_credit_init(&stream->credit, config->credit, config->frame_size);
+        if (err != ESP_OK) {
+            adc_stream_free(stream);
+            return err;
+        }
+    }
+    if (config->timestamps) {
+        // a stamp must outlive every frame still in the pool, the one being
+        // read, the one the interrupt is adding and any held back
+        uint32_t needed = (config->pool_size + config->frame_size - 1) / config->frame_size + 2 + stream->credit.max_held;
+        stream->num_stamps = 1;
+        while (stream->num_stamps < needed) {
+            stream->num_stamps <<= 1;
+        }
+        stream->stamps = malloc(stream->num_stamps * sizeof(int64_t));
+        stream->positions = malloc(frame_records * sizeof(uint32_t));
+        stream->deltas = malloc(frame_records * ADC_CODEC_VARINT_MAX);
+        if (stream->stamps == NULL || stream->positions == NULL || stream->deltas == NULL) {
+            adc_stream_free(stream);
+            return ESP_ERR_NO_MEM;
+        }
+    }
+
+    struct ADCBackendStreamConfig stream_config = {
+        .unit = config->unit,
+        .atten = config->atten,
+        .channels = config->channels,
+        .num_channels = config->num_channels,
+        .sample_freq_hz = config->sample_freq_hz,
+        .frame_size = config->frame_size,
+        .pool_size = config->pool_size,
+    };
+    struct ADCBackendStreamEvents events = {
+        .frame_done = adc_stream_conv_done,
+        .pool_overflow = adc_stream_pool_ovf,
+        .arg = stream,
+    };
+    esp_err_t err = stream->backend->stream_open(&stream_config, &events, &stream->handle);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to open %s stream.  err=%i", stream->backend->name, err);
+        stream->handle = NULL;
+        adc_stream_free(stream);
+        return err;
+    }
+
+    stream->running = true;
+    if (xTaskCreate(adc_stream_task, "adc_stream", ADC_STREAM_TASK_STACK_SIZE, stream, ADC_STREAM_TASK_PRIORITY, NULL) != pdPASS) {
+        stream->running = false;
+        adc_stream_free(stream);
+        return ESP_ERR_NO_MEM;
+    }
+
+    err = stream->backend->stream_start(stream->handle);
+    if (err != ESP_OK) {
+        stream->running = false;
+        xSemaphoreGive(stream->ready);
+        xSemaphoreTake(stream->done, portMAX_DELAY);
+        adc_stream_free(stream);
+        return err;
+    }
+
+    return ESP_OK;
+}
+
+bool adc_stream_grant(struct ADCStream *stream, uint32_t credits)
+{
+    if (!stream->running || !stream->credit.limited) {
+        return false;
+    }
+    if (adc_credit_grant(&stream->credit, credits)) {
+        xSemaphoreGive(stream->ready);
+    }
+    return true;
+}
+
+uint32_t adc_stream_dropped(const struct ADCStream *stream)
+{
+    return adc_credit_dropped(&stream->credit);
+}
+
+void adc_stream_stop(struct ADCStream *stream)
+{
+    if (!stream->running) {
+        return;
+    }
+    stream->running = false;
+    stream->backend->stream_stop(stream->handle);
+    xSemaphoreGive(stream->ready);
+    xSemaphoreTake(stream->done, portMAX_DELAY);
+    adc_stream_free(stream);
+}
@@ -0,0 +1,217 @@
+//
+// Copyright (c) 2024 Jose Rodriguez
+// All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef __ADC_STREAM_H__
+#define __ADC_STREAM_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "soc/soc_caps.h"
+
+#include "adc_backend.h"
+#include "adc_codec.h"
+#include "adc_credit.h"
+#include "adc_filter.h"
+
+//
+// Samples handed to the frame callback are packed as 16-bit words, with the
+// channel in the top nibble and the conversion result in the low 12 bits.
+//
+#define ADC_STREAM_SAMPLE(channel, data) ((uint16_t) (((channel) << 12) | ((data) & 0xFFF)))
+#define ADC_STREAM_SAMPLE_CHANNEL(sample) ((sample) >> 12)
+#define ADC_STREAM_SAMPLE_DATA(sample) ((sample) & 0xFFF)
+
+#define ADC_STREAM_DEFAULT_SAMPLE_FREQ_HZ 20000
+#define ADC_STREAM_DEFAULT_FRAME_SIZE 256
+#define ADC_STREAM_DEFAULT_POOL_SIZE 1024
+
+typedef void (*adc_stream_frame_cb_t)(void *arg, const uint16_t *samples, size_t count, const struct ADCTimestamps *timestamps);
+
+#define ADC_STREAM_NO_LANE 0xFF
+
+//
+// Splits interleaved stream samples into one lane per pattern slot.  Only
+// records in pattern order are kept: one that breaks the order is counted,
+// the round it interrupts is dropped, and records are skipped until the next
+// round starts.  So lanes never get out of step, and every lane holds the
+// same number of samples once the last (incomplete) round is left out.
+//
+struct ADCStreamDemux
+{
+    size_t num_lanes;
+    // lane of each channel, or ADC_STREAM_NO_LANE
+    uint8_t lane_of[SOC_ADC_MAX_CHANNEL_NUM];
+    // lane the next record belongs to
+    uint8_t next_lane;
+    // lane l holds counts[l] raw values from lanes[l]; capacity each
+    uint16_t *lanes[SOC_ADC_PATT_LEN_MAX];
+    size_t counts[SOC_ADC_PATT_LEN_MAX];
+    size_t capacity;
+    // records out of pattern order since the count was last cleared
+    uint32_t out_of_order;
+};
+
+//
+// The lanes of a demultiplexed stream, one per pin in pattern order.  Lanes
+// hold the same number of values unless their filters decimate differently.
+//
+struct ADCStreamLanes
+{
+    size_t num_lanes;
+    const uint16_t *samples[SOC_ADC_PATT_LEN_MAX];
+    size_t counts[SOC_ADC_PATT_LEN_MAX];
+    // records dropped for breaking the pattern order since the last call
+    uint32_t out_of_order;
+};
+
+typedef void (*adc_stream_lanes_cb_t)(void *arg, const struct ADCStreamLanes *lanes);
+
+struct ADCStreamConfig
+{
+    // a backend with streams, or NULL for the continuous driver
+    const struct ADCBackend *backend;
+    adc_unit_t unit;
+    adc_atten_t atten;
+    adc_channel_t channels[SOC_ADC_PATT_LEN_MAX];
+    size_t num_channels;
+    uint32_t sample_freq_hz;
+    uint32_t frame_size;
+    uint32_t pool_size;
+    // time each sample, for the frame callback
+    bool timestamps;
+    // if set, samples are demultiplexed by channel and handed to this
+    // callback rather than to the frame callback; needs distinct channels
+    // and no timestamps
+    adc_stream_lanes_cb_t lanes_cb;
+    // if set, a frame is only handed on while the subscriber has credit (see
+    // adc_stream_grant); frames are held back as raw driver output
+    const struct ADCCreditConfig *credit;
+    // optional per channel filters, indexed by channel; ownership passes to the stream
+    struct ADCFilterChain *filters[SOC_ADC_MAX_CHANNEL_NUM];
+};
+
+struct ADCStream
+{
+    const struct ADCBackend *backend;
+    // the backend stream
+    void *handle;
+    adc_unit_t unit;
+    SemaphoreHandle_t ready;
+    SemaphoreHandle_t done;
+    volatile bool running;
+    uint32_t frame_size;
+    uint8_t *frame;
+    uint16_t *samples;
+    adc_stream_frame_cb_t frame_cb;
+    void *frame_cb_arg;
+    struct ADCFilterChain *filters[SOC_ADC_MAX_CHANNEL_NUM];
+    bool filtered;
+    // bumped by the pool overflow interrupt; access with __atomic builtins
+    uint32_t overflows;
+    uint32_t sample_freq_hz;
+    // when timestamping: the time each frame completed, indexed by frame
+    // number modulo num_stamps (a power of two), written by the DMA interrupt
+    int64_t *stamps;
+    uint32_t num_stamps;
+    // frames stamped so far; accessed atomically
+    uint32_t stamp_head;
+    // bytes taken from the pool so far, which locate a record in its frame
+    uint64_t bytes_read;
+    // time of the last sample handed to the frame callback
+    int64_t last_us;
+    // record index of each sample within the bytes last read
+    uint32_t *positions;
+    uint8_t *deltas;
+    // with a lanes callback
+    adc_stream_lanes_cb_t lanes_cb;
+    struct ADCStreamDemux demux;
+    adc_channel_t channels[SOC_ADC_PATT_LEN_MAX];
+    // frames are tagged with bytes_read when held back
+    struct ADCCredit credit;
+};
+
+/**
+ * @brief   Configure a stream of the backend and start delivering frames.
+ * @details The frame callback is invoked from the stream task (never from the
+ *          DMA interrupt) with the samples of each conversion frame, after any
+ *          channel filters have run, and their conversion times if
+ *          config->timestamps is set (NULL otherwise).  The stream owns the
+ *          filters in config from this call on, whether or not it succeeds.
+ * @return  ESP_ERR_NOT_SUPPORTED if the backend has no streams.
+ */
+esp_err_t adc_stream_start(struct ADCStream *stream, const struct ADCStreamConfig *config, adc_stream_frame_cb_t frame_cb, void *frame_cb_arg);
+
+/**
+ * @brief   Stop the stream, wait for the stream task to exit and release the backend stream.
+ * @details Once this returns the frame callback is no longer called.
+ */
+void adc_stream_stop(struct ADCStream *stream);
+
+/**
+ * @brief   Grant the subscriber of a stream started with credit more credits,
+ *          and have the stream task send what it held back for want of them.
+ * @return  false if the stream has no flow control.
+ */
+bool adc_stream_grant(struct ADCStream *stream, uint32_t credits);
+
+/**
+ * @brief   The number of frames dropped for want of subscriber credit.
+ */
+uint32_t adc_stream_dropped(const struct ADCStream *stream);
+
+/**
+ * @brief   Decode raw continuous driver output into packed stream samples.
+ * @details If positions is not NULL, the index of the record each sample was
+ *          decoded from is written to it.
+ * @return  the number of samples written to out.
+ */
+size_t adc_stream_parse_frame(adc_unit_t unit, const uint8_t *frame, size_t size, uint16_t *out, uint32_t *positions);
+
+/**
+ * @brief   Set up a demultiplexer for the pattern of num_channels channels,
+ *          with room for capacity values per lane.
+ * @details A push of count samples needs count / num_channels + 2 values of
+ *          room per lane, once the complete rounds have been consumed.
+ * @return  ESP_ERR_INVALID_ARG if a channel repeats.
+ */
+esp_err_t adc_stream_demux_init(struct ADCStreamDemux *demux, const adc_channel_t *channels, size_t num_channels, size_t capacity);
+
+/**
+ * @brief   Release the lanes.  Safe to call more than once.
+ */
+void adc_stream_demux_free(struct ADCStreamDemux *demux);
+
+/**
+ * @brief   Sort packed stream samples (see ADC_STREAM_SAMPLE) into the lanes.
+ */
+void adc_stream_demux_push(struct ADCStreamDemux *demux, const uint16_t *samples, size_t count);
+
+/**
+ * @brief   The number of complete rounds, which every lane holds first.
+ */
+size_t adc_stream_demux_rounds(const struct ADCStreamDemux *demux);
+
+/**
+ * @brief   Drop the complete rounds, keeping the incomplete one.
+ */
+void adc_stream_demux_consume(struct ADCStreamDemux *demux);
+
+#endif
@@ -0,0 +1,759 @@
+//
+// Copyright (c) 2024 Jose Rodriguez
+// All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "adc_unit.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "esp_timer.h"
+#include "sdkconfig.h"
+#include "soc/adc_channel.h"
+
+#include "adc_arbiter.h"
+
+//
+// GPIO -> (unit, channel) map, generated for the target from soc_caps.h and
+// the ADCn_CHANNEL_m_GPIO_NUM definitions in soc/adc_channel.h.  A zero entry
+// means the GPIO is not an ADC pin.
+//
+#define ADC_PIN_VALID 0x80
+#define ADC_PIN_ENTRY(unit_id, channel) (ADC_PIN_VALID | ((unit_id) << 4) | (channel))
+#define ADC_PIN_UNIT(entry) ((adc_unit_t) (((entry) >> 4) & 0x7))
+#define ADC_PIN_CHANNEL(entry) ((adc_channel_t) ((entry) & 0xF))
+
+#if CONFIG_AVM_ADC_METRICS
+#define CHANNEL_METRICS(channel) (&(channel)->metrics)
+#else
+#define CHANNEL_METRICS(channel) NULL
+#endif
+
+// conversions asked of the backend at a time
+#define ADC_UNIT_BATCH 32
+
+static const uint8_t adc_pin_map[SOC_GPIO_PIN_COUNT] = {
+    [ADC1_CHANNEL_0_GPIO_NUM] = ADC_PIN_ENTRY(ADC_UNIT_1, ADC_CHANNEL_0),
+#if SOC_ADC_CHANNEL_NUM(0) > 1
+    [ADC1_CHANNEL_1_GPIO_NUM] = ADC_PIN_ENTRY(ADC_UNIT_1, ADC_CHANNEL_1),
+#endif
+#if SOC_ADC_CHANNEL_NUM(0) > 2
+    [ADC1_CHANNEL_2_GPIO_NUM] = ADC_PIN_ENTRY(ADC_UNIT_1, ADC_CHANNEL_2),
+#endif
+#if SOC_ADC_CHANNEL_NUM(0) > 3
+    [ADC1_CHANNEL_3_GPIO_NUM] = ADC_PIN_ENTRY(ADC_UNIT_1, ADC_CHANNEL_3),
+#endif
+#if SOC_ADC_CHANNEL_NUM(0) > 4
+    [ADC1_CHANNEL_4_GPIO_NUM] = ADC_PIN_ENTRY(ADC_UNIT_1, ADC_CHANNEL_4),
+#endif
+#if SOC_ADC_CHANNEL_NUM(0) > 5
+    [ADC1_CHANNEL_5_GPIO_NUM] = ADC_PIN_ENTRY(ADC_UNIT_1, ADC_CHANNEL_5),
+#endif
+#if SOC_ADC_CHANNEL_NUM(0) > 6
+    [ADC1_CHANNEL_6_GPIO_NUM] = ADC_PIN_ENTRY(ADC_UNIT_1, ADC_CHANNEL_6),
+#endif
+#if SOC_ADC_CHANNEL_NUM(0) > 7
+    [ADC1_CHANNEL_7_GPIO_NUM] = ADC_PIN_ENTRY(ADC_UNIT_1, ADC_CHANNEL_7),
+#endif
+#if SOC_ADC_CHANNEL_NUM(0) > 8
+    [ADC1_CHANNEL_8_GPIO_NUM] = ADC_PIN_ENTRY(ADC_UNIT_1, ADC_CHANNEL_8),
+#endif
+#if SOC_ADC_CHANNEL_NUM(0) > 9
+    [ADC1_CHANNEL_9_GPIO_NUM] = ADC_PIN_ENTRY(ADC_UNIT_1, ADC_CHANNEL_9),
+#endif
+#if defined(CONFIG_AVM_ADC2_ENABLE) && SOC_ADC_PERIPH_NUM > 1
+    [ADC2_CHANNEL_0_GPIO_NUM] = ADC_PIN_ENTRY(ADC_UNIT_2, ADC_CHANNEL_0),
+#if SOC_ADC_CHANNEL_NUM(1) > 1
+    [ADC2_CHANNEL_1_GPIO_NUM] = ADC_PIN_ENTRY(ADC_UNIT_2, ADC_CHANNEL_1),
+#endif
+#if SOC_ADC_CHANNEL_NUM(1) > 2
+    [ADC2_CHANNEL_2_GPIO_NUM] = ADC_PIN_ENTRY(ADC_UNIT_2, ADC_CHANNEL_2),
+#endif
+#if SOC_ADC_CHANNEL_NUM(1) > 3
+    [ADC2_CHANNEL_3_GPIO_NUM] = ADC_PIN_ENTRY(ADC_UNIT_2, ADC_CHANNEL_3),
+#endif
+#if SOC_ADC_CHANNEL_NUM(1) > 4
+    [ADC2_CHANNEL_4_GPIO_NUM] = ADC_PIN_ENTRY(ADC_UNIT_2, ADC_CHANNEL_4),
+#endif
+#if SOC_ADC_CHANNEL_NUM(1) > 5
+    [ADC2_CHANNEL_5_GPIO_NUM] = ADC_PIN_ENTRY(ADC_UNIT_2, ADC_CHANNEL_5),
+#endif
+#if SOC_ADC_CHANNEL_NUM(1) > 6
+    [ADC2_CHANNEL_6_GPIO_NUM] = ADC_PIN_ENTRY(ADC_UNIT_2, ADC_CHANNEL_6),
+#endif
+#if SOC_ADC_CHANNEL_NUM(1) > 7
+    [ADC2_CHANNEL_7_GPIO_NUM] = ADC_PIN_ENTRY(ADC_UNIT_2, ADC_CHANNEL_7),
+#endif
+#if SOC_ADC_CHANNEL_NUM(1) > 8
+    [ADC2_CHANNEL_8_GPIO_NUM] = ADC_PIN_ENTRY(ADC_UNIT_2, ADC_CHANNEL_8),
+#endif
+#if SOC_ADC_CHANNEL_NUM(1) > 9
+    [ADC2_CHANNEL_9_GPIO_NUM] = ADC_PIN_ENTRY(ADC_UNIT_2, ADC_CHANNEL_9),
+#endif
+#endif
+};
+
+bool adc_unit_pin_lookup(int pin, adc_unit_t *unit_id, adc_channel_t *channel)
+{
+    if (pin < 0 || pin >= SOC_GPIO_PIN_COUNT || !(adc_pin_map[pin] & ADC_PIN_VALID)) {
+        return false;
+    }
+    *unit_id = ADC_PIN_UNIT(adc_pin_map[pin]);
+    *channel = ADC_PIN_CHANNEL(adc_pin_map[pin]);
+    return true;
+}
+
+esp_err_t adc_unit_init(struct ADCUnit *unit, const struct ADCBackend *backend, adc_unit_t unit_id)
+{
+    memset(unit, 0, sizeof(struct ADCUnit));
+    unit->unit_id = unit_id;
+    unit->dither_pin = -1;
+    adc_fft_init(&unit->fft);
+    for (int i = 0; i < SOC_ADC_MAX_CHANNEL_NUM; ++i) {
+        struct ADCChannel *channel = &unit->channels[i];
+        channel->channel = (adc_channel_t) i;
+        channel->samples = ADC_UNIT_DEFAULT_SAMPLES;
+    }
+    return adc_registry_acquire(backend, unit_id, &unit->shared);
+}
+
+void adc_unit_deinit(struct ADCUnit *unit)
+{
+    if (unit->shared == NULL) {
+        return;
+    }
+    for (int i = 0; i < SOC_ADC_MAX_CHANNEL_NUM; ++i) {
+        unit->channels[i].cali = NULL;
+        free(unit->channels[i].filter);
+        unit->channels[i].filter = NULL;
+    }
+    free(unit->histogram);
+    unit->histogram = NULL;
+    adc_fft_free(&unit->fft);
+    if (unit->dither_pin >= 0) {
+        gpio_reset_pin(unit->dither_pin);
+        unit->dither_pin = -1;
+    }
+    adc_registry_release(unit->shared);
+    unit->shared = NULL;
+}
+
+struct ADCChannel *adc_unit_channel(struct ADCUnit *unit, int pin)
+{
+    adc_unit_t unit_id;
+    adc_channel_t channel;
+    if (!adc_unit_pin_lookup(pin, &unit_id, &channel) || unit_id != unit->unit_id) {
+        return NULL;
+    }
+    return &unit->channels[channel];
+}
+
+//
+// Write the settings of channel to the driver unless they are there already,
+// as the last user of the channel may have configured it differently.
+// Requires the shared lock.
+//
+static esp_err_t program_channel(struct ADCUnitShared *shared, const struct ADCChannel *channel)
+{
+    struct ADCProgrammed *programmed = &shared->programmed[channel->channel];
+    if (programmed->valid && programmed->bitwidth == channel->bitwidth && programmed->atten == channel->atten) {
+        return ESP_OK;
+    }
+    esp_err_t err = shared->backend->config(shared->handle, channel->channel, channel->bitwidth, channel->atten);
+    programmed->valid = err == ESP_OK;
+    programmed->bitwidth = channel->bitwidth;
+    programmed->atten = channel->atten;
+    return err;
+}
+
+//
+// Conversions of one channel, taken from the backend a batch at a time, so
+// one that converts in bursts is not asked for a value per call.
+//
+struct ADCBatch
+{
+    uint16_t values[ADC_UNIT_BATCH];
+    uint32_t next;
+    uint32_t count;
+};
+
+//
+// Take the next conversion of channel, needed being the least number of
+// conversions the caller still has to take, so a batch never reads ahead of
+// them.  Requires the shared lock, with the channel programmed.
+//
+static inline esp_err_t batch_next(struct ADCUnitShared *shared, adc_channel_t channel, struct ADCBatch *batch, uint32_t needed, uint16_t *value)
+{
+    if (batch->next == batch->count) {
+        uint32_t n = needed < ADC_UNIT_BATCH ? needed : ADC_UNIT_BATCH;
+        esp_err_t err = shared->backend->read_batch(shared->handle, channel, batch->values, n);
+        if (err != ESP_OK) {
+            return err;
+        }
+        batch->next = 0;
+        batch->count = n;
+    }
+    *value = batch->values[batch->next++];
+    return ESP_OK;
+}
+
+esp_err_t adc_unit_config_channel(struct ADCUnit *unit, struct ADCChannel *channel, adc_bitwidth_t bitwidth, adc_atten_t atten, uint32_t samples)
+{
+    xSemaphoreTake(unit->shared->lock, portMAX_DELAY);
+    channel->bitwidth = bitwidth;
+    channel->atten = atten;
+    esp_err_t err = program_channel(unit->shared, channel);
+    xSemaphoreGive(unit->shared->lock);
+    if (err != ESP_OK) {
+        return err;
+    }
+    __atomic_store_n(&channel->samples, samples, __ATOMIC_RELAXED);
+    __atomic_store_n(&channel->configured, true, __ATOMIC_RELEASE);
+
+    // keep a calibrated channel calibrated for its new settings
+    if (channel->cali != NULL && (channel->cali->atten != atten || channel->cali->bitwidth != bitwidth)) {
+        if (adc_unit_calibrate_channel(unit, channel, atten, bitwidth) != ESP_OK) {
+            channel->cali = NULL;
+        }
+    }
+    return ESP_OK;
+}
+
+bool adc_unit_channel_configured(const struct ADCChannel *channel)
+{
+    return __atomic_load_n(&channel->configured, __ATOMIC_ACQUIRE);
+}
+
+void adc_unit_read_defaults(const struct ADCChannel *channel, struct ADCReadOptions *out)
+{
+    memset(out, 0, sizeof(struct ADCReadOptions));
+    out->samples = __atomic_load_n(&channel->samples, __ATOMIC_RELAXED);
+    out->raw = true;
+    out->voltage = true;
+}
+
+// requires the shared lock
+static esp_err_t find_cali_table(struct ADCUnitShared *shared, const struct ADCChannel *channel, adc_atten_t atten, adc_bitwidth_t bitwidth, struct ADCCaliTable **out)
+{
+    int free_slot = -1;
+    for (int i = 0; i < ADC_REGISTRY_MAX_CALI_TABLES; ++i) {
+        struct ADCCaliTable *table = shared->cali_tables[i];
+        if (table == NULL) {
+            if (free_slot < 0) {
+                free_slot = i;
+            }
+        } else if (table->atten == atten && table->bitwidth == bitwidth) {
+            *out = table;
+            return ESP_OK;
+        }
+    }
+    if (free_slot < 0) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    struct ADCCaliTable *table = adc_calib_create(shared->backend, shared->handle, channel->channel, atten, bitwidth);
+    if (table == NULL) {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    shared->cali_tables[free_slot] = table;
+    *out = table;
+    return ESP_OK;
+}
+
+esp_err_t adc_unit_calibrate_channel(struct ADCUnit *unit, struct ADCChannel *channel, adc_atten_t atten, adc_bitwidth_t bitwidth)
+{
+    struct ADCCaliTable *table;
+    xSemaphoreTake(unit->shared->lock, portMAX_DELAY);
+    esp_err_t err = find_cali_table(unit->shared, channel, atten, bitwidth, &table);
+    if (err == ESP_OK) {
+        channel->cali = table;
+    }
+    xSemaphoreGive(unit->shared->lock);
+    return err;
+}
+
+void adc_unit_set_filter(struct ADCUnit *unit, struct ADCChannel *channel, struct ADCFilterChain *filter)
+{
+    xSemaphoreTake(unit->shared->lock, portMAX_DELAY);
+    struct ADCFilterChain *old = channel->filter;
+    channel->filter = filter;
+    xSemaphoreGive(unit->shared->lock);
+    free(old);
+}
+
+bool adc_unit_copy_filter(struct ADCUnit *unit, const struct ADCChannel *channel, struct ADCFilterChain *out)
+{
+    xSemaphoreTake(unit->shared->lock, portMAX_DELAY);
+    bool ret = channel->filter != NULL;
+    if (ret) {
+        memcpy(out, channel->filter, sizeof(struct ADCFilterChain));
+        adc_filter_reset(out);
+    }
+    xSemaphoreGive(unit->shared->lock);
+    return ret;
+}
+
+bool adc_unit_claim(struct ADCUnit *unit)
+{
+#ifdef CONFIG_AVM_ADC2_ENABLE
+    if (unit->unit_id == ADC_UNIT_2) {
+        return adc_arbiter_enter();
+    }
+#else
+    (void) unit;
+#endif
+    return true;
+}
+
+void adc_unit_release(struct ADCUnit *unit)
+{
+#ifdef CONFIG_AVM_ADC2_ENABLE
+    if (unit->unit_id == ADC_UNIT_2) {
+        adc_arbiter_leave();
+    }
+#else
+    (void) unit;
+#endif
+}
+
+esp_err_t adc_unit_read(struct ADCUnit *unit, struct ADCChannel *channel, uint32_t samples, uint32_t *adc_reading)
+{
+    esp_err_t err = ESP_OK;
+    uint64_t sum = 0;
+    uint32_t outputs = 0;
+
+    if (!adc_unit_claim(unit)) {
+        return ESP_ERR_TIMEOUT;
+    }
+    xSemaphoreTake(unit->shared->lock, portMAX_DELAY);
+    int64_t start = adc_metrics_start();
+    struct ADCFilterChain *filter = channel->filter;
+    err = program_channel(unit->shared, channel);
+    struct ADCBatch batch = { 0 };
+    uint32_t i;
+    for (i = 0; err == ESP_OK && i < samples; ++i) {
+        uint16_t value;
+        err = batch_next(unit->shared, channel->channel, &batch, samples - i, &value);
+        if (err != ESP_OK) {
+            break;
+        }
+        if (filter == NULL || adc_filter_push(filter, value, &value)) {
+            sum += value;
+            outputs++;
+        }
+    }
+    if (err == ESP_OK) {
+        *adc_reading = outputs > 0 ? (uint32_t) (sum / outputs) : filter->last;
+    }
+    adc_metrics_record(CHANNEL_METRICS(channel), start, i, err);
+    xSemaphoreGive(unit->shared->lock);
+    adc_unit_release(unit);
+    return err;
+}
+
+//
+// The standard error of the mean of n values with sum s and sum of squares q
+// is below tolerance when n q - s^2 < tolerance^2 n^2 (n - 1).  The sums are
+// exact integers, so a steady signal converges without the drift a floating
+// point running variance picks up, and the test takes no floating point at
+// all, which cores without an FPU would emulate on every sample.  With n and
+// the values at most 16 bits, n q <= (n max)^2 fits 64 bits, and so does
+// n^2 (n - 1); tolerance^2 is taken in 1/65536ths of an LSB^2, and a bound
+// too large for 64 bits has converged whatever the spread.
+//
+static uint64_t tolerance_sq_q16(float tolerance)
+{
+    float t = tolerance * tolerance * 65536.0f;
+    return t < 1.0f ? 1 : t >= (float) UINT64_MAX ? UINT64_MAX : (uint64_t) t;
+}
+
+static inline bool mean_converged(uint32_t n, uint64_t sum, uint64_t sum_sq, uint64_t tol_sq_q16)
+{
+    uint64_t spread = n * sum_sq - sum * sum;
+    uint64_t m = (uint64_t) n * n * (n - 1);
+    // tol_sq_q16 m / 65536, in two parts so that neither loses the low bits
+    uint64_t high;
+    uint64_t low;
+    uint64_t bound;
+    if (__builtin_mul_overflow(tol_sq_q16, m >> 16, &high)
+        || __builtin_mul_overflow(tol_sq_q16, m & 0xFFFF, &low)
+        || __builtin_add_overflow(high, low >> 16, &bound)) {
+        return true;
+    }
+    return spread < bound;
+}
+
+esp_err_t adc_unit_read_adaptive(struct ADCUnit *unit, struct ADCChannel *channel, uint32_t min_samples, uint32_t max_samples, float tolerance, uint32_t *adc_reading, uint32_t *used)
+{
+    if (max_samples == 0 || max_samples > ADC_UNIT_MAX_ADAPTIVE_SAMPLES || min_samples < 2 || tolerance <= 0.0f) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    esp_err_t err = ESP_OK;
+    uint64_t sum = 0;
+    uint64_t sum_sq = 0;
+    uint32_t outputs = 0;
+    uint64_t tol_sq_q16 = tolerance_sq_q16(tolerance);
+
+    if (!adc_unit_claim(unit)) {
+        return ESP_ERR_TIMEOUT;
+    }
+    xSemaphoreTake(unit->shared->lock, portMAX_DELAY);
+    int64_t start = adc_metrics_start();
+    struct ADCFilterChain *filter = channel->filter;
+    err = program_channel(unit->shared, channel);
+    uint32_t i;
+    // converted one at a time, as it stops as soon as the mean settles
+    for (i = 0; err == ESP_OK && i < max_samples; ++i) {
+        int adc_raw;
+        err = unit->shared->backend->read(unit->shared->handle, channel->channel, &adc_raw);
+        if (err != ESP_OK) {
+            break;
+        }
+        uint16_t value = (uint16_t) adc_raw;
+        if (filter != NULL && !adc_filter_push(filter, value, &value)) {
+            continue;
+        }
+        sum += value;
+        sum_sq += (uint32_t) value * value;
+        outputs++;
+        if (outputs >= min_samples && mean_converged(outputs, sum, sum_sq, tol_sq_q16)) {
+            i++;
+            break;
+        }
+    }
+    if (err == ESP_OK) {
+        *adc_reading = outputs > 0 ? (uint32_t) (sum / outputs) : filter->last;
+        *used = i;
+    }
+    adc_metrics_record(CHANNEL_METRICS(channel), start, i, err);
+    xSemaphoreGive(unit->shared->lock);
+    adc_unit_release(unit);
+    return err;
+}
+
+// converted one at a time, as the dither output toggles in between
+static inline esp_err_t oversample_convert(struct ADCUnitShared *shared, adc_channel_t channel, gpio_num_t dither_pin, uint32_t n, uint64_t *sum)
+{
+    if (dither_pin >= 0) {
+        gpio_set_level(dither_pin, n & 1);
+    }
+    int adc_raw = 0;
+    esp_err_t err = shared->backend->read(shared->handle, channel, &adc_raw);
+    *sum += (uint32_t) adc_raw;
+    return err;
+}
+
+static inline uint8_t channel_bits(const struct ADCChannel *channel)
+{
+    return channel->bitwidth == ADC_BITWIDTH_DEFAULT ? SOC_ADC_RTC_MAX_BITWIDTH : channel->bitwidth;
+}
+
+uint8_t adc_unit_max_oversample_bits(const struct ADCChannel *channel)
+{
+    uint8_t room = ADC_UNIT_MAX_OVERSAMPLED_BITWIDTH - channel_bits(channel);
+    return room < ADC_UNIT_MAX_OVERSAMPLE_BITS ? room : ADC_UNIT_MAX_OVERSAMPLE_BITS;
+}
+
+esp_err_t adc_unit_oversample(struct ADCUnit *unit, struct ADCChannel *channel, uint8_t extra_bits, uint32_t *value, uint8_t *bits)
+{
+    esp_err_t err = ESP_OK;
+    uint32_t samples = UINT32_C(1) << (2 * extra_bits);
+    uint64_t sum = 0;
+
+    if (!adc_unit_claim(unit)) {
+        return ESP_ERR_TIMEOUT;
+    }
+    xSemaphoreTake(unit->shared->lock, portMAX_DELAY);
+    int64_t start = adc_metrics_start();
+    struct ADCUnitShared *shared = unit->shared;
+    adc_channel_t ch = channel->channel;
+    gpio_num_t dither_pin = unit->dither_pin;
+    // the width was checked when the read was queued, but may have changed since
+    err = extra_bits <= adc_unit_max_oversample_bits(channel) ? program_channel(unit->shared, channel) : ESP_ERR_INVALID_ARG;
+    uint32_t i;
+    // samples is a power of 4, so unrolling by 4 needs no remainder loop
+    for (i = 0; err == ESP_OK && i < samples; i += 4) {
+        if ((err = oversample_convert(shared, ch, dither_pin, i, &sum)) != ESP_OK
+            || (err = oversample_convert(shared, ch, dither_pin, i + 1, &sum)) != ESP_OK
+            || (err = oversample_convert(shared, ch, dither_pin, i + 2, &sum)) != ESP_OK
+            || (err = oversample_convert(shared, ch, dither_pin, i + 3, &sum)) != ESP_OK) {
+            break;
+        }
+    }
+    if (dither_pin >= 0) {
+        gpio_set_level(dither_pin, 0);
+    }
+    if (err == ESP_OK) {
+        *value = (uint32_t) (sum >> extra_bits);
+        *bits = channel_bits(channel) + extra_bits;
+    }
+    adc_metrics_record(CHANNEL_METRICS(channel), start, i, err);
+    xSemaphoreGive(unit->shared->lock);
+    adc_unit_release(unit);
+    return err;
+}
+
+esp_err_t adc_unit_set_dither(struct ADCUnit *unit, gpio_num_t pin)
+{
+    if (pin >= 0 && !GPIO_IS_VALID_OUTPUT_GPIO(pin)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    esp_err_t err = ESP_OK;
+    xSemaphoreTake(unit->shared->lock, portMAX_DELAY);
+    if (unit->dither_pin >= 0) {
+        gpio_reset_pin(unit->dither_pin);
+    }
+    unit->dither_pin = -1;
+    if (pin >= 0) {
+        err = gpio_reset_pin(pin);
+        if (err == ESP_OK) {
+            err = gpio_set_direction(pin, GPIO_MODE_OUTPUT);
+        }
+        if (err == ESP_OK) {
+            err = gpio_set_level(pin, 0);
+        }
+        if (err == ESP_OK) {
+            unit->dither_pin = pin;
+        }
+    }
+    xSemaphoreGive(unit->shared->lock);
+    return err;
+}
+
+esp_err_t adc_unit_read_many(struct ADCUnit *unit, struct ADCChannel *const *channels, size_t num_channels, const uint32_t *samples, uint32_t *readings)
+{
+    esp_err_t err = ESP_OK;
+    uint64_t sums[SOC_ADC_MAX_CHANNEL_NUM] = { 0 };
+    uint32_t counts[SOC_ADC_MAX_CHANNEL_NUM] = { 0 };
+    uint32_t rounds = 0;
+    for (size_t k = 0; k < num_channels; ++k) {
+        if (samples[k] > rounds) {
+            rounds = samples[k];
+        }
+    }
+
+    if (!adc_unit_claim(unit)) {
+        return ESP_ERR_TIMEOUT;
+    }
+    xSemaphoreTake(unit->shared->lock, portMAX_DELAY);
+    int64_t start = adc_metrics_start();
+    size_t c;
+    for (c = 0; c < num_channels; ++c) {
+        err = program_channel(unit->shared, channels[c]);
+        if (err != ESP_OK) {
+            break;
+        }
+    }
+    // a channel drops out of the rounds once it has its samples; on error,
+    // c is the channel that failed
+    for (uint32_t round = 0; err == ESP_OK && round < rounds; ++round) {
+        for (c = 0; c < num_channels; ++c) {
+            if (round >= samples[c]) {
+                continue;
+            }
+            int adc_raw = 0;
+            err = unit->shared->backend->read(unit->shared->handle, channels[c]->channel, &adc_raw);
+            if (err != ESP_OK) {
+                break;
+            }
+            sums[c] += (uint32_t) adc_raw;
+            counts[c]++;
+        }
+    }
+    // every channel is charged the duration of the whole read, and a failure to the channel that failed
+    for (size_t k = 0; k < num_channels; ++k) {
+        adc_metrics_record(CHANNEL_METRICS(channels[k]), start, counts[k], k == c ? err : ESP_OK);
+    }
+    if (err == ESP_OK) {
+        for (size_t k = 0; k < num_channels; ++k) {
+            readings[k] = (uint32_t) (sums[k] / samples[k]);
+        }
+    }
+    xSemaphoreGive(unit->shared->lock);
+    adc_unit_release(unit);
+    return err;
+}
+
+//
+// Store samples filter outputs of a channel in out, counting conversions.
+// Requires the shared lock, with the channel programmed.
+//
+static esp_err_t capture_locked(struct ADCUnit *unit, struct ADCChannel *channel, uint32_t samples, const struct ADCCaliTable *cali, uint8_t *out, struct ADCTimestamps *timestamps, uint32_t *conversions)
+{
+    esp_err_t err = ESP_OK;
+    struct ADCFilterChain *filter = channel->filter;
+    struct ADCBatch batch = { 0 };
+    uint32_t i = 0;
+    while (i < samples) {
+        uint16_t value;
+        // every sample left takes a conversion at least
+        err = batch_next(unit->shared, channel->channel, &batch, samples - i, &value);
+        if (err != ESP_OK) {
+            break;
+        }
+        (*conversions)++;
+        if (filter != NULL && !adc_filter_push(filter, value, &value)) {
+            continue;
+        }
+        if (timestamps != NULL) {
+            adc_codec_timestamps_push(timestamps, esp_timer_get_time());
+        }
+        if (cali != NULL) {
+            value = adc_calib_to_mv(cali, value);
+        }
+        out[2 * i] = value & 0xFF;
+        out[2 * i + 1] = value >> 8;
+        i++;
+    }
+    return err;
+}
+
+esp_err_t adc_unit_capture(struct ADCUnit *unit, struct ADCChannel *channel, uint32_t samples, bool mv, uint8_t *out, struct ADCTimestamps *timestamps)
+{
+    esp_err_t err = ESP_OK;
+    const struct ADCCaliTable *cali = mv ? channel->cali : NULL;
+
+    if (!adc_unit_claim(unit)) {
+        return ESP_ERR_TIMEOUT;
+    }
+    xSemaphoreTake(unit->shared->lock, portMAX_DELAY);
+    int64_t start = adc_metrics_start();
+    err = program_channel(unit->shared, channel);
+    uint32_t conversions = 0;
+    if (err == ESP_OK) {
+        err = capture_locked(unit, channel, samples, cali, out, timestamps, &conversions);
+    }
+    adc_metrics_record(CHANNEL_METRICS(channel), start, conversions, err);
+    xSemaphoreGive(unit->shared->lock);
+    adc_unit_release(unit);
+    return err;
+}
+
+esp_err_t adc_unit_spectrum(struct ADCUnit *unit, struct ADCChannel *channel, uint32_t samples, enum ADCWindow window, uint8_t peaks, uint8_t *out, size_t *out_size, uint32_t *span_us)
+{
+    if (!adc_fft_valid_size(samples) || peaks > ADC_FFT_MAX_PEAKS) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!adc_unit_claim(unit)) {
+        return ESP_ERR_TIMEOUT;
+    }
+    xSemaphoreTake(unit->shared->lock, portMAX_DELAY);
+    // the transform scratch is shared, only valid while the lock is held
+    esp_err_t err = adc_fft_reserve(&unit->fft, samples);
+    if (err != ESP_OK) {
+        xSemaphoreGive(unit->shared->lock);
+        adc_unit_release(unit);
+        return err;
+    }
+    int64_t start = adc_metrics_start();
+    err = program_channel(unit->shared, channel);
+    uint32_t conversions = 0;
+    if (err == ESP_OK) {
+        int64_t first = esp_timer_get_time();
+        err = capture_locked(unit, channel, samples, NULL, adc_fft_input(&unit->fft, samples), NULL, &conversions);
+        int64_t span = esp_timer_get_time() - first;
+        *span_us = span > 0 ? (uint32_t) span : 1;
+    }
+    adc_metrics_record(CHANNEL_METRICS(channel), start, conversions, err);
+    if (err == ESP_OK) {
+        adc_fft_run(&unit->fft, samples, window);
+        if (peaks > 0) {
+            *out_size = adc_fft_put_peaks(&unit->fft, samples, peaks, out) * ADC_FFT_PEAK_SIZE;
+        } else {
+            adc_fft_put_bins(&unit->fft, samples, out);
+            *out_size = samples;
+        }
+    }
+    xSemaphoreGive(unit->shared->lock);
+    adc_unit_release(unit);
+    return err;
+}
+
+esp_err_t adc_unit_read_stats(struct ADCUnit *unit, struct ADCChannel *channel, uint32_t samples, bool mv, bool order, struct ADCStats *stats)
+{
+    if (order && samples > ADC_UNIT_MAX_HISTOGRAM_SAMPLES) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    esp_err_t err = ESP_OK;
+    const struct ADCCaliTable *cali = mv ? channel->cali : NULL;
+
+    if (!adc_unit_claim(unit)) {
+        return ESP_ERR_TIMEOUT;
+    }
+    xSemaphoreTake(unit->shared->lock, portMAX_DELAY);
+    if (order && unit->histogram == NULL) {
+        unit->histogram = malloc(ADC_UNIT_HISTOGRAM_SIZE * sizeof(uint16_t));
+        if (unit->histogram == NULL) {
+            xSemaphoreGive(unit->shared->lock);
+            adc_unit_release(unit);
+            return ESP_ERR_NO_MEM;
+        }
+    }
+    adc_stats_init(stats, order ? unit->histogram : NULL, ADC_UNIT_HISTOGRAM_SIZE);
+
+    int64_t start = adc_metrics_start();
+    struct ADCFilterChain *filter = channel->filter;
+    err = program_channel(unit->shared, channel);
+    struct ADCBatch batch = { 0 };
+    uint32_t i;
+    for (i = 0; err == ESP_OK && i < samples; ++i) {
+        uint16_t value;
+        err = batch_next(unit->shared, channel->channel, &batch, samples - i, &value);
+        if (err != ESP_OK) {
+            break;
+        }
+        if (filter != NULL && !adc_filter_push(filter, value, &value)) {
+            continue;
+        }
+        adc_stats_add(stats, cali != NULL ? adc_calib_to_mv(cali, value) : value);
+    }
+    adc_metrics_record(CHANNEL_METRICS(channel), start, i, err);
+    // the histogram is shared scratch, only valid while the lock is held
+    adc_stats_finish(stats);
+    xSemaphoreGive(unit->shared->lock);
+    adc_unit_release(unit);
+    return err;
+}
+
+bool adc_unit_get_metrics(struct ADCUnit *unit, const struct ADCChannel *channel, struct ADCMetrics *out)
+{
+#if CONFIG_AVM_ADC_METRICS
+    xSemaphoreTake(unit->shared->lock, portMAX_DELAY);
+    memcpy(out, &channel->metrics, sizeof(struct ADCMetrics));
+    xSemaphoreGive(unit->shared->lock);
+    return true;
+#else
+    (void) unit;
+    (void) channel;
+    (void) out;
+    return false;
+#endif
+}
+
+bool adc_unit_reset_metrics(struct ADCUnit *unit)
+{
+#if CONFIG_AVM_ADC_METRICS
+    xSemaphoreTake(unit->shared->lock, portMAX_DELAY);
+    for (int i = 0; i < SOC_ADC_MAX_CHANNEL_NUM; ++i) {
+        memset(&unit->channels[i].metrics, 0, sizeof(struct ADCMetrics));
+    }
+    xSemaphoreGive(unit->shared->lock);
+    return true;
+#else
+    (void) unit;
+    return false;
+#endif
+}
@@ -0,0 +1,293 @@
+//
+// Copyright (c) 2024 Jose Rodriguez
+// All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef __ADC_UNIT_H__
+#define __ADC_UNIT_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "driver/gpio.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "soc/soc_caps.h"
+
+#include "adc_backend.h"
+#include "adc_calib.h"
+#include "adc_codec.h"
+#include "adc_fft.h"
+#include "adc_filter.h"
+#include "adc_metrics.h"
+#include "adc_registry.h"
+#include "adc_stats.h"
+
+#define ADC_UNIT_DEFAULT_SAMPLES 64
+// a capture is buffered whole, so it is bounded before any time is spent
+// sampling it
+#define ADC_UNIT_MAX_CAPTURE_SAMPLES 16384
+// one bin per raw value; millivolts always fit as well
+#define ADC_UNIT_HISTOGRAM_SIZE (1 << SOC_ADC_RTC_MAX_BITWIDTH)
+// histogram bins are 16 bit, which bounds the samples of an order statistic read
+#define ADC_UNIT_MAX_HISTOGRAM_SAMPLES UINT16_MAX
+// an adaptive read keeps exact integer sums, which bounds its samples
+#define ADC_UNIT_MAX_ADAPTIVE_SAMPLES UINT16_MAX
+#define ADC_UNIT_DEFAULT_MIN_SAMPLES 8
+// an oversampled read takes 4^n conversions for n extra bits
+#define ADC_UNIT_MAX_OVERSAMPLE_BITS 4
+// and still fits its result in 16 bits
+#define ADC_UNIT_MAX_OVERSAMPLED_BITWIDTH 16
+
+struct ADCReadOptions
+{
+    uint32_t samples;
+    // when non zero, stop sampling once the standard error of the mean is
+    // below this many LSB, after at least min_samples and at most samples
+    float tolerance;
+    uint32_t min_samples;
+    // when non zero, return this many individual samples instead of their mean
+    uint32_t capture;
+    // when num_stats is non zero, return these statistics (enum ADCStat), in order
+    uint8_t stats[ADC_STAT_COUNT];
+    uint8_t num_stats;
+    // how long a read may wait for Wi-Fi to release ADC2
+    uint32_t timeout_ms;
+    // when non zero, return a mean of 4^oversample conversions with this many extra bits
+    uint8_t oversample;
+    // with capture, also return the time of each sample (see adc_codec.h)
+    bool timestamps;
+    // with capture, the enum ADCEncoding of the samples
+    uint8_t encoding;
+    // when non zero, return the spectrum of this many samples instead
+    uint16_t spectrum;
+    // with spectrum, the enum ADCWindow applied, and how many peaks to
+    // return instead of every bin (0 for all of them)
+    uint8_t window;
+    uint8_t peaks;
+    bool raw;
+    bool voltage;
+};
+
+struct ADCChannel
+{
+    // set (atomically) once the settings below have been written; never cleared
+    bool configured;
+    adc_channel_t channel;
+    adc_bitwidth_t bitwidth;
+    adc_atten_t atten;
+    struct ADCCaliTable *cali;
+    // NULL unless a filter has been configured; guarded by the unit lock
+    struct ADCFilterChain *filter;
+    // samples of a read that gives no {samples, N}; accessed atomically, as
+    // reads may start while the channel is being reconfigured
+    uint32_t samples;
+#if CONFIG_AVM_ADC_METRICS
+    // guarded by the unit lock
+    struct ADCMetrics metrics;
+#endif
+};
+
+struct ADCUnit
+{
+    adc_unit_t unit_id;
+    // backend unit, lock and calibration tables, shared with other users of
+    // the unit; the lock is held while sampling, so filter state is never
+    // changed under a read.  NULL once deinitialized.
+    struct ADCUnitShared *shared;
+    struct ADCChannel channels[SOC_ADC_MAX_CHANNEL_NUM];
+    // scratch for order statistics, allocated on first use; guarded by the lock
+    uint16_t *histogram;
+    // scratch for spectra, reserved on first use; guarded by the lock
+    struct ADCFFT fft;
+    // output toggled between oversampled conversions, or -1; guarded by the lock
+    gpio_num_t dither_pin;
+};
+
+/**
+ * @brief   Map a GPIO number to its ADC unit and channel.
+ * @return  false if the pin is not an (enabled) ADC pin on this target.
+ */
+bool adc_unit_pin_lookup(int pin, adc_unit_t *unit_id, adc_channel_t *channel);
+
+/**
+ * @brief   Reset the channel table of a unit and take a reference on the
+ *          unit of backend from the registry.
+ * @return  the backend error if its unit cannot be created.
+ */
+esp_err_t adc_unit_init(struct ADCUnit *unit, const struct ADCBackend *backend, adc_unit_t unit_id);
+
+/**
+ * @brief   Release the filters of a unit and its reference on the driver unit.
+ * @details Safe to call more than once.
+ */
+void adc_unit_deinit(struct ADCUnit *unit);
+
+/**
+ * @brief   Get the channel table entry for a pin.
+ * @return  NULL if the pin does not belong to this unit.
+ */
+struct ADCChannel *adc_unit_channel(struct ADCUnit *unit, int pin);
+
+/**
+ * @brief   Configure bit width, attenuation and default samples of a channel
+ *          and mark it configured.
+ */
+esp_err_t adc_unit_config_channel(struct ADCUnit *unit, struct ADCChannel *channel, adc_bitwidth_t bitwidth, adc_atten_t atten, uint32_t samples);
+
+/**
+ * @brief   Check whether a channel has been configured.
+ * @details Safe to call while the channel is being configured.
+ */
+bool adc_unit_channel_configured(const struct ADCChannel *channel);
+
+/**
+ * @brief   Set out to the options of a read on channel that gives none.
+ * @details Safe to call while the channel is being configured.
+ */
+void adc_unit_read_defaults(const struct ADCChannel *channel, struct ADCReadOptions *out);
+
+/**
+ * @brief   Calibrate a channel for the given attenuation and bit width.
+ * @details Channels sharing an (atten, bitwidth) pair share one lookup table.
+ *          Returns ESP_ERR_NOT_SUPPORTED if the device is not calibrated.
+ */
+esp_err_t adc_unit_calibrate_channel(struct ADCUnit *unit, struct ADCChannel *channel, adc_atten_t atten, adc_bitwidth_t bitwidth);
+
+/**
+ * @brief   Replace the filter chain of a channel, taking ownership of filter.
+ * @details filter may be NULL to remove filtering.  The previous chain is
+ *          freed once no read is using it.
+ */
+void adc_unit_set_filter(struct ADCUnit *unit, struct ADCChannel *channel, struct ADCFilterChain *filter);
+
+/**
+ * @brief   Copy the filter chain of a channel into out, with cleared history.
+ * @return  false if the channel has no filter.
+ */
+bool adc_unit_copy_filter(struct ADCUnit *unit, const struct ADCChannel *channel, struct ADCFilterChain *out);
+
+/**
+ * @brief   Claim the unit for a sequence of conversions outside of the
+ *          functions below.  Always succeeds on ADC1.
+ * @return  false if ADC2 is owned by Wi-Fi; otherwise adc_unit_release must follow.
+ */
+bool adc_unit_claim(struct ADCUnit *unit);
+
+/**
+ * @brief   Release a unit claimed with adc_unit_claim.
+ */
+void adc_unit_release(struct ADCUnit *unit);
+
+/**
+ * @brief   Take samples conversions on a channel and return their mean.
+ * @details If the channel has a filter, the mean is taken over the filter
+ *          output (or is its last output, if decimation swallowed every
+ *          sample).  Stops at, and returns, the first driver error.  This
+ *          and the functions below return ESP_ERR_TIMEOUT at once while
+ *          Wi-Fi owns ADC2.
+ */
+esp_err_t adc_unit_read(struct ADCUnit *unit, struct ADCChannel *channel, uint32_t samples, uint32_t *adc_reading);
+
+/**
+ * @brief   Take conversions on a channel until the standard error of their
+ *          mean is below tolerance, and return the mean.
+ * @details At least min_samples filter outputs are taken and at most
+ *          max_samples conversions, which may not exceed
+ *          ADC_UNIT_MAX_ADAPTIVE_SAMPLES.  tolerance is in LSB of the raw
+ *          reading.  The conversions taken are returned in *used, and the
+ *          mean is as with adc_unit_read.  Stops at the first driver error.
+ */
+esp_err_t adc_unit_read_adaptive(struct ADCUnit *unit, struct ADCChannel *channel, uint32_t min_samples, uint32_t max_samples, float tolerance, uint32_t *adc_reading, uint32_t *used);
+
+/**
+ * @brief   Take samples[i] conversions on each of channels[i], a round of
+ *          one per channel at a time, and return the mean of each in readings.
+ * @details Stops at, and returns, the first driver error.
+ */
+esp_err_t adc_unit_read_many(struct ADCUnit *unit, struct ADCChannel *const *channels, size_t num_channels, const uint32_t *samples, uint32_t *readings);
+
+/**
+ * @brief   Take samples conversions on a channel, storing each one as a
+ *          little-endian uint16 in out (2 * samples bytes).
+ * @details When mv is true and the channel is calibrated, millivolts are
+ *          stored instead of raw values.  With a filter, samples counts filter
+ *          outputs, so a decimating chain converts proportionally more.  If
+ *          timestamps is not NULL, the time each stored sample was converted
+ *          is recorded in it.  Stops at the first driver error.
+ */
+esp_err_t adc_unit_capture(struct ADCUnit *unit, struct ADCChannel *channel, uint32_t samples, bool mv, uint8_t *out, struct ADCTimestamps *timestamps);
+
+/**
+ * @brief   Capture samples raw values of a channel and write their spectrum
+ *          to out.
+ * @details samples must be a power of two (see adc_fft_valid_size).  The
+ *          filter chain applies.  Without peaks, out receives samples / 2
+ *          bins (samples bytes); otherwise up to peaks entries of
+ *          ADC_FFT_PEAK_SIZE bytes (see adc_fft.h).  The bytes written are
+ *          returned in *out_size and the time the capture took in *span_us,
+ *          which makes the bin width 1 / span.  Nothing is allocated once
+ *          the unit has held a spectrum of this size.
+ */
+esp_err_t adc_unit_spectrum(struct ADCUnit *unit, struct ADCChannel *channel, uint32_t samples, enum ADCWindow window, uint8_t peaks, uint8_t *out, size_t *out_size, uint32_t *span_us);
+
+/**
+ * @brief   Take samples conversions on a channel, accumulating statistics.
+ * @details Values are the filter output if the channel is filtered, and are
+ *          converted to millivolts when mv is true and the channel is
+ *          calibrated.  The median and p95 are only computed if order is
+ *          true, in which case samples may not exceed
+ *          ADC_UNIT_MAX_HISTOGRAM_SAMPLES.
+ *          Stops at the first driver error.
+ */
+esp_err_t adc_unit_read_stats(struct ADCUnit *unit, struct ADCChannel *channel, uint32_t samples, bool mv, bool order, struct ADCStats *stats);
+
+/**
+ * @brief   The most extra bits an oversampled read of the channel may take,
+ *          so that its result fits in ADC_UNIT_MAX_OVERSAMPLED_BITWIDTH bits.
+ */
+uint8_t adc_unit_max_oversample_bits(const struct ADCChannel *channel);
+
+/**
+ * @brief   Take 4^extra_bits conversions on a channel and return their sum
+ *          shifted down to bits + extra_bits bits.
+ * @details bits (the channel bit width) is returned in *bits.  The filter
+ *          chain is bypassed.  If a dither pin is set, it is toggled before
+ *          every conversion.  extra_bits must be 1..adc_unit_max_oversample_bits.
+ * @return  ESP_ERR_INVALID_ARG if the channel has been widened past that since.
+ */
+esp_err_t adc_unit_oversample(struct ADCUnit *unit, struct ADCChannel *channel, uint8_t extra_bits, uint32_t *value, uint8_t *bits);
+
+/**
+ * @brief   Set the output pin toggled to dither oversampled reads.
+ * @details pin may be -1 to disable dithering.  The previous pin is reset.
+ * @return  ESP_ERR_INVALID_ARG if pin is not an output capable GPIO.
+ */
+esp_err_t adc_unit_set_dither(struct ADCUnit *unit, gpio_num_t pin);
+
+/**
+ * @brief   Copy the counters of a channel into out.
+ * @return  false if metrics are disabled in the build (CONFIG_AVM_ADC_METRICS).
+ */
+bool adc_unit_get_metrics(struct ADCUnit *unit, const struct ADCChannel *channel, struct ADCMetrics *out);
+
+/**
+ * @brief   Zero the counters of every channel of a unit.
+ * @return  false if metrics are disabled in the build (CONFIG_AVM_ADC_METRICS).
+ */
+bool adc_unit_reset_metrics(struct ADCUnit *unit);
+
+#endif
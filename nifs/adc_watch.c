@@ -0,0 +1,206 @@
+//
+// Copyright (c) 2024 Jose Rodriguez
+// All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+//
+// Native watch points.  A single task per watcher samples every watched
+// channel on its own period and calls back only when a channel changes state,
+// so slowly changing supervision inputs cost no Erlang work at all.
+//
+
+#include "adc_watch.h"
+
+#include <string.h>
+
+#include "esp_log.h"
+#include "freertos/task.h"
+
+#define TAG "adc_watch"
+
+#define ADC_WATCH_TASK_STACK_SIZE 3072
+#define ADC_WATCH_TASK_PRIORITY 4
+
+enum ADCWatchState adc_watch_classify(enum ADCWatchState state, const struct ADCWatchConfig *config, uint32_t value)
+{
+    if (value < config->low) {
+        return ADC_WATCH_LOW;
+    }
+    if (value > config->high) {
+        return ADC_WATCH_HIGH;
+    }
+    switch (state) {
+        case ADC_WATCH_LOW:
+            return value >= (uint32_t) config->low + config->hysteresis ? ADC_WATCH_NORMAL : ADC_WATCH_LOW;
+        case ADC_WATCH_HIGH:
+            return value + config->hysteresis <= config->high ? ADC_WATCH_NORMAL : ADC_WATCH_HIGH;
+        default:
+            return ADC_WATCH_NORMAL;
+    }
+}
+
+static void adc_watch_evaluate(struct ADCWatcher *watcher, struct ADCWatch *watch)
+{
+    uint32_t reading;
+    if (adc_unit_read(watcher->unit, watch->channel, watch->config.samples, &reading) != ESP_OK) {
+        // try again next period
+        return;
+    }
+    enum ADCWatchState state = adc_watch_classify(watch->state, &watch->config, reading);
+    if (state == watch->state) {
+        return;
+    }
+    bool report = watch->state != ADC_WATCH_UNKNOWN || state != ADC_WATCH_NORMAL;
+    watch->state = state;
+    if (report) {
+        watcher->cb(watcher->cb_arg, watch->pin, watch->owner, state, reading);
+    }
+}
+
+static void adc_watch_task(void *arg)
+{
+    struct ADCWatcher *watcher = (struct ADCWatcher *) arg;
+
+    while (watcher->running) {
+        TickType_t wait = portMAX_DELAY;
+
+        xSemaphoreTake(watcher->lock, portMAX_DELAY);
+        for (int i = 0; i < SOC_ADC_MAX_CHANNEL_NUM; ++i) {
+            struct ADCWatch *watch = &watcher->watches[i];
+            if (!watch->active) {
+                continue;
+            }
+            TickType_t now = xTaskGetTickCount();
+            if ((int32_t) (now - watch->next) >= 0) {
+                adc_watch_evaluate(watcher, watch);
+                TickType_t period = pdMS_TO_TICKS(watch->config.period_ms);
+                watch->next += period > 0 ? period : 1;
+                // if we fell behind, skip the missed periods rather than bursting
+                now = xTaskGetTickCount();
+                if ((int32_t) (now - watch->next) >= 0) {
+                    watch->next = now + (period > 0 ? period : 1);
+                }
+            }
+            TickType_t remaining = watch->next - now;
+            if (remaining < wait) {
+                wait = remaining;
+            }
+        }
+        xSemaphoreGive(watcher->lock);
+
+        // woken early when watches are added or removed, or to exit
+        xSemaphoreTake(watcher->wake, wait);
+    }
+
+    xSemaphoreGive(watcher->done);
+    vTaskDelete(NULL);
+}
+
+void adc_watcher_init(struct ADCWatcher *watcher, struct ADCUnit *unit, adc_watch_cb_t cb, void *cb_arg)
+{
+    memset(watcher, 0, sizeof(struct ADCWatcher));
+    watcher->unit = unit;
+    watcher->cb = cb;
+    watcher->cb_arg = cb_arg;
+}
+
+static void adc_watcher_free(struct ADCWatcher *watcher)
+{
+    if (watcher->lock != NULL) {
+        vSemaphoreDelete(watcher->lock);
+        watcher->lock = NULL;
+    }
+    if (watcher->wake != NULL) {
+        vSemaphoreDelete(watcher->wake);
+        watcher->wake = NULL;
+    }
+    if (watcher->done != NULL) {
+        vSemaphoreDelete(watcher->done);
+        watcher->done = NULL;
+    }
+}
+
+static esp_err_t adc_watcher_start(struct ADCWatcher *watcher)
+{
+    watcher->lock = xSemaphoreCreateMutex();
+    watcher->wake = xSemaphoreCreateBinary();
+    watcher->done = xSemaphoreCreateBinary();
+    if (watcher->lock == NULL || watcher->wake == NULL || watcher->done == NULL) {
+        adc_watcher_free(watcher);
+        return ESP_ERR_NO_MEM;
+    }
+    watcher->running = true;
+    if (xTaskCreate(adc_watch_task, "adc_watch", ADC_WATCH_TASK_STACK_SIZE, watcher, ADC_WATCH_TASK_PRIORITY, NULL) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create watch task");
+        watcher->running = false;
+        adc_watcher_free(watcher);
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+esp_err_t adc_watcher_add(struct ADCWatcher *watcher, struct ADCChannel *channel, int pin, int32_t owner, const struct ADCWatchConfig *config)
+{
+    if (config->low > config->high || config->period_ms == 0 || config->samples == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!watcher->running) {
+        esp_err_t err = adc_watcher_start(watcher);
+        if (err != ESP_OK) {
+            return err;
+        }
+    }
+
+    xSemaphoreTake(watcher->lock, portMAX_DELAY);
+    struct ADCWatch *watch = &watcher->watches[channel->channel];
+    watch->pin = pin;
+    watch->owner = owner;
+    watch->channel = channel;
+    watch->config = *config;
+    watch->state = ADC_WATCH_UNKNOWN;
+    watch->next = xTaskGetTickCount();
+    watch->active = true;
+    xSemaphoreGive(watcher->lock);
+
+    xSemaphoreGive(watcher->wake);
+    return ESP_OK;
+}
+
+bool adc_watcher_remove(struct ADCWatcher *watcher, struct ADCChannel *channel)
+{
+    if (!watcher->running) {
+        return false;
+    }
+    xSemaphoreTake(watcher->lock, portMAX_DELAY);
+    struct ADCWatch *watch = &watcher->watches[channel->channel];
+    bool ret = watch->active;
+    watch->active = false;
+    xSemaphoreGive(watcher->lock);
+    return ret;
+}
+
+void adc_watcher_stop(struct ADCWatcher *watcher)
+{
+    if (!watcher->running) {
+        return;
+    }
+    watcher->running = false;
+    xSemaphoreGive(watcher->wake);
+    xSemaphoreTake(watcher->done, portMAX_DELAY);
+    adc_watcher_free(watcher);
+    for (int i = 0; i < SOC_ADC_MAX_CHANNEL_NUM; ++i) {
+        watcher->watches[i].active = false;
+    }
+}
@@ -0,0 +1,115 @@
+//
+// Copyright (c) 2024 Jose Rodriguez
+// All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef __ADC_WATCH_H__
+#define __ADC_WATCH_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "soc/soc_caps.h"
+
+#include "adc_unit.h"
+
+#define ADC_WATCH_DEFAULT_PERIOD_MS 100
+
+enum ADCWatchState
+{
+    ADC_WATCH_UNKNOWN,
+    ADC_WATCH_LOW,
+    ADC_WATCH_NORMAL,
+    ADC_WATCH_HIGH
+};
+
+//
+// A pin is low below low, high above high, and normal in between.  To leave
+// low (high) again the reading must come back hysteresis above low (below
+// high), so noise around a threshold does not produce a burst of changes.
+//
+struct ADCWatchConfig
+{
+    uint16_t low;
+    uint16_t high;
+    uint16_t hysteresis;
+    uint32_t samples;
+    uint32_t period_ms;
+};
+
+// called from the watch task on every state change
+typedef void (*adc_watch_cb_t)(void *arg, int pin, int32_t owner, enum ADCWatchState state, uint32_t reading);
+
+struct ADCWatch
+{
+    bool active;
+    int pin;
+    int32_t owner;
+    struct ADCChannel *channel;
+    struct ADCWatchConfig config;
+    enum ADCWatchState state;
+    TickType_t next;
+};
+
+struct ADCWatcher
+{
+    struct ADCUnit *unit;
+    SemaphoreHandle_t lock;
+    SemaphoreHandle_t wake;
+    SemaphoreHandle_t done;
+    volatile bool running;
+    adc_watch_cb_t cb;
+    void *cb_arg;
+    // indexed by channel
+    struct ADCWatch watches[SOC_ADC_MAX_CHANNEL_NUM];
+};
+
+/**
+ * @brief   Prepare a watcher for a unit.  Nothing is allocated, and no task
+ *          is started, until the first watch is added.
+ */
+void adc_watcher_init(struct ADCWatcher *watcher, struct ADCUnit *unit, adc_watch_cb_t cb, void *cb_arg);
+
+/**
+ * @brief   Watch a channel, replacing any existing watch on it.
+ * @details The first evaluation happens immediately; its state is reported
+ *          only if it is not normal.  pin and owner are handed back to the
+ *          callback untouched.
+ * @return  ESP_ERR_INVALID_ARG for inconsistent thresholds or a zero period,
+ *          ESP_ERR_NO_MEM if the watch task cannot be started.
+ */
+esp_err_t adc_watcher_add(struct ADCWatcher *watcher, struct ADCChannel *channel, int pin, int32_t owner, const struct ADCWatchConfig *config);
+
+/**
+ * @brief   Stop watching a channel.
+ * @return  false if the channel was not watched.
+ */
+bool adc_watcher_remove(struct ADCWatcher *watcher, struct ADCChannel *channel);
+
+/**
+ * @brief   Stop the watch task, if any, and release its resources.
+ * @details Once this returns the callback is no longer called.
+ */
+void adc_watcher_stop(struct ADCWatcher *watcher);
+
+/**
+ * @brief   The state a watch in state moves to on reading value.
+ */
+enum ADCWatchState adc_watch_classify(enum ADCWatchState state, const struct ADCWatchConfig *config, uint32_t value);
+
+#endif
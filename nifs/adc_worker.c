@@ -0,0 +1,86 @@
+//
+// Copyright (c) 2024 Jose Rodriguez
+// All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+//
+// FreeRTOS tasks that run blocking ADC jobs (long sample loops) off the
+// AtomVM scheduler threads, one per ADC unit.  Jobs of a unit run in
+// submission order.
+//
+
+#include "adc_worker.h"
+
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/task.h"
+
+#define TAG "adc_worker"
+
+#define ADC_WORKER_TASK_STACK_SIZE 4096
+#define ADC_WORKER_TASK_PRIORITY 5
+
+struct ADCWorkItem
+{
+    adc_worker_fn_t fn;
+    void *arg;
+};
+
+static QueueHandle_t adc_worker_queues[ADC_WORKER_LANES];
+
+static void adc_worker_task(void *arg)
+{
+    QueueHandle_t queue = (QueueHandle_t) arg;
+    struct ADCWorkItem item;
+
+    for (;;) {
+        if (xQueueReceive(queue, &item, portMAX_DELAY) == pdTRUE) {
+            item.fn(item.arg);
+        }
+    }
+}
+
+esp_err_t adc_worker_init(size_t lanes)
+{
+    for (size_t lane = 0; lane < lanes && lane < ADC_WORKER_LANES; ++lane) {
+        if (adc_worker_queues[lane] != NULL) {
+            continue;
+        }
+        QueueHandle_t queue = xQueueCreate(ADC_WORKER_QUEUE_LENGTH, sizeof(struct ADCWorkItem));
+        if (queue == NULL) {
+            return ESP_ERR_NO_MEM;
+        }
+        if (xTaskCreate(adc_worker_task, "adc_worker", ADC_WORKER_TASK_STACK_SIZE, queue, ADC_WORKER_TASK_PRIORITY, NULL) != pdPASS) {
+            ESP_LOGE(TAG, "Failed to create worker task");
+            vQueueDelete(queue);
+            return ESP_ERR_NO_MEM;
+        }
+        adc_worker_queues[lane] = queue;
+    }
+    return ESP_OK;
+}
+
+esp_err_t adc_worker_submit(size_t lane, adc_worker_fn_t fn, void *arg)
+{
+    if (lane >= ADC_WORKER_LANES || adc_worker_queues[lane] == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    struct ADCWorkItem item = {
+        .fn = fn,
+        .arg = arg
+    };
+    return xQueueSend(adc_worker_queues[lane], &item, 0) == pdPASS ? ESP_OK : ESP_ERR_TIMEOUT;
+}
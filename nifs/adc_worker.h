@@ -0,0 +1,46 @@
+//
+// Copyright (c) 2024 Jose Rodriguez
+// All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef __ADC_WORKER_H__
+#define __ADC_WORKER_H__
+
+#include <stddef.h>
+
+#include "esp_err.h"
+#include "soc/soc_caps.h"
+
+#define ADC_WORKER_QUEUE_LENGTH 16
+// one task per ADC unit, so a long read on one unit does not hold up the other
+#define ADC_WORKER_LANES SOC_ADC_PERIPH_NUM
+
+typedef void (*adc_worker_fn_t)(void *arg);
+
+/**
+ * @brief   Create the worker queues and tasks of lanes 0..lanes-1.  Called at
+ *          nif collection init; lanes already running are left alone.
+ */
+esp_err_t adc_worker_init(size_t lanes);
+
+/**
+ * @brief   Queue fn(arg) to run on the task of a lane (the ADC unit id).
+ * @details Never blocks; returns ESP_ERR_TIMEOUT if the queue is full, in which
+ *          case fn is not called and arg is still owned by the caller.  Jobs
+ *          of a lane run in submission order.
+ */
+esp_err_t adc_worker_submit(size_t lane, adc_worker_fn_t fn, void *arg);
+
+#endif
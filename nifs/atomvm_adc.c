@@ -35,11 +35,22 @@
 
 #include "soc/soc_caps.h"
 #include "esp_log.h"
-#include "esp_adc/adc_oneshot.h"
-#include "esp_adc/adc_cali.h"
-#include "esp_adc/adc_cali_scheme.h"
+#include "esp_timer.h"
+
+#include "adc_arbiter.h"
+#include "adc_backend.h"
+#include "adc_codec.h"
+#include "adc_recorder.h"
+#include "adc_registry.h"
+#include "adc_sched.h"
+#include "adc_sim.h"
+#include "adc_stream.h"
+#include "adc_unit.h"
+#include "adc_watch.h"
+#include "adc_worker.h"
 
 #include <stdlib.h>
+#include <string.h>
 
 #include <esp32_sys.h>
 #include <sys.h>
@@ -55,187 +66,56 @@ if (UNLIKELY(err != ESP_OK)) {
     return create_error_tuple(ctx, esp_err_to_term(ctx->global, err));                  \
 }
 
+//
+// The bus calls most nifs on behalf of its clients, where raising badarg for a
+// bad argument would take the bus down; those return {error, badarg} instead.
+//
+#define RETURN_BADARG(ctx)                                                              \
+do {                                                                                    \
+    if (UNLIKELY(memory_ensure_free(ctx, TUPLE_SIZE(2)) != MEMORY_GC_OK)) {             \
+        RAISE_ERROR(OUT_OF_MEMORY_ATOM);                                                \
+    }                                                                                   \
+    return create_error_tuple(ctx, BADARG_ATOM);                                        \
+} while (0)
+
+#define VALIDATE_ARG(ctx, value, predicate)                                             \
+if (UNLIKELY(!predicate(value))) {                                                      \
+    RETURN_BADARG(ctx);                                                                 \
+}
+
 static ErlNifResourceType *adc_resource_type;
+static ErlNifResourceType *adc_stream_resource_type;
 
 struct ADCResource
 {
-    adc_unit_t adc_num;
-    adc_oneshot_unit_handle_t adc_handle;
+    struct ADCUnit unit;
+    struct ADCWatcher watcher;
+    struct ADCScheduler sched;
+    // closed until recorder_open; recorded schedules write into it
+    struct ADCRecorder recorder;
+    GlobalContext *global;
+    // set by close; a closed resource is rejected by every nif.  Accessed
+    // atomically, as a direct read may race the bus closing it.
+    bool closed;
+    // one for the open resource plus one per read in flight; the last to drop
+    // it releases the unit
+    uint32_t unit_users;
 };
 
+struct ADCStreamResource
+{
+    struct ADCStream stream;
+    GlobalContext *global;
+    int32_t owner_process_id;
+    uint64_t ref_ticks;
+    enum ADCEncoding encoding;
+};
 
-#define DEFAULT_SAMPLES 64
-#define DEFAULT_VREF 1100
+static void adc_watch_send_change(void *arg, int pin, int32_t owner, enum ADCWatchState state, uint32_t reading);
+static void adc_sched_send_batch(void *arg, int pin, int32_t owner, const uint16_t *samples, size_t count);
 
-static adc_unit_t adc_unit_from_pin(int pin_val)
-{
-    switch (pin_val) {
-#if CONFIG_IDF_TARGET_ESP32
-        case 32:
-        case 33:
-        case 34:
-        case 35:
-        case 36:
-        case 37:
-        case 38:
-        case 39:
-#elif CONFIG_IDF_TARGET_ESP32S2 || CONFIG_IDF_TARGET_ESP32S3
-        case 1:
-        case 2:
-        case 3:
-        case 4:
-        case 5:
-        case 6:
-        case 7:
-        case 8:
-        case 9:
-        case 10:
-#elif CONFIG_IDF_TARGET_ESP32C3
-        case 0:
-        case 1:
-        case 2:
-        case 3:
-        case 4:
-#endif
-            return ADC_UNIT_1;
-#ifdef CONFIG_AVM_ADC2_ENABLE
-#if CONFIG_IDF_TARGET_ESP32
-        case 0:
-        case 2:
-        case 4:
-        case 12:
-        case 13:
-        case 14:
-        case 15:
-        case 25:
-        case 26:
-        case 27:
-#elif CONFIG_IDF_TARGET_ESP32S3 || CONFIG_IDF_TARGET_ESP32S2
-        case 11:
-        case 12:
-        case 13:
-        case 14:
-        case 15:
-        case 16:
-        case 17:
-        case 18:
-        case 19:
-        case 20:
-#elif CONFIG_IDF_TARGET_ESP32C3
-        case 5:
-#endif
-            return ADC_UNIT_2;
-#endif
-        default:
-            return ADC_UNIT_2 + 1;
-    }
-}
-
-static adc_channel_t get_channel(avm_int_t pin_val)
-{
-    switch (pin_val) {
-#if CONFIG_IDF_TARGET_ESP32
-        case 32:
-            return ADC_CHANNEL_4;
-        case 33:
-            return ADC_CHANNEL_5;
-        case 34:
-            return ADC_CHANNEL_6;
-        case 35:
-            return ADC_CHANNEL_7;
-        case 36:
-            return ADC_CHANNEL_0;
-        case 37:
-            return ADC_CHANNEL_1;
-        case 38:
-            return ADC_CHANNEL_2;
-        case 39:
-            return ADC_CHANNEL_3;
-#elif CONFIG_IDF_TARGET_ESP32S2 || CONFIG_IDF_TARGET_ESP32S3
-        case 1:
-            return ADC_CHANNEL_0;
-        case 2:
-            return ADC_CHANNEL_1;
-        case 3:
-            return ADC_CHANNEL_2;
-        case 4:
-            return ADC_CHANNEL_3;
-        case 5:
-            return ADC_CHANNEL_4;
-        case 6:
-            return ADC_CHANNEL_5;
-        case 7:
-            return ADC_CHANNEL_6;
-        case 8:
-            return ADC_CHANNEL_7;
-        case 9:
-            return ADC_CHANNEL_8;
-        case 10:
-            return ADC_CHANNEL_9;
-#elif CONFIG_IDF_TARGET_ESP32C3
-        case 0:
-            return ADC1_CHANNEL_0;
-        case 1:
-            return ADC1_CHANNEL_1;
-        case 2:
-            return ADC1_CHANNEL_2;
-        case 3:
-            return ADC1_CHANNEL_3;
-        case 4:
-            return ADC1_CHANNEL_4;
-#endif
-#ifdef CONFIG_AVM_ADC2_ENABLE
-#if CONFIG_IDF_TARGET_ESP32
-        case 0:
-            return ADC_CHANNEL_1;
-        case 2:
-            return ADC_CHANNEL_2;
-        case 4:
-            return ADC_CHANNEL_0;
-        case 12:
-            return ADC_CHANNEL_5;
-        case 13:
-            return ADC_CHANNEL_4;
-        case 14:
-            return ADC_CHANNEL_6;
-        case 15:
-            return ADC_CHANNEL_3;
-        case 25:
-            return ADC_CHANNEL_8;
-        case 26:
-            return ADC_CHANNEL_9;
-        case 27:
-            return ADC_CHANNEL_7;
-#elif CONFIG_IDF_TARGET_ESP32S2 || CONFIG_IDF_TARGET_ESP32S3
-        case 11:
-            return ADC_CHANNEL_0;
-        case 12:
-            return ADC_CHANNEL_1;
-        case 13:
-            return ADC_CHANNEL_2;
-        case 14:
-            return ADC_CHANNEL_3;
-        case 15:
-            return ADC_CHANNEL_4;
-        case 16:
-            return ADC_CHANNEL_5;
-        case 17:
-            return ADC_CHANNEL_6;
-        case 18:
-            return ADC_CHANNEL_7;
-        case 19:
-            return ADC_CHANNEL_8;
-        case 20:
-            return ADC_CHANNEL_9;
-#elif CONFIG_IDF_TARGET_ESP32C3
-        case 5:
-            return ADC_CHANNEL_0;
-#endif
-#endif
-        default:
-            return ADC_CHANNEL_9 + 1;
-    }
-}
+
+#define DEFAULT_VREF 1100
 
 static const AtomStringIntPair bit_width_table[] = {
     { ATOM_STR("\xa", "bit_defult"), (ADC_BITWIDTH_DEFAULT) },
@@ -244,6 +124,7 @@ static const AtomStringIntPair bit_width_table[] = {
     { ATOM_STR("\x6", "bit_11"), ADC_BITWIDTH_11 },
     { ATOM_STR("\x6", "bit_12"), ADC_BITWIDTH_12 },
     { ATOM_STR("\x6", "bit_13"), ADC_BITWIDTH_13 },
+    { ATOM_STR("\x7", "bit_max"), ADC_BITWIDTH_DEFAULT },
     SELECT_INT_DEFAULT(ADC_BITWIDTH_13 + 1)
 };
 
@@ -251,10 +132,74 @@ static const AtomStringIntPair attenuation_table[] = {
     { ATOM_STR("\x4", "db_0"), ADC_ATTEN_DB_0 },
     { ATOM_STR("\x6", "db_2_5"), ADC_ATTEN_DB_2_5 },
     { ATOM_STR("\x4", "db_6"), ADC_ATTEN_DB_6 },
+    { ATOM_STR("\x5", "db_11"), ADC_ATTEN_DB_12 },
     { ATOM_STR("\x5", "db_12"), ADC_ATTEN_DB_12 },
     SELECT_INT_DEFAULT(ADC_ATTEN_DB_12 + 1)
 };
 
+// indices into backends[]
+static const AtomStringIntPair backend_table[] = {
+    { ATOM_STR("\x7", "oneshot"), 0 },
+    { ATOM_STR("\xa", "continuous"), 1 },
+    { ATOM_STR("\x9", "simulator"), 2 },
+    SELECT_INT_DEFAULT(-1)
+};
+
+static const struct ADCBackend *const backends[] = {
+    &adc_backend_oneshot,
+    &adc_backend_continuous,
+    &adc_backend_sim,
+};
+
+static const AtomStringIntPair wave_table[] = {
+    { ATOM_STR("\x4", "sine"), ADC_SIM_SINE },
+    { ATOM_STR("\x6", "square"), ADC_SIM_SQUARE },
+    { ATOM_STR("\x5", "noise"), ADC_SIM_NOISE },
+    { ATOM_STR("\x6", "replay"), ADC_SIM_REPLAY },
+    SELECT_INT_DEFAULT(-1)
+};
+
+static const AtomStringIntPair filter_table[] = {
+    { ATOM_STR("\x6", "boxcar"), ADC_FILTER_BOXCAR },
+    { ATOM_STR("\xb", "exponential"), ADC_FILTER_EXPONENTIAL },
+    { ATOM_STR("\x3", "fir"), ADC_FILTER_FIR },
+    { ATOM_STR("\x6", "median"), ADC_FILTER_MEDIAN },
+    { ATOM_STR("\x8", "decimate"), ADC_FILTER_DECIMATE },
+    SELECT_INT_DEFAULT(-1)
+};
+
+static const AtomStringIntPair stats_table[] = {
+    { ATOM_STR("\x3", "min"), ADC_STAT_MIN },
+    { ATOM_STR("\x3", "max"), ADC_STAT_MAX },
+    { ATOM_STR("\x4", "mean"), ADC_STAT_MEAN },
+    { ATOM_STR("\x6", "stddev"), ADC_STAT_STDDEV },
+    { ATOM_STR("\x6", "median"), ADC_STAT_MEDIAN },
+    { ATOM_STR("\x3", "p95"), ADC_STAT_P95 },
+    SELECT_INT_DEFAULT(-1)
+};
+
+static const AtomStringIntPair encoding_table[] = {
+    { ATOM_STR("\x5", "raw16"), ADC_ENCODING_RAW16 },
+    { ATOM_STR("\x8", "packed12"), ADC_ENCODING_PACKED12 },
+    { ATOM_STR("\x5", "delta"), ADC_ENCODING_DELTA },
+    SELECT_INT_DEFAULT(-1)
+};
+
+static const AtomStringIntPair window_table[] = {
+    { ATOM_STR("\xb", "rectangular"), ADC_WINDOW_RECTANGULAR },
+    { ATOM_STR("\x4", "hann"), ADC_WINDOW_HANN },
+    { ATOM_STR("\x7", "hamming"), ADC_WINDOW_HAMMING },
+    { ATOM_STR("\x8", "blackman"), ADC_WINDOW_BLACKMAN },
+    SELECT_INT_DEFAULT(-1)
+};
+
+static const AtomStringIntPair overflow_table[] = {
+    { ATOM_STR("\x6", "latest"), ADC_CREDIT_LATEST },
+    { ATOM_STR("\x8", "drop_new"), ADC_CREDIT_DROP_NEW },
+    { ATOM_STR("\x8", "drop_old"), ADC_CREDIT_DROP_OLD },
+    SELECT_INT_DEFAULT(-1)
+};
+
 static const char *const invalid_pin_atom   = ATOM_STR("\xb", "invalid_pin");
 //static const char *const invalid_unit_adc_atom  = ATOM_STR("\x10", "invalid_unit_adc");
 static const char *const invalid_width_atom = ATOM_STR("\xd", "invalid_width");
@@ -262,11 +207,30 @@ static const char *const invalid_db_atom    = ATOM_STR("\xa", "invalid_db");
 //static const char *const default_db   = ATOM_STR("\x5", "bit_12");
 //static const char *const default_width   = ATOM_STR("\xa", "bit_defult");
 static const char *const error_read = ATOM_STR("\xa", "error_read");
-#ifdef CONFIG_AVM_ADC2_ENABLE
+static const char *const unconfigured_pin_atom = ATOM_STR("\x10", "unconfigured_pin");
+static const char *const busy_atom = ATOM_STR("\x4", "busy");
+static const char *const adc_reading_atom = ATOM_STR("\xb", "adc_reading");
 static const char *const timeout_atom = ATOM_STR("\x7", "timeout");
-#endif
+
+static const char *const adc_stream_atom = ATOM_STR("\xa", "adc_stream");
+static const char *const invalid_rate_atom = ATOM_STR("\xc", "invalid_rate");
+static const char *const unsupported_option_atom = ATOM_STR("\x12", "unsupported_option");
+static const char *const invalid_filter_atom = ATOM_STR("\xe", "invalid_filter");
+static const char *const invalid_threshold_atom = ATOM_STR("\x11", "invalid_threshold");
+static const char *const adc_watch_atom = ATOM_STR("\x9", "adc_watch");
+static const char *const low_atom = ATOM_STR("\x3", "low");
+static const char *const normal_atom = ATOM_STR("\x6", "normal");
+static const char *const high_atom = ATOM_STR("\x4", "high");
+static const char *const adc_sched_atom = ATOM_STR("\x9", "adc_sched");
+static const char *const not_scheduled_atom = ATOM_STR("\xd", "not_scheduled");
+static const char *const metrics_disabled_atom = ATOM_STR("\x10", "metrics_disabled");
+static const char *const not_open_atom = ATOM_STR("\x8", "not_open");
+static const char *const no_flow_control_atom = ATOM_STR("\xf", "no_flow_control");
+static const char *const not_simulated_atom = ATOM_STR("\xd", "not_simulated");
+static const char *const adc2_released_atom = ATOM_STR("\xd", "adc2_released");
 
 #define ADC_ATOMSTR (ATOM_STR("\x4", "$adc"))
+#define ADC_STREAM_ATOMSTR (ATOM_STR("\xb", "$adc_stream"))
 
 static term create_pair(Context *ctx, term term1, term term2)
 {
@@ -293,7 +257,7 @@ static bool is_adc_resource(GlobalContext *global, term t)
     return ret;
 }
 
-static bool to_adc_resource(term adc_resource, struct ADCResource **rsrc_obj, Context *ctx)
+static bool get_adc_resource(term adc_resource, struct ADCResource **rsrc_obj, Context *ctx)
 {
     if (!is_adc_resource(ctx->global, adc_resource)) {
         return false;
@@ -307,56 +271,370 @@ static bool to_adc_resource(term adc_resource, struct ADCResource **rsrc_obj, Co
     return true;
 }
 
-/*---------------------------------------------------------------
-        ADC Calibration
----------------------------------------------------------------*/
-static bool adc_calibration_init(adc_unit_t unit, adc_channel_t channel, adc_atten_t atten, adc_cali_handle_t *out_handle)
-{
-    adc_cali_handle_t handle = NULL;
-    esp_err_t ret = ESP_FAIL;
-    bool calibrated = false;
-
-#if ADC_CALI_SCHEME_CURVE_FITTING_SUPPORTED
-    if (!calibrated) {
-        ESP_LOGI(TAG, "calibration scheme version is %s", "Curve Fitting");
-        adc_cali_curve_fitting_config_t cali_config = {
-            .unit_id = unit,
-            .chan = channel,
-            .atten = atten,
-            .bitwidth = ADC_BITWIDTH_DEFAULT,
-        };
-        ret = adc_cali_create_scheme_curve_fitting(&cali_config, &handle);
-        if (ret == ESP_OK) {
-            calibrated = true;
+static bool to_adc_resource(term adc_resource, struct ADCResource **rsrc_obj, Context *ctx)
+{
+    return get_adc_resource(adc_resource, rsrc_obj, ctx) && !__atomic_load_n(&(*rsrc_obj)->closed, __ATOMIC_ACQUIRE);
+}
+
+//
+// Take a reference on the unit for a read, which may run on any process
+// holding the handle and so race close.  Once the count has dropped to zero
+// the unit is gone for good, so it is never raised from there.
+//
+static bool adc_resource_get_unit(struct ADCResource *rsrc_obj)
+{
+    uint32_t users = __atomic_load_n(&rsrc_obj->unit_users, __ATOMIC_RELAXED);
+    do {
+        if (users == 0 || __atomic_load_n(&rsrc_obj->closed, __ATOMIC_ACQUIRE)) {
+            return false;
         }
+    } while (!__atomic_compare_exchange_n(&rsrc_obj->unit_users, &users, users + 1, true, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED));
+    return true;
+}
+
+static void adc_resource_put_unit(struct ADCResource *rsrc_obj)
+{
+    if (__atomic_sub_fetch(&rsrc_obj->unit_users, 1, __ATOMIC_ACQ_REL) == 0) {
+        adc_unit_deinit(&rsrc_obj->unit);
     }
-#endif
+}
+
+//
+// Resolve a pin to its entry in the channel table of the resource.  On failure
+// NULL is returned and reason is set to the atom string for the error tuple.
+//
+static struct ADCChannel *lookup_channel(struct ADCResource *rsrc_obj, term pin, bool require_configured, const char **reason)
+{
+    struct ADCChannel *channel = adc_unit_channel(&rsrc_obj->unit, term_to_int(pin));
+    if (UNLIKELY(IS_NULL_PTR(channel))) {
+        TRACE("Pin %i is not a valid adc pin.\n", term_to_int(pin));
+        *reason = invalid_pin_atom;
+        return NULL;
+    }
+    if (UNLIKELY(require_configured && !adc_unit_channel_configured(channel))) {
+        *reason = unconfigured_pin_atom;
+        return NULL;
+    }
+    return channel;
+}
+
+// a read turned away while Wi-Fi owns ADC2 fails with timeout
+static const char *read_error_atom(esp_err_t err)
+{
+    return err == ESP_ERR_TIMEOUT ? timeout_atom : error_read;
+}
 
-#if ADC_CALI_SCHEME_LINE_FITTING_SUPPORTED
-    if (!calibrated) {
-        ESP_LOGI(TAG, "calibration scheme version is %s", "Line Fitting");
-        adc_cali_line_fitting_config_t cali_config = {
-            .unit_id = unit,
-            .atten = atten,
-            .bitwidth = ADC_BITWIDTH_DEFAULT,
-        };
-        ret = adc_cali_create_scheme_line_fitting(&cali_config, &handle);
-        if (ret == ESP_OK) {
-            calibrated = true;
+static bool stats_need_histogram(const struct ADCReadOptions *read_options)
+{
+    for (size_t i = 0; i < read_options->num_stats; ++i) {
+        if (read_options->stats[i] == ADC_STAT_MEDIAN || read_options->stats[i] == ADC_STAT_P95) {
+            return true;
         }
     }
-#endif
+    return false;
+}
 
-    *out_handle = handle;
-    if (ret == ESP_OK) {
-        ESP_LOGI(TAG, "Calibration Success");
-    } else if (ret == ESP_ERR_NOT_SUPPORTED || !calibrated) {
-        ESP_LOGW(TAG, "eFuse not burnt, skip software calibration");
-    } else {
-        ESP_LOGE(TAG, "Invalid arg or no memory");
+//
+// {spectrum, N, Window} carries two values, so interop_kv_get_value_default
+// does not see it.  Returns nil if the option is not given.
+//
+static term find_spectrum_option(term read_options, GlobalContext *global)
+{
+    while (term_is_nonempty_list(read_options)) {
+        term t = term_get_list_head(read_options);
+        if (term_is_tuple(t)
+            && term_get_tuple_arity(t) == 3
+            && globalcontext_is_term_equal_to_atom_string(global, term_get_tuple_element(t, 0), ATOM_STR("\x8", "spectrum"))) {
+            return t;
+        }
+        read_options = term_get_list_tail(read_options);
+    }
+    return term_nil();
+}
+
+//
+// Overlay the options given in a read call on the channel defaults.  An empty
+// list leaves the defaults untouched and costs nothing.
+//
+static bool parse_read_options(term read_options, struct ADCReadOptions *options, GlobalContext *global)
+{
+    if (term_is_nil(read_options)) {
+        return true;
+    }
+    term samples = interop_kv_get_value_default(read_options, ATOM_STR("\x7", "samples"), term_from_int(options->samples), global);
+    if (UNLIKELY(!term_is_integer(samples) || term_to_int(samples) <= 0)) {
+        return false;
+    }
+    options->samples = term_to_int(samples);
+    term capture = interop_kv_get_value_default(read_options, ATOM_STR("\x7", "capture"), term_from_int(0), global);
+    if (UNLIKELY(!term_is_integer(capture) || term_to_int(capture) < 0 || term_to_int(capture) > ADC_UNIT_MAX_CAPTURE_SAMPLES)) {
+        return false;
+    }
+    options->capture = term_to_int(capture);
+    term stats = interop_kv_get_value_default(read_options, ATOM_STR("\x5", "stats"), term_nil(), global);
+    if (UNLIKELY(!term_is_list(stats))) {
+        return false;
+    }
+    options->num_stats = 0;
+    while (term_is_nonempty_list(stats)) {
+        int stat = interop_atom_term_select_int(stats_table, term_get_list_head(stats), global);
+        if (UNLIKELY(stat < 0 || options->num_stats == ADC_STAT_COUNT)) {
+            return false;
+        }
+        options->stats[options->num_stats++] = (uint8_t) stat;
+        stats = term_get_list_tail(stats);
+    }
+    if (UNLIKELY(stats_need_histogram(options) && options->samples > ADC_UNIT_MAX_HISTOGRAM_SAMPLES)) {
+        return false;
+    }
+    options->raw = interop_kv_get_value_default(read_options, ATOM_STR("\x3", "raw"), FALSE_ATOM, global) == TRUE_ATOM;
+    options->voltage = interop_kv_get_value_default(read_options, ATOM_STR("\x7", "voltage"), FALSE_ATOM, global) == TRUE_ATOM;
+    term timeout = interop_kv_get_value_default(read_options, ATOM_STR("\x7", "timeout"), term_from_int(0), global);
+    if (UNLIKELY(!term_is_integer(timeout) || term_to_int(timeout) < 0)) {
+        return false;
+    }
+    options->timeout_ms = term_to_int(timeout);
+    term oversample = interop_kv_get_value_default(read_options, ATOM_STR("\xa", "oversample"), term_from_int(0), global);
+    if (UNLIKELY(!term_is_integer(oversample) || term_to_int(oversample) < 0 || term_to_int(oversample) > ADC_UNIT_MAX_OVERSAMPLE_BITS)) {
+        return false;
+    }
+    options->oversample = term_to_int(oversample);
+    // an oversampled read returns one value, so it does not mix with capture or stats
+    if (UNLIKELY(options->oversample > 0 && (options->capture > 0 || options->num_stats > 0))) {
+        return false;
+    }
+    options->timestamps = interop_kv_get_value_default(read_options, ATOM_STR("\xa", "timestamps"), FALSE_ATOM, global) == TRUE_ATOM;
+    if (UNLIKELY(options->timestamps && options->capture == 0)) {
+        return false;
+    }
+    term encoding = interop_kv_get_value_default(read_options, ATOM_STR("\x8", "encoding"), globalcontext_make_atom(global, ATOM_STR("\x5", "raw16")), global);
+    int encoding_val = interop_atom_term_select_int(encoding_table, encoding, global);
+    if (UNLIKELY(encoding_val < 0)) {
+        return false;
+    }
+    options->encoding = (uint8_t) encoding_val;
+    // timestamped binaries hold plain samples
+    if (UNLIKELY(options->encoding != ADC_ENCODING_RAW16 && (options->capture == 0 || options->timestamps))) {
+        return false;
+    }
+    term spectrum = find_spectrum_option(read_options, global);
+    if (!term_is_nil(spectrum)) {
+        term size = term_get_tuple_element(spectrum, 1);
+        int window = interop_atom_term_select_int(window_table, term_get_tuple_element(spectrum, 2), global);
+        if (UNLIKELY(!term_is_integer(size) || term_to_int(size) < 0 || !adc_fft_valid_size(term_to_int(size)) || window < 0)) {
+            return false;
+        }
+        options->spectrum = (uint16_t) term_to_int(size);
+        options->window = (uint8_t) window;
+    }
+    term peaks = interop_kv_get_value_default(read_options, ATOM_STR("\x5", "peaks"), term_from_int(0), global);
+    if (UNLIKELY(!term_is_integer(peaks) || term_to_int(peaks) < 0 || term_to_int(peaks) > ADC_FFT_MAX_PEAKS)) {
+        return false;
+    }
+    options->peaks = (uint8_t) term_to_int(peaks);
+    // a spectrum is of raw samples, returned as its own kind of binary
+    if (UNLIKELY(options->spectrum > 0 && (options->capture > 0 || options->num_stats > 0 || options->oversample > 0))) {
+        return false;
+    }
+    if (UNLIKELY(options->peaks > 0 && options->spectrum == 0)) {
+        return false;
+    }
+    term tolerance = interop_kv_get_value_default(read_options, ATOM_STR("\x9", "tolerance"), term_from_int(0), global);
+    if (UNLIKELY(!term_is_number(tolerance) || term_conv_to_float(tolerance) < 0)) {
+        return false;
+    }
+    options->tolerance = term_conv_to_float(tolerance);
+    // a minimum above the maximum is a mistake, though the default may exceed a small {samples, N}
+    term min_samples = interop_kv_get_value(read_options, ATOM_STR("\xb", "min_samples"), global);
+    options->min_samples = ADC_UNIT_DEFAULT_MIN_SAMPLES;
+    if (!term_is_invalid_term(min_samples)) {
+        if (UNLIKELY(!term_is_integer(min_samples) || term_to_int(min_samples) < 2 || (uint64_t) term_to_int(min_samples) > options->samples)) {
+            return false;
+        }
+        options->min_samples = term_to_int(min_samples);
+    }
+    // an adaptive read returns one mean, with {samples, N} as its upper bound
+    if (UNLIKELY(options->tolerance > 0 && (options->capture > 0 || options->num_stats > 0 || options->oversample > 0 || options->spectrum > 0 || options->samples > ADC_UNIT_MAX_ADAPTIVE_SAMPLES))) {
+        return false;
+    }
+    return true;
+}
+
+// bytes of the binary of a spectrum: every bin, or room for the peaks
+static size_t spectrum_buffer_size(const struct ADCReadOptions *read_options)
+{
+    return read_options->peaks > 0 ? read_options->peaks * ADC_FFT_PEAK_SIZE : read_options->spectrum;
+}
+
+// {BinHz, Binary} for a spectrum taken over span_us; requires
+// TUPLE_SIZE(2) + FLOAT_SIZE on the heap
+static term make_spectrum(term binary, uint32_t span_us, Heap *heap)
+{
+    term spectrum = term_alloc_tuple(2, heap);
+    term_put_tuple_element(spectrum, 0, term_from_float((avm_float_t) 1000000.0 / span_us, heap));
+    term_put_tuple_element(spectrum, 1, binary);
+    return spectrum;
+}
+
+//
+// Whether a capture or spectrum comes back as the bytes the read writes, so
+// that it can write them straight into the binary sent: a raw16 capture
+// without timestamps, or every bin of a spectrum.
+//
+static bool capture_is_binary(const struct ADCReadOptions *read_options)
+{
+    if (read_options->spectrum > 0) {
+        return read_options->peaks == 0;
+    }
+    return read_options->encoding == ADC_ENCODING_RAW16 && !read_options->timestamps;
+}
+
+// room a capture needs, timestamps included
+static size_t capture_buffer_size(const struct ADCReadOptions *read_options)
+{
+    size_t size = read_options->capture * sizeof(uint16_t);
+    if (read_options->timestamps) {
+        size += ADC_CODEC_TIMESTAMP_HEADER_SIZE + read_options->capture * ADC_CODEC_VARINT_MAX;
+    }
+    return size;
+}
+
+//
+// Capture into buffer (capture_buffer_size bytes), laid out as a timestamped
+// sample binary when timestamps are asked for; *size is set to the bytes used.
+//
+static esp_err_t capture_to_buffer(struct ADCUnit *unit, struct ADCChannel *channel, const struct ADCReadOptions *read_options, uint8_t *buffer, size_t *size)
+{
+    if (!read_options->timestamps) {
+        *size = read_options->capture * sizeof(uint16_t);
+        return adc_unit_capture(unit, channel, read_options->capture, read_options->voltage, buffer, NULL);
+    }
+    uint8_t *samples = buffer + ADC_CODEC_TIMESTAMP_HEADER_SIZE;
+    struct ADCTimestamps timestamps;
+    adc_codec_timestamps_init(&timestamps, samples + read_options->capture * sizeof(uint16_t));
+    esp_err_t err = adc_unit_capture(unit, channel, read_options->capture, read_options->voltage, samples, &timestamps);
+    adc_codec_put_timestamp_header(buffer, &timestamps);
+    *size = adc_codec_timestamped_size(&timestamps);
+    return err;
+}
+
+// size of the binary of a capture of size bytes in buffer, once encoded
+static size_t capture_binary_size(const struct ADCReadOptions *read_options, const uint8_t *buffer, size_t size)
+{
+    if (read_options->spectrum > 0 || read_options->encoding == ADC_ENCODING_RAW16) {
+        return size;
+    }
+    return adc_codec_encoded_size(read_options->encoding, buffer, read_options->capture, 0xFFFF);
+}
+
+// requires term_binary_heap_size(binary_size) on the heap
+static term make_capture_binary(const struct ADCReadOptions *read_options, const uint8_t *buffer, size_t size, size_t binary_size, Heap *heap, GlobalContext *global)
+{
+    if (read_options->spectrum > 0 || read_options->encoding == ADC_ENCODING_RAW16) {
+        return term_from_literal_binary(buffer, size, heap, global);
+    }
+    term bin = term_create_uninitialized_binary(binary_size, heap, global);
+    adc_codec_encode(read_options->encoding, buffer, read_options->capture, 0xFFFF, (uint8_t *) term_binary_data(bin));
+    return bin;
+}
+
+// {Raw, MilliVolts}; requires TUPLE_SIZE(2) on the heap
+static term make_reading(const struct ADCChannel *channel, const struct ADCReadOptions *read_options, uint32_t adc_reading, Heap *heap)
+{
+    term raw = read_options->raw ? term_from_int32(adc_reading) : UNDEFINED_ATOM;
+    term voltage = read_options->voltage && channel->cali != NULL ? term_from_int32(adc_calib_to_mv(channel->cali, adc_reading)) : UNDEFINED_ATOM;
+
+    term reading = term_alloc_tuple(2, heap);
+    term_put_tuple_element(reading, 0, raw);
+    term_put_tuple_element(reading, 1, voltage);
+    return reading;
+}
+
+// {Raw, MilliVolts, Used}, from Used samples; requires TUPLE_SIZE(3) on the heap
+static term make_adaptive_reading(const struct ADCChannel *channel, const struct ADCReadOptions *read_options, uint32_t adc_reading, uint32_t used, Heap *heap)
+{
+    term raw = read_options->raw ? term_from_int32(adc_reading) : UNDEFINED_ATOM;
+    term voltage = read_options->voltage && channel->cali != NULL ? term_from_int32(adc_calib_to_mv(channel->cali, adc_reading)) : UNDEFINED_ATOM;
+
+    term reading = term_alloc_tuple(3, heap);
+    term_put_tuple_element(reading, 0, raw);
+    term_put_tuple_element(reading, 1, voltage);
+    term_put_tuple_element(reading, 2, term_from_int32(used));
+    return reading;
+}
+
+// {Raw, MilliVolts, Bits}, Raw having Bits bits; requires TUPLE_SIZE(3) on the heap
+static term make_oversampled_reading(const struct ADCChannel *channel, const struct ADCReadOptions *read_options, uint32_t value, uint8_t bits, Heap *heap)
+{
+    term raw = read_options->raw ? term_from_int32(value) : UNDEFINED_ATOM;
+    term voltage = read_options->voltage && channel->cali != NULL ? term_from_int32(adc_calib_to_mv_frac(channel->cali, value, read_options->oversample)) : UNDEFINED_ATOM;
+
+    term reading = term_alloc_tuple(3, heap);
+    term_put_tuple_element(reading, 0, raw);
+    term_put_tuple_element(reading, 1, voltage);
+    term_put_tuple_element(reading, 2, term_from_int(bits));
+    return reading;
+}
+
+static size_t stats_heap_size(const struct ADCReadOptions *read_options)
+{
+    return TUPLE_SIZE(read_options->num_stats) + read_options->num_stats * FLOAT_SIZE;
+}
+
+// one element per requested statistic, in the order requested; requires stats_heap_size
+static term make_stats(const struct ADCReadOptions *read_options, const struct ADCStats *stats, Heap *heap)
+{
+    term result = term_alloc_tuple(read_options->num_stats, heap);
+    for (size_t i = 0; i < read_options->num_stats; ++i) {
+        term value;
+        switch (read_options->stats[i]) {
+            case ADC_STAT_MIN:
+                value = term_from_int32(stats->min);
+                break;
+            case ADC_STAT_MAX:
+                value = term_from_int32(stats->max);
+                break;
+            case ADC_STAT_MEAN:
+                value = term_from_float(adc_stats_mean(stats), heap);
+                break;
+            case ADC_STAT_STDDEV:
+                value = term_from_float(adc_stats_stddev(stats), heap);
+                break;
+            case ADC_STAT_MEDIAN:
+                value = term_from_int32(stats->median);
+                break;
+            default:
+                value = term_from_int32(stats->p95);
+                break;
+        }
+        term_put_tuple_element(result, i, value);
+    }
+    return result;
+}
+
+static bool is_adc_stream_resource(GlobalContext *global, term t)
+{
+    bool ret = term_is_tuple(t)
+        && term_get_tuple_arity(t) == 3
+        && globalcontext_is_term_equal_to_atom_string(global, term_get_tuple_element(t, 0), ADC_STREAM_ATOMSTR)
+        && term_is_binary(term_get_tuple_element(t, 1))
+        && term_is_reference(term_get_tuple_element(t, 2));
+
+    return ret;
+}
+
+static bool to_adc_stream_resource(term stream_resource, struct ADCStreamResource **rsrc_obj, Context *ctx)
+{
+    if (!is_adc_stream_resource(ctx->global, stream_resource)) {
+        return false;
+    }
+    void *rsrc_obj_ptr;
+    if (UNLIKELY(!enif_get_resource(erl_nif_env_from_context(ctx), term_get_tuple_element(stream_resource, 1), adc_stream_resource_type, &rsrc_obj_ptr))) {
+        return false;
     }
+    *rsrc_obj = (struct ADCStreamResource *) rsrc_obj_ptr;
 
-    return calibrated;
+    return true;
 }
 
 //
@@ -382,44 +660,27 @@ static bool adc_calibration_init(adc_unit_t unit, adc_channel_t channel, adc_att
         }
     }
 
-    adc_oneshot_unit_handle_t adc_handle;
+#ifndef CONFIG_AVM_ADC2_ENABLE
+    if (adc_num == ADC_UNIT_2) {
+        ESP_LOGE(TAG, "Invalid parameter: ADC2 is not enabled");
+        RAISE_ERROR(BADARG_ATOM);
+    }
+#endif
 
-    if (adc_num == ADC_UNIT_1) {
-        //-------------ADC1 Init---------------//
-        adc_oneshot_unit_init_cfg_t init_config = {
-            .unit_id = ADC_UNIT_1,
-        };
-        esp_err_t err = adc_oneshot_new_unit(&init_config, &adc_handle);
-        if (err != ESP_OK) {
-            ESP_LOGE(TAG, "Failed to initialize ADC parameters.  err=%i", err);
-            if (UNLIKELY(memory_ensure_free(ctx, TUPLE_SIZE(2)) != MEMORY_GC_OK)) {
-                ESP_LOGW(TAG, "Failed to allocate memory: %s:%i.\n", __FILE__, __LINE__);
-                return OUT_OF_MEMORY_ATOM;
-            } else {
-                return create_error_tuple(ctx, term_from_int(err));
-            }
+    const struct ADCBackend *backend = &adc_backend_oneshot;
+    term backend_opt = interop_kv_get_value(opts, ATOM_STR("\x7", "backend"), global);
+    if (!term_is_invalid_term(backend_opt)) {
+        if (!term_is_atom(backend_opt)) {
+            ESP_LOGE(TAG, "Invalid parameter: backend is not an atom");
+            RAISE_ERROR(BADARG_ATOM);
         }
-        ESP_LOGE(TAG, "ADC driver installed using ADC port %i\n, ", adc_num);
-    }
-#ifdef CONFIG_AVM_ADC2_ENABLE
-    else {
-         //-------------ADC2 Init---------------//
-        adc_oneshot_unit_init_cfg_t init_config = {
-            .unit_id = ADC_UNIT_2,
-        };
-        esp_err_t err = adc_oneshot_new_unit(&init_config, &adc_handle);
-        if (err != ESP_OK) {
-            ESP_LOGE(TAG, "Failed to initialize ADC parameters.  err=%i", err);
-            if (UNLIKELY(memory_ensure_free(ctx, TUPLE_SIZE(2)) != MEMORY_GC_OK)) {
-                ESP_LOGW(TAG, "Failed to allocate memory: %s:%i.\n", __FILE__, __LINE__);
-                return OUT_OF_MEMORY_ATOM;
-            } else {
-                return create_error_tuple(ctx, term_from_int(err));
-            }
+        int backend_index = interop_atom_term_select_int(backend_table, backend_opt, global);
+        if (backend_index < 0) {
+            ESP_LOGE(TAG, "Invalid parameter: unknown backend");
+            RAISE_ERROR(BADARG_ATOM);
         }
-         ESP_LOGE(TAG, "ADC driver installed using ADC port %i\n, ", adc_num);
+        backend = backends[backend_index];
     }
-#endif
 
     //
     // allocate and initialize the Nif resource
@@ -431,8 +692,29 @@ static bool adc_calibration_init(adc_unit_t unit, adc_channel_t channel, adc_att
         ESP_LOGW(TAG, "Failed to allocate memory: %s:%i.\n", __FILE__, __LINE__);
         RAISE_ERROR(OUT_OF_MEMORY_ATOM);
     }
-    rsrc_obj->adc_handle = adc_handle;
-    rsrc_obj->adc_num = adc_num;
+    rsrc_obj->global = global;
+    rsrc_obj->closed = false;
+    rsrc_obj->unit_users = 1;
+    adc_watcher_init(&rsrc_obj->watcher, &rsrc_obj->unit, adc_watch_send_change, rsrc_obj);
+    adc_sched_init(&rsrc_obj->sched, &rsrc_obj->unit, adc_sched_send_batch, rsrc_obj);
+    adc_recorder_reset(&rsrc_obj->recorder);
+    rsrc_obj->sched.recorder = &rsrc_obj->recorder;
+    // the first resource on a unit of a backend creates the backend unit;
+    // later ones share it
+    esp_err_t err = adc_unit_init(&rsrc_obj->unit, backend, adc_num);
+    if (UNLIKELY(err != ESP_OK)) {
+        ESP_LOGE(TAG, "Failed to initialize ADC parameters.  err=%i", err);
+        // nothing to release in the destructor
+        rsrc_obj->closed = true;
+        enif_release_resource(rsrc_obj);
+        if (UNLIKELY(memory_ensure_free(ctx, TUPLE_SIZE(2)) != MEMORY_GC_OK)) {
+            ESP_LOGW(TAG, "Failed to allocate memory: %s:%i.\n", __FILE__, __LINE__);
+            return OUT_OF_MEMORY_ATOM;
+        } else {
+            return create_error_tuple(ctx, term_from_int(err));
+        }
+    }
+    ESP_LOGD(TAG, "ADC%i opened on %s, %u users", adc_num + 1, backend->name, (unsigned) adc_registry_users(backend, adc_num));
 
 
     if (UNLIKELY(memory_ensure_free(ctx, TERM_BOXED_RESOURCE_SIZE) != MEMORY_GC_OK)) {
@@ -479,10 +761,19 @@ static term nif_adc_close(Context *ctx, int argc, term argv[])
     term adc_resource = argv[0];
     struct ADCResource *rsrc_obj;
 
-    if (UNLIKELY(!to_adc_resource(adc_resource, &rsrc_obj, ctx))) {
+    if (UNLIKELY(!get_adc_resource(adc_resource, &rsrc_obj, ctx))) {
         ESP_LOGE(TAG, "Failed to convert adc_resource");
         RAISE_ERROR(BADARG_ATOM);
     }
+    if (__atomic_exchange_n(&rsrc_obj->closed, true, __ATOMIC_ACQ_REL)) {
+        return OK_ATOM;
+    }
+
+    // the unit goes back to the registry now, or when the last read in flight ends
+    adc_watcher_stop(&rsrc_obj->watcher);
+    adc_sched_stop(&rsrc_obj->sched);
+    adc_recorder_close(&rsrc_obj->recorder);
+    adc_resource_put_unit(rsrc_obj);
 
     return OK_ATOM;
 }
@@ -504,61 +795,55 @@ static term nif_config_channel_bitwidth_atten(Context *ctx, int argc, term argv[
     }
 
     term pin = argv[1];
-    VALIDATE_VALUE(pin, term_is_integer);
-    adc_channel_t channel = get_channel(term_to_int(pin));
-    if (UNLIKELY(channel == ADC_CHANNEL_9 + 1)) {
-        if (UNLIKELY(memory_ensure_free(ctx, TUPLE_SIZE(3)) != MEMORY_GC_OK)) {
+    VALIDATE_ARG(ctx, pin, term_is_integer);
+    const char *reason;
+    struct ADCChannel *channel = lookup_channel(rsrc_obj, pin, false, &reason);
+    if (UNLIKELY(IS_NULL_PTR(channel))) {
+        if (UNLIKELY(memory_ensure_free(ctx, TUPLE_SIZE(2)) != MEMORY_GC_OK)) {
             RAISE_ERROR(OUT_OF_MEMORY_ATOM);
         } else {
-            return create_pair(ctx, ERROR_ATOM, globalcontext_make_atom(ctx->global, invalid_pin_atom));
+            return create_error_tuple(ctx, globalcontext_make_atom(global, reason));
         }
     }
 
     term config_options = argv[2];
-    VALIDATE_VALUE(config_options, term_is_list);
+    VALIDATE_ARG(ctx, config_options, term_is_list);
 
-    term bitwidth = interop_kv_get_value_default(config_options, ATOM_STR("\x8", "bitwidth"), FALSE_ATOM, ctx->global);
-    VALIDATE_VALUE(bitwidth, term_is_atom);
-    adc_bitwidth_t bit_width = interop_atom_term_select_int(bit_width_table, bitwidth, ctx->global);
+    term bitwidth = interop_kv_get_value_default(config_options, ATOM_STR("\x9", "bit_width"), FALSE_ATOM, global);
+    VALIDATE_ARG(ctx, bitwidth, term_is_atom);
+    adc_bitwidth_t bit_width = interop_atom_term_select_int(bit_width_table, bitwidth, global);
 
-    term attenuation = interop_kv_get_value_default(config_options, ATOM_STR("\x5", "atten"), FALSE_ATOM, ctx->global);
-    VALIDATE_VALUE(attenuation, term_is_atom);
-    adc_atten_t atten = interop_atom_term_select_int(attenuation_table, attenuation, ctx->global);
+    term attenuation = interop_kv_get_value_default(config_options, ATOM_STR("\xb", "attenuation"), FALSE_ATOM, global);
+    VALIDATE_ARG(ctx, attenuation, term_is_atom);
+    adc_atten_t atten = interop_atom_term_select_int(attenuation_table, attenuation, global);
 
     if (UNLIKELY(bit_width == ADC_BITWIDTH_13 + 1)) {
-        if (UNLIKELY(memory_ensure_free(ctx, TUPLE_SIZE(3)) != MEMORY_GC_OK)) {
+        if (UNLIKELY(memory_ensure_free(ctx, TUPLE_SIZE(2)) != MEMORY_GC_OK)) {
             RAISE_ERROR(OUT_OF_MEMORY_ATOM);
         } else {
-            return create_pair(ctx, ERROR_ATOM, globalcontext_make_atom(ctx->global, invalid_width_atom));
+            return create_error_tuple(ctx, globalcontext_make_atom(global, invalid_width_atom));
         }
     }
 
     if (UNLIKELY(atten == ADC_ATTEN_DB_12 + 1)) {
-        if (UNLIKELY(memory_ensure_free(ctx, TUPLE_SIZE(3)) != MEMORY_GC_OK)) {
+        if (UNLIKELY(memory_ensure_free(ctx, TUPLE_SIZE(2)) != MEMORY_GC_OK)) {
             RAISE_ERROR(OUT_OF_MEMORY_ATOM);
         } else {
-            return create_pair(ctx, ERROR_ATOM, globalcontext_make_atom(ctx->global, invalid_db_atom));
+            return create_error_tuple(ctx, globalcontext_make_atom(global, invalid_db_atom));
         }
     }
 
-    adc_unit_t adc_unit = adc_unit_from_pin(term_to_int(pin));
-    if (UNLIKELY(adc_unit != rsrc_obj->adc_num)) {
-        TRACE("Pin %i is not a valid adc pin.\n", term_to_int(pin));
-        if (UNLIKELY(memory_ensure_free(ctx, TUPLE_SIZE(3)) != MEMORY_GC_OK)) {
-            RAISE_ERROR(OUT_OF_MEMORY_ATOM);
-        } else {
-            return create_pair(ctx, ERROR_ATOM, globalcontext_make_atom(ctx->global, invalid_pin_atom));
-        }
+    // default samples for the channel, used when a read passes []
+    term samples = interop_kv_get_value_default(config_options, ATOM_STR("\x7", "samples"), term_from_int(channel->samples), global);
+    VALIDATE_ARG(ctx, samples, term_is_integer);
+    if (UNLIKELY(term_to_int(samples) <= 0)) {
+        RETURN_BADARG(ctx);
     }
 
     //-------------ADC Config---------------//
-    adc_oneshot_chan_cfg_t config = {
-        .bitwidth = bit_width,
-        .atten = atten,
-    };
-    esp_err_t err = adc_oneshot_config_channel(rsrc_obj->adc_handle, channel, &config);
+    esp_err_t err = adc_unit_config_channel(&rsrc_obj->unit, channel, bit_width, atten, term_to_int(samples));
 
-    CHECK_ERROR(ctx, err, "config_channel_bitwidth_atten_nif; adc_oneshot_config_channel");
+    CHECK_ERROR(ctx, err, "config_channel_bitwidth_atten_nif; adc_unit_config_channel");
 
     return OK_ATOM;
 }
@@ -580,65 +865,93 @@ static term nif_config_channel_calibration(Context *ctx, int argc, term argv[])
     }
 
     term pin = argv[1];
-    VALIDATE_VALUE(pin, term_is_integer);
-    adc_channel_t channel = get_channel(term_to_int(pin));
-    if (UNLIKELY(channel == ADC_CHANNEL_9 + 1)) {
-        if (UNLIKELY(memory_ensure_free(ctx, TUPLE_SIZE(3)) != MEMORY_GC_OK)) {
+    VALIDATE_ARG(ctx, pin, term_is_integer);
+    const char *reason;
+    struct ADCChannel *channel = lookup_channel(rsrc_obj, pin, false, &reason);
+    if (UNLIKELY(IS_NULL_PTR(channel))) {
+        if (UNLIKELY(memory_ensure_free(ctx, TUPLE_SIZE(2)) != MEMORY_GC_OK)) {
             RAISE_ERROR(OUT_OF_MEMORY_ATOM);
         } else {
-            return create_pair(ctx, ERROR_ATOM, globalcontext_make_atom(ctx->global, invalid_pin_atom));
+            return create_error_tuple(ctx, globalcontext_make_atom(global, reason));
         }
     }
 
     term config_options = argv[2];
-    VALIDATE_VALUE(config_options, term_is_list);
-
-    term attenuation = interop_kv_get_value_default(config_options, ATOM_STR("\x5", "atten"), FALSE_ATOM, ctx->global);
-    VALIDATE_VALUE(attenuation, term_is_atom);
-    adc_atten_t atten = interop_atom_term_select_int(attenuation_table, attenuation, ctx->global);
-
-    if (UNLIKELY(atten == ADC_ATTEN_DB_12 + 1)) {
-        if (UNLIKELY(memory_ensure_free(ctx, TUPLE_SIZE(3)) != MEMORY_GC_OK)) {
-            RAISE_ERROR(OUT_OF_MEMORY_ATOM);
-        } else {
-            return create_pair(ctx, ERROR_ATOM, globalcontext_make_atom(ctx->global, invalid_db_atom));
-        }
+    VALIDATE_ARG(ctx, config_options, term_is_list);
+
+    // a configured channel is calibrated for its own attenuation and bit width
+    adc_atten_t atten = channel->atten;
+    adc_bitwidth_t bit_width = channel->bitwidth;
+    if (!adc_unit_channel_configured(channel)) {
+        term attenuation = interop_kv_get_value_default(config_options, ATOM_STR("\xb", "attenuation"), FALSE_ATOM, global);
+        VALIDATE_ARG(ctx, attenuation, term_is_atom);
+        atten = interop_atom_term_select_int(attenuation_table, attenuation, global);
+        bit_width = ADC_BITWIDTH_DEFAULT;
     }
 
-    adc_unit_t adc_unit = adc_unit_from_pin(term_to_int(pin));
-    if (UNLIKELY(adc_unit != rsrc_obj->adc_num)) {
-        TRACE("Pin %i is not a valid adc pin.\n", term_to_int(pin));
-        if (UNLIKELY(memory_ensure_free(ctx, TUPLE_SIZE(3)) != MEMORY_GC_OK)) {
+    if (UNLIKELY(atten == ADC_ATTEN_DB_12 + 1)) {
+        if (UNLIKELY(memory_ensure_free(ctx, TUPLE_SIZE(2)) != MEMORY_GC_OK)) {
             RAISE_ERROR(OUT_OF_MEMORY_ATOM);
         } else {
-            return create_pair(ctx, ERROR_ATOM, globalcontext_make_atom(ctx->global, invalid_pin_atom));
+            return create_error_tuple(ctx, globalcontext_make_atom(global, invalid_db_atom));
         }
     }
 
     //-------------ADC Calibration Init---------------//
-    adc_cali_handle_t adc_cali_chan_handle = NULL;
-    bool do_calibration = adc_calibration_init(rsrc_obj->adc_num, channel, atten, &adc_cali_chan_handle);
-
-    esp_err_t err;
-
-    if(do_calibration)
-        err = ESP_OK;
-    else
-        err = ESP_FAIL;
+    esp_err_t err = adc_unit_calibrate_channel(&rsrc_obj->unit, channel, atten, bit_width);
 
     CHECK_ERROR(ctx, err, "config_channel_calibration_nif; ADC Calibration");
 
     return OK_ATOM;
 }
 
-static term nif_adc_take_reading(Context *ctx, int argc, term argv[])
+//
+// Build a filter chain from [{boxcar, N} | {exponential, Shift} | {fir, Coeffs}
+// | {median, N} | {decimate, M}].
+//
+static bool parse_filter_chain(term stages, struct ADCFilterChain *chain, GlobalContext *global)
+{
+    adc_filter_init(chain);
+    while (term_is_nonempty_list(stages)) {
+        term stage = term_get_list_head(stages);
+        if (!term_is_tuple(stage) || term_get_tuple_arity(stage) != 2) {
+            return false;
+        }
+        int type = interop_atom_term_select_int(filter_table, term_get_tuple_element(stage, 0), global);
+        term param = term_get_tuple_element(stage, 1);
+        esp_err_t err;
+        if (type == ADC_FILTER_FIR) {
+            int16_t coeffs[ADC_FILTER_MAX_TAPS];
+            size_t taps = 0;
+            while (term_is_nonempty_list(param)) {
+                term coeff = term_get_list_head(param);
+                if (taps == ADC_FILTER_MAX_TAPS || !term_is_integer(coeff)
+                    || term_to_int(coeff) < INT16_MIN || term_to_int(coeff) > INT16_MAX) {
+                    return false;
+                }
+                coeffs[taps++] = (int16_t) term_to_int(coeff);
+                param = term_get_list_tail(param);
+            }
+            err = adc_filter_add_stage(chain, ADC_FILTER_FIR, taps, coeffs);
+        } else if (type >= 0 && term_is_integer(param) && term_to_int(param) > 0) {
+            err = adc_filter_add_stage(chain, (enum ADCFilterType) type, term_to_int(param), NULL);
+        } else {
+            return false;
+        }
+        if (err != ESP_OK) {
+            return false;
+        }
+        stages = term_get_list_tail(stages);
+    }
+    return true;
+}
+
+static term nif_config_filter(Context *ctx, int argc, term argv[])
 {
+    TRACE("nif_config_filter\n");
     UNUSED(argc);
     GlobalContext *global = ctx->global;
 
-    //
-    // extract the resource
-    //
     term adc_resource = argv[0];
     struct ADCResource *rsrc_obj;
     if (UNLIKELY(!to_adc_resource(adc_resource, &rsrc_obj, ctx))) {
@@ -647,70 +960,1898 @@ static term nif_adc_take_reading(Context *ctx, int argc, term argv[])
     }
 
     term pin = argv[1];
-    VALIDATE_VALUE(pin, term_is_integer);
-    adc_channel_t channel = get_channel(term_to_int(pin));
-    if (UNLIKELY(channel == ADC_CHANNEL_9 + 1)) {
-        if (UNLIKELY(memory_ensure_free(ctx, TUPLE_SIZE(3)) != MEMORY_GC_OK)) {
+    VALIDATE_ARG(ctx, pin, term_is_integer);
+    const char *reason;
+    struct ADCChannel *channel = lookup_channel(rsrc_obj, pin, false, &reason);
+    if (UNLIKELY(IS_NULL_PTR(channel))) {
+        if (UNLIKELY(memory_ensure_free(ctx, TUPLE_SIZE(2)) != MEMORY_GC_OK)) {
             RAISE_ERROR(OUT_OF_MEMORY_ATOM);
         } else {
-            return create_pair(ctx, ERROR_ATOM, globalcontext_make_atom(ctx->global, invalid_pin_atom));
+            return create_error_tuple(ctx, globalcontext_make_atom(global, reason));
         }
     }
 
-    term config_options = argv[2];
-    VALIDATE_VALUE(config_options, term_is_list);
+    term stages = argv[2];
+    VALIDATE_ARG(ctx, stages, term_is_list);
 
-    term samples = interop_kv_get_value_default(config_options, ATOM_STR("\x7", "samples"), DEFAULT_SAMPLES, ctx->global);
-    avm_int_t samples_val = term_to_int(samples);
-    term raw = interop_kv_get_value_default(config_options, ATOM_STR("\x3", "raw"), FALSE_ATOM, ctx->global);
-    term voltage = interop_kv_get_value_default(config_options, ATOM_STR("\x7", "voltage"), FALSE_ATOM, ctx->global);
+    // an empty chain removes the filter, so unfiltered reads stay free
+    if (term_is_nil(stages)) {
+        adc_unit_set_filter(&rsrc_obj->unit, channel, NULL);
+        return OK_ATOM;
+    }
 
-    adc_unit_t adc_unit = adc_unit_from_pin(term_to_int(pin));
-    if (UNLIKELY(adc_unit != rsrc_obj->adc_num)) {
-        TRACE("Pin %i is not a valid adc pin.\n", term_to_int(pin));
-        if (UNLIKELY(memory_ensure_free(ctx, TUPLE_SIZE(3)) != MEMORY_GC_OK)) {
+    struct ADCFilterChain *filter = malloc(sizeof(struct ADCFilterChain));
+    if (IS_NULL_PTR(filter)) {
+        ESP_LOGW(TAG, "Failed to allocate memory: %s:%i.\n", __FILE__, __LINE__);
+        RAISE_ERROR(OUT_OF_MEMORY_ATOM);
+    }
+    if (UNLIKELY(!parse_filter_chain(stages, filter, global))) {
+        free(filter);
+        if (UNLIKELY(memory_ensure_free(ctx, TUPLE_SIZE(2)) != MEMORY_GC_OK)) {
             RAISE_ERROR(OUT_OF_MEMORY_ATOM);
         } else {
-            return create_pair(ctx, ERROR_ATOM, globalcontext_make_atom(ctx->global, invalid_pin_atom));
+            return create_error_tuple(ctx, globalcontext_make_atom(global, invalid_filter_atom));
         }
     }
+    adc_unit_set_filter(&rsrc_obj->unit, channel, filter);
 
-    int AdcRawValueChannel = 0;
-    int AdcVoltageChannel = 0;
-
-    uint32_t adc_reading = 0;
-
-    esp_err_t err = ESP_OK;
-    
-    for (avm_int_t i = 0; i < samples_val; ++i) {
-            err = adc_oneshot_read(rsrc_obj->adc_handle, channel, &AdcRawValueChannel);
-            adc_reading += AdcRawValueChannel;
-        }
+    return OK_ATOM;
+}
 
-    if (UNLIKELY(err != ESP_OK)) {
-            if (UNLIKELY(memory_ensure_free(ctx, TUPLE_SIZE(3)) != MEMORY_GC_OK)) {
+//
+// adc:nif_config_dither/2
+//
+static term nif_config_dither(Context *ctx, int argc, term argv[])
+{
+    TRACE("nif_config_dither\n");
+    UNUSED(argc);
+    GlobalContext *global = ctx->global;
+
+    term adc_resource = argv[0];
+    struct ADCResource *rsrc_obj;
+    if (UNLIKELY(!to_adc_resource(adc_resource, &rsrc_obj, ctx))) {
+        ESP_LOGE(TAG, "Failed to convert adc_resource");
+        RAISE_ERROR(BADARG_ATOM);
+    }
+
+    // undefined turns dithering off
+    term pin = argv[1];
+    int dither_pin = -1;
+    if (pin != UNDEFINED_ATOM) {
+        VALIDATE_ARG(ctx, pin, term_is_integer);
+        dither_pin = term_to_int(pin);
+    }
+    esp_err_t err = dither_pin < 0 && pin != UNDEFINED_ATOM ? ESP_ERR_INVALID_ARG : adc_unit_set_dither(&rsrc_obj->unit, dither_pin);
+    if (UNLIKELY(err != ESP_OK)) {
+        if (UNLIKELY(memory_ensure_free(ctx, TUPLE_SIZE(2)) != MEMORY_GC_OK)) {
+            RAISE_ERROR(OUT_OF_MEMORY_ATOM);
+        } else {
+            return create_error_tuple(ctx, globalcontext_make_atom(global, invalid_pin_atom));
+        }
+    }
+    return OK_ATOM;
+}
+
+/*---------------------------------------------------------------
+        Asynchronous Reads
+---------------------------------------------------------------*/
+
+struct ADCReadJob
+{
+    struct ADCResource *rsrc_obj;
+    struct ADCChannel *channel;
+    struct ADCReadOptions read_options;
+    // the pins of a read of several pins, or none for a read of channel
+    size_t num_channels;
+    struct ADCChannel *channels[SOC_ADC_MAX_CHANNEL_NUM];
+    uint32_t samples[SOC_ADC_MAX_CHANNEL_NUM];
+    uint32_t readings[SOC_ADC_MAX_CHANNEL_NUM];
+    // readings of several pins as one binary rather than a tuple
+    bool packed;
+    GlobalContext *global;
+    int32_t owner_process_id;
+    uint64_t ref_ticks;
+    // esp_timer time after which a read parked on ADC2 gives up
+    int64_t deadline_us;
+    // where a capture or spectrum goes: the data of binary, if the result
+    // can be sent as written (see capture_is_binary), or scratch memory
+    uint8_t *capture;
+    // bytes of capture in use once the samples are in
+    size_t capture_size;
+    // the binary capture points into, alone on heap, or an invalid term
+    term binary;
+    Heap heap;
+    // bit depth of an oversampled reading
+    uint8_t bits;
+    // time a spectrum took to capture
+    uint32_t span_us;
+    // samples an adaptive reading took
+    uint32_t used;
+};
+
+//
+// The readings of several pins, as a tuple of {Raw, MilliVolts} or, packed,
+// as <<Raw:16/little, ...>>, one per pin in the order given
+//
+static term make_readings(const struct ADCReadJob *job, Heap *heap, GlobalContext *global)
+{
+    if (job->packed) {
+        term bin = term_create_uninitialized_binary(job->num_channels * sizeof(uint16_t), heap, global);
+        uint8_t *data = (uint8_t *) term_binary_data(bin);
+        for (size_t c = 0; c < job->num_channels; ++c) {
+            data[2 * c] = job->readings[c] & 0xFF;
+            data[2 * c + 1] = job->readings[c] >> 8;
+        }
+        return bin;
+    }
+    term readings = term_alloc_tuple(job->num_channels, heap);
+    for (size_t c = 0; c < job->num_channels; ++c) {
+        term_put_tuple_element(readings, c, make_reading(job->channels[c], &job->read_options, job->readings[c], heap));
+    }
+    return readings;
+}
+
+// the message sent holds its own reference on the binary, so the job's goes
+static void adc_read_job_free(struct ADCReadJob *job)
+{
+    if (!term_is_invalid_term(job->binary)) {
+        memory_destroy_heap(&job->heap, job->global);
+    } else {
+        free(job->capture);
+    }
+    free(job);
+}
+
+//
+// Sends {adc_reading, Ref, {ok, Reading} | {error, Reason}} to the owner and
+// drops the reference on the resource taken at submission.
+//
+static void adc_read_job_reply(struct ADCReadJob *job, esp_err_t err, uint32_t adc_reading, const struct ADCStats *stats)
+{
+    GlobalContext *global = job->global;
+    size_t binary_size = 0;
+    if (job->capture != NULL && term_is_invalid_term(job->binary) && err == ESP_OK) {
+        binary_size = capture_binary_size(&job->read_options, job->capture, job->capture_size);
+    }
+
+    size_t readings_size = 0;
+    if (job->num_channels > 0 && err == ESP_OK) {
+        readings_size = job->packed ? term_binary_heap_size(job->num_channels * sizeof(uint16_t)) : TUPLE_SIZE(job->num_channels) + job->num_channels * TUPLE_SIZE(2);
+    }
+
+    BEGIN_WITH_STACK_HEAP(TUPLE_SIZE(3) + REF_SIZE + TUPLE_SIZE(2) + TUPLE_SIZE(3) + FLOAT_SIZE + term_binary_heap_size(binary_size) + stats_heap_size(&job->read_options) + readings_size, heap);
+    term result = term_alloc_tuple(2, &heap);
+    if (LIKELY(err == ESP_OK)) {
+        term_put_tuple_element(result, 0, OK_ATOM);
+        if (job->num_channels > 0) {
+            term_put_tuple_element(result, 1, make_readings(job, &heap, global));
+        } else if (job->capture != NULL) {
+            // a binary the read wrote into is sent as is
+            term bin = job->binary;
+            if (term_is_invalid_term(bin)) {
+                bin = make_capture_binary(&job->read_options, job->capture, job->capture_size, binary_size, &heap, global);
+            }
+            term_put_tuple_element(result, 1, job->read_options.spectrum > 0 ? make_spectrum(bin, job->span_us, &heap) : bin);
+        } else if (job->read_options.num_stats > 0) {
+            term_put_tuple_element(result, 1, make_stats(&job->read_options, stats, &heap));
+        } else if (job->read_options.tolerance > 0) {
+            term_put_tuple_element(result, 1, make_adaptive_reading(job->channel, &job->read_options, adc_reading, job->used, &heap));
+        } else if (job->read_options.oversample > 0) {
+            term_put_tuple_element(result, 1, make_oversampled_reading(job->channel, &job->read_options, adc_reading, job->bits, &heap));
+        } else {
+            term_put_tuple_element(result, 1, make_reading(job->channel, &job->read_options, adc_reading, &heap));
+        }
+    } else {
+        term_put_tuple_element(result, 0, ERROR_ATOM);
+        term_put_tuple_element(result, 1, globalcontext_make_atom(global, read_error_atom(err)));
+    }
+    term msg = term_alloc_tuple(3, &heap);
+    term_put_tuple_element(msg, 0, globalcontext_make_atom(global, adc_reading_atom));
+    term_put_tuple_element(msg, 1, term_from_ref_ticks(job->ref_ticks, &heap));
+    term_put_tuple_element(msg, 2, result);
+    globalcontext_send_message_from_task(global, job->owner_process_id, NormalMessage, msg);
+    END_WITH_STACK_HEAP(heap, global);
+
+    adc_resource_put_unit(job->rsrc_obj);
+    enif_release_resource(job->rsrc_obj);
+    adc_read_job_free(job);
+}
+
+#ifdef CONFIG_AVM_ADC2_ENABLE
+static void adc_read_job_run(void *arg);
+
+// called by the arbiter once ADC2 is back, or when the read runs out of time
+static void adc_read_job_resume(void *arg, esp_err_t err)
+{
+    if (err == ESP_OK) {
+        adc_read_job_run(arg);
+    } else {
+        adc_read_job_reply((struct ADCReadJob *) arg, err, 0, NULL);
+    }
+}
+#endif
+
+static esp_err_t adc_read_job_perform(struct ADCReadJob *job, uint32_t *adc_reading, struct ADCStats *stats)
+{
+    if (job->num_channels > 0) {
+        return adc_unit_read_many(&job->rsrc_obj->unit, job->channels, job->num_channels, job->samples, job->readings);
+    } else if (job->read_options.spectrum > 0) {
+        return adc_unit_spectrum(&job->rsrc_obj->unit, job->channel, job->read_options.spectrum, job->read_options.window, job->read_options.peaks, job->capture, &job->capture_size, &job->span_us);
+    } else if (job->capture != NULL) {
+        return capture_to_buffer(&job->rsrc_obj->unit, job->channel, &job->read_options, job->capture, &job->capture_size);
+    } else if (job->read_options.num_stats > 0) {
+        return adc_unit_read_stats(&job->rsrc_obj->unit, job->channel, job->read_options.samples, job->read_options.voltage, stats_need_histogram(&job->read_options), stats);
+    } else if (job->read_options.tolerance > 0) {
+        return adc_unit_read_adaptive(&job->rsrc_obj->unit, job->channel, job->read_options.min_samples, job->read_options.samples, job->read_options.tolerance, adc_reading, &job->used);
+    } else if (job->read_options.oversample > 0) {
+        return adc_unit_oversample(&job->rsrc_obj->unit, job->channel, job->read_options.oversample, adc_reading, &job->bits);
+    } else {
+        return adc_unit_read(&job->rsrc_obj->unit, job->channel, job->read_options.samples, adc_reading);
+    }
+}
+
+//
+// Runs on the worker task.  A read on ADC2 turned away by Wi-Fi is parked
+// with the arbiter until its deadline rather than failing straight away.
+//
+static void adc_read_job_run(void *arg)
+{
+    struct ADCReadJob *job = (struct ADCReadJob *) arg;
+
+    uint32_t adc_reading = 0;
+    struct ADCStats stats;
+    esp_err_t err = adc_read_job_perform(job, &adc_reading, &stats);
+
+#ifdef CONFIG_AVM_ADC2_ENABLE
+    if (err == ESP_ERR_TIMEOUT && job->rsrc_obj->unit.unit_id == ADC_UNIT_2 && job->read_options.timeout_ms > 0) {
+        esp_err_t park_err = adc_arbiter_park(adc_read_job_resume, job, job->deadline_us);
+        if (park_err == ESP_OK) {
+            return;
+        }
+        // Wi-Fi let go in the meantime, or the driver timed out on its own
+        if (park_err == ESP_ERR_INVALID_STATE) {
+            err = adc_read_job_perform(job, &adc_reading, &stats);
+        }
+    }
+#endif
+
+    adc_read_job_reply(job, err, adc_reading, &stats);
+}
+
+//
+// Queues job, filled in but for its owner, to the worker task and returns
+// {ok, Ref}, Ref tagging the eventual adc_reading message.  The job is freed
+// if it cannot be queued.
+//
+static term submit_read_job(Context *ctx, struct ADCReadJob *job, term owner)
+{
+    GlobalContext *global = ctx->global;
+    struct ADCResource *rsrc_obj = job->rsrc_obj;
+    job->global = global;
+    job->owner_process_id = term_to_local_process_id(owner);
+    job->ref_ticks = globalcontext_get_ref_ticks(global);
+    job->deadline_us = esp_timer_get_time() + (int64_t) job->read_options.timeout_ms * 1000;
+
+    // the bus may have been stopped since the resource was looked up
+    if (UNLIKELY(!adc_resource_get_unit(rsrc_obj))) {
+        adc_read_job_free(job);
+        RAISE_ERROR(BADARG_ATOM);
+    }
+    enif_keep_resource(rsrc_obj);
+    if (UNLIKELY(adc_worker_submit(rsrc_obj->unit.unit_id, adc_read_job_run, job) != ESP_OK)) {
+        adc_resource_put_unit(rsrc_obj);
+        enif_release_resource(rsrc_obj);
+        adc_read_job_free(job);
+        if (UNLIKELY(memory_ensure_free(ctx, TUPLE_SIZE(2)) != MEMORY_GC_OK)) {
+            RAISE_ERROR(OUT_OF_MEMORY_ATOM);
+        } else {
+            return create_error_tuple(ctx, globalcontext_make_atom(global, busy_atom));
+        }
+    }
+    uint64_t ref_ticks = job->ref_ticks;
+
+    if (UNLIKELY(memory_ensure_free(ctx, TUPLE_SIZE(2) + REF_SIZE) != MEMORY_GC_OK)) {
+        RAISE_ERROR(OUT_OF_MEMORY_ATOM);
+    }
+    return create_pair(ctx, OK_ATOM, term_from_ref_ticks(ref_ticks, &ctx->heap));
+}
+
+//
+// adc:nif_take_reading_async/4
+//
+// Validates the request on the scheduler, queues the sample loop to the worker
+// task and returns the reference that tags the eventual adc_reading message.
+//
+static term nif_adc_take_reading_async(Context *ctx, int argc, term argv[])
+{
+    TRACE("nif_take_reading_async\n");
+    UNUSED(argc);
+    GlobalContext *global = ctx->global;
+
+    term adc_resource = argv[0];
+    struct ADCResource *rsrc_obj;
+    if (UNLIKELY(!to_adc_resource(adc_resource, &rsrc_obj, ctx))) {
+        ESP_LOGE(TAG, "Failed to convert adc_resource");
+        RAISE_ERROR(BADARG_ATOM);
+    }
+
+    term pin = argv[1];
+    VALIDATE_ARG(ctx, pin, term_is_integer);
+    const char *reason;
+    struct ADCChannel *channel = lookup_channel(rsrc_obj, pin, true, &reason);
+    if (UNLIKELY(IS_NULL_PTR(channel))) {
+        if (UNLIKELY(memory_ensure_free(ctx, TUPLE_SIZE(2)) != MEMORY_GC_OK)) {
+            RAISE_ERROR(OUT_OF_MEMORY_ATOM);
+        } else {
+            return create_error_tuple(ctx, globalcontext_make_atom(global, reason));
+        }
+    }
+
+    term config_options = argv[2];
+    VALIDATE_ARG(ctx, config_options, term_is_list);
+    term owner = argv[3];
+    VALIDATE_ARG(ctx, owner, term_is_pid);
+
+    struct ADCReadJob *job = malloc(sizeof(struct ADCReadJob));
+    if (IS_NULL_PTR(job)) {
+        ESP_LOGW(TAG, "Failed to allocate memory: %s:%i.\n", __FILE__, __LINE__);
+        RAISE_ERROR(OUT_OF_MEMORY_ATOM);
+    }
+    adc_unit_read_defaults(channel, &job->read_options);
+    // the extra bits of an oversampled read must keep it within 16 bits
+    if (UNLIKELY(!parse_read_options(config_options, &job->read_options, global)
+            || job->read_options.oversample > adc_unit_max_oversample_bits(channel))) {
+        free(job);
+        RETURN_BADARG(ctx);
+    }
+    job->capture = NULL;
+    job->binary = term_invalid_term();
+    if (job->read_options.capture > 0 || job->read_options.spectrum > 0) {
+        size_t size = job->read_options.spectrum > 0 ? spectrum_buffer_size(&job->read_options) : capture_buffer_size(&job->read_options);
+        // allocated once, as the binary the reply carries, where the format allows
+        if (capture_is_binary(&job->read_options)) {
+            if (memory_init_heap(&job->heap, term_binary_heap_size(size)) == MEMORY_GC_OK) {
+                job->binary = term_create_uninitialized_binary(size, &job->heap, global);
+                if (term_is_invalid_term(job->binary)) {
+                    memory_destroy_heap(&job->heap, global);
+                } else {
+                    job->capture = (uint8_t *) term_binary_data(job->binary);
+                }
+            }
+        } else {
+            job->capture = malloc(size);
+        }
+        if (IS_NULL_PTR(job->capture)) {
+            free(job);
+            ESP_LOGW(TAG, "Failed to allocate memory: %s:%i.\n", __FILE__, __LINE__);
+            RAISE_ERROR(OUT_OF_MEMORY_ATOM);
+        }
+    }
+    job->rsrc_obj = rsrc_obj;
+    job->channel = channel;
+    job->num_channels = 0;
+    return submit_read_job(ctx, job, owner);
+}
+
+//
+// adc:nif_take_readings_async/4
+//
+// Queues a read of every listed pin, sampled back to back on the unit handle
+// so that the readings are as close together in time as the driver allows,
+// like nif_take_reading_async.
+//
+static term nif_adc_take_readings_async(Context *ctx, int argc, term argv[])
+{
+    TRACE("nif_take_readings_async\n");
+    UNUSED(argc);
+    GlobalContext *global = ctx->global;
+
+    //
+    // extract the resource
+    //
+    term adc_resource = argv[0];
+    struct ADCResource *rsrc_obj;
+    if (UNLIKELY(!to_adc_resource(adc_resource, &rsrc_obj, ctx))) {
+        ESP_LOGE(TAG, "Failed to convert adc_resource");
+        RAISE_ERROR(BADARG_ATOM);
+    }
+
+    term pins = argv[1];
+    VALIDATE_ARG(ctx, pins, term_is_list);
+    term config_options = argv[2];
+    VALIDATE_ARG(ctx, config_options, term_is_list);
+    term owner = argv[3];
+    VALIDATE_ARG(ctx, owner, term_is_pid);
+
+    struct ADCChannel *channels[SOC_ADC_MAX_CHANNEL_NUM];
+    size_t num_channels = 0;
+    while (term_is_nonempty_list(pins)) {
+        term pin = term_get_list_head(pins);
+        VALIDATE_ARG(ctx, pin, term_is_integer);
+        if (UNLIKELY(num_channels == SOC_ADC_MAX_CHANNEL_NUM)) {
+            RETURN_BADARG(ctx);
+        }
+        const char *reason;
+        struct ADCChannel *channel = lookup_channel(rsrc_obj, pin, true, &reason);
+        if (UNLIKELY(IS_NULL_PTR(channel))) {
+            if (UNLIKELY(memory_ensure_free(ctx, TUPLE_SIZE(2)) != MEMORY_GC_OK)) {
+                RAISE_ERROR(OUT_OF_MEMORY_ATOM);
+            } else {
+                return create_error_tuple(ctx, globalcontext_make_atom(global, reason));
+            }
+        }
+        channels[num_channels++] = channel;
+        pins = term_get_list_tail(pins);
+    }
+    if (UNLIKELY(num_channels == 0)) {
+        RETURN_BADARG(ctx);
+    }
+
+    struct ADCReadJob *job = malloc(sizeof(struct ADCReadJob));
+    if (IS_NULL_PTR(job)) {
+        ESP_LOGW(TAG, "Failed to allocate memory: %s:%i.\n", __FILE__, __LINE__);
+        RAISE_ERROR(OUT_OF_MEMORY_ATOM);
+    }
+    adc_unit_read_defaults(channels[0], &job->read_options);
+    if (UNLIKELY(!parse_read_options(config_options, &job->read_options, global))) {
+        free(job);
+        RETURN_BADARG(ctx);
+    }
+    // each pin returns one mean, so none of the other kinds of read apply
+    if (UNLIKELY(job->read_options.capture > 0 || job->read_options.num_stats > 0 || job->read_options.oversample > 0
+            || job->read_options.timestamps || job->read_options.spectrum > 0 || job->read_options.tolerance > 0)) {
+        free(job);
+        if (UNLIKELY(memory_ensure_free(ctx, TUPLE_SIZE(2)) != MEMORY_GC_OK)) {
+            RAISE_ERROR(OUT_OF_MEMORY_ATOM);
+        } else {
+            return create_error_tuple(ctx, globalcontext_make_atom(global, unsupported_option_atom));
+        }
+    }
+    // without {samples, N}, each pin takes its own default
+    bool samples_given = !term_is_invalid_term(interop_kv_get_value(config_options, ATOM_STR("\x7", "samples"), global));
+    for (size_t c = 0; c < num_channels; ++c) {
+        struct ADCReadOptions defaults;
+        adc_unit_read_defaults(channels[c], &defaults);
+        job->samples[c] = samples_given ? job->read_options.samples : defaults.samples;
+    }
+    job->packed = interop_kv_get_value_default(config_options, ATOM_STR("\x6", "binary"), FALSE_ATOM, global) == TRUE_ATOM;
+    memcpy(job->channels, channels, num_channels * sizeof(struct ADCChannel *));
+    job->num_channels = num_channels;
+    job->capture = NULL;
+    job->binary = term_invalid_term();
+    job->rsrc_obj = rsrc_obj;
+    job->channel = channels[0];
+    return submit_read_job(ctx, job, owner);
+}
+
+/*---------------------------------------------------------------
+        Flow Control
+---------------------------------------------------------------*/
+
+//
+// Parses {credits, N} and {overflow, Policy} out of stream or schedule
+// options into config.  Returns false for bad values, and sets *limited if
+// credits were given; an overflow policy on its own is an error.
+//
+static bool parse_credit_options(term options, struct ADCCreditConfig *config, bool *limited, GlobalContext *global)
+{
+    term credits = interop_kv_get_value(options, ATOM_STR("\x7", "credits"), global);
+    term overflow = interop_kv_get_value(options, ATOM_STR("\x8", "overflow"), global);
+    *limited = !term_is_invalid_term(credits);
+    if (!*limited) {
+        return term_is_invalid_term(overflow);
+    }
+    if (!term_is_integer(credits) || term_to_int(credits) < 0 || (uint64_t) term_to_int(credits) > UINT32_MAX) {
+        return false;
+    }
+    config->credits = (uint32_t) term_to_int(credits);
+    config->policy = ADC_CREDIT_LATEST;
+    if (!term_is_invalid_term(overflow)) {
+        int policy = term_is_atom(overflow) ? interop_atom_term_select_int(overflow_table, overflow, global) : -1;
+        if (policy < 0) {
+            return false;
+        }
+        config->policy = (enum ADCCreditPolicy) policy;
+    }
+    return true;
+}
+
+// a grant must add at least one credit
+static bool to_grant(term credits, uint32_t *out)
+{
+    if (!term_is_integer(credits) || term_to_int(credits) <= 0 || (uint64_t) term_to_int(credits) > UINT32_MAX) {
+        return false;
+    }
+    *out = (uint32_t) term_to_int(credits);
+    return true;
+}
+
+/*---------------------------------------------------------------
+        ADC Continuous Streaming
+---------------------------------------------------------------*/
+
+//
+// Runs on the stream task.  Frames are copied into a (refc) binary on a
+// temporary heap and sent to the owner as {adc_stream, Ref, Samples}, where
+// Samples is a timestamped sample binary if the stream was started with
+// timestamps, or holds just the values in the stream encoding if it has one.
+//
+static void adc_stream_send_frame(void *arg, const uint16_t *samples, size_t count, const struct ADCTimestamps *timestamps)
+{
+    struct ADCStreamResource *rsrc_obj = (struct ADCStreamResource *) arg;
+    GlobalContext *global = rsrc_obj->global;
+    size_t samples_size = count * sizeof(uint16_t);
+    size_t size = timestamps != NULL ? adc_codec_timestamped_size(timestamps) : samples_size;
+    if (rsrc_obj->encoding != ADC_ENCODING_RAW16) {
+        size = adc_codec_encoded_size(rsrc_obj->encoding, (const uint8_t *) samples, count, 0xFFF);
+    }
+
+    BEGIN_WITH_STACK_HEAP(TUPLE_SIZE(3) + REF_SIZE + term_binary_heap_size(size), heap);
+    term bin = term_create_uninitialized_binary(size, &heap, global);
+    uint8_t *data = (uint8_t *) term_binary_data(bin);
+    if (timestamps != NULL) {
+        adc_codec_put_timestamp_header(data, timestamps);
+        data += ADC_CODEC_TIMESTAMP_HEADER_SIZE;
+    }
+    if (rsrc_obj->encoding != ADC_ENCODING_RAW16) {
+        adc_codec_encode(rsrc_obj->encoding, (const uint8_t *) samples, count, 0xFFF, data);
+    } else {
+        memcpy(data, samples, samples_size);
+    }
+    if (timestamps != NULL) {
+        memcpy(data + samples_size, timestamps->deltas, timestamps->size);
+    }
+    term msg = term_alloc_tuple(3, &heap);
+    term_put_tuple_element(msg, 0, globalcontext_make_atom(global, adc_stream_atom));
+    term_put_tuple_element(msg, 1, term_from_ref_ticks(rsrc_obj->ref_ticks, &heap));
+    term_put_tuple_element(msg, 2, bin);
+    globalcontext_send_message_from_task(global, rsrc_obj->owner_process_id, NormalMessage, msg);
+    END_WITH_STACK_HEAP(heap, global);
+}
+
+//
+// Runs on the stream task, for a stream started with {demux, true}.  Sends
+// {adc_stream, Ref, Lanes, OutOfOrder} to the owner, where Lanes is a tuple
+// with a binary of raw values per pin, in the stream encoding.
+//
+static void adc_stream_send_lanes(void *arg, const struct ADCStreamLanes *lanes)
+{
+    struct ADCStreamResource *rsrc_obj = (struct ADCStreamResource *) arg;
+    GlobalContext *global = rsrc_obj->global;
+    size_t sizes[SOC_ADC_PATT_LEN_MAX];
+    size_t heap_size = TUPLE_SIZE(4) + REF_SIZE + TUPLE_SIZE(lanes->num_lanes) + BOXED_INT64_SIZE;
+    for (size_t l = 0; l < lanes->num_lanes; ++l) {
+        sizes[l] = lanes->counts[l] * sizeof(uint16_t);
+        if (rsrc_obj->encoding != ADC_ENCODING_RAW16) {
+            sizes[l] = adc_codec_encoded_size(rsrc_obj->encoding, (const uint8_t *) lanes->samples[l], lanes->counts[l], 0xFFF);
+        }
+        heap_size += term_binary_heap_size(sizes[l]);
+    }
+
+    BEGIN_WITH_STACK_HEAP(heap_size, heap);
+    term binaries = term_alloc_tuple(lanes->num_lanes, &heap);
+    for (size_t l = 0; l < lanes->num_lanes; ++l) {
+        term bin = term_create_uninitialized_binary(sizes[l], &heap, global);
+        uint8_t *data = (uint8_t *) term_binary_data(bin);
+        if (rsrc_obj->encoding != ADC_ENCODING_RAW16) {
+            adc_codec_encode(rsrc_obj->encoding, (const uint8_t *) lanes->samples[l], lanes->counts[l], 0xFFF, data);
+        } else {
+            memcpy(data, lanes->samples[l], sizes[l]);
+        }
+        term_put_tuple_element(binaries, l, bin);
+    }
+    term msg = term_alloc_tuple(4, &heap);
+    term_put_tuple_element(msg, 0, globalcontext_make_atom(global, adc_stream_atom));
+    term_put_tuple_element(msg, 1, term_from_ref_ticks(rsrc_obj->ref_ticks, &heap));
+    term_put_tuple_element(msg, 2, binaries);
+    term_put_tuple_element(msg, 3, term_make_maybe_boxed_int64(lanes->out_of_order, &heap));
+    globalcontext_send_message_from_task(global, rsrc_obj->owner_process_id, NormalMessage, msg);
+    END_WITH_STACK_HEAP(heap, global);
+}
+
+//
+// adc:nif_stream_start/3
+//
+static term nif_stream_start(Context *ctx, int argc, term argv[])
+{
+    TRACE("nif_stream_start\n");
+    UNUSED(argc);
+    GlobalContext *global = ctx->global;
+
+    term adc_resource = argv[0];
+    struct ADCResource *rsrc_obj;
+    if (UNLIKELY(!to_adc_resource(adc_resource, &rsrc_obj, ctx))) {
+        ESP_LOGE(TAG, "Failed to convert adc_resource");
+        RAISE_ERROR(BADARG_ATOM);
+    }
+
+    term pins = argv[1];
+    VALIDATE_ARG(ctx, pins, term_is_list);
+    term stream_options = argv[2];
+    VALIDATE_ARG(ctx, stream_options, term_is_list);
+
+    // a unit whose backend has no streams of its own (oneshot) streams
+    // through the continuous driver
+    const struct ADCBackend *unit_backend = rsrc_obj->unit.shared->backend;
+    struct ADCStreamConfig config = {
+        .unit = rsrc_obj->unit.unit_id,
+        .num_channels = 0,
+        .backend = IS_NULL_PTR(unit_backend->stream_open) ? NULL : unit_backend,
+    };
+    while (term_is_nonempty_list(pins)) {
+        term pin = term_get_list_head(pins);
+        VALIDATE_ARG(ctx, pin, term_is_integer);
+        if (UNLIKELY(config.num_channels == SOC_ADC_PATT_LEN_MAX)) {
+            RETURN_BADARG(ctx);
+        }
+        const char *reason;
+        struct ADCChannel *channel = lookup_channel(rsrc_obj, pin, false, &reason);
+        // the pattern takes the channel number whole, so it must exist on the unit
+        if (!IS_NULL_PTR(channel) && UNLIKELY(channel->channel >= SOC_ADC_CHANNEL_NUM(config.unit))) {
+            reason = invalid_pin_atom;
+            channel = NULL;
+        }
+        if (UNLIKELY(IS_NULL_PTR(channel))) {
+            if (UNLIKELY(memory_ensure_free(ctx, TUPLE_SIZE(2)) != MEMORY_GC_OK)) {
                 RAISE_ERROR(OUT_OF_MEMORY_ATOM);
             } else {
-                return create_pair(ctx, ERROR_ATOM, globalcontext_make_atom(ctx->global, error_read));
+                return create_error_tuple(ctx, globalcontext_make_atom(global, reason));
+            }
+        }
+        config.channels[config.num_channels++] = channel->channel;
+        pins = term_get_list_tail(pins);
+    }
+    if (UNLIKELY(config.num_channels == 0)) {
+        RETURN_BADARG(ctx);
+    }
+
+    term owner = interop_kv_get_value(stream_options, ATOM_STR("\x5", "owner"), global);
+    VALIDATE_ARG(ctx, owner, term_is_pid);
+
+    term sample_freq_hz = interop_kv_get_value_default(stream_options, ATOM_STR("\xe", "sample_freq_hz"), term_from_int(ADC_STREAM_DEFAULT_SAMPLE_FREQ_HZ), global);
+    VALIDATE_ARG(ctx, sample_freq_hz, term_is_integer);
+    avm_int_t sample_freq_hz_val = term_to_int(sample_freq_hz);
+    if (UNLIKELY(sample_freq_hz_val < SOC_ADC_SAMPLE_FREQ_THRES_LOW || sample_freq_hz_val > SOC_ADC_SAMPLE_FREQ_THRES_HIGH)) {
+        if (UNLIKELY(memory_ensure_free(ctx, TUPLE_SIZE(2)) != MEMORY_GC_OK)) {
+            RAISE_ERROR(OUT_OF_MEMORY_ATOM);
+        } else {
+            return create_error_tuple(ctx, globalcontext_make_atom(global, invalid_rate_atom));
+        }
+    }
+    config.sample_freq_hz = sample_freq_hz_val;
+
+    term attenuation = interop_kv_get_value_default(stream_options, ATOM_STR("\xb", "attenuation"), globalcontext_make_atom(global, ATOM_STR("\x5", "db_12")), global);
+    VALIDATE_ARG(ctx, attenuation, term_is_atom);
+    config.atten = interop_atom_term_select_int(attenuation_table, attenuation, global);
+    if (UNLIKELY(config.atten == ADC_ATTEN_DB_12 + 1)) {
+        if (UNLIKELY(memory_ensure_free(ctx, TUPLE_SIZE(2)) != MEMORY_GC_OK)) {
+            RAISE_ERROR(OUT_OF_MEMORY_ATOM);
+        } else {
+            return create_error_tuple(ctx, globalcontext_make_atom(global, invalid_db_atom));
+        }
+    }
+
+    term frame_size = interop_kv_get_value_default(stream_options, ATOM_STR("\xa", "frame_size"), term_from_int(ADC_STREAM_DEFAULT_FRAME_SIZE), global);
+    VALIDATE_ARG(ctx, frame_size, term_is_integer);
+    term pool_size = interop_kv_get_value_default(stream_options, ATOM_STR("\x9", "pool_size"), term_from_int(ADC_STREAM_DEFAULT_POOL_SIZE), global);
+    VALIDATE_ARG(ctx, pool_size, term_is_integer);
+    if (UNLIKELY(term_to_int(frame_size) <= 0 || term_to_int(pool_size) < term_to_int(frame_size))) {
+        RETURN_BADARG(ctx);
+    }
+    config.frame_size = term_to_int(frame_size);
+    config.pool_size = term_to_int(pool_size);
+    config.timestamps = interop_kv_get_value_default(stream_options, ATOM_STR("\xa", "timestamps"), FALSE_ATOM, global) == TRUE_ATOM;
+    term encoding = interop_kv_get_value_default(stream_options, ATOM_STR("\x8", "encoding"), globalcontext_make_atom(global, ATOM_STR("\x5", "raw16")), global);
+    int encoding_val = interop_atom_term_select_int(encoding_table, encoding, global);
+    bool demux = interop_kv_get_value_default(stream_options, ATOM_STR("\x5", "demux"), FALSE_ATOM, global) == TRUE_ATOM;
+    // encoded frames drop the channel, so they need a stream of one pin, or
+    // a lane per pin, and hold no times; nor do demultiplexed ones
+    if (UNLIKELY(encoding_val < 0 || (demux && config.timestamps)
+            || (encoding_val != ADC_ENCODING_RAW16 && ((config.num_channels > 1 && !demux) || config.timestamps)))) {
+        RETURN_BADARG(ctx);
+    }
+    if (demux) {
+        // a lane per channel, so a pin may only appear once
+        for (size_t i = 0; i < config.num_channels; ++i) {
+            for (size_t j = 0; j < i; ++j) {
+                if (UNLIKELY(config.channels[i] == config.channels[j])) {
+                    RETURN_BADARG(ctx);
+                }
             }
         }
+        config.lanes_cb = adc_stream_send_lanes;
+    }
+    struct ADCCreditConfig credit;
+    bool limited;
+    if (UNLIKELY(!parse_credit_options(stream_options, &credit, &limited, global))) {
+        RETURN_BADARG(ctx);
+    }
+    config.credit = limited ? &credit : NULL;
+
+    // the stream runs its own copies of the channel filters
+    for (size_t i = 0; i < config.num_channels; ++i) {
+        adc_channel_t c = config.channels[i];
+        if (config.filters[c] != NULL) {
+            continue;
+        }
+        struct ADCFilterChain *filter = malloc(sizeof(struct ADCFilterChain));
+        if (IS_NULL_PTR(filter)) {
+            for (size_t j = 0; j < SOC_ADC_MAX_CHANNEL_NUM; ++j) {
+                free(config.filters[j]);
+            }
+            ESP_LOGW(TAG, "Failed to allocate memory: %s:%i.\n", __FILE__, __LINE__);
+            RAISE_ERROR(OUT_OF_MEMORY_ATOM);
+        }
+        if (adc_unit_copy_filter(&rsrc_obj->unit, &rsrc_obj->unit.channels[c], filter)) {
+            config.filters[c] = filter;
+        } else {
+            free(filter);
+        }
+    }
+
+    //
+    // allocate and start the stream resource
+    //
+
+    struct ADCStreamResource *stream_obj = enif_alloc_resource(adc_stream_resource_type, sizeof(struct ADCStreamResource));
+    if (IS_NULL_PTR(stream_obj)) {
+        for (size_t j = 0; j < SOC_ADC_MAX_CHANNEL_NUM; ++j) {
+            free(config.filters[j]);
+        }
+        ESP_LOGW(TAG, "Failed to allocate memory: %s:%i.\n", __FILE__, __LINE__);
+        RAISE_ERROR(OUT_OF_MEMORY_ATOM);
+    }
+    stream_obj->global = global;
+    stream_obj->owner_process_id = term_to_local_process_id(owner);
+    stream_obj->ref_ticks = globalcontext_get_ref_ticks(global);
+    stream_obj->encoding = encoding_val;
+
+    esp_err_t err = adc_stream_start(&stream_obj->stream, &config, adc_stream_send_frame, stream_obj);
+    if (UNLIKELY(err != ESP_OK)) {
+        enif_release_resource(stream_obj);
+        CHECK_ERROR(ctx, err, "nif_stream_start; adc_stream_start");
+    }
+
+    if (UNLIKELY(memory_ensure_free(ctx, TERM_BOXED_RESOURCE_SIZE) != MEMORY_GC_OK)) {
+        enif_release_resource(stream_obj);
+        ESP_LOGW(TAG, "Failed to allocate memory: %s:%i.\n", __FILE__, __LINE__);
+        RAISE_ERROR(OUT_OF_MEMORY_ATOM);
+    }
+    term obj = enif_make_resource(erl_nif_env_from_context(ctx), stream_obj);
+    enif_release_resource(stream_obj);
+
+    // {ok, {'$adc_stream', Resource :: resource(), Ref :: reference()}}
+    size_t requested_size = TUPLE_SIZE(2) + TUPLE_SIZE(3) + REF_SIZE;
+    if (UNLIKELY(memory_ensure_free_with_roots(ctx, requested_size, 1, &obj, MEMORY_CAN_SHRINK) != MEMORY_GC_OK)) {
+        ESP_LOGW(TAG, "Failed to allocate memory: %s:%i.\n", __FILE__, __LINE__);
+        RAISE_ERROR(OUT_OF_MEMORY_ATOM);
+    }
+
+    term stream_term = term_alloc_tuple(3, &ctx->heap);
+    term_put_tuple_element(stream_term, 0, globalcontext_make_atom(global, ADC_STREAM_ATOMSTR));
+    term_put_tuple_element(stream_term, 1, obj);
+    term_put_tuple_element(stream_term, 2, term_from_ref_ticks(stream_obj->ref_ticks, &ctx->heap));
+
+    return create_pair(ctx, OK_ATOM, stream_term);
+}
+
+//
+// adc:nif_stream_stop/1
+//
+static term nif_stream_stop(Context *ctx, int argc, term argv[])
+{
+    TRACE("nif_stream_stop\n");
+    UNUSED(argc);
+
+    struct ADCStreamResource *stream_obj;
+    if (UNLIKELY(!to_adc_stream_resource(argv[0], &stream_obj, ctx))) {
+        ESP_LOGE(TAG, "Failed to convert stream resource");
+        RAISE_ERROR(BADARG_ATOM);
+    }
+
+    adc_stream_stop(&stream_obj->stream);
+
+    return OK_ATOM;
+}
+
+//
+// adc:nif_stream_grant/2
+//
+static term nif_stream_grant(Context *ctx, int argc, term argv[])
+{
+    TRACE("nif_stream_grant\n");
+    UNUSED(argc);
+
+    struct ADCStreamResource *stream_obj;
+    if (UNLIKELY(!to_adc_stream_resource(argv[0], &stream_obj, ctx))) {
+        ESP_LOGE(TAG, "Failed to convert stream resource");
+        RAISE_ERROR(BADARG_ATOM);
+    }
+    uint32_t credits;
+    if (UNLIKELY(!to_grant(argv[1], &credits))) {
+        RAISE_ERROR(BADARG_ATOM);
+    }
+
+    if (UNLIKELY(!adc_stream_grant(&stream_obj->stream, credits))) {
+        if (UNLIKELY(memory_ensure_free(ctx, TUPLE_SIZE(2)) != MEMORY_GC_OK)) {
+            RAISE_ERROR(OUT_OF_MEMORY_ATOM);
+        } else {
+            return create_error_tuple(ctx, globalcontext_make_atom(ctx->global, no_flow_control_atom));
+        }
+    }
+
+    return OK_ATOM;
+}
+
+//
+// adc:nif_stream_info/1
+//
+static term nif_stream_info(Context *ctx, int argc, term argv[])
+{
+    TRACE("nif_stream_info\n");
+    UNUSED(argc);
+    GlobalContext *global = ctx->global;
+
+    struct ADCStreamResource *stream_obj;
+    if (UNLIKELY(!to_adc_stream_resource(argv[0], &stream_obj, ctx))) {
+        ESP_LOGE(TAG, "Failed to convert stream resource");
+        RAISE_ERROR(BADARG_ATOM);
+    }
+
+    // {ok, [{dropped, D}, {overflows, O}]}
+    size_t requested_size = TUPLE_SIZE(2) + LIST_SIZE(2, TUPLE_SIZE(2)) + 2 * BOXED_INT64_SIZE;
+    if (UNLIKELY(memory_ensure_free(ctx, requested_size) != MEMORY_GC_OK)) {
+        RAISE_ERROR(OUT_OF_MEMORY_ATOM);
+    }
+    term list = term_nil();
+    list = term_list_prepend(create_pair(ctx, globalcontext_make_atom(global, ATOM_STR("\x9", "overflows")),
+        term_make_maybe_boxed_int64(__atomic_load_n(&stream_obj->stream.overflows, __ATOMIC_RELAXED), &ctx->heap)), list, &ctx->heap);
+    list = term_list_prepend(create_pair(ctx, globalcontext_make_atom(global, ATOM_STR("\x7", "dropped")),
+        term_make_maybe_boxed_int64(adc_stream_dropped(&stream_obj->stream), &ctx->heap)), list, &ctx->heap);
+    return create_pair(ctx, OK_ATOM, list);
+}
+
+/*---------------------------------------------------------------
+        Sample Encodings
+---------------------------------------------------------------*/
+
+//
+// adc:nif_bytes_per_sample/1
+//
+// Sizes a capture binary in each encoding, without encoding it.
+//
+static term nif_bytes_per_sample(Context *ctx, int argc, term argv[])
+{
+    TRACE("nif_bytes_per_sample\n");
+    UNUSED(argc);
+    GlobalContext *global = ctx->global;
+
+    term samples = argv[0];
+    VALIDATE_VALUE(samples, term_is_binary);
+    size_t count = term_binary_size(samples) / sizeof(uint16_t);
+    if (UNLIKELY(count == 0)) {
+        RAISE_ERROR(BADARG_ATOM);
+    }
+
+    // [{raw16, B}, {packed12, B}, {delta, B}]
+    if (UNLIKELY(memory_ensure_free(ctx, LIST_SIZE(ADC_ENCODING_COUNT, TUPLE_SIZE(2) + FLOAT_SIZE)) != MEMORY_GC_OK)) {
+        RAISE_ERROR(OUT_OF_MEMORY_ATOM);
+    }
+    const uint8_t *data = (const uint8_t *) term_binary_data(samples);
+    term list = term_nil();
+    for (int encoding = ADC_ENCODING_COUNT - 1; encoding >= 0; --encoding) {
+        size_t size = adc_codec_encoded_size(encoding, data, count, 0xFFFF);
+        term value = term_from_float((avm_float_t) size / count, &ctx->heap);
+        list = term_list_prepend(create_pair(ctx, globalcontext_make_atom(global, encoding_table[encoding].as_str), value), list, &ctx->heap);
+    }
+    return list;
+}
+
+/*---------------------------------------------------------------
+        Watch Points
+---------------------------------------------------------------*/
+
+//
+// Runs on the watch task.  Sends {adc_watch, Pin, low | normal | high, Raw}
+// to the process that set the watch.
+//
+static void adc_watch_send_change(void *arg, int pin, int32_t owner, enum ADCWatchState state, uint32_t reading)
+{
+    struct ADCResource *rsrc_obj = (struct ADCResource *) arg;
+    GlobalContext *global = rsrc_obj->global;
+
+    const char *state_atom = state == ADC_WATCH_LOW ? low_atom : state == ADC_WATCH_HIGH ? high_atom : normal_atom;
+    BEGIN_WITH_STACK_HEAP(TUPLE_SIZE(4), heap);
+    term msg = term_alloc_tuple(4, &heap);
+    term_put_tuple_element(msg, 0, globalcontext_make_atom(global, adc_watch_atom));
+    term_put_tuple_element(msg, 1, term_from_int32(pin));
+    term_put_tuple_element(msg, 2, globalcontext_make_atom(global, state_atom));
+    term_put_tuple_element(msg, 3, term_from_int32(reading));
+    globalcontext_send_message_from_task(global, owner, NormalMessage, msg);
+    END_WITH_STACK_HEAP(heap, global);
+}
+
+//
+// adc:nif_watch/4
+//
+static term nif_watch(Context *ctx, int argc, term argv[])
+{
+    TRACE("nif_watch\n");
+    UNUSED(argc);
+    GlobalContext *global = ctx->global;
+
+    term adc_resource = argv[0];
+    struct ADCResource *rsrc_obj;
+    if (UNLIKELY(!to_adc_resource(adc_resource, &rsrc_obj, ctx))) {
+        ESP_LOGE(TAG, "Failed to convert adc_resource");
+        RAISE_ERROR(BADARG_ATOM);
+    }
+
+    term pin = argv[1];
+    VALIDATE_ARG(ctx, pin, term_is_integer);
+    const char *reason;
+    struct ADCChannel *channel = lookup_channel(rsrc_obj, pin, true, &reason);
+    if (UNLIKELY(IS_NULL_PTR(channel))) {
+        if (UNLIKELY(memory_ensure_free(ctx, TUPLE_SIZE(2)) != MEMORY_GC_OK)) {
+            RAISE_ERROR(OUT_OF_MEMORY_ATOM);
+        } else {
+            return create_error_tuple(ctx, globalcontext_make_atom(global, reason));
+        }
+    }
+
+    term watch_options = argv[2];
+    VALIDATE_ARG(ctx, watch_options, term_is_list);
+    term owner = argv[3];
+    VALIDATE_ARG(ctx, owner, term_is_pid);
+
+    term low = interop_kv_get_value_default(watch_options, ATOM_STR("\x3", "low"), term_from_int(0), global);
+    VALIDATE_ARG(ctx, low, term_is_integer);
+    term high = interop_kv_get_value_default(watch_options, ATOM_STR("\x4", "high"), term_from_int(UINT16_MAX), global);
+    VALIDATE_ARG(ctx, high, term_is_integer);
+    term hysteresis = interop_kv_get_value_default(watch_options, ATOM_STR("\xa", "hysteresis"), term_from_int(0), global);
+    VALIDATE_ARG(ctx, hysteresis, term_is_integer);
+    term period_ms = interop_kv_get_value_default(watch_options, ATOM_STR("\x9", "period_ms"), term_from_int(ADC_WATCH_DEFAULT_PERIOD_MS), global);
+    VALIDATE_ARG(ctx, period_ms, term_is_integer);
+    term samples = interop_kv_get_value_default(watch_options, ATOM_STR("\x7", "samples"), term_from_int(channel->samples), global);
+    VALIDATE_ARG(ctx, samples, term_is_integer);
+
+    avm_int_t low_val = term_to_int(low);
+    avm_int_t high_val = term_to_int(high);
+    avm_int_t hysteresis_val = term_to_int(hysteresis);
+    if (UNLIKELY(low_val < 0 || high_val > UINT16_MAX || low_val > high_val || hysteresis_val < 0 || hysteresis_val > UINT16_MAX
+            || term_to_int(period_ms) <= 0 || term_to_int(samples) <= 0)) {
+        if (UNLIKELY(memory_ensure_free(ctx, TUPLE_SIZE(2)) != MEMORY_GC_OK)) {
+            RAISE_ERROR(OUT_OF_MEMORY_ATOM);
+        } else {
+            return create_error_tuple(ctx, globalcontext_make_atom(global, invalid_threshold_atom));
+        }
+    }
+
+    struct ADCWatchConfig config = {
+        .low = (uint16_t) low_val,
+        .high = (uint16_t) high_val,
+        .hysteresis = (uint16_t) hysteresis_val,
+        .samples = term_to_int(samples),
+        .period_ms = term_to_int(period_ms),
+    };
+    esp_err_t err = adc_watcher_add(&rsrc_obj->watcher, channel, term_to_int(pin), term_to_local_process_id(owner), &config);
+
+    CHECK_ERROR(ctx, err, "nif_watch; adc_watcher_add");
+
+    return OK_ATOM;
+}
+
+//
+// adc:nif_unwatch/2
+//
+static term nif_unwatch(Context *ctx, int argc, term argv[])
+{
+    TRACE("nif_unwatch\n");
+    UNUSED(argc);
+    GlobalContext *global = ctx->global;
+
+    term adc_resource = argv[0];
+    struct ADCResource *rsrc_obj;
+    if (UNLIKELY(!to_adc_resource(adc_resource, &rsrc_obj, ctx))) {
+        ESP_LOGE(TAG, "Failed to convert adc_resource");
+        RAISE_ERROR(BADARG_ATOM);
+    }
+
+    term pin = argv[1];
+    VALIDATE_ARG(ctx, pin, term_is_integer);
+    const char *reason;
+    struct ADCChannel *channel = lookup_channel(rsrc_obj, pin, false, &reason);
+    if (UNLIKELY(IS_NULL_PTR(channel))) {
+        if (UNLIKELY(memory_ensure_free(ctx, TUPLE_SIZE(2)) != MEMORY_GC_OK)) {
+            RAISE_ERROR(OUT_OF_MEMORY_ATOM);
+        } else {
+            return create_error_tuple(ctx, globalcontext_make_atom(global, reason));
+        }
+    }
+
+    adc_watcher_remove(&rsrc_obj->watcher, channel);
+
+    return OK_ATOM;
+}
+
+/*---------------------------------------------------------------
+        Periodic Sampling
+---------------------------------------------------------------*/
+
+//
+// Runs on the sampler task.  Sends {adc_sched, Pin, Samples} to the subscriber,
+// with one little-endian uint16 reading per tick.
+//
+static void adc_sched_send_batch(void *arg, int pin, int32_t owner, const uint16_t *samples, size_t count)
+{
+    struct ADCResource *rsrc_obj = (struct ADCResource *) arg;
+    GlobalContext *global = rsrc_obj->global;
+    size_t size = count * sizeof(uint16_t);
+
+    BEGIN_WITH_STACK_HEAP(TUPLE_SIZE(3) + term_binary_heap_size(size), heap);
+    term msg = term_alloc_tuple(3, &heap);
+    term_put_tuple_element(msg, 0, globalcontext_make_atom(global, adc_sched_atom));
+    term_put_tuple_element(msg, 1, term_from_int32(pin));
+    term_put_tuple_element(msg, 2, term_from_literal_binary(samples, size, &heap, global));
+    globalcontext_send_message_from_task(global, owner, NormalMessage, msg);
+    END_WITH_STACK_HEAP(heap, global);
+}
+
+//
+// adc:nif_schedule/4
+//
+static term nif_schedule(Context *ctx, int argc, term argv[])
+{
+    TRACE("nif_schedule\n");
+    UNUSED(argc);
+    GlobalContext *global = ctx->global;
+
+    term adc_resource = argv[0];
+    struct ADCResource *rsrc_obj;
+    if (UNLIKELY(!to_adc_resource(adc_resource, &rsrc_obj, ctx))) {
+        ESP_LOGE(TAG, "Failed to convert adc_resource");
+        RAISE_ERROR(BADARG_ATOM);
+    }
+
+    term pin = argv[1];
+    VALIDATE_ARG(ctx, pin, term_is_integer);
+    const char *reason;
+    struct ADCChannel *channel = lookup_channel(rsrc_obj, pin, true, &reason);
+    if (UNLIKELY(IS_NULL_PTR(channel))) {
+        if (UNLIKELY(memory_ensure_free(ctx, TUPLE_SIZE(2)) != MEMORY_GC_OK)) {
+            RAISE_ERROR(OUT_OF_MEMORY_ATOM);
+        } else {
+            return create_error_tuple(ctx, globalcontext_make_atom(global, reason));
+        }
+    }
+
+    term sched_options = argv[2];
+    VALIDATE_ARG(ctx, sched_options, term_is_list);
+    term owner = argv[3];
+    VALIDATE_ARG(ctx, owner, term_is_pid);
+
+    // {period_us, N} takes precedence over {period_ms, N}
+    term period_ms = interop_kv_get_value_default(sched_options, ATOM_STR("\x9", "period_ms"), term_from_int(1000), global);
+    VALIDATE_ARG(ctx, period_ms, term_is_integer);
+    term period_us = interop_kv_get_value_default(sched_options, ATOM_STR("\x9", "period_us"), term_from_int(term_to_int(period_ms) * 1000), global);
+    VALIDATE_ARG(ctx, period_us, term_is_integer);
+    term samples = interop_kv_get_value_default(sched_options, ATOM_STR("\x7", "samples"), term_from_int(1), global);
+    VALIDATE_ARG(ctx, samples, term_is_integer);
+    term batch = interop_kv_get_value_default(sched_options, ATOM_STR("\x5", "batch"), term_from_int(ADC_SCHED_DEFAULT_BATCH), global);
+    VALIDATE_ARG(ctx, batch, term_is_integer);
+    if (UNLIKELY(term_to_int(period_us) <= 0 || term_to_int(samples) <= 0 || term_to_int(batch) <= 0)) {
+        RETURN_BADARG(ctx);
+    }
+    bool ring = interop_kv_get_value_default(sched_options, ATOM_STR("\x4", "ring"), FALSE_ATOM, global) == TRUE_ATOM;
+    bool record = interop_kv_get_value_default(sched_options, ATOM_STR("\x6", "record"), FALSE_ATOM, global) == TRUE_ATOM;
+    if (UNLIKELY(ring && record)) {
+        RETURN_BADARG(ctx);
+    }
+    enum ADCSchedSink sink = ring ? ADC_SCHED_RING : record ? ADC_SCHED_RECORD : ADC_SCHED_BATCH;
+    // only batches sent to the subscriber take credit
+    struct ADCCreditConfig credit;
+    bool limited;
+    if (UNLIKELY(!parse_credit_options(sched_options, &credit, &limited, global) || (limited && sink != ADC_SCHED_BATCH))) {
+        RETURN_BADARG(ctx);
+    }
+
+    esp_err_t err = adc_sched_add(&rsrc_obj->sched, channel, term_to_int(pin), term_to_local_process_id(owner),
+        term_to_int(period_us), term_to_int(samples), term_to_int(batch), sink, limited ? &credit : NULL);
+    if (UNLIKELY(err == ESP_ERR_INVALID_ARG)) {
+        if (UNLIKELY(memory_ensure_free(ctx, TUPLE_SIZE(2)) != MEMORY_GC_OK)) {
+            RAISE_ERROR(OUT_OF_MEMORY_ATOM);
+        } else {
+            return create_error_tuple(ctx, globalcontext_make_atom(global, invalid_rate_atom));
+        }
+    }
+    if (UNLIKELY(err == ESP_ERR_INVALID_STATE)) {
+        if (UNLIKELY(memory_ensure_free(ctx, TUPLE_SIZE(2)) != MEMORY_GC_OK)) {
+            RAISE_ERROR(OUT_OF_MEMORY_ATOM);
+        } else {
+            return create_error_tuple(ctx, globalcontext_make_atom(global, not_open_atom));
+        }
+    }
+
+    CHECK_ERROR(ctx, err, "nif_schedule; adc_sched_add");
+
+    return OK_ATOM;
+}
+
+//
+// adc:nif_unschedule/2
+//
+static term nif_unschedule(Context *ctx, int argc, term argv[])
+{
+    TRACE("nif_unschedule\n");
+    UNUSED(argc);
+    GlobalContext *global = ctx->global;
+
+    term adc_resource = argv[0];
+    struct ADCResource *rsrc_obj;
+    if (UNLIKELY(!to_adc_resource(adc_resource, &rsrc_obj, ctx))) {
+        ESP_LOGE(TAG, "Failed to convert adc_resource");
+        RAISE_ERROR(BADARG_ATOM);
+    }
+
+    term pin = argv[1];
+    VALIDATE_ARG(ctx, pin, term_is_integer);
+    const char *reason;
+    struct ADCChannel *channel = lookup_channel(rsrc_obj, pin, false, &reason);
+    if (UNLIKELY(IS_NULL_PTR(channel))) {
+        if (UNLIKELY(memory_ensure_free(ctx, TUPLE_SIZE(2)) != MEMORY_GC_OK)) {
+            RAISE_ERROR(OUT_OF_MEMORY_ATOM);
+        } else {
+            return create_error_tuple(ctx, globalcontext_make_atom(global, reason));
+        }
+    }
+
+    adc_sched_remove(&rsrc_obj->sched, channel);
+
+    return OK_ATOM;
+}
+
+//
+// adc:nif_grant/3
+//
+static term nif_grant(Context *ctx, int argc, term argv[])
+{
+    TRACE("nif_grant\n");
+    UNUSED(argc);
+    GlobalContext *global = ctx->global;
+
+    term adc_resource = argv[0];
+    struct ADCResource *rsrc_obj;
+    if (UNLIKELY(!to_adc_resource(adc_resource, &rsrc_obj, ctx))) {
+        ESP_LOGE(TAG, "Failed to convert adc_resource");
+        RAISE_ERROR(BADARG_ATOM);
+    }
+
+    term pin = argv[1];
+    VALIDATE_ARG(ctx, pin, term_is_integer);
+    uint32_t credits;
+    if (UNLIKELY(!to_grant(argv[2], &credits))) {
+        RETURN_BADARG(ctx);
+    }
+    const char *reason;
+    struct ADCChannel *channel = lookup_channel(rsrc_obj, pin, false, &reason);
+    if (!IS_NULL_PTR(channel) && !adc_sched_grant(&rsrc_obj->sched, channel, credits)) {
+        reason = no_flow_control_atom;
+        channel = NULL;
+    }
+    if (UNLIKELY(IS_NULL_PTR(channel))) {
+        if (UNLIKELY(memory_ensure_free(ctx, TUPLE_SIZE(2)) != MEMORY_GC_OK)) {
+            RAISE_ERROR(OUT_OF_MEMORY_ATOM);
+        } else {
+            return create_error_tuple(ctx, globalcontext_make_atom(global, reason));
+        }
+    }
+
+    return OK_ATOM;
+}
+
+//
+// adc:nif_schedule_info/2
+//
+static term nif_schedule_info(Context *ctx, int argc, term argv[])
+{
+    TRACE("nif_schedule_info\n");
+    UNUSED(argc);
+    GlobalContext *global = ctx->global;
+
+    term adc_resource = argv[0];
+    struct ADCResource *rsrc_obj;
+    if (UNLIKELY(!to_adc_resource(adc_resource, &rsrc_obj, ctx))) {
+        ESP_LOGE(TAG, "Failed to convert adc_resource");
+        RAISE_ERROR(BADARG_ATOM);
+    }
+
+    term pin = argv[1];
+    VALIDATE_ARG(ctx, pin, term_is_integer);
+    const char *reason;
+    struct ADCChannel *channel = lookup_channel(rsrc_obj, pin, false, &reason);
+    struct ADCSchedInfo info;
+    if (!IS_NULL_PTR(channel) && !adc_sched_info(&rsrc_obj->sched, channel, &info)) {
+        reason = not_scheduled_atom;
+        channel = NULL;
+    }
+    if (UNLIKELY(IS_NULL_PTR(channel))) {
+        if (UNLIKELY(memory_ensure_free(ctx, TUPLE_SIZE(2)) != MEMORY_GC_OK)) {
+            RAISE_ERROR(OUT_OF_MEMORY_ATOM);
+        } else {
+            return create_error_tuple(ctx, globalcontext_make_atom(global, reason));
+        }
+    }
+
+    // {ok, [{period_us, P}, {ticks, T}, {missed, M}, {errors, E}, {max_jitter_us, J}, {mean_jitter_us, MJ}, {dropped, D}]}
+    size_t requested_size = TUPLE_SIZE(2) + LIST_SIZE(7, TUPLE_SIZE(2)) + 3 * BOXED_INT64_SIZE;
+    if (UNLIKELY(memory_ensure_free(ctx, requested_size) != MEMORY_GC_OK)) {
+        RAISE_ERROR(OUT_OF_MEMORY_ATOM);
+    }
+    uint64_t mean_jitter = info.ticks > 0 ? info.total_jitter_us / info.ticks : 0;
+    const char *keys[] = {
+        ATOM_STR("\x7", "dropped"),
+        ATOM_STR("\xe", "mean_jitter_us"),
+        ATOM_STR("\xd", "max_jitter_us"),
+        ATOM_STR("\x6", "errors"),
+        ATOM_STR("\x6", "missed"),
+        ATOM_STR("\x5", "ticks"),
+        ATOM_STR("\x9", "period_us"),
+    };
+    term values[] = {
+        term_make_maybe_boxed_int64(info.dropped, &ctx->heap),
+        term_make_maybe_boxed_int64(mean_jitter, &ctx->heap),
+        term_from_int32(info.max_jitter_us),
+        term_from_int32(info.errors),
+        term_from_int32(info.missed),
+        term_make_maybe_boxed_int64(info.ticks, &ctx->heap),
+        term_from_int32(info.period_us),
+    };
+    term list = term_nil();
+    for (size_t i = 0; i < sizeof(values) / sizeof(values[0]); ++i) {
+        list = term_list_prepend(create_pair(ctx, globalcontext_make_atom(global, keys[i]), values[i]), list, &ctx->heap);
+    }
+    return create_pair(ctx, OK_ATOM, list);
+}
+
+//
+// adc:nif_drain/2
+//
+// Moves what the sampler task has put in the ring into a single binary.  Calls
+// are serialized by the gen_server, which makes this the only consumer.
+//
+static term nif_drain(Context *ctx, int argc, term argv[])
+{
+    TRACE("nif_drain\n");
+    UNUSED(argc);
+    GlobalContext *global = ctx->global;
+
+    term adc_resource = argv[0];
+    struct ADCResource *rsrc_obj;
+    if (UNLIKELY(!to_adc_resource(adc_resource, &rsrc_obj, ctx))) {
+        ESP_LOGE(TAG, "Failed to convert adc_resource");
+        RAISE_ERROR(BADARG_ATOM);
+    }
+
+    term drain_options = argv[1];
+    VALIDATE_ARG(ctx, drain_options, term_is_list);
+    term max = interop_kv_get_value_default(drain_options, ATOM_STR("\x3", "max"), term_from_int(ADC_SCHED_RING_SIZE), global);
+    VALIDATE_ARG(ctx, max, term_is_integer);
+    if (UNLIKELY(term_to_int(max) <= 0)) {
+        RETURN_BADARG(ctx);
+    }
+
+    // entries may only be added meanwhile, so all of these can be drained below
+    size_t count = adc_sched_ring_count(&rsrc_obj->sched);
+    if (count > (size_t) term_to_int(max)) {
+        count = term_to_int(max);
+    }
+    size_t size = count * sizeof(struct ADCRingEntry);
+    if (UNLIKELY(memory_ensure_free(ctx, TUPLE_SIZE(2) + term_binary_heap_size(size)) != MEMORY_GC_OK)) {
+        RAISE_ERROR(OUT_OF_MEMORY_ATOM);
+    }
+    term bin = term_create_uninitialized_binary(size, &ctx->heap, global);
+    adc_sched_drain(&rsrc_obj->sched, (void *) term_binary_data(bin), count);
+    return create_pair(ctx, OK_ATOM, bin);
+}
+
+//
+// adc:nif_ring_info/1
+//
+static term nif_ring_info(Context *ctx, int argc, term argv[])
+{
+    TRACE("nif_ring_info\n");
+    UNUSED(argc);
+    GlobalContext *global = ctx->global;
+
+    term adc_resource = argv[0];
+    struct ADCResource *rsrc_obj;
+    if (UNLIKELY(!to_adc_resource(adc_resource, &rsrc_obj, ctx))) {
+        ESP_LOGE(TAG, "Failed to convert adc_resource");
+        RAISE_ERROR(BADARG_ATOM);
+    }
+
+    struct ADCRingInfo info;
+    adc_sched_ring_info(&rsrc_obj->sched, &info);
+
+    // {ok, [{size, S}, {count, C}, {overruns, O}, {high_water, H}]}
+    size_t requested_size = TUPLE_SIZE(2) + LIST_SIZE(4, TUPLE_SIZE(2)) + BOXED_INT64_SIZE;
+    if (UNLIKELY(memory_ensure_free(ctx, requested_size) != MEMORY_GC_OK)) {
+        RAISE_ERROR(OUT_OF_MEMORY_ATOM);
+    }
+    const char *keys[] = {
+        ATOM_STR("\xa", "high_water"),
+        ATOM_STR("\x8", "overruns"),
+        ATOM_STR("\x5", "count"),
+        ATOM_STR("\x4", "size"),
+    };
+    term values[] = {
+        term_from_int32(info.high_water),
+        term_make_maybe_boxed_int64(info.overruns, &ctx->heap),
+        term_from_int32(info.count),
+        term_from_int32(info.size),
+    };
+    term list = term_nil();
+    for (size_t i = 0; i < sizeof(values) / sizeof(values[0]); ++i) {
+        list = term_list_prepend(create_pair(ctx, globalcontext_make_atom(global, keys[i]), values[i]), list, &ctx->heap);
+    }
+    return create_pair(ctx, OK_ATOM, list);
+}
+
+/*---------------------------------------------------------------
+        Flash Recorder
+---------------------------------------------------------------*/
+
+// blocks returned by one recorder_read
+#define RECORDER_MAX_READ 256
+
+//
+// adc:nif_recorder_open/2
+//
+static term nif_recorder_open(Context *ctx, int argc, term argv[])
+{
+    TRACE("nif_recorder_open\n");
+    UNUSED(argc);
+
+    term adc_resource = argv[0];
+    struct ADCResource *rsrc_obj;
+    if (UNLIKELY(!to_adc_resource(adc_resource, &rsrc_obj, ctx))) {
+        ESP_LOGE(TAG, "Failed to convert adc_resource");
+        RAISE_ERROR(BADARG_ATOM);
+    }
+
+    term label = argv[1];
+    VALIDATE_ARG(ctx, label, term_is_binary);
+    char label_str[sizeof(((esp_partition_t *) NULL)->label)];
+    size_t len = term_binary_size(label);
+    if (UNLIKELY(len == 0 || len >= sizeof(label_str))) {
+        RETURN_BADARG(ctx);
+    }
+    memcpy(label_str, term_binary_data(label), len);
+    label_str[len] = '\0';
+
+    // calls are serialized by the gen_server, so the recorder cannot be opened twice at once
+    esp_err_t err = adc_recorder_open(&rsrc_obj->recorder, label_str);
+    CHECK_ERROR(ctx, err, "nif_recorder_open; adc_recorder_open");
+
+    return OK_ATOM;
+}
+
+//
+// adc:nif_recorder_read/2
+//
+// The samples of each block are copied out of the mapping, which the writer
+// reuses once the log wraps; a block it wrapped over meanwhile is left out.
+//
+static term nif_recorder_read(Context *ctx, int argc, term argv[])
+{
+    TRACE("nif_recorder_read\n");
+    UNUSED(argc);
+    GlobalContext *global = ctx->global;
+
+    term adc_resource = argv[0];
+    struct ADCResource *rsrc_obj;
+    if (UNLIKELY(!to_adc_resource(adc_resource, &rsrc_obj, ctx))) {
+        ESP_LOGE(TAG, "Failed to convert adc_resource");
+        RAISE_ERROR(BADARG_ATOM);
+    }
+
+    term read_options = argv[1];
+    VALIDATE_ARG(ctx, read_options, term_is_list);
+    term from = interop_kv_get_value_default(read_options, ATOM_STR("\x4", "from"), term_from_int(0), global);
+    VALIDATE_ARG(ctx, from, term_is_any_integer);
+    term max = interop_kv_get_value_default(read_options, ATOM_STR("\x3", "max"), term_from_int(32), global);
+    VALIDATE_ARG(ctx, max, term_is_integer);
+    avm_int64_t from_seq = term_maybe_unbox_int64(from);
+    if (UNLIKELY(from_seq < 0 || from_seq > UINT32_MAX || term_to_int(max) <= 0)) {
+        RETURN_BADARG(ctx);
+    }
+
+    struct ADCRecorder *recorder = &rsrc_obj->recorder;
+    if (UNLIKELY(!adc_recorder_is_open(recorder))) {
+        if (UNLIKELY(memory_ensure_free(ctx, TUPLE_SIZE(2)) != MEMORY_GC_OK)) {
+            RAISE_ERROR(OUT_OF_MEMORY_ATOM);
+        } else {
+            return create_error_tuple(ctx, globalcontext_make_atom(global, not_open_atom));
+        }
+    }
+
+    size_t max_blocks = term_to_int(max) < RECORDER_MAX_READ ? (size_t) term_to_int(max) : RECORDER_MAX_READ;
+    struct ADCRecorderBlock *blocks = malloc(max_blocks * sizeof(struct ADCRecorderBlock));
+    if (IS_NULL_PTR(blocks)) {
+        RAISE_ERROR(OUT_OF_MEMORY_ATOM);
+    }
+    size_t count = adc_recorder_read(recorder, (uint32_t) from_seq, blocks, max_blocks);
+
+    // {ok, [{Seq, Pin, TimeUs, PeriodUs, Samples}]}
+    size_t requested_size = TUPLE_SIZE(2);
+    for (size_t i = 0; i < count; ++i) {
+        requested_size += LIST_SIZE(1, TUPLE_SIZE(5) + 2 * BOXED_INT64_SIZE)
+            + term_binary_heap_size(blocks[i].count * sizeof(uint16_t));
+    }
+    if (UNLIKELY(memory_ensure_free(ctx, requested_size) != MEMORY_GC_OK)) {
+        free(blocks);
+        RAISE_ERROR(OUT_OF_MEMORY_ATOM);
+    }
+    term list = term_nil();
+    for (size_t i = count; i-- > 0;) {
+        const struct ADCRecorderBlock *block = &blocks[i];
+        term samples = term_create_uninitialized_binary(block->count * sizeof(uint16_t), &ctx->heap, global);
+        if (!adc_recorder_copy(recorder, block, (uint16_t *) term_binary_data(samples))) {
+            continue;
+        }
+        term block_tuple = term_alloc_tuple(5, &ctx->heap);
+        term_put_tuple_element(block_tuple, 0, term_make_maybe_boxed_int64(block->seq, &ctx->heap));
+        term_put_tuple_element(block_tuple, 1, term_from_int32(block->pin));
+        term_put_tuple_element(block_tuple, 2, term_make_maybe_boxed_int64(block->time_us, &ctx->heap));
+        term_put_tuple_element(block_tuple, 3, term_from_int32(block->period_us));
+        term_put_tuple_element(block_tuple, 4, samples);
+        list = term_list_prepend(block_tuple, list, &ctx->heap);
+    }
+    free(blocks);
+    return create_pair(ctx, OK_ATOM, list);
+}
+
+//
+// adc:nif_recorder_info/1
+//
+static term nif_recorder_info(Context *ctx, int argc, term argv[])
+{
+    TRACE("nif_recorder_info\n");
+    UNUSED(argc);
+    GlobalContext *global = ctx->global;
+
+    term adc_resource = argv[0];
+    struct ADCResource *rsrc_obj;
+    if (UNLIKELY(!to_adc_resource(adc_resource, &rsrc_obj, ctx))) {
+        ESP_LOGE(TAG, "Failed to convert adc_resource");
+        RAISE_ERROR(BADARG_ATOM);
+    }
+
+    if (UNLIKELY(!adc_recorder_is_open(&rsrc_obj->recorder))) {
+        if (UNLIKELY(memory_ensure_free(ctx, TUPLE_SIZE(2)) != MEMORY_GC_OK)) {
+            RAISE_ERROR(OUT_OF_MEMORY_ATOM);
+        } else {
+            return create_error_tuple(ctx, globalcontext_make_atom(global, not_open_atom));
+        }
+    }
+    struct ADCRecorderInfo info;
+    adc_recorder_info(&rsrc_obj->recorder, &info);
+
+    // {ok, [{size, S}, {used, U}, {blocks, B}, {first_seq, F}, {next_seq, N}, {dropped, D}, {write_errors, E}]}
+    size_t requested_size = TUPLE_SIZE(2) + LIST_SIZE(7, TUPLE_SIZE(2)) + 7 * BOXED_INT64_SIZE;
+    if (UNLIKELY(memory_ensure_free(ctx, requested_size) != MEMORY_GC_OK)) {
+        RAISE_ERROR(OUT_OF_MEMORY_ATOM);
+    }
+    const char *keys[] = {
+        ATOM_STR("\xc", "write_errors"),
+        ATOM_STR("\x7", "dropped"),
+        ATOM_STR("\x8", "next_seq"),
+        ATOM_STR("\x9", "first_seq"),
+        ATOM_STR("\x6", "blocks"),
+        ATOM_STR("\x4", "used"),
+        ATOM_STR("\x4", "size"),
+    };
+    uint32_t values[] = {
+        info.write_errors,
+        info.dropped,
+        info.next_seq,
+        info.first_seq,
+        info.blocks,
+        info.used,
+        info.size,
+    };
+    term list = term_nil();
+    for (size_t i = 0; i < sizeof(values) / sizeof(values[0]); ++i) {
+        term value = term_make_maybe_boxed_int64(values[i], &ctx->heap);
+        list = term_list_prepend(create_pair(ctx, globalcontext_make_atom(global, keys[i]), value), list, &ctx->heap);
+    }
+    return create_pair(ctx, OK_ATOM, list);
+}
+
+/*---------------------------------------------------------------
+        Metrics
+---------------------------------------------------------------*/
+
+// {Pin, [{reads, R}, {samples, S}, {errors, [{Reason, N}]}, {time_us, T}, {max_us, M}, {latency_us, {...}}]}
+#define METRICS_ENTRY_SIZE                                                          \
+    (TUPLE_SIZE(2) + CONS_SIZE + LIST_SIZE(6, TUPLE_SIZE(2)) + 4 * BOXED_INT64_SIZE \
+        + LIST_SIZE(ADC_METRICS_MAX_ERROR_CODES + 1, TUPLE_SIZE(2))                  \
+        + (ADC_METRICS_MAX_ERROR_CODES + 1) * BOXED_INT64_SIZE                      \
+        + TUPLE_SIZE(ADC_METRICS_LATENCY_BUCKETS) + ADC_METRICS_LATENCY_BUCKETS * BOXED_INT64_SIZE)
+
+static term make_metrics(Context *ctx, const struct ADCMetrics *metrics)
+{
+    GlobalContext *global = ctx->global;
+
+    term errors = term_nil();
+    uint32_t counted = 0;
+    for (int i = ADC_METRICS_MAX_ERROR_CODES - 1; i >= 0; --i) {
+        const struct ADCMetricsError *entry = &metrics->error_codes[i];
+        if (entry->count > 0) {
+            counted += entry->count;
+            term count = term_make_maybe_boxed_int64(entry->count, &ctx->heap);
+            errors = term_list_prepend(create_pair(ctx, esp_err_to_term(global, entry->err), count), errors, &ctx->heap);
+        }
+    }
+    if (metrics->errors > counted) {
+        term count = term_make_maybe_boxed_int64(metrics->errors - counted, &ctx->heap);
+        errors = term_list_prepend(create_pair(ctx, globalcontext_make_atom(global, ATOM_STR("\x5", "other")), count), errors, &ctx->heap);
+    }
+
+    term latency = term_alloc_tuple(ADC_METRICS_LATENCY_BUCKETS, &ctx->heap);
+    for (int i = 0; i < ADC_METRICS_LATENCY_BUCKETS; ++i) {
+        term_put_tuple_element(latency, i, term_make_maybe_boxed_int64(metrics->latency[i], &ctx->heap));
+    }
+
+    const char *keys[] = {
+        ATOM_STR("\xa", "latency_us"),
+        ATOM_STR("\x6", "max_us"),
+        ATOM_STR("\x7", "time_us"),
+        ATOM_STR("\x6", "errors"),
+        ATOM_STR("\x7", "samples"),
+        ATOM_STR("\x5", "reads"),
+    };
+    term values[] = {
+        latency,
+        term_make_maybe_boxed_int64(metrics->max_us, &ctx->heap),
+        term_make_maybe_boxed_int64(metrics->time_us, &ctx->heap),
+        errors,
+        term_make_maybe_boxed_int64(metrics->samples, &ctx->heap),
+        term_make_maybe_boxed_int64(metrics->reads, &ctx->heap),
+    };
+    term list = term_nil();
+    for (size_t i = 0; i < sizeof(values) / sizeof(values[0]); ++i) {
+        list = term_list_prepend(create_pair(ctx, globalcontext_make_atom(global, keys[i]), values[i]), list, &ctx->heap);
+    }
+    return list;
+}
+
+//
+// adc:nif_stats/1
+//
+// Counters of every pin of the unit that has been read since the last reset.
+//
+static term nif_stats(Context *ctx, int argc, term argv[])
+{
+    TRACE("nif_stats\n");
+    UNUSED(argc);
+    GlobalContext *global = ctx->global;
+
+    term adc_resource = argv[0];
+    struct ADCResource *rsrc_obj;
+    if (UNLIKELY(!to_adc_resource(adc_resource, &rsrc_obj, ctx))) {
+        ESP_LOGE(TAG, "Failed to convert adc_resource");
+        RAISE_ERROR(BADARG_ATOM);
+    }
+
+    // the counters live with the unit, which a direct call may find closed
+    if (UNLIKELY(!adc_resource_get_unit(rsrc_obj))) {
+        RAISE_ERROR(BADARG_ATOM);
+    }
+
+    // snapshot first, so the heap is sized for what is returned
+    struct ADCMetrics metrics[SOC_ADC_MAX_CHANNEL_NUM];
+    int pins[SOC_ADC_MAX_CHANNEL_NUM];
+    size_t num_entries = 0;
+    bool enabled = true;
+    for (int pin = SOC_GPIO_PIN_COUNT - 1; enabled && pin >= 0 && num_entries < SOC_ADC_MAX_CHANNEL_NUM; --pin) {
+        struct ADCChannel *channel = adc_unit_channel(&rsrc_obj->unit, pin);
+        if (IS_NULL_PTR(channel)) {
+            continue;
+        }
+        enabled = adc_unit_get_metrics(&rsrc_obj->unit, channel, &metrics[num_entries]);
+        if (enabled && metrics[num_entries].reads > 0) {
+            pins[num_entries++] = pin;
+        }
+    }
+    adc_resource_put_unit(rsrc_obj);
 
-    adc_reading /= samples_val;
-    TRACE("take_reading adc_reading: %i\n", adc_reading);
+    if (UNLIKELY(!enabled)) {
+        if (UNLIKELY(memory_ensure_free(ctx, TUPLE_SIZE(2)) != MEMORY_GC_OK)) {
+            RAISE_ERROR(OUT_OF_MEMORY_ATOM);
+        } else {
+            return create_error_tuple(ctx, globalcontext_make_atom(global, metrics_disabled_atom));
+        }
+    }
 
-    raw = raw == TRUE_ATOM ? term_from_int32(adc_reading) : UNDEFINED_ATOM;
-    if (voltage == TRUE_ATOM) {
-        //adc_cali_raw_to_voltage(rsrc_obj->adc_handle, channel, &AdcVoltageChannel);
-        voltage = term_from_int32(AdcVoltageChannel);
-    } else {
-        voltage = UNDEFINED_ATOM;
-    };
+    if (UNLIKELY(memory_ensure_free(ctx, TUPLE_SIZE(2) + num_entries * METRICS_ENTRY_SIZE) != MEMORY_GC_OK)) {
+        RAISE_ERROR(OUT_OF_MEMORY_ATOM);
+    }
+    // pins were visited in descending order, so prepending yields them ascending
+    term list = term_nil();
+    for (size_t i = 0; i < num_entries; ++i) {
+        term entry = create_pair(ctx, term_from_int32(pins[i]), make_metrics(ctx, &metrics[i]));
+        list = term_list_prepend(entry, list, &ctx->heap);
+    }
+    return create_pair(ctx, OK_ATOM, list);
+}
+
+//
+// adc:nif_reset_stats/1
+//
+static term nif_reset_stats(Context *ctx, int argc, term argv[])
+{
+    TRACE("nif_reset_stats\n");
+    UNUSED(argc);
+
+    term adc_resource = argv[0];
+    struct ADCResource *rsrc_obj;
+    if (UNLIKELY(!to_adc_resource(adc_resource, &rsrc_obj, ctx))) {
+        ESP_LOGE(TAG, "Failed to convert adc_resource");
+        RAISE_ERROR(BADARG_ATOM);
+    }
+
+    if (UNLIKELY(!adc_unit_reset_metrics(&rsrc_obj->unit))) {
+        if (UNLIKELY(memory_ensure_free(ctx, TUPLE_SIZE(2)) != MEMORY_GC_OK)) {
+            RAISE_ERROR(OUT_OF_MEMORY_ATOM);
+        } else {
+            return create_error_tuple(ctx, globalcontext_make_atom(ctx->global, metrics_disabled_atom));
+        }
+    }
+    return OK_ATOM;
+}
+
+/*---------------------------------------------------------------
+        ADC2 and Wi-Fi
+---------------------------------------------------------------*/
+
+#ifdef CONFIG_AVM_ADC2_ENABLE
+struct ADCHandover
+{
+    GlobalContext *global;
+    int32_t owner_process_id;
+    uint64_t ref_ticks;
+};
+
+// sends {adc2_released, Ref, ok | {error, Reason}} once the reads that held
+// ADC2 when it was handed to Wi-Fi have ended
+static void adc_handover_done(void *arg, esp_err_t err)
+{
+    struct ADCHandover *handover = (struct ADCHandover *) arg;
+    GlobalContext *global = handover->global;
+
+    BEGIN_WITH_STACK_HEAP(TUPLE_SIZE(3) + REF_SIZE + TUPLE_SIZE(2), heap);
+    term result = OK_ATOM;
+    if (err != ESP_OK) {
+        result = term_alloc_tuple(2, &heap);
+        term_put_tuple_element(result, 0, ERROR_ATOM);
+        term_put_tuple_element(result, 1, esp_err_to_term(global, err));
+    }
+    term msg = term_alloc_tuple(3, &heap);
+    term_put_tuple_element(msg, 0, globalcontext_make_atom(global, adc2_released_atom));
+    term_put_tuple_element(msg, 1, term_from_ref_ticks(handover->ref_ticks, &heap));
+    term_put_tuple_element(msg, 2, result);
+    globalcontext_send_message_from_task(global, handover->owner_process_id, NormalMessage, msg);
+    END_WITH_STACK_HEAP(heap, global);
+
+    free(handover);
+}
+#endif
+
+//
+// adc:nif_wifi_acquire/1
+//
+// Never waits: ADC2 reads may hold the unit for a whole capture, so if any
+// are in progress this returns {ok, Ref}, and the last of them to end sends
+// Owner an adc2_released message tagged with Ref.  Without ADC2 in the build
+// there is nothing to hand over.
+//
+static term nif_wifi_acquire(Context *ctx, int argc, term argv[])
+{
+    TRACE("nif_wifi_acquire\n");
+    UNUSED(argc);
+
+    term owner = argv[0];
+    VALIDATE_VALUE(owner, term_is_pid);
 
-    if (UNLIKELY(memory_ensure_free(ctx, TUPLE_SIZE(3)) != MEMORY_GC_OK)) {
+#ifdef CONFIG_AVM_ADC2_ENABLE
+    struct ADCHandover *handover = malloc(sizeof(struct ADCHandover));
+    if (IS_NULL_PTR(handover)) {
         RAISE_ERROR(OUT_OF_MEMORY_ATOM);
-    } else {
-        return create_pair(ctx, raw, voltage);
     }
+    uint64_t ref_ticks = globalcontext_get_ref_ticks(ctx->global);
+    handover->global = ctx->global;
+    handover->owner_process_id = term_to_local_process_id(owner);
+    handover->ref_ticks = ref_ticks;
+    bool pending = false;
+    esp_err_t err = adc_arbiter_wifi_acquire(adc_handover_done, handover, &pending);
+    // once pending, handover belongs to the arbiter and may be freed already
+    if (err != ESP_OK || !pending) {
+        free(handover);
+    }
+    CHECK_ERROR(ctx, err, "Failed to hand ADC2 to Wi-Fi");
+    if (pending) {
+        if (UNLIKELY(memory_ensure_free(ctx, TUPLE_SIZE(2) + REF_SIZE) != MEMORY_GC_OK)) {
+            RAISE_ERROR(OUT_OF_MEMORY_ATOM);
+        }
+        return create_pair(ctx, OK_ATOM, term_from_ref_ticks(ref_ticks, &ctx->heap));
+    }
+#else
+    UNUSED(ctx);
+#endif
+    return OK_ATOM;
+}
+
+//
+// adc:nif_wifi_release/0
+//
+static term nif_wifi_release(Context *ctx, int argc, term argv[])
+{
+    TRACE("nif_wifi_release\n");
+    UNUSED(argc);
+    UNUSED(argv);
+
+#ifdef CONFIG_AVM_ADC2_ENABLE
+    esp_err_t err = adc_arbiter_wifi_release();
+    CHECK_ERROR(ctx, err, "Failed to serve reads parked on ADC2");
+#else
+    UNUSED(ctx);
+#endif
+    return OK_ATOM;
+}
+
+//
+// adc:nif_wifi_owned/0
+//
+static term nif_wifi_owned(Context *ctx, int argc, term argv[])
+{
+    UNUSED(ctx);
+    UNUSED(argc);
+    UNUSED(argv);
+
+#ifdef CONFIG_AVM_ADC2_ENABLE
+    return adc_arbiter_wifi_owned() ? TRUE_ATOM : FALSE_ATOM;
+#else
+    return FALSE_ATOM;
+#endif
+}
+
+/*---------------------------------------------------------------
+        Simulator
+---------------------------------------------------------------*/
+
+static bool to_sim_level(term t, uint16_t *level)
+{
+    if (!term_is_integer(t) || term_to_int(t) < 0 || term_to_int(t) > 0xFFF) {
+        return false;
+    }
+    *level = term_to_int(t);
+    return true;
+}
+
+//
+// adc:nif_simulate/3
+//
+// Signal is off, {sine | square, Offset, Amplitude, FreqHz},
+// {noise, Offset, Amplitude} or {replay, Samples | Path, RateHz}.  The
+// signal drives the channel on every simulator unit of the peripheral, so
+// only a bus opened on the simulator may set it.
+//
+static term nif_simulate(Context *ctx, int argc, term argv[])
+{
+    TRACE("nif_simulate\n");
+    UNUSED(argc);
+    GlobalContext *global = ctx->global;
+
+    term adc_resource = argv[0];
+    struct ADCResource *rsrc_obj;
+    if (UNLIKELY(!to_adc_resource(adc_resource, &rsrc_obj, ctx))) {
+        ESP_LOGE(TAG, "Failed to convert adc_resource");
+        RAISE_ERROR(BADARG_ATOM);
+    }
+    if (UNLIKELY(rsrc_obj->unit.shared->backend != &adc_backend_sim)) {
+        if (UNLIKELY(memory_ensure_free(ctx, TUPLE_SIZE(2)) != MEMORY_GC_OK)) {
+            RAISE_ERROR(OUT_OF_MEMORY_ATOM);
+        }
+        return create_error_tuple(ctx, globalcontext_make_atom(global, not_simulated_atom));
+    }
+
+    term pin = argv[1];
+    VALIDATE_ARG(ctx, pin, term_is_integer);
+    const char *reason;
+    struct ADCChannel *channel = lookup_channel(rsrc_obj, pin, false, &reason);
+    if (UNLIKELY(IS_NULL_PTR(channel))) {
+        if (UNLIKELY(memory_ensure_free(ctx, TUPLE_SIZE(2)) != MEMORY_GC_OK)) {
+            RAISE_ERROR(OUT_OF_MEMORY_ATOM);
+        } else {
+            return create_error_tuple(ctx, globalcontext_make_atom(global, reason));
+        }
+    }
+
+    term signal = argv[2];
+    if (signal == globalcontext_make_atom(global, ATOM_STR("\x3", "off"))) {
+        adc_sim_clear(rsrc_obj->unit.unit_id, channel->channel);
+        return OK_ATOM;
+    }
+    VALIDATE_ARG(ctx, signal, term_is_tuple);
+    int arity = term_get_tuple_arity(signal);
+    if (UNLIKELY(arity < 3 || arity > 4)) {
+        RETURN_BADARG(ctx);
+    }
+    term wave = term_get_tuple_element(signal, 0);
+    VALIDATE_ARG(ctx, wave, term_is_atom);
+
+    struct ADCSimSignal sim = {
+        .wave = interop_atom_term_select_int(wave_table, wave, global),
+    };
+    esp_err_t err;
+    switch ((int) sim.wave) {
+        case ADC_SIM_SINE:
+        case ADC_SIM_SQUARE:
+        case ADC_SIM_NOISE:
+            if (UNLIKELY(arity != (sim.wave == ADC_SIM_NOISE ? 3 : 4)
+                    || !to_sim_level(term_get_tuple_element(signal, 1), &sim.offset)
+                    || !to_sim_level(term_get_tuple_element(signal, 2), &sim.amplitude))) {
+                RETURN_BADARG(ctx);
+            }
+            if (sim.wave != ADC_SIM_NOISE) {
+                term frequency_hz = term_get_tuple_element(signal, 3);
+                if (UNLIKELY(!term_is_number(frequency_hz) || term_conv_to_float(frequency_hz) <= 0)) {
+                    RETURN_BADARG(ctx);
+                }
+                sim.frequency_hz = term_conv_to_float(frequency_hz);
+            }
+            err = adc_sim_set_signal(rsrc_obj->unit.unit_id, channel->channel, &sim);
+            break;
+        case ADC_SIM_REPLAY: {
+            term source = term_get_tuple_element(signal, 1);
+            term sample_rate_hz = term_get_tuple_element(signal, 2);
+            if (UNLIKELY(arity != 3 || !term_is_integer(sample_rate_hz) || term_to_int(sample_rate_hz) <= 0)) {
+                RETURN_BADARG(ctx);
+            }
+            if (term_is_binary(source)) {
+                // the binary is copied, so it may be collected once this returns
+                sim.samples = (const uint16_t *) term_binary_data(source);
+                sim.count = term_binary_size(source) / sizeof(uint16_t);
+                sim.sample_rate_hz = term_to_int(sample_rate_hz);
+                err = adc_sim_set_signal(rsrc_obj->unit.unit_id, channel->channel, &sim);
+            } else {
+                int ok;
+                char *path = interop_list_to_string(source, &ok);
+                if (UNLIKELY(!ok)) {
+                    RETURN_BADARG(ctx);
+                }
+                err = adc_sim_replay_file(rsrc_obj->unit.unit_id, channel->channel, path, term_to_int(sample_rate_hz));
+                free(path);
+            }
+            break;
+        }
+        default:
+            RETURN_BADARG(ctx);
+    }
+    if (UNLIKELY(err == ESP_ERR_INVALID_ARG)) {
+        RETURN_BADARG(ctx);
+    }
+    // a replay file that is missing or empty is the caller's to report
+    if (UNLIKELY(err == ESP_ERR_NOT_FOUND)) {
+        if (UNLIKELY(memory_ensure_free(ctx, TUPLE_SIZE(2)) != MEMORY_GC_OK)) {
+            RAISE_ERROR(OUT_OF_MEMORY_ATOM);
+        }
+        return create_error_tuple(ctx, esp_err_to_term(global, err));
+    }
+    CHECK_ERROR(ctx, err, "nif_simulate; adc_sim_set_signal");
+
+    return OK_ATOM;
 }
 
 static const struct Nif adc_init_nif = {
@@ -729,9 +2870,109 @@ static const struct Nif config_channel_calibration_nif = {
     .base.type = NIFFunctionType,
     .nif_ptr = nif_config_channel_calibration
 };
-static const struct Nif adc_take_reading_nif = {
+static const struct Nif config_filter_nif = {
+    .base.type = NIFFunctionType,
+    .nif_ptr = nif_config_filter
+};
+static const struct Nif config_dither_nif = {
+    .base.type = NIFFunctionType,
+    .nif_ptr = nif_config_dither
+};
+static const struct Nif adc_take_reading_async_nif = {
+    .base.type = NIFFunctionType,
+    .nif_ptr = nif_adc_take_reading_async
+};
+static const struct Nif adc_take_readings_async_nif = {
+    .base.type = NIFFunctionType,
+    .nif_ptr = nif_adc_take_readings_async
+};
+static const struct Nif stream_start_nif = {
+    .base.type = NIFFunctionType,
+    .nif_ptr = nif_stream_start
+};
+static const struct Nif stream_stop_nif = {
+    .base.type = NIFFunctionType,
+    .nif_ptr = nif_stream_stop
+};
+static const struct Nif stream_grant_nif = {
+    .base.type = NIFFunctionType,
+    .nif_ptr = nif_stream_grant
+};
+static const struct Nif stream_info_nif = {
+    .base.type = NIFFunctionType,
+    .nif_ptr = nif_stream_info
+};
+static const struct Nif watch_nif = {
+    .base.type = NIFFunctionType,
+    .nif_ptr = nif_watch
+};
+static const struct Nif unwatch_nif = {
+    .base.type = NIFFunctionType,
+    .nif_ptr = nif_unwatch
+};
+static const struct Nif schedule_nif = {
+    .base.type = NIFFunctionType,
+    .nif_ptr = nif_schedule
+};
+static const struct Nif unschedule_nif = {
+    .base.type = NIFFunctionType,
+    .nif_ptr = nif_unschedule
+};
+static const struct Nif grant_nif = {
+    .base.type = NIFFunctionType,
+    .nif_ptr = nif_grant
+};
+static const struct Nif schedule_info_nif = {
+    .base.type = NIFFunctionType,
+    .nif_ptr = nif_schedule_info
+};
+static const struct Nif drain_nif = {
+    .base.type = NIFFunctionType,
+    .nif_ptr = nif_drain
+};
+static const struct Nif ring_info_nif = {
+    .base.type = NIFFunctionType,
+    .nif_ptr = nif_ring_info
+};
+static const struct Nif recorder_open_nif = {
+    .base.type = NIFFunctionType,
+    .nif_ptr = nif_recorder_open
+};
+static const struct Nif recorder_read_nif = {
+    .base.type = NIFFunctionType,
+    .nif_ptr = nif_recorder_read
+};
+static const struct Nif recorder_info_nif = {
+    .base.type = NIFFunctionType,
+    .nif_ptr = nif_recorder_info
+};
+static const struct Nif stats_nif = {
+    .base.type = NIFFunctionType,
+    .nif_ptr = nif_stats
+};
+static const struct Nif reset_stats_nif = {
+    .base.type = NIFFunctionType,
+    .nif_ptr = nif_reset_stats
+};
+static const struct Nif wifi_acquire_nif = {
+    .base.type = NIFFunctionType,
+    .nif_ptr = nif_wifi_acquire
+};
+static const struct Nif wifi_release_nif = {
+    .base.type = NIFFunctionType,
+    .nif_ptr = nif_wifi_release
+};
+static const struct Nif wifi_owned_nif = {
+    .base.type = NIFFunctionType,
+    .nif_ptr = nif_wifi_owned
+};
+static const struct Nif bytes_per_sample_nif = {
+    .base.type = NIFFunctionType,
+    .nif_ptr = nif_bytes_per_sample
+};
+static const struct Nif simulate_nif = {
     .base.type = NIFFunctionType,
-    .nif_ptr = nif_adc_take_reading
+    .nif_ptr = nif_simulate
 };
 
 //
@@ -743,6 +2984,15 @@ static void adc_resource_dtor(ErlNifEnv *caller_env, void *obj)
     UNUSED(caller_env);
     struct ADCResource *rsrc_obj = (struct ADCResource *) obj;
 
+    // the watch and sampler tasks use the unit, so they must be gone first;
+    // read jobs hold a reference on the resource, so none is in flight
+    adc_watcher_stop(&rsrc_obj->watcher);
+    adc_sched_stop(&rsrc_obj->sched);
+    adc_sched_free(&rsrc_obj->sched);
+    adc_recorder_close(&rsrc_obj->recorder);
+    if (!rsrc_obj->closed) {
+        adc_resource_put_unit(rsrc_obj);
+    }
 }
 
 static const ErlNifResourceTypeInit ADCResourceTypeInit = {
@@ -750,6 +3000,19 @@ static const ErlNifResourceTypeInit ADCResourceTypeInit = {
     .dtor = adc_resource_dtor,
 };
 
+static void adc_stream_resource_dtor(ErlNifEnv *caller_env, void *obj)
+{
+    UNUSED(caller_env);
+    struct ADCStreamResource *stream_obj = (struct ADCStreamResource *) obj;
+
+    adc_stream_stop(&stream_obj->stream);
+}
+
+static const ErlNifResourceTypeInit ADCStreamResourceTypeInit = {
+    .members = 1,
+    .dtor = adc_stream_resource_dtor,
+};
+
 //
 // Component Nif Entrypoints
 //
@@ -760,6 +3023,30 @@ void atomvm_adc_init(GlobalContext *global)
     ErlNifEnv env;
     erl_nif_env_partial_init_from_globalcontext(&env, global);
     adc_resource_type = enif_init_resource_type(&env, "adc_resource", &ADCResourceTypeInit, ERL_NIF_RT_CREATE, NULL);
+    adc_stream_resource_type = enif_init_resource_type(&env, "adc_stream_resource", &ADCStreamResourceTypeInit, ERL_NIF_RT_CREATE, NULL);
+
+    if (UNLIKELY(adc_registry_init() != ESP_OK)) {
+        ESP_LOGE(TAG, "Failed to create ADC unit registry; no ADC can be opened");
+    }
+    if (UNLIKELY(adc_sim_init() != ESP_OK)) {
+        ESP_LOGE(TAG, "Failed to create ADC simulator lock; simulated signals cannot be set");
+    }
+#ifdef CONFIG_AVM_ADC2_ENABLE
+    size_t worker_lanes = ADC_UNIT_2 + 1;
+#else
+    size_t worker_lanes = ADC_UNIT_1 + 1;
+#endif
+    if (UNLIKELY(adc_worker_init(worker_lanes) != ESP_OK)) {
+        ESP_LOGE(TAG, "Failed to start ADC worker tasks; asynchronous reads are unavailable");
+    }
+    if (UNLIKELY(adc_recorder_init() != ESP_OK)) {
+        ESP_LOGE(TAG, "Failed to create recorder partition table; recorders cannot be opened");
+    }
+#ifdef CONFIG_AVM_ADC2_ENABLE
+    if (UNLIKELY(adc_arbiter_init() != ESP_OK)) {
+        ESP_LOGE(TAG, "Failed to create ADC2 arbiter");
+    }
+#endif
 
 }
 
@@ -771,7 +3058,7 @@ const struct Nif *atomvm_adc_get_nif(const char *nifname)
         TRACE("Resolved platform nif %s ...\n", nifname);
         return &adc_init_nif;
     }
-    if (strcmp("adc:nif_closef/1", nifname) == 0) {
+    if (strcmp("adc:nif_close/1", nifname) == 0) {
         TRACE("Resolved platform nif %s ...\n", nifname);
         return &adc_close_nif;
     }
@@ -783,9 +3070,109 @@ const struct Nif *atomvm_adc_get_nif(const char *nifname)
         TRACE("Resolved platform nif %s ...\n", nifname);
         return &config_channel_calibration_nif;
     }
-    if (strcmp("adc:nif_take_reading/3", nifname) == 0) {
+    if (strcmp("adc:nif_config_filter/3", nifname) == 0) {
+        TRACE("Resolved platform nif %s ...\n", nifname);
+        return &config_filter_nif;
+    }
+    if (strcmp("adc:nif_config_dither/2", nifname) == 0) {
+        TRACE("Resolved platform nif %s ...\n", nifname);
+        return &config_dither_nif;
+    }
+    if (strcmp("adc:nif_take_reading_async/4", nifname) == 0) {
+        TRACE("Resolved platform nif %s ...\n", nifname);
+        return &adc_take_reading_async_nif;
+    }
+    if (strcmp("adc:nif_take_readings_async/4", nifname) == 0) {
+        TRACE("Resolved platform nif %s ...\n", nifname);
+        return &adc_take_readings_async_nif;
+    }
+    if (strcmp("adc:nif_stream_start/3", nifname) == 0) {
+        TRACE("Resolved platform nif %s ...\n", nifname);
+        return &stream_start_nif;
+    }
+    if (strcmp("adc:nif_stream_stop/1", nifname) == 0) {
+        TRACE("Resolved platform nif %s ...\n", nifname);
+        return &stream_stop_nif;
+    }
+    if (strcmp("adc:nif_stream_grant/2", nifname) == 0) {
+        TRACE("Resolved platform nif %s ...\n", nifname);
+        return &stream_grant_nif;
+    }
+    if (strcmp("adc:nif_stream_info/1", nifname) == 0) {
+        TRACE("Resolved platform nif %s ...\n", nifname);
+        return &stream_info_nif;
+    }
+    if (strcmp("adc:nif_watch/4", nifname) == 0) {
+        TRACE("Resolved platform nif %s ...\n", nifname);
+        return &watch_nif;
+    }
+    if (strcmp("adc:nif_unwatch/2", nifname) == 0) {
+        TRACE("Resolved platform nif %s ...\n", nifname);
+        return &unwatch_nif;
+    }
+    if (strcmp("adc:nif_schedule/4", nifname) == 0) {
+        TRACE("Resolved platform nif %s ...\n", nifname);
+        return &schedule_nif;
+    }
+    if (strcmp("adc:nif_unschedule/2", nifname) == 0) {
+        TRACE("Resolved platform nif %s ...\n", nifname);
+        return &unschedule_nif;
+    }
+    if (strcmp("adc:nif_grant/3", nifname) == 0) {
+        TRACE("Resolved platform nif %s ...\n", nifname);
+        return &grant_nif;
+    }
+    if (strcmp("adc:nif_schedule_info/2", nifname) == 0) {
+        TRACE("Resolved platform nif %s ...\n", nifname);
+        return &schedule_info_nif;
+    }
+    if (strcmp("adc:nif_drain/2", nifname) == 0) {
+        TRACE("Resolved platform nif %s ...\n", nifname);
+        return &drain_nif;
+    }
+    if (strcmp("adc:nif_ring_info/1", nifname) == 0) {
+        TRACE("Resolved platform nif %s ...\n", nifname);
+        return &ring_info_nif;
+    }
+    if (strcmp("adc:nif_recorder_open/2", nifname) == 0) {
+        TRACE("Resolved platform nif %s ...\n", nifname);
+        return &recorder_open_nif;
+    }
+    if (strcmp("adc:nif_recorder_read/2", nifname) == 0) {
+        TRACE("Resolved platform nif %s ...\n", nifname);
+        return &recorder_read_nif;
+    }
+    if (strcmp("adc:nif_recorder_info/1", nifname) == 0) {
+        TRACE("Resolved platform nif %s ...\n", nifname);
+        return &recorder_info_nif;
+    }
+    if (strcmp("adc:nif_stats/1", nifname) == 0) {
+        TRACE("Resolved platform nif %s ...\n", nifname);
+        return &stats_nif;
+    }
+    if (strcmp("adc:nif_reset_stats/1", nifname) == 0) {
+        TRACE("Resolved platform nif %s ...\n", nifname);
+        return &reset_stats_nif;
+    }
+    if (strcmp("adc:nif_wifi_acquire/1", nifname) == 0) {
+        TRACE("Resolved platform nif %s ...\n", nifname);
+        return &wifi_acquire_nif;
+    }
+    if (strcmp("adc:nif_wifi_release/0", nifname) == 0) {
+        TRACE("Resolved platform nif %s ...\n", nifname);
+        return &wifi_release_nif;
+    }
+    if (strcmp("adc:nif_wifi_owned/0", nifname) == 0) {
+        TRACE("Resolved platform nif %s ...\n", nifname);
+        return &wifi_owned_nif;
+    }
+    if (strcmp("adc:nif_bytes_per_sample/1", nifname) == 0) {
+        TRACE("Resolved platform nif %s ...\n", nifname);
+        return &bytes_per_sample_nif;
+    }
+    if (strcmp("adc:nif_simulate/3", nifname) == 0) {
         TRACE("Resolved platform nif %s ...\n", nifname);
-        return &adc_take_reading_nif;
+        return &simulate_nif;
     }
     return NULL;
 }
@@ -19,31 +19,68 @@
 %%
 %% Use this module to take ADC readings on an ESP32 device. ADC1 is enabled by 
 %% default and allows taking reading from pins 32-39. If ADC2 is also enabled
-%% pins 0, 2, 4, 12-15, and 25-27 may be used as long as WiFi is not required
-%% by the application. A solution should be available soon to allow for
-%% non-simultaneous use of WiFi and ADC2 channels.
+%% pins 0, 2, 4, 12-15, and 25-27 may be used as well. ADC2 is shared with
+%% WiFi: call wifi_acquire/0 before starting WiFi and wifi_release/0 after
+%% stopping it, and ADC2 reads in between fail with, or wait (up to their
+%% `{timeout, Ms}') for the unit with, `{error, timeout}'.
+%%
+%% Bad arguments and options are returned as `{error, badarg}' rather than
+%% raised, so that a bad call cannot take the bus, and the other users of
+%% it, down.
 %% @end
 %%-----------------------------------------------------------------------------
 -module(adc).
 
 -export([
-    start/0, start/1, start_link/0, start_link/1, stop/1
+    start/0, start/1, start/2, start_link/0, start_link/1, start_link/2, stop/1, handle/1
+]).
+-export([
+    read/2, read/3, read_many/3, config_width_attenuation/2, config_width_attenuation/3
+]).
+-export([
+    config_calibration/2, config_calibration/3, config_filter/3, config_dither/2
+]).
+-export([
+    start_stream/3, stop_stream/1, grant_stream/2, receive_stream/2, stream_info/1,
+    timestamps/1, decode/2, bytes_per_sample/1
+]).
+-export([
+    watch/4, unwatch/2
+]).
+-export([
+    schedule/4, unschedule/2, grant/3, receive_batch/3, schedule_info/2, drain/2, ring_info/1
+]).
+-export([
+    recorder_open/2, recorder_read/2, recorder_info/1
+]).
+-export([
+    stats/1, reset_stats/1
 ]).
 -export([
-    read/2, read/3, config_width_attenuation/2, config_width_attenuation/3
+    wifi_acquire/0, wifi_release/0, wifi_owned/0
 ]).
 -export([
-    config_calibration/2, config_calibration/3
+    simulate/3
 ]).
 -export([init/1, handle_call/3, handle_cast/2, handle_info/2, terminate/2, code_change/3]).
--export([nif_init/1, nif_close/1, nif_config_channel_bitwidth_atten/3, nif_config_channel_calibration/3, nif_take_reading/3]). %% internal nif APIs
+-export([nif_init/1, nif_close/1, nif_config_channel_bitwidth_atten/3, nif_config_channel_calibration/3, nif_config_filter/3, nif_config_dither/2, nif_take_reading_async/4, nif_take_readings_async/4]). %% internal nif APIs
+-export([nif_stream_start/3, nif_stream_stop/1, nif_stream_grant/2, nif_stream_info/1, nif_watch/4, nif_unwatch/2]). %% internal nif APIs
+-export([nif_schedule/4, nif_unschedule/2, nif_grant/3, nif_schedule_info/2, nif_drain/2, nif_ring_info/1]). %% internal nif APIs
+-export([nif_recorder_open/2, nif_recorder_read/2, nif_recorder_info/1]). %% internal nif APIs
+-export([nif_stats/1, nif_reset_stats/1]). %% internal nif APIs
+-export([nif_wifi_acquire/1, nif_wifi_release/0, nif_wifi_owned/0, nif_bytes_per_sample/1, nif_simulate/3]). %% internal nif APIs
 
 -behaviour(gen_server).
 
 -include_lib("atomvm_lib/include/trace.hrl").
 
 -type adc_bus() :: pid().
+-type adc_handle() :: {'$adc', Resource::binary(), Ref::reference()}.
 -type adc_peripheral() ::  1 | 2.
+-type start_options() :: [{backend, backend()}].
+-type backend() :: oneshot | continuous | simulator.
+-type signal() :: off | {sine | square, Offset::0..4095, Amplitude::0..4095, FreqHz::number()} |
+    {noise, Offset::0..4095, Amplitude::0..4095} | {replay, Samples::binary() | Path::string(), RateHz::pos_integer()}.
 -type adc_pin() ::  adc1_pin() | adc2_pin().
 -type adc1_pin() :: 32..39.
 -type adc2_pin() :: 0 | 2 | 4 | 12..15 | 25..27.
@@ -51,20 +88,64 @@
 -type option_cali() :: [{attenuation, attenuation()}].
 -type bit_width() :: bit_9 | bit_10 | bit_11 | bit_12 | bit_13 | bit_max.
 -type attenuation() :: db_0 | db_2_5 | db_6 | db_11.
--type option() :: {bit_width, bit_width()} | {attenuation, attenuation()}.
+-type option() :: {bit_width, bit_width()} | {attenuation, attenuation()} | {samples, pos_integer()}.
 
+-type filter() :: [filter_stage()].
+-type filter_stage() :: {boxcar, 1..32} | {exponential, 1..15} | {fir, [-32768..32767]} |
+    {median, 1..15} | {decimate, 1..255}.
+-type watch_options() :: [watch_option()].
+-type watch_option() :: {low, non_neg_integer()} | {high, non_neg_integer()} |
+    {hysteresis, non_neg_integer()} | {period_ms, pos_integer()} | {samples, pos_integer()}.
+-type schedule_options() :: [schedule_option()].
+-type schedule_option() :: {period_ms, pos_integer()} | {period_us, pos_integer()} |
+    {samples, pos_integer()} | {batch, pos_integer()} | ring | record |
+    {credits, non_neg_integer()} | {overflow, overflow()}.
+-type overflow() :: latest | drop_new | drop_old.
+-type schedule_info() :: [{period_us, pos_integer()} | {ticks, non_neg_integer()} |
+    {missed, non_neg_integer()} | {errors, non_neg_integer()} | {max_jitter_us, non_neg_integer()} |
+    {mean_jitter_us, non_neg_integer()} | {dropped, non_neg_integer()}].
+-type pin_metrics() :: [{reads, non_neg_integer()} | {samples, non_neg_integer()} |
+    {errors, [{Reason::term(), non_neg_integer()}]} | {time_us, non_neg_integer()} |
+    {max_us, non_neg_integer()} | {latency_us, tuple()}].
+-type drain_options() :: [{max, pos_integer()}].
+-type ring_info() :: [{size, non_neg_integer()} | {count, non_neg_integer()} |
+    {overruns, non_neg_integer()} | {high_water, non_neg_integer()}].
+-type recorder_read_options() :: [{from, non_neg_integer()} | {max, pos_integer()}].
+-type recorded_block() :: {Seq::non_neg_integer(), Pin::adc_pin(), TimeUs::integer(),
+    PeriodUs::pos_integer(), Samples::binary()}.
+-type recorder_info() :: [{size, non_neg_integer()} | {used, non_neg_integer()} |
+    {blocks, non_neg_integer()} | {first_seq, non_neg_integer()} | {next_seq, non_neg_integer()} |
+    {dropped, non_neg_integer()} | {write_errors, non_neg_integer()}].
 -type read_options() :: [read_option()].
--type read_option() :: raw | voltage | {samples, pos_integer()}.
+-type read_option() :: raw | voltage | {samples, pos_integer()} | {capture, 1..16384} |
+    {stats, [stat()]} | {timeout, non_neg_integer()} | {oversample, 1..4} | {timestamps, boolean()} |
+    {encoding, encoding()} | {spectrum, 16..2048, window()} | {peaks, 1..32} |
+    {tolerance, number()} | {min_samples, pos_integer()}.
+-type stat() :: min | max | mean | stddev | median | p95.
+-type window() :: rectangular | hann | hamming | blackman.
+-type encoding() :: raw16 | packed12 | delta.
+-type read_many_options() :: [read_many_option()].
+-type read_many_option() :: read_option() | binary.
+
+-type stream() :: {'$adc_stream', Resource::binary(), Ref::reference()}.
+-type stream_options() :: [stream_option()].
+-type stream_option() :: {sample_freq_hz, pos_integer()} | {attenuation, attenuation()} |
+    {frame_size, pos_integer()} | {pool_size, pos_integer()} | {timestamps, boolean()} |
+    {encoding, encoding()} | {demux, boolean()} | {credits, non_neg_integer()} | {overflow, overflow()}.
+-type stream_info() :: [{dropped, non_neg_integer()} | {overflows, non_neg_integer()}].
 
 -type raw_value() :: 0..4095 | undefined.
 -type voltage_reading() :: 0..3300 | undefined.
 -type reading() :: {raw_value(), voltage_reading()}.
+-type oversampled_reading() :: {0..65535 | undefined, voltage_reading(), 10..16}.
+-type spectrum() :: {BinHz::float(), Bins::binary()}.
+-type adaptive_reading() :: {raw_value(), voltage_reading(), Used::pos_integer()}.
 
 -define(DEFAULT_OPTIONS, [{bit_width, bit_12}, {attenuation, db_11}]).
 -define(DEFAULT_OPTIONS_CALI, [{attenuation, db_11}]).
--define(DEFAULT_SAMPLES, 64).
 -define(DEFAULT_PERIPHERAL, 1).
--define(DEFAULT_READ_OPTIONS, [raw, voltage, {samples, ?DEFAULT_SAMPLES}]).
+%% how long a reply may take beyond the {timeout, Ms} of a read
+-define(READ_REPLY_GRACE_MS, 10000).
 
 -record(state, {
     adc
@@ -98,12 +179,38 @@ start() ->
 %% Note. Unlike the esp-idf adc driver bit widths are used on a per pin basis,
 %% so pins on the same adc unit can use different widths if necessary.
 %%
+%% Any number of buses may be started on the same peripheral.  They share
+%% the driver unit and calibration tables, which are created for the first
+%% bus and released with the last, while each keeps its own pin settings.
+%%
 %% Use the returned reference in subsequent ADC operations.
 %% @end
 %%-----------------------------------------------------------------------------
 -spec start(Peripheral::adc_peripheral()) -> {ok, adc_bus()} | {error, Reason::term()}.
 start(Peripheral) ->
-    gen_server:start(?MODULE, Peripheral, []).
+    start(Peripheral, []).
+
+%%-----------------------------------------------------------------------------
+%% @param   Peripheral         Peripheral from which to read ADC
+%% @param   Options            start options
+%% @returns {ok, adc_bus()} on success, or {error, Reason}, on failure
+%% @doc     Start a ADC on the given backend.
+%%
+%% `{backend, Backend}' selects how the bus converts:
+%% <ul>
+%%   <li>`oneshot', the default, one conversion per driver call;</li>
+%%   <li>`continuous', the DMA driver, which takes each batch of samples in
+%%   one burst at the highest sample rate;</li>
+%%   <li>`simulator', no hardware at all: pins read the signal set with
+%%   simulate/3, or 0 without one.</li>
+%% </ul>
+%% Buses share the unit of a peripheral only with buses on the same
+%% backend.  An unknown backend raises `badarg'.
+%% @end
+%%-----------------------------------------------------------------------------
+-spec start(Peripheral::adc_peripheral(), Options::start_options()) -> {ok, adc_bus()} | {error, Reason::term()}.
+start(Peripheral, Options) ->
+    gen_server:start(?MODULE, {Peripheral, Options}, []).
 
 %%-----------------------------------------------------------------------------
 %% @param   Options
@@ -113,7 +220,7 @@ start(Peripheral) ->
 %%-----------------------------------------------------------------------------
 -spec start_link() -> {ok, adc_bus()} | {error, Reason::term()}.
 start_link() ->
-    gen_server:start_link(?MODULE, ?DEFAULT_PERIPHERAL, []).
+    start_link(?DEFAULT_PERIPHERAL).
 
 %%-----------------------------------------------------------------------------
 %% @param   Options
@@ -123,28 +230,65 @@ start_link() ->
 %%-----------------------------------------------------------------------------
 -spec start_link(Peripheral::adc_peripheral()) -> {ok, adc_bus()} | {error, Reason::term()}.
 start_link(Peripheral) ->
-    gen_server:start_link(?MODULE, Peripheral, []).
+    start_link(Peripheral, []).
+
+%%-----------------------------------------------------------------------------
+%% @param   Peripheral         Peripheral from which to read ADC
+%% @param   Options            start options
+%% @returns {ok, adc_bus()} on success, or {error, Reason}, on failure
+%% @doc     Start the ADC Bus on the given backend, see start/2.
+%% @end
+%%-----------------------------------------------------------------------------
+-spec start_link(Peripheral::adc_peripheral(), Options::start_options()) -> {ok, adc_bus()} | {error, Reason::term()}.
+start_link(Peripheral, Options) ->
+    gen_server:start_link(?MODULE, {Peripheral, Options}, []).
 
 %%-----------------------------------------------------------------------------
 %% @returns ok
 %% @doc     Stop the specified ADC.
+%%
+%% Watch points and scheduled sampling of the bus stop, and its share of the
+%% driver unit is released once any reads still in progress have completed.
 %% @end
 %%-----------------------------------------------------------------------------
 -spec stop(Bus::adc_bus()) -> ok.
 stop(Bus) ->
     gen_server:stop(Bus).
 
+%%-----------------------------------------------------------------------------
+%% @param   Bus         the ADC bus
+%% @returns {ok, Handle}
+%% @doc     Get a handle for reading from the bus without going through it.
+%%
+%% read/2,3, read_many/3 and stats/1 accept the handle in place of the bus.
+%% They then call into the driver from the calling process, so concurrent
+%% readers neither queue behind one another in the bus mailbox nor copy their
+%% requests and replies through it.  Reads on different peripherals run fully
+%% in parallel; reads on the same peripheral take turns on the unit, as they
+%% would through the bus.  The handle may be shared with any process.
+%%
+%% The bus remains in charge of configuration, watch points, scheduling,
+%% streams and its own lifetime.  Once it has stopped, calls made with the
+%% handle raise `badarg', and reads already under way complete normally.
+%% @end
+%%-----------------------------------------------------------------------------
+-spec handle(Bus::adc_bus()) -> {ok, adc_handle()}.
+handle(Bus) ->
+    gen_server:call(Bus, handle).
+
 %%-----------------------------------------------------------------------------
 %% @param   Pin         pin from which to read ADC
 %% @returns {ok, {RawValue, MilliVoltage}} | {error, Reason}
-%% @equiv   read(ADC, [raw, voltage, {samples, 64}])
+%% @equiv   read(ADC, Pin, [])
 %% @doc     Take a reading from the pin associated with this ADC.
 %%
+%% The read options configured for the pin are used, which default to
+%% `[raw, voltage, {samples, 64}]'.
 %% @end
 %%-----------------------------------------------------------------------------
--spec read(Bus::adc_bus(), Pin::adc_pin()) -> {ok, reading()} | {error, Reason::term()}.
+-spec read(Bus::adc_bus() | adc_handle(), Pin::adc_pin()) -> {ok, reading()} | {error, Reason::term()}.
 read(Bus, Pin) ->
-    read(Bus, Pin, ?DEFAULT_READ_OPTIONS).
+    read(Bus, Pin, []).
 
 %%-----------------------------------------------------------------------------
 %% @param   Pin         pin from which to read ADC
@@ -153,26 +297,128 @@ read(Bus, Pin) ->
 %% @doc     Take a reading from the pin associated with this ADC.
 %%
 %% The Options parameter may be used to specify the behavior of the read
-%% operation.
+%% operation.  An empty list selects the defaults configured for the pin with
+%% config_width_attenuation/3, without any option parsing on the read path.
 %%
 %% If the ReadOptions contains the atom `raw', then the raw value will be returned
 %% in the first element of the returned tuple.  Otherwise, this element will be the
 %% atom `undefined'.
 %%
 %% If the ReadOptions contains the atom `voltage', then the millivoltage value will be returned
-%% in the second element of the returned tuple.  Otherwise, this element will be the
-%% atom `undefined'.
+%% in the second element of the returned tuple.  Otherwise, or if the pin has not been
+%% calibrated with config_calibration/2,3, this element will be the atom `undefined'.
 %%
 %% You may specify the number of samples to be taken and averaged over using the tuple
 %% `{samples, Samples::pos_integer()}'.
 %%
-%% If the error `Reason' is timeout and the adc channel is on unit 2 then WiFi is likely
-%% enabled and adc2 readings will no longer be possible.
+%% A fixed sample count costs as much on a quiet signal as on a noisy one.
+%% With `{tolerance, T}', sampling instead stops as soon as the standard
+%% error of the mean falls below T raw LSB, after at least
+%% `{min_samples, Min}' (default 8, and no more than `Max') samples and at
+%% most `{samples, Max}' (at most 65535).  The result is then `{ok, {Raw, MilliVolts, Used}}',
+%% where `Used' is the number of samples taken.  `{tolerance, T}' cannot be
+%% combined with `capture', `stats', `oversample' or `spectrum'.
+%%
+%% To inspect a waveform rather than a single averaged value, pass
+%% `{capture, N}', with N up to 16384.  The result is then `{ok, Binary}',
+%% where `Binary' holds the N individual samples as little-endian unsigned
+%% 16-bit integers, e.g. `[S || <<S:16/little>> <= Binary]'.  The samples are raw values, or
+%% millivolts if `voltage' is also given and the pin has been calibrated.
+%% With `{timestamps, true}' as well, the binary also records when each
+%% sample was taken; see timestamps/1.  With `{encoding, Encoding}', the
+%% samples are encoded more compactly instead; see decode/2.
+%%
+%% To characterise noise or jitter, pass `{stats, Stats}', where `Stats' is
+%% a list of `min', `max', `mean', `stddev', `median' and `p95'.  The result
+%% is then `{ok, Tuple}', with one element per statistic in the order given,
+%% all computed natively in a single pass over the `{samples, N}' samples.
+%% `mean' and `stddev' (population) are floats, the rest integers; values are
+%% millivolts if `voltage' is also given and the pin has been calibrated.
+%% `median' and `p95' are limited to 65535 samples.
+%%
+%% To resolve more than the converter's 12 bits, pass `{oversample, N}'
+%% with N from 1 to 4.  4^N conversions are summed and scaled down to
+%% 12 + N bits, and the result is then `{ok, {Raw, MilliVolts, Bits}}',
+%% where `Raw' has `Bits' bits (the pin bit width plus N) and `MilliVolts'
+%% is interpolated between calibration points.  `Bits' may not exceed 16,
+%% so a pin wider than 12 bits takes a smaller N; a larger one returns
+%% `{error, badarg}'.  `{samples, N}' and the pin filter do not apply, and
+%% `{oversample, N}' cannot be combined with `capture' or `stats'.
+%% Oversampling only adds resolution if the signal carries about one LSB of
+%% noise; see config_dither/2.
+%%
+%% For the frequency content of a signal, pass `{spectrum, N, Window}', with
+%% N a power of two from 16 to 2048 and Window one of `rectangular',
+%% `hann', `hamming' and `blackman'.  N raw samples are captured (through
+%% the pin filter, if any), the mean is removed, and a fixed-point FFT is
+%% run natively.  The result is `{ok, {BinHz, Bins}}', where `Bins' holds
+%% N / 2 little-endian unsigned 16-bit amplitudes, bin K being the component
+%% at K * BinHz Hz, in 1/16 of a raw unit: a sine of amplitude A reads about
+%% 16 * A in its bin.  `BinHz' follows from the time the capture took.  With
+%% `{peaks, K}' as well, `Bins' holds only the (at most) K highest local
+%% maxima, highest first, as `<<Bin:16/little, Amplitude:16/little>>'
+%% entries.  `{spectrum, N, Window}' cannot be combined with `capture',
+%% `stats' or `oversample'.
+%%
+%% The pin must have been configured with config_width_attenuation/2,3
+%% first; otherwise `{error, unconfigured_pin}' is returned.
+%%
+%% The samples are taken on a native task of the ADC unit rather than on the
+%% AtomVM scheduler, so a large `{samples, N}' only blocks the caller, while
+%% other processes (including the ADC bus) keep running.  If too many reads
+%% are already queued, `{error, busy}' is returned.
+%%
+%% While WiFi owns ADC2 (see wifi_acquire/0), reads of ADC2 pins return
+%% `{error, timeout}' straight away.  With `{timeout, Ms}' they instead wait
+%% for wifi_release/0 for up to `Ms' milliseconds, without occupying the
+%% native task; all reads waiting when the unit is released are then served
+%% back to back.
+%%
+%% If no result arrives within `Ms' milliseconds (0 without `{timeout, Ms}')
+%% plus 10 seconds, as when the reply could not be sent for want of memory,
+%% `{error, timeout}' is returned.  A result that arrives later is left in the
+%% mailbox of the caller as an `{adc_reading, Ref, Result}' message.
+%%
+%% With a handle from handle/1 in place of the bus, the read is queued
+%% straight from the calling process.
 %% @end
 %%-----------------------------------------------------------------------------
--spec read(Bus::adc_bus(), Pin::adc_pin(), ReadOptions::read_options()) -> {ok, reading()} | {error, Reason::term()}.
+-spec read(Bus::adc_bus() | adc_handle(), Pin::adc_pin(), ReadOptions::read_options()) -> {ok, reading() | oversampled_reading() | adaptive_reading() | spectrum() | binary() | tuple()} | {error, Reason::term()}.
+read({'$adc', _, _} = Handle, Pin, ReadOptions) ->
+    await_reading(?MODULE:nif_take_reading_async(Handle, Pin, ReadOptions, self()), ReadOptions);
 read(Bus, Pin, ReadOptions) ->
-    gen_server:call(Bus, {read, Pin, ReadOptions}).
+    await_reading(gen_server:call(Bus, {read_async, Pin, ReadOptions, self()}), ReadOptions).
+
+%%-----------------------------------------------------------------------------
+%% @param   Pins        pins from which to read ADC
+%% @param   ReadOptions extra options
+%% @returns {ok, Readings} | {error, Reason}
+%% @doc     Take a reading from each of the given pins in a single call.
+%%
+%% All pins are sampled back to back on the same unit, one sample per pin in
+%% turn, so the readings are taken much closer together in time than with
+%% successive calls to read/3.  The `raw', `voltage' and `samples' options
+%% behave as in read/3, and `Readings' is a tuple with one `{Raw, MilliVolts}'
+%% element per pin, in the order given.  Without `{samples, N}', each pin
+%% takes the number of samples configured for it, and drops out of the
+%% rounds once it has them.  The options of other kinds of read (`capture',
+%% `stats', `oversample', `spectrum', `timestamps' and `tolerance') return
+%% `{error, unsupported_option}'.
+%%
+%% If the ReadOptions contains the atom `binary', `Readings' is instead a binary
+%% of 16-bit little-endian raw values, one per pin.
+%%
+%% As with read/3, the pins are sampled on the native task of the ADC unit,
+%% so only the caller waits for them; `{error, busy}' and `{timeout, Ms}'
+%% behave as they do there.  With a handle from handle/1 in place of the bus,
+%% the read is queued straight from the calling process.
+%% @end
+%%-----------------------------------------------------------------------------
+-spec read_many(Bus::adc_bus() | adc_handle(), Pins::[adc_pin()], ReadOptions::read_many_options()) -> {ok, tuple() | binary()} | {error, Reason::term()}.
+read_many({'$adc', _, _} = Handle, Pins, ReadOptions) ->
+    await_reading(?MODULE:nif_take_readings_async(Handle, Pins, ReadOptions, self()), ReadOptions);
+read_many(Bus, Pins, ReadOptions) ->
+    await_reading(gen_server:call(Bus, {read_many_async, Pins, ReadOptions, self()}), ReadOptions).
 
 -spec config_calibration(Bus::adc_bus(), Pin::adc_pin()) -> ok | {error, Reason::term()}.
 config_calibration(Bus, Pin) ->
@@ -182,6 +428,52 @@ config_calibration(Bus, Pin) ->
 config_calibration(Bus, Pin, Options) ->
     gen_server:call(Bus, {calibration, Pin, Options}).
 
+%%-----------------------------------------------------------------------------
+%% @param   Bus         the ADC bus
+%% @param   Pin         pin to filter
+%% @param   Filter      filter stages, applied in order; `[]' removes the filter
+%% @returns ok | {error, Reason}
+%% @doc     Set a filter chain run natively on every sample taken from the pin.
+%%
+%% The filter runs in fixed-point arithmetic on each raw sample, before
+%% averaging in read/3, on each sample of a `{capture, N}' read (N then
+%% counts filter outputs), and on the samples of any stream started after the
+%% filter is set.  Its state carries over from one read to the next.
+%%
+%% The stages are:
+%% <ul>
+%%   <li>`{boxcar, N}' mean of the last N samples (N =< 32)</li>
+%%   <li>`{exponential, Shift}' single-pole IIR, y += (x - y) / 2^Shift</li>
+%%   <li>`{fir, Coeffs}' FIR filter with up to 32 Q15 coefficients
+%%       (32768 is 1.0)</li>
+%%   <li>`{median, N}' median of the last N samples (N odd, =< 15)</li>
+%%   <li>`{decimate, M}' pass only every M-th sample</li>
+%% </ul>
+%% At most 4 stages may be given; otherwise, or if a stage is malformed,
+%% `{error, invalid_filter}' is returned.
+%% @end
+%%-----------------------------------------------------------------------------
+-spec config_filter(Bus::adc_bus(), Pin::adc_pin(), Filter::filter()) -> ok | {error, Reason::term()}.
+config_filter(Bus, Pin, Filter) ->
+    gen_server:call(Bus, {filter, Pin, Filter}).
+
+%%-----------------------------------------------------------------------------
+%% @param   Bus         the ADC bus
+%% @param   Pin         output pin to toggle, or `undefined' to stop dithering
+%% @returns ok | {error, Reason}
+%% @doc     Dither the oversampled reads of the bus from a GPIO.
+%%
+%% The pin is driven as an output and toggled before each conversion of an
+%% `{oversample, N}' read, so that, fed to the input through a large resistor
+%% (or an RC network), it adds the LSB or so of noise oversampling needs to
+%% gain resolution on a quiet signal.  It is left low between reads.
+%% Returns `{error, invalid_pin}' if the pin cannot be an output.
+%% @end
+%%-----------------------------------------------------------------------------
+-spec config_dither(Bus::adc_bus(), Pin::non_neg_integer() | undefined) -> ok | {error, Reason::term()}.
+config_dither(Bus, Pin) ->
+    gen_server:call(Bus, {dither, Pin}).
+
 -spec config_width_attenuation(Bus::adc_bus(), Pin::adc_pin()) -> ok | {error, Reason::term()}.
 config_width_attenuation(Bus, Pin) ->
     config_width_attenuation(Bus, Pin, ?DEFAULT_OPTIONS).
@@ -190,37 +482,648 @@ config_width_attenuation(Bus, Pin) ->
 config_width_attenuation(Bus, Pin, Options) ->
     gen_server:call(Bus, {config, Pin, Options}).
 
+%%-----------------------------------------------------------------------------
+%% @param   Bus         the ADC bus
+%% @param   Pin         pin to watch
+%% @param   Options     watch options
+%% @param   Pid         process to notify
+%% @returns ok | {error, Reason}
+%% @doc     Watch a pin natively, and notify Pid when it crosses a threshold.
+%%
+%% The pin is sampled every `{period_ms, Ms}' (default 100) on a native
+%% task, averaging the configured number of samples (or `{samples, N}'), and
+%% compared to the raw `{low, Low}' and `{high, High}' thresholds.  A reading
+%% below `Low' is `low', above `High' is `high', and `normal' otherwise;
+%% to return to `normal' the reading must come back `{hysteresis, H}' inside
+%% the thresholds.  Pid receives
+%%
+%% `{adc_watch, Pin, low | normal | high, Raw}'
+%%
+%% only when the state changes (or when the pin is already low or high when
+%% the watch is set), so an unchanging pin costs no Erlang work.  Watching a
+%% pin again replaces its watch.  The pin must have been configured with
+%% config_width_attenuation/2,3.
+%% @end
+%%-----------------------------------------------------------------------------
+-spec watch(Bus::adc_bus(), Pin::adc_pin(), Options::watch_options(), Pid::pid()) -> ok | {error, Reason::term()}.
+watch(Bus, Pin, Options, Pid) ->
+    gen_server:call(Bus, {watch, Pin, Options, Pid}).
+
+%%-----------------------------------------------------------------------------
+%% @param   Bus         the ADC bus
+%% @param   Pin         pin to stop watching
+%% @returns ok
+%% @doc     Remove the watch on a pin, if any.
+%% @end
+%%-----------------------------------------------------------------------------
+-spec unwatch(Bus::adc_bus(), Pin::adc_pin()) -> ok | {error, Reason::term()}.
+unwatch(Bus, Pin) ->
+    gen_server:call(Bus, {unwatch, Pin}).
+
+%%-----------------------------------------------------------------------------
+%% @param   Bus         the ADC bus
+%% @param   Pin         pin to sample
+%% @param   Options     schedule options
+%% @param   Pid         process to deliver readings to
+%% @returns ok | {error, Reason}
+%% @doc     Sample a pin periodically on a hardware timer.
+%%
+%% The pin is sampled every `{period_ms, Ms}' (default 1000) or
+%% `{period_us, Us}' (at least 100) by a native task woken by an esp_timer,
+%% so the sampling instant does not depend on VM load the way a
+%% `timer:sleep/1' loop does.  Each reading averages `{samples, N}' samples
+%% (default 1).  Readings are batched, and every `{batch, N}' (default 32)
+%% readings Pid receives
+%%
+%% `{adc_sched, Pin, Readings}'
+%%
+%% where `Readings' is a binary of little-endian unsigned 16-bit raw values,
+%% one per period.  Pins with the same period are sampled together, back to
+%% back; up to 4 different periods may be in use at a time, otherwise
+%% `{error, not_found}' is returned.  Scheduling a pin again replaces its
+%% schedule.  The pin must have been configured with
+%% config_width_attenuation/2,3.
+%%
+%% With the `ring' option no messages are sent; the readings are instead
+%% timestamped and buffered in a ring shared by all such pins of the bus, to
+%% be collected with drain/2.
+%%
+%% With the `record' option no messages are sent either; each batch (at most
+%% 240 readings) is written as a block to the flash partition opened with
+%% recorder_open/2, which must be open (otherwise `{error, not_open}').
+%%
+%% A Pid that cannot keep up would otherwise see its mailbox grow without
+%% bound.  With `{credits, N}', at most N batches are sent before Pid grants
+%% more with grant/3, or takes batches with receive_batch/3, which grants a
+%% credit back for each one.  Batches sampled while Pid has no credit are
+%% dealt with as `{overflow, Policy}' says: `latest' (the default) keeps only
+%% the newest, `drop_old' keeps the 4 newest and `drop_new' keeps none.  Kept
+%% batches are sent, oldest first, as soon as credit is granted; the others
+%% are counted as `dropped' by schedule_info/2.  Credits do not apply to
+%% `ring' and `record'.
+%% @end
+%%-----------------------------------------------------------------------------
+-spec schedule(Bus::adc_bus(), Pin::adc_pin(), Options::schedule_options(), Pid::pid()) -> ok | {error, Reason::term()}.
+schedule(Bus, Pin, Options, Pid) ->
+    gen_server:call(Bus, {schedule, Pin, Options, Pid}).
+
+%%-----------------------------------------------------------------------------
+%% @param   Bus         the ADC bus
+%% @param   Pin         pin to stop sampling
+%% @returns ok
+%% @doc     Stop periodic sampling of a pin.  A partial batch is discarded.
+%% @end
+%%-----------------------------------------------------------------------------
+-spec unschedule(Bus::adc_bus(), Pin::adc_pin()) -> ok | {error, Reason::term()}.
+unschedule(Bus, Pin) ->
+    gen_server:call(Bus, {unschedule, Pin}).
+
+%%-----------------------------------------------------------------------------
+%% @param   Bus         the ADC bus, or a handle from handle/1
+%% @param   Pin         pin scheduled with `{credits, N}'
+%% @param   Credits     number of further batches the subscriber will take
+%% @returns ok | {error, Reason}
+%% @doc     Let the sampler send a scheduled pin's subscriber more batches.
+%%
+%% Batches held back for want of credit are sent first.  Through the bus the
+%% grant is asynchronous and always returns `ok'; with a handle it returns
+%% `{error, no_flow_control}' if the pin is not scheduled with credits.
+%% @end
+%%-----------------------------------------------------------------------------
+-spec grant(Bus::adc_bus() | adc_handle(), Pin::adc_pin(), Credits::pos_integer()) -> ok | {error, Reason::term()}.
+grant({'$adc', _, _} = Handle, Pin, Credits) ->
+    ?MODULE:nif_grant(Handle, Pin, Credits);
+%% checked here, as a bad grant would otherwise take the bus down
+grant(Bus, Pin, Credits) when is_integer(Pin), is_integer(Credits), Credits > 0, Credits =< 16#FFFFFFFF ->
+    gen_server:cast(Bus, {grant, Pin, Credits}).
+
+%%-----------------------------------------------------------------------------
+%% @param   Bus         the ADC bus, or a handle from handle/1
+%% @param   Pin         pin scheduled to deliver to the calling process
+%% @param   Timeout     how long to wait, in milliseconds or `infinity'
+%% @returns {ok, Readings} | timeout
+%% @doc     Take the next batch of a scheduled pin, and grant a credit back.
+%%
+%% `Readings' is as in the `adc_sched' message.  A subscriber that takes
+%% every batch this way keeps its `{credits, N}' topped up without further
+%% bookkeeping.
+%% @end
+%%-----------------------------------------------------------------------------
+-spec receive_batch(Bus::adc_bus() | adc_handle(), Pin::adc_pin(), Timeout::timeout()) -> {ok, binary()} | timeout.
+receive_batch(Bus, Pin, Timeout) ->
+    receive
+        {adc_sched, Pin, Readings} ->
+            grant(Bus, Pin, 1),
+            {ok, Readings}
+    after Timeout ->
+        timeout
+    end.
+
+%%-----------------------------------------------------------------------------
+%% @param   Bus         the ADC bus
+%% @param   Pin         scheduled pin
+%% @returns {ok, Info} | {error, Reason}
+%% @doc     Timing counters of a scheduled pin.
+%%
+%% `ticks' is the number of periods served, `missed' the number of periods
+%% skipped because the sampler was late, `errors' the number of periods
+%% whose conversion failed, so that they gave no reading, and
+%% `max_jitter_us' and `mean_jitter_us' the lateness of the samples with
+%% respect to their ideal instants.  `dropped' is the number of batches
+%% dropped because the subscriber had no credit (see schedule/4).
+%% @end
+%%-----------------------------------------------------------------------------
+-spec schedule_info(Bus::adc_bus(), Pin::adc_pin()) -> {ok, schedule_info()} | {error, Reason::term()}.
+schedule_info(Bus, Pin) ->
+    gen_server:call(Bus, {schedule_info, Pin}).
+
+%%-----------------------------------------------------------------------------
+%% @param   Bus         the ADC bus
+%% @param   Options     drain options
+%% @returns {ok, Entries} | {error, Reason}
+%% @doc     Collect the readings of pins scheduled with the `ring' option.
+%%
+%% Returns everything currently in the ring (or at most `{max, N}' entries),
+%% oldest first, as a binary of 8-byte entries
+%%
+%%      <<TimestampUs:32/little, Raw:16/little, Pin:8, 0:8>>
+%%
+%% where `TimestampUs' is the low 32 bits of the time of the reading in
+%% microseconds since boot.  It wraps to 0 every 2^32 microseconds (about
+%% 71.6 minutes), so take the difference of two timestamps modulo 2^32,
+%% `(B - A) band 16#FFFFFFFF', rather than comparing them; that is right for
+%% readings less than one wrap apart.  Returns an empty binary if nothing is
+%% buffered.
+%% @end
+%%-----------------------------------------------------------------------------
+-spec drain(Bus::adc_bus(), Options::drain_options()) -> {ok, binary()} | {error, Reason::term()}.
+drain(Bus, Options) ->
+    gen_server:call(Bus, {drain, Options}).
+
+%%-----------------------------------------------------------------------------
+%% @param   Bus         the ADC bus
+%% @returns {ok, Info}
+%% @doc     Fill level and counters of the scheduler ring.
+%%
+%% `size' is the capacity of the ring (0 until a pin is scheduled into it),
+%% `count' the number of entries waiting to be drained, `overruns' the number
+%% of readings dropped because the ring was full, and `high_water' the
+%% highest fill level seen.
+%% @end
+%%-----------------------------------------------------------------------------
+-spec ring_info(Bus::adc_bus()) -> {ok, ring_info()}.
+ring_info(Bus) ->
+    gen_server:call(Bus, ring_info).
+
+%%-----------------------------------------------------------------------------
+%% @param   Bus         the ADC bus
+%% @param   Label       label of a data partition
+%% @returns ok | {error, Reason}
+%% @doc     Open a flash partition as a circular log of recorded samples.
+%%
+%% Pins scheduled with the `record' option append their batches to the log
+%% as blocks, each stamped with a sequence number, the time of its first
+%% reading and the period, and checked by a CRC.  Writing happens on a
+%% native task from preallocated buffers, so recording costs the VM nothing;
+%% a batch that finds all buffers waiting for the flash is dropped.  When the
+%% log is full the oldest 4 KiB sector is erased to make room.  The log
+%% survives reboots: opening it again carries on after the newest block.
+%%
+%% The partition (of any data subtype, at least 8 KiB) stays open until the
+%% bus is stopped, and only one bus may have it open.
+%% @end
+%%-----------------------------------------------------------------------------
+-spec recorder_open(Bus::adc_bus(), Label::string() | binary()) -> ok | {error, Reason::term()}.
+recorder_open(Bus, Label) when is_list(Label) ->
+    recorder_open(Bus, list_to_binary(Label));
+recorder_open(Bus, Label) ->
+    gen_server:call(Bus, {recorder_open, Label}).
+
+%%-----------------------------------------------------------------------------
+%% @param   Bus         the ADC bus
+%% @param   Options     read options
+%% @returns {ok, Blocks} | {error, Reason}
+%% @doc     Read recorded blocks, oldest first.
+%%
+%% Returns up to `{max, N}' (default 32, at most 256) blocks whose sequence
+%% number is at least `{from, Seq}' (default 0), as
+%% `{Seq, Pin, TimeUs, PeriodUs, Samples}' tuples, where `Samples' is a binary
+%% of little-endian unsigned 16-bit raw values.  To page through the log,
+%% pass the last `Seq' returned plus one.  Blocks that fail their CRC are
+%% skipped.
+%%
+%% `Samples' are copied out of the memory-mapped partition, so they keep
+%% their contents after the log wraps over the block.  A block the log wraps
+%% over while it is being read is left out, as if it had failed its CRC.
+%% @end
+%%-----------------------------------------------------------------------------
+-spec recorder_read(Bus::adc_bus(), Options::recorder_read_options()) -> {ok, [recorded_block()]} | {error, Reason::term()}.
+recorder_read(Bus, Options) ->
+    gen_server:call(Bus, {recorder_read, Options}).
+
+%%-----------------------------------------------------------------------------
+%% @param   Bus         the ADC bus
+%% @returns {ok, Info} | {error, Reason}
+%% @doc     Fill level and counters of the recorder.
+%%
+%% `size' and `used' are in bytes, `blocks' is the number of valid blocks,
+%% from `first_seq' to just before `next_seq'.  `dropped' counts batches lost
+%% because the flash was busy, and `write_errors' failed flash writes, since
+%% the recorder was opened.
+%% @end
+%%-----------------------------------------------------------------------------
+-spec recorder_info(Bus::adc_bus()) -> {ok, recorder_info()} | {error, Reason::term()}.
+recorder_info(Bus) ->
+    gen_server:call(Bus, recorder_info).
+
+%%-----------------------------------------------------------------------------
+%% @param   Bus         the ADC bus
+%% @returns {ok, [{Pin, Metrics}]} | {error, Reason}
+%% @doc     Read counters of every pin of the bus read since the last reset.
+%%
+%% For each pin, `reads' is the number of read operations (including
+%% captures, statistics, watch and scheduled reads), `samples' the number of
+%% successful conversions, and `errors' the failed reads by reason.  `time_us'
+%% is the total and `max_us' the longest time spent in a read, and
+%% `latency_us' a 16-tuple histogram of read times whose element N counts
+%% reads that took less than 2^(N-1) microseconds (and at least half that),
+%% the last element counting everything longer.
+%%
+%% Returns `{error, metrics_disabled}' if the counters were disabled in the
+%% component configuration.
+%% @end
+%%-----------------------------------------------------------------------------
+-spec stats(Bus::adc_bus() | adc_handle()) -> {ok, [{adc_pin(), pin_metrics()}]} | {error, Reason::term()}.
+stats({'$adc', _, _} = Handle) ->
+    ?MODULE:nif_stats(Handle);
+stats(Bus) ->
+    gen_server:call(Bus, stats).
+
+%%-----------------------------------------------------------------------------
+%% @param   Bus         the ADC bus
+%% @returns ok | {error, metrics_disabled}
+%% @doc     Zero the read counters of every pin of the bus.
+%%
+%% Returns `{error, metrics_disabled}' if the counters were disabled in the
+%% component configuration.
+%% @end
+%%-----------------------------------------------------------------------------
+-spec reset_stats(Bus::adc_bus()) -> ok | {error, metrics_disabled}.
+reset_stats(Bus) ->
+    gen_server:call(Bus, reset_stats).
+
+%%-----------------------------------------------------------------------------
+%% @returns ok | {error, Reason}
+%% @doc     Hand ADC2 to WiFi.  Call this before starting WiFi.
+%%
+%% From the call on, reads of ADC2 pins on every bus fail with
+%% `{error, timeout}', or wait for wifi_release/0 if they were given a
+%% `{timeout, Ms}' option.  Pins keep their configuration.  This returns once
+%% the ADC2 reads in progress, which may be whole captures, have ended; only
+%% the calling process waits, for a message from the native side.  If the
+%% unit is taken back with wifi_release/0 first, or another handover is
+%% still waiting, `{error, esp_err_invalid_state}' is returned.  A no-op if
+%% ADC2 is not enabled.
+%% @end
+%%-----------------------------------------------------------------------------
+-spec wifi_acquire() -> ok | {error, Reason::term()}.
+wifi_acquire() ->
+    case ?MODULE:nif_wifi_acquire(self()) of
+        {ok, Ref} ->
+            receive
+                {adc2_released, Ref, Result} ->
+                    Result
+            end;
+        Result ->
+            Result
+    end.
+
+%%-----------------------------------------------------------------------------
+%% @returns ok | {error, Reason}
+%% @doc     Take ADC2 back from WiFi.  Call this after stopping WiFi.
+%%
+%% Reads still waiting for the unit are served at once, in one batch.
+%% @end
+%%-----------------------------------------------------------------------------
+-spec wifi_release() -> ok | {error, Reason::term()}.
+wifi_release() ->
+    ?MODULE:nif_wifi_release().
+
+%%-----------------------------------------------------------------------------
+%% @returns true | false
+%% @doc     Whether ADC2 is currently handed to WiFi.
+%% @end
+%%-----------------------------------------------------------------------------
+-spec wifi_owned() -> boolean().
+wifi_owned() ->
+    ?MODULE:nif_wifi_owned().
+
+%%-----------------------------------------------------------------------------
+%% @param   Bus         an ADC bus started with `{backend, simulator}'
+%% @param   Pin         pin to drive
+%% @param   Signal      the signal, or `off'
+%% @returns ok | {error, Reason}
+%% @doc     Drive a pin of the simulator with a signal.
+%%
+%% Offset and Amplitude are raw 12-bit levels; the wave swings Amplitude
+%% either side of Offset, clamped to 0..4095, and reads at a narrower bit
+%% width are scaled down.  `noise' is uniform and repeatable.  `replay'
+%% plays recorded `raw16' samples, such as a capture read returns, or a file
+%% of them, in a loop at RateHz; a file that is missing or empty gives
+%% `{error, esp_err_not_found}'.  Reads sample the signal when they take
+%% place and streams at their sample clock, so a stream of a sine has the
+%% exact frequency asked for.
+%%
+%% The signal drives the pin for every simulator bus on the peripheral, and
+%% stays until set to `off'.  Buses on other backends get
+%% `{error, not_simulated}'.
+%% @end
+%%-----------------------------------------------------------------------------
+-spec simulate(Bus::adc_bus(), Pin::adc_pin(), Signal::signal()) -> ok | {error, Reason::term()}.
+simulate(Bus, Pin, Signal) ->
+    gen_server:call(Bus, {simulate, Pin, Signal}).
+
+%%-----------------------------------------------------------------------------
+%% @param   Bus         the ADC bus
+%% @param   Pins        pins to sample, in pattern order
+%% @param   Options     stream options
+%% @returns {ok, Stream} | {error, Reason}
+%% @doc     Start continuous (DMA) sampling of the given pins.
+%%
+%% The continuous driver walks the pins in order at `{sample_freq_hz, Hz}'
+%% (default 20000) conversions per second.  Each completed DMA frame is sent
+%% to the calling process as a message
+%%
+%%      {adc_stream, Ref, Samples}
+%%
+%% where `Ref' is the reference in the returned `Stream' handle and `Samples'
+%% is a binary of 16-bit little-endian words, one per conversion, holding the
+%% channel number in the top 4 bits and the raw value in the low 12 bits.
+%%
+%% `{frame_size, Bytes}' (default 256) sets the size of a DMA frame, and thus
+%% how many conversions are batched per message; `{pool_size, Bytes}' (default
+%% 1024) sets how much data the driver buffers before frames are dropped.
+%%
+%% With `{timestamps, true}', `Samples' also records when each conversion was
+%% taken, derived from the time the DMA frame completed; see timestamps/1.
+%% A stream of a single pin may instead set `{encoding, Encoding}', in which
+%% case `Samples' holds just the raw values in that encoding; see decode/2.
+%%
+%% With `{demux, true}', the conversions are split by pin natively, and each
+%% frame is sent as
+%%
+%%      {adc_stream, Ref, Lanes, OutOfOrder}
+%%
+%% where `Lanes' is a tuple with one binary of raw values per pin, in the
+%% order of `Pins' (in `{encoding, Encoding}', raw16 by default), and
+%% `OutOfOrder' counts the conversions since the previous message that did
+%% not come in pattern order.  Those are dropped together with the pattern
+%% round they interrupted, so all lanes hold the same number of values
+%% (unless pin filters decimate differently).  Pins may not repeat, and
+%% `{timestamps, true}' is not supported.
+%%
+%% With `{credits, N}', at most N messages are sent before the caller grants
+%% more with grant_stream/2, or takes messages with receive_stream/2, which
+%% grants a credit back for each one.  Frames converted in the meantime are
+%% kept or dropped as `{overflow, Policy}' says, as for schedule/4; kept
+%% frames are sent as soon as credit is granted, with their own timestamps.
+%% stream_info/1 counts the frames dropped.
+%% @end
+%%-----------------------------------------------------------------------------
+-spec start_stream(Bus::adc_bus(), Pins::[adc_pin()], Options::stream_options()) -> {ok, stream()} | {error, Reason::term()}.
+start_stream(Bus, Pins, Options) ->
+    gen_server:call(Bus, {start_stream, Pins, Options, self()}).
+
+%%-----------------------------------------------------------------------------
+%% @param   Stream      stream returned from start_stream/3
+%% @returns ok
+%% @doc     Stop a continuous stream.
+%%
+%% No further `adc_stream' messages are sent once this function returns,
+%% though messages already delivered remain in the owner's mailbox.
+%% @end
+%%-----------------------------------------------------------------------------
+-spec stop_stream(Stream::stream()) -> ok.
+stop_stream(Stream) ->
+    ?MODULE:nif_stream_stop(Stream).
+
+%%-----------------------------------------------------------------------------
+%% @param   Stream      stream started with `{credits, N}'
+%% @param   Credits     number of further messages the owner will take
+%% @returns ok | {error, no_flow_control}
+%% @doc     Let a stream send its owner more messages.
+%%
+%% Frames held back for want of credit are sent first.
+%% @end
+%%-----------------------------------------------------------------------------
+-spec grant_stream(Stream::stream(), Credits::pos_integer()) -> ok | {error, Reason::term()}.
+grant_stream(Stream, Credits) ->
+    ?MODULE:nif_stream_grant(Stream, Credits).
+
+%%-----------------------------------------------------------------------------
+%% @param   Stream      stream started by the calling process
+%% @param   Timeout     how long to wait, in milliseconds or `infinity'
+%% @returns {ok, Samples} | {ok, Lanes, OutOfOrder} | timeout
+%% @doc     Take the next message of a stream, and grant a credit back.
+%%
+%% The results carry the payload of the `adc_stream' message, of either
+%% form.  On a stream without credits no credit is granted, so this is just
+%% a selective receive.
+%% @end
+%%-----------------------------------------------------------------------------
+-spec receive_stream(Stream::stream(), Timeout::timeout()) -> {ok, binary()} | {ok, tuple(), non_neg_integer()} | timeout.
+receive_stream({'$adc_stream', _, Ref} = Stream, Timeout) ->
+    receive
+        {adc_stream, Ref, Samples} ->
+            ?MODULE:nif_stream_grant(Stream, 1),
+            {ok, Samples};
+        {adc_stream, Ref, Lanes, OutOfOrder} ->
+            ?MODULE:nif_stream_grant(Stream, 1),
+            {ok, Lanes, OutOfOrder}
+    after Timeout ->
+        timeout
+    end.
+
+%%-----------------------------------------------------------------------------
+%% @param   Stream      a running stream
+%% @returns {ok, Info}
+%% @doc     Loss counters of a stream.
+%%
+%% `dropped' is the number of frames dropped because the owner had no
+%% credit, and `overflows' the number of frames the driver dropped because
+%% its pool was full.
+%% @end
+%%-----------------------------------------------------------------------------
+-spec stream_info(Stream::stream()) -> {ok, stream_info()}.
+stream_info(Stream) ->
+    ?MODULE:nif_stream_info(Stream).
+
+%%-----------------------------------------------------------------------------
+%% @param   Binary      a capture or stream binary taken with `{timestamps, true}'
+%% @returns {Samples, Timestamps}
+%% @doc     Split a timestamped sample binary into its samples and times.
+%%
+%% `Samples' is the plain 16-bit sample binary, as returned without
+%% timestamps, and `Timestamps' the time of each sample in sample order, in
+%% microseconds since boot (the esp_timer clock).
+%%
+%% On the wire the times take a 64-bit base time and a varint delta per
+%% sample after the first, usually one byte:
+%%
+%%      <<BaseUs:64/little-signed, Count:32/little,
+%%        Samples:Count/binary-unit:16, Deltas/binary>>
+%% @end
+%%-----------------------------------------------------------------------------
+-spec timestamps(Binary::binary()) -> {Samples::binary(), Timestamps::[integer()]}.
+timestamps(<<BaseUs:64/little-signed, Count:32/little, Rest/binary>>) ->
+    SamplesSize = Count * 2,
+    <<Samples:SamplesSize/binary, Deltas/binary>> = Rest,
+    Timestamps = case Count of
+        0 -> [];
+        _ -> [BaseUs | accumulate(decode_varints(Deltas, 0, 0), BaseUs)]
+    end,
+    {Samples, Timestamps}.
+
+%%-----------------------------------------------------------------------------
+%% @param   Binary      samples in the given encoding
+%% @param   Encoding    the `{encoding, Encoding}' the samples were taken with
+%% @returns Samples
+%% @doc     Decode samples to 16-bit little-endian values, as taken with `raw16'.
+%%
+%% The encodings are
+%% <ul>
+%%   <li>`raw16', 2 bytes per sample, the default;</li>
+%%   <li>`packed12', 12 bits per sample: each pair of samples takes 3 bytes,
+%%   `<<ALow:8, BLow:4, AHigh:4, BHigh:8>>', and an odd last sample 2 bytes as
+%%   in `raw16'.  Values above 4095 saturate;</li>
+%%   <li>`delta', the difference of each sample to the one before (the first
+%%   to 0), zigzag mapped to a non negative integer and written as an unsigned
+%%   LEB128 varint: 1 byte for steps within +/-63, 2 bytes within +/-8191.</li>
+%% </ul>
+%% The function does not need the ADC, so host tools may use it as well.
+%% @end
+%%-----------------------------------------------------------------------------
+-spec decode(Binary::binary(), Encoding::encoding()) -> Samples::binary().
+decode(Binary, raw16) ->
+    Binary;
+decode(Binary, packed12) ->
+    PairsSize = byte_size(Binary) div 3 * 3,
+    <<Pairs:PairsSize/binary, Last/binary>> = Binary,
+    Unpacked = << <<((AHigh bsl 8) bor ALow):16/little, ((BHigh bsl 4) bor BLow):16/little>>
+        || <<ALow:8, BLow:4, AHigh:4, BHigh:8>> <= Pairs >>,
+    <<Unpacked/binary, Last/binary>>;
+decode(Binary, delta) ->
+    Deltas = [(Z bsr 1) bxor -(Z band 1) || Z <- decode_varints(Binary, 0, 0)],
+    << <<Sample:16/little>> || Sample <- accumulate(Deltas, 0) >>.
+
+%%-----------------------------------------------------------------------------
+%% @param   Samples     a `raw16' capture
+%% @returns [{Encoding, BytesPerSample}]
+%% @doc     Size the given samples in each encoding, without encoding them.
+%%
+%% `packed12' always takes 1.5 bytes per sample, while `delta' depends on
+%% the signal: it beats `packed12' on slow or quiet signals and loses on
+%% noisy ones.  Comparing the two on a typical capture picks the encoding to
+%% use for a signal.
+%% @end
+%%-----------------------------------------------------------------------------
+-spec bytes_per_sample(Samples::binary()) -> [{encoding(), float()}].
+bytes_per_sample(Samples) ->
+    ?MODULE:nif_bytes_per_sample(Samples).
+
 
 %%
 %% gen_server API
 %%
 
 %% @hidden
-init(Peripheral) ->
-    ADC = adc:init(Peripheral),
-    ?TRACE("ADC opened. ADC_UNIT: ~p", [Peripheral]),
-    State = #state{
-        adc = ADC
-    },
-    {ok, State}.
+init({Peripheral, Options}) ->
+    case ?MODULE:nif_init([{peripheral, Peripheral} | Options]) of
+        {error, _Reason} = Error ->
+            {stop, Error};
+        ADC ->
+            ?TRACE("ADC opened. ADC_UNIT: ~p", [Peripheral]),
+            State = #state{
+                adc = ADC
+            },
+            {ok, State}
+    end.
 
 %% @hidden
-handle_call({read, Pin, ReadOptions}, _From, State) ->
-    Reading = adc:take_reading(State#state.adc, Pin, ReadOptions),
-    ?TRACE("Reply: ~p", [Reading]),
-    {reply, {ok, Reading}, State};
+handle_call({read_async, Pin, ReadOptions, Owner}, _From, State) ->
+    Reply = ?MODULE:nif_take_reading_async(State#state.adc, Pin, ReadOptions, Owner),
+    ?TRACE("Reply: ~p", [Reply]),
+    {reply, Reply, State};
+handle_call({read_many_async, Pins, ReadOptions, Owner}, _From, State) ->
+    Reply = ?MODULE:nif_take_readings_async(State#state.adc, Pins, ReadOptions, Owner),
+    ?TRACE("Reply: ~p", [Reply]),
+    {reply, Reply, State};
 handle_call({config, Pin, Options}, _From, State) ->
-    Reply = adc:config_channel_bitwidth_atten(State#state.adc, Pin, Options),
+    Reply = ?MODULE:nif_config_channel_bitwidth_atten(State#state.adc, Pin, Options),
     ?TRACE("Reply: ~p", [Reply]),
     {reply, Reply, State};
 handle_call({calibration, Pin, Options}, _From, State) ->
-    Reply = adc:config_channel_calibration(State#state.adc, Pin, Options),
+    Reply = ?MODULE:nif_config_channel_calibration(State#state.adc, Pin, Options),
+    ?TRACE("Reply: ~p", [Reply]),
+    {reply, Reply, State};
+handle_call({filter, Pin, Filter}, _From, State) ->
+    Reply = ?MODULE:nif_config_filter(State#state.adc, Pin, Filter),
+    {reply, Reply, State};
+handle_call({dither, Pin}, _From, State) ->
+    Reply = ?MODULE:nif_config_dither(State#state.adc, Pin),
+    {reply, Reply, State};
+handle_call({watch, Pin, Options, Pid}, _From, State) ->
+    Reply = ?MODULE:nif_watch(State#state.adc, Pin, Options, Pid),
+    {reply, Reply, State};
+handle_call({unwatch, Pin}, _From, State) ->
+    Reply = ?MODULE:nif_unwatch(State#state.adc, Pin),
+    {reply, Reply, State};
+handle_call({schedule, Pin, Options, Pid}, _From, State) ->
+    Reply = ?MODULE:nif_schedule(State#state.adc, Pin, Options, Pid),
+    {reply, Reply, State};
+handle_call({unschedule, Pin}, _From, State) ->
+    Reply = ?MODULE:nif_unschedule(State#state.adc, Pin),
+    {reply, Reply, State};
+handle_call({schedule_info, Pin}, _From, State) ->
+    Reply = ?MODULE:nif_schedule_info(State#state.adc, Pin),
+    {reply, Reply, State};
+handle_call({drain, Options}, _From, State) ->
+    Reply = ?MODULE:nif_drain(State#state.adc, Options),
+    {reply, Reply, State};
+handle_call(ring_info, _From, State) ->
+    Reply = ?MODULE:nif_ring_info(State#state.adc),
+    {reply, Reply, State};
+handle_call({recorder_open, Label}, _From, State) ->
+    Reply = ?MODULE:nif_recorder_open(State#state.adc, Label),
+    {reply, Reply, State};
+handle_call({recorder_read, Options}, _From, State) ->
+    Reply = ?MODULE:nif_recorder_read(State#state.adc, Options),
+    {reply, Reply, State};
+handle_call(recorder_info, _From, State) ->
+    Reply = ?MODULE:nif_recorder_info(State#state.adc),
+    {reply, Reply, State};
+handle_call(stats, _From, State) ->
+    Reply = ?MODULE:nif_stats(State#state.adc),
+    {reply, Reply, State};
+handle_call(reset_stats, _From, State) ->
+    Reply = ?MODULE:nif_reset_stats(State#state.adc),
+    {reply, Reply, State};
+handle_call({simulate, Pin, Signal}, _From, State) ->
+    Reply = ?MODULE:nif_simulate(State#state.adc, Pin, Signal),
+    {reply, Reply, State};
+handle_call(handle, _From, State) ->
+    {reply, {ok, State#state.adc}, State};
+handle_call({start_stream, Pins, Options, Owner}, _From, State) ->
+    Reply = ?MODULE:nif_stream_start(State#state.adc, Pins, [{owner, Owner} | Options]),
     ?TRACE("Reply: ~p", [Reply]),
     {reply, Reply, State};
 handle_call(Request, _From, State) ->
     {reply, {error, {unknown_request, Request}}, State}.
 
 %% @hidden
+handle_cast({grant, Pin, Credits}, State) ->
+    ?MODULE:nif_grant(State#state.adc, Pin, Credits),
+    {noreply, State};
 handle_cast(_Msg, State) ->
     {noreply, State}.
 
@@ -231,15 +1134,164 @@ handle_info(_Info, State) ->
 %% @hidden
 terminate(_Reason, State) ->
     io:format("Closing ADC ... ~n"),
-    adc:close(State#state.adc),
+    ?MODULE:nif_close(State#state.adc),
     ok.
 
 %% @hidden
 code_change(_OldVsn, State, _Extra) ->
     {ok, State}.
 
+%%
+%% internal operations, shared by the bus and direct calls on a handle
+%%
+
+%% @private
+await_reading({ok, Ref}, ReadOptions) ->
+    Timeout = proplists:get_value(timeout, ReadOptions, 0) + ?READ_REPLY_GRACE_MS,
+    receive
+        {adc_reading, Ref, Result} ->
+            Result
+    after Timeout ->
+        {error, timeout}
+    end;
+await_reading(Error, _ReadOptions) ->
+    Error.
+
+%% @private
+decode_varints(<<>>, 0, 0) ->
+    [];
+decode_varints(<<1:1, Bits:7, Rest/binary>>, Acc, Shift) ->
+    decode_varints(Rest, Acc bor (Bits bsl Shift), Shift + 7);
+decode_varints(<<0:1, Bits:7, Rest/binary>>, Acc, Shift) ->
+    [Acc bor (Bits bsl Shift) | decode_varints(Rest, 0, 0)].
+
+%% @private
+accumulate([], _Sum) ->
+    [];
+accumulate([X | Tail], Sum) ->
+    Next = Sum + X,
+    [Next | accumulate(Tail, Next)].
+
 %%
 %% internal nif API operations
 %%
 
+%% @hidden
+nif_init(_Options) ->
+    erlang:nif_error(undefined).
+
+%% @hidden
+nif_close(_ADC) ->
+    erlang:nif_error(undefined).
+
+%% @hidden
+nif_config_channel_bitwidth_atten(_ADC, _Pin, _Options) ->
+    erlang:nif_error(undefined).
+
+%% @hidden
+nif_config_channel_calibration(_ADC, _Pin, _Options) ->
+    erlang:nif_error(undefined).
+
+%% @hidden
+nif_config_filter(_ADC, _Pin, _Filter) ->
+    erlang:nif_error(undefined).
+
+%% @hidden
+nif_config_dither(_ADC, _Pin) ->
+    erlang:nif_error(undefined).
+
+%% @hidden
+nif_take_reading_async(_ADC, _Pin, _ReadOptions, _Owner) ->
+    erlang:nif_error(undefined).
+
+%% @hidden
+nif_take_readings_async(_ADC, _Pins, _ReadOptions, _Owner) ->
+    erlang:nif_error(undefined).
+
+%% @hidden
+nif_stream_start(_ADC, _Pins, _Options) ->
+    erlang:nif_error(undefined).
+
+%% @hidden
+nif_stream_stop(_Stream) ->
+    erlang:nif_error(undefined).
+
+%% @hidden
+nif_stream_grant(_Stream, _Credits) ->
+    erlang:nif_error(undefined).
+
+%% @hidden
+nif_stream_info(_Stream) ->
+    erlang:nif_error(undefined).
+
+%% @hidden
+nif_watch(_ADC, _Pin, _Options, _Pid) ->
+    erlang:nif_error(undefined).
+
+%% @hidden
+nif_unwatch(_ADC, _Pin) ->
+    erlang:nif_error(undefined).
+
+%% @hidden
+nif_schedule(_ADC, _Pin, _Options, _Pid) ->
+    erlang:nif_error(undefined).
+
+%% @hidden
+nif_unschedule(_ADC, _Pin) ->
+    erlang:nif_error(undefined).
+
+%% @hidden
+nif_grant(_ADC, _Pin, _Credits) ->
+    erlang:nif_error(undefined).
+
+%% @hidden
+nif_schedule_info(_ADC, _Pin) ->
+    erlang:nif_error(undefined).
+
+%% @hidden
+nif_drain(_ADC, _Options) ->
+    erlang:nif_error(undefined).
+
+%% @hidden
+nif_ring_info(_ADC) ->
+    erlang:nif_error(undefined).
 
+%% @hidden
+nif_recorder_open(_ADC, _Label) ->
+    erlang:nif_error(undefined).
+
+%% @hidden
+nif_recorder_read(_ADC, _Options) ->
+    erlang:nif_error(undefined).
+
+%% @hidden
+nif_recorder_info(_ADC) ->
+    erlang:nif_error(undefined).
+
+%% @hidden
+nif_stats(_ADC) ->
+    erlang:nif_error(undefined).
+
+%% @hidden
+nif_reset_stats(_ADC) ->
+    erlang:nif_error(undefined).
+
+%% @hidden
+nif_wifi_acquire(_Owner) ->
+    erlang:nif_error(undefined).
+
+%% @hidden
+nif_wifi_release() ->
+    erlang:nif_error(undefined).
+
+%% @hidden
+nif_wifi_owned() ->
+    erlang:nif_error(undefined).
+
+%% @hidden
+nif_bytes_per_sample(_Samples) ->
+    erlang:nif_error(undefined).
+
+%% @hidden
+nif_simulate(_ADC, _Pin, _Signal) ->
+    erlang:nif_error(undefined).